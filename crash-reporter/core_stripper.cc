@@ -0,0 +1,311 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/core_stripper.h"
+
+#include <bits/wordsize.h>
+#include <fcntl.h>
+#include <sys/procfs.h>
+#include <sys/stat.h>
+#include <sys/user.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+using base::FilePath;
+
+namespace {
+
+using Ehdr = ElfW(Ehdr);
+using Phdr = ElfW(Phdr);
+using Nhdr = ElfW(Nhdr);
+
+// Upper bound on the size of the head of the core, which is held in memory.
+// The notes of a process with hundreds of threads and thousands of mappings
+// take well under a megabyte.
+const uint64_t kMaxHeadSize = 16 * 1024 * 1024;
+
+const size_t kCopyBufferSize = 64 * 1024;
+
+// Size of the beginning of a code mapping that is kept.  It holds the ELF and
+// program headers of the mapped object, which core2md reads to find the
+// dynamic linker's data.
+const uint64_t kFilePageSize = 4096;
+
+#if __WORDSIZE == 64
+const unsigned char kNativeClass = ELFCLASS64;
+#else
+const unsigned char kNativeClass = ELFCLASS32;
+#endif
+
+// Returns the stack pointer saved in the NT_PRSTATUS note description |desc|
+// of |size| bytes.
+bool GetStackPointer(const char *desc, size_t size, uint64_t *sp) {
+  struct elf_prstatus status;
+  if (size < sizeof(status))
+    return false;
+  memcpy(&status, desc, sizeof(status));
+#if defined(__x86_64__)
+  *sp = reinterpret_cast<const struct user_regs_struct *>(&status.pr_reg)->rsp;
+#elif defined(__i386__)
+  *sp = reinterpret_cast<const struct user_regs_struct *>(&status.pr_reg)->esp;
+#elif defined(__aarch64__)
+  *sp = reinterpret_cast<const struct user_regs_struct *>(&status.pr_reg)->sp;
+#elif defined(__arm__)
+  *sp = status.pr_reg[13];
+#else
+  return false;
+#endif
+  return true;
+}
+
+// Rounds |offset| up to a multiple of |align|.
+uint64_t Align(uint64_t offset, uint64_t align) {
+  if (align <= 1 || offset % align == 0)
+    return offset;
+  return offset + align - offset % align;
+}
+
+}  // namespace
+
+CoreStripper::CoreStripper(int input_fd) : input_fd_(input_fd) {}
+
+bool CoreStripper::WriteTo(const FilePath &core_path, bool strip) {
+  base::ScopedFD output(HANDLE_EINTR(open(core_path.value().c_str(),
+                                          O_CREAT | O_WRONLY | O_TRUNC |
+                                              O_EXCL | O_CLOEXEC,
+                                          0666)));
+  if (!output.is_valid()) {
+    PLOG(ERROR) << "Could not create " << core_path.value();
+    return false;
+  }
+
+  if (!strip || !ReadHead() || !StripSegments()) {
+    // Copy what was read so far and the rest of the input unchanged.
+    if (!base::WriteFileDescriptor(output.get(), head_.data(), head_.size())) {
+      PLOG(ERROR) << "Could not write core file";
+      return false;
+    }
+    bytes_written_ += head_.size();
+    return Copy(output.get(), kCopyAll);
+  }
+
+  if (!base::WriteFileDescriptor(output.get(), head_.data(), head_.size())) {
+    PLOG(ERROR) << "Could not write core file";
+    return false;
+  }
+  bytes_written_ += head_.size();
+
+  const Ehdr *ehdr = reinterpret_cast<const Ehdr *>(head_.data());
+  for (size_t i = 1; i < ehdr->e_phnum; ++i) {
+    // Copy |phdr| out of |head_|, which the loop doesn't modify.
+    Phdr phdr;
+    memcpy(&phdr, head_.data() + ehdr->e_phoff + i * sizeof(Phdr),
+           sizeof(phdr));
+    if (phdr.p_filesz == 0)
+      continue;
+    if (!Copy(-1, original_offsets_[i] - bytes_read_) ||
+        lseek(output.get(), phdr.p_offset, SEEK_SET) !=
+            static_cast<off_t>(phdr.p_offset) ||
+        !Copy(output.get(), phdr.p_filesz)) {
+      PLOG(ERROR) << "Could not copy segment " << i;
+      return false;
+    }
+  }
+  // Let the kernel finish writing the core.
+  return Copy(-1, kCopyAll);
+}
+
+bool CoreStripper::ReadHead() {
+  if (!ReadToHead(sizeof(Ehdr)))
+    return false;
+  Ehdr ehdr;
+  memcpy(&ehdr, head_.data(), sizeof(ehdr));
+  if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr.e_ident[EI_CLASS] != kNativeClass ||
+      ehdr.e_type != ET_CORE ||
+      ehdr.e_phentsize != sizeof(Phdr) ||
+      ehdr.e_phnum == 0 || ehdr.e_phnum == PN_XNUM ||
+      ehdr.e_phoff < sizeof(Ehdr)) {
+    LOG(WARNING) << "Unexpected core file header, not stripping";
+    return false;
+  }
+
+  uint64_t phdrs_end = ehdr.e_phoff + ehdr.e_phnum * sizeof(Phdr);
+  if (phdrs_end > kMaxHeadSize) {
+    LOG(WARNING) << "Too many program headers, not stripping";
+    return false;
+  }
+  if (!ReadToHead(phdrs_end))
+    return false;
+
+  // The kernel writes the notes as the first segment, right after the
+  // program headers.
+  Phdr note;
+  memcpy(&note, head_.data() + ehdr.e_phoff, sizeof(note));
+  if (note.p_type != PT_NOTE || note.p_offset < phdrs_end ||
+      note.p_offset + note.p_filesz > kMaxHeadSize) {
+    LOG(WARNING) << "Unexpected core file layout, not stripping";
+    return false;
+  }
+  return ReadToHead(note.p_offset + note.p_filesz);
+}
+
+void CoreStripper::ParseNotes() {
+  const Ehdr *ehdr = reinterpret_cast<const Ehdr *>(head_.data());
+  Phdr note;
+  memcpy(&note, head_.data() + ehdr->e_phoff, sizeof(note));
+
+  const char *data = head_.data() + note.p_offset;
+  size_t size = note.p_filesz;
+  while (size >= sizeof(Nhdr)) {
+    Nhdr nhdr;
+    memcpy(&nhdr, data, sizeof(nhdr));
+    // Names and descriptions are padded to 4 bytes in core files.
+    size_t desc_offset = sizeof(nhdr) + Align(nhdr.n_namesz, 4);
+    size_t note_size = desc_offset + Align(nhdr.n_descsz, 4);
+    if (note_size > size)
+      break;
+    const char *desc = data + desc_offset;
+
+    uint64_t sp;
+    if (nhdr.n_type == NT_PRSTATUS &&
+        GetStackPointer(desc, nhdr.n_descsz, &sp)) {
+      stack_pointers_.push_back(sp);
+    } else if (nhdr.n_type == NT_FILE) {
+      // A count and a page size, followed by |count| (start, end, offset)
+      // triples and the file names.  See fill_files_note() in the kernel.
+      const size_t kWord = sizeof(ElfW(Addr));
+      ElfW(Addr) count = 0;
+      if (nhdr.n_descsz >= 2 * kWord)
+        memcpy(&count, desc, kWord);
+      if (count > (nhdr.n_descsz - 2 * kWord) / (3 * kWord))
+        count = 0;
+      for (size_t i = 0; i < count; ++i) {
+        ElfW(Addr) range[2];
+        memcpy(range, desc + (2 + 3 * i) * kWord, sizeof(range));
+        file_ranges_.emplace_back(range[0], range[1]);
+      }
+    }
+    data += note_size;
+    size -= note_size;
+  }
+  std::sort(file_ranges_.begin(), file_ranges_.end());
+}
+
+uint64_t CoreStripper::GetKeptSize(const Phdr &phdr) const {
+  if (phdr.p_type != PT_LOAD)
+    return phdr.p_filesz;
+  const uint64_t start = phdr.p_vaddr;
+  const uint64_t end = phdr.p_vaddr + phdr.p_memsz;
+  for (uint64_t sp : stack_pointers_) {
+    if (sp >= start && sp < end)
+      return phdr.p_filesz;
+  }
+  // The kernel dumps one segment per mapping, so a file-backed segment
+  // matches a range of the NT_FILE note exactly.
+  if (std::binary_search(file_ranges_.begin(), file_ranges_.end(),
+                         std::make_pair(start, end))) {
+    // Code is never written to, so the rest of it can be read from the file.
+    if ((phdr.p_flags & (PF_W | PF_X)) == PF_X)
+      return std::min<uint64_t>(phdr.p_filesz, kFilePageSize);
+    // With the default coredump_filter, the kernel only dumps other file
+    // mappings in full if the process wrote to them.  They hold relocated
+    // data, such as the GOT and the dynamic section through which core2md
+    // finds the link map, even once RELRO made them read-only.
+    return phdr.p_filesz;
+  }
+  // Without stack pointers, there's no telling where the stacks are.
+  if (phdr.p_filesz <= kMaxKeptSegmentSize || stack_pointers_.empty())
+    return phdr.p_filesz;
+  return 0;
+}
+
+bool CoreStripper::StripSegments() {
+  ParseNotes();
+
+  const Ehdr *ehdr = reinterpret_cast<const Ehdr *>(head_.data());
+  Phdr *phdrs = reinterpret_cast<Phdr *>(head_.data() + ehdr->e_phoff);
+  const uint64_t head_size = head_.size();
+
+  // Check that segments can be read in order first, since |head_| must be
+  // left unchanged if the core is to be copied as is.
+  uint64_t previous_end = head_size;
+  for (size_t i = 1; i < ehdr->e_phnum; ++i) {
+    Phdr phdr;
+    memcpy(&phdr, &phdrs[i], sizeof(phdr));
+    if (phdr.p_filesz == 0)
+      continue;
+    if (phdr.p_offset < previous_end) {
+      LOG(WARNING) << "Unexpected core file layout, not stripping";
+      return false;
+    }
+    previous_end = phdr.p_offset + phdr.p_filesz;
+  }
+
+  original_offsets_.resize(ehdr->e_phnum);
+  uint64_t offset = head_size;
+  for (size_t i = 1; i < ehdr->e_phnum; ++i) {
+    Phdr phdr;
+    memcpy(&phdr, &phdrs[i], sizeof(phdr));
+    original_offsets_[i] = phdr.p_offset;
+    phdr.p_filesz = GetKeptSize(phdr);
+    offset = Align(offset, phdr.p_align);
+    phdr.p_offset = offset;
+    offset += phdr.p_filesz;
+    memcpy(&phdrs[i], &phdr, sizeof(phdr));
+  }
+  return true;
+}
+
+bool CoreStripper::ReadToHead(size_t size) {
+  while (head_.size() < size) {
+    size_t offset = head_.size();
+    head_.resize(size);
+    ssize_t count = HANDLE_EINTR(
+        read(input_fd_, head_.data() + offset, size - offset));
+    head_.resize(offset + std::max<ssize_t>(count, 0));
+    if (count < 0) {
+      PLOG(ERROR) << "Could not read core file";
+      return false;
+    }
+    if (count == 0) {
+      LOG(ERROR) << "Core file is truncated";
+      return false;
+    }
+    bytes_read_ += count;
+  }
+  return true;
+}
+
+bool CoreStripper::Copy(int output_fd, uint64_t size) {
+  char buffer[kCopyBufferSize];
+  while (size > 0) {
+    ssize_t count = HANDLE_EINTR(
+        read(input_fd_, buffer, std::min<uint64_t>(size, sizeof(buffer))));
+    if (count < 0) {
+      PLOG(ERROR) << "Could not read core file";
+      return false;
+    }
+    if (count == 0)
+      return size == kCopyAll;
+    bytes_read_ += count;
+    if (size != kCopyAll)
+      size -= count;
+    if (output_fd < 0)
+      continue;
+    if (!base::WriteFileDescriptor(output_fd, buffer, count)) {
+      PLOG(ERROR) << "Could not write core file";
+      return false;
+    }
+    bytes_written_ += count;
+  }
+  return true;
+}
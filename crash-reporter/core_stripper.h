@@ -0,0 +1,93 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRASH_REPORTER_CORE_STRIPPER_H_
+#define CRASH_REPORTER_CORE_STRIPPER_H_
+
+#include <elf.h>
+#include <link.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/macros.h>
+
+// Streams an ELF core dump from a pipe to a file, leaving out the memory that
+// core2md doesn't need to generate a minidump, so that large cores are never
+// written out in full.
+//
+// Kept are the notes (thread registers, auxv, file mappings), the segments
+// holding a thread's stack, small segments such as the vDSO, the data of file
+// mappings, including relocated data made read-only by RELRO, and the first
+// page of code mappings.  Left out are the rest of code mappings, whose
+// contents are on disk, and large segments no thread's stack is in, which are
+// mostly heap.  Segments keep
+// their program header with less or no file data, as core2md and gdb expect
+// of memory the kernel didn't dump.
+//
+// A core that doesn't have the layout written by the kernel's
+// fs/binfmt_elf.c is copied unchanged.
+class CoreStripper {
+ public:
+  // Segments up to this size are kept even if no thread's stack is in them.
+  static const uint64_t kMaxKeptSegmentSize = 1024 * 1024;
+
+  // The core is read from |input_fd|, which is not closed.
+  explicit CoreStripper(int input_fd);
+
+  // Writes the core to a new file at |core_path|.  If |strip| is false, the
+  // core is copied unchanged.  Reads the input until its end in any case.
+  // Returns false on error, possibly leaving a partial file behind.
+  bool WriteTo(const base::FilePath &core_path, bool strip);
+
+  uint64_t bytes_read() const { return bytes_read_; }
+  // Does not count the holes left to align segments in the output.
+  uint64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  // Reads the ELF header, the program headers, and the PT_NOTE segment
+  // following them into |head_|.  Returns false if the core doesn't have the
+  // expected layout.
+  bool ReadHead();
+
+  // Rewrites the program headers in |head_| so that only needed segments have
+  // file data, packed after the head.  Returns false if segments are not
+  // stored in order after the head.
+  bool StripSegments();
+
+  // Fills |stack_pointers_| and |file_ranges_| from the notes in |head_|.
+  void ParseNotes();
+
+  // Returns the number of bytes at the beginning of segment |phdr| to keep
+  // in the stripped core.
+  uint64_t GetKeptSize(const ElfW(Phdr) &phdr) const;
+
+  // Reads input into |head_| until it holds |size| bytes.
+  bool ReadToHead(size_t size);
+
+  // Copies |size| bytes of input to |output_fd| at its current offset, or
+  // discards them if |output_fd| is negative.  Copies until the end of the
+  // input if |size| is kCopyAll.
+  static const uint64_t kCopyAll = UINT64_MAX;
+  bool Copy(int output_fd, uint64_t size);
+
+  const int input_fd_;
+  uint64_t bytes_read_ = 0;
+  uint64_t bytes_written_ = 0;
+
+  // Beginning of the input, up to the end of the notes.
+  std::vector<char> head_;
+  // Original offset of each segment, in program header order.
+  std::vector<uint64_t> original_offsets_;
+  // Stack pointers of the threads in the core.
+  std::vector<uint64_t> stack_pointers_;
+  // Address ranges mapped to files, sorted.
+  std::vector<std::pair<uint64_t, uint64_t>> file_ranges_;
+
+  DISALLOW_COPY_AND_ASSIGN(CoreStripper);
+};
+
+#endif  // CRASH_REPORTER_CORE_STRIPPER_H_
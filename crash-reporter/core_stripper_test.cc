@@ -0,0 +1,253 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/core_stripper.h"
+
+#include <bits/wordsize.h>
+#include <fcntl.h>
+#include <sys/procfs.h>
+#include <sys/user.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
+#include <base/files/scoped_temp_dir.h>
+#include <gtest/gtest.h>
+
+using base::FilePath;
+
+namespace {
+
+using Ehdr = ElfW(Ehdr);
+using Phdr = ElfW(Phdr);
+using Nhdr = ElfW(Nhdr);
+
+const uint64_t kPageSize = 4096;
+
+const uint64_t kCodeAddress = 0x10000;
+const uint64_t kRelroAddress = 0x14000;
+const uint64_t kStackAddress = 0x20000;
+const uint64_t kHeapAddress = 0x100000;
+const uint64_t kDataAddress = 0x400000;
+
+const char kMappedFile[] = "/lib/libfoo.so";
+
+// Appends the note of |type| with description |desc| to |notes|.
+void AppendNote(uint32_t type, const std::string &desc, std::string *notes) {
+  Nhdr nhdr = {};
+  nhdr.n_namesz = 5;  // "CORE" and its terminator.
+  nhdr.n_descsz = desc.size();
+  nhdr.n_type = type;
+  notes->append(reinterpret_cast<const char *>(&nhdr), sizeof(nhdr));
+  notes->append("CORE\0\0\0", 8);
+  notes->append(desc);
+  notes->resize((notes->size() + 3) & ~3);
+}
+
+// Returns |size| bytes of segment data identifying |address|.
+std::string SegmentData(uint64_t address, uint64_t size) {
+  std::string data(size, static_cast<char>(address >> 12));
+  memcpy(&data[0], &address, sizeof(address));
+  return data;
+}
+
+class CoreStripperTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    input_path_ = temp_dir_.path().Append("input");
+    output_path_ = temp_dir_.path().Append("output");
+  }
+
+  // Writes a core with a note segment, a code and a RELRO file mapping, a
+  // thread stack, a large heap segment and a small data segment.
+  void WriteCore() {
+    std::string notes;
+    struct elf_prstatus status = {};
+    const uint64_t sp = kStackAddress + 0x1800;
+#if defined(__x86_64__)
+    reinterpret_cast<struct user_regs_struct *>(&status.pr_reg)->rsp = sp;
+#elif defined(__i386__)
+    reinterpret_cast<struct user_regs_struct *>(&status.pr_reg)->esp = sp;
+#elif defined(__aarch64__)
+    reinterpret_cast<struct user_regs_struct *>(&status.pr_reg)->sp = sp;
+#elif defined(__arm__)
+    status.pr_reg[13] = sp;
+#endif
+    AppendNote(NT_PRSTATUS,
+               std::string(reinterpret_cast<const char *>(&status),
+                           sizeof(status)),
+               &notes);
+    const ElfW(Addr) file_note[] = {
+      2, kPageSize,
+      kCodeAddress, kCodeAddress + 4 * kPageSize, 0,
+      kRelroAddress, kRelroAddress + 2 * kPageSize, 4,
+    };
+    std::string file_desc(reinterpret_cast<const char *>(file_note),
+                          sizeof(file_note));
+    file_desc.append(kMappedFile, sizeof(kMappedFile));
+    file_desc.append(kMappedFile, sizeof(kMappedFile));
+    AppendNote(NT_FILE, file_desc, &notes);
+
+    struct {
+      uint64_t address;
+      uint64_t size;
+      uint32_t flags;
+    } segments[] = {
+      { kCodeAddress, 4 * kPageSize, PF_R | PF_X },
+      { kRelroAddress, 2 * kPageSize, PF_R },
+      { kStackAddress, 2 * kPageSize, PF_R | PF_W },
+      { kHeapAddress, 2 * CoreStripper::kMaxKeptSegmentSize, PF_R | PF_W },
+      { kDataAddress, kPageSize, PF_R | PF_W },
+    };
+    const size_t num_phdrs = 1 + arraysize(segments);
+
+    Ehdr ehdr = {};
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+#if __WORDSIZE == 64
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+#else
+    ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+#endif
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_CORE;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_phoff = sizeof(ehdr);
+    ehdr.e_ehsize = sizeof(ehdr);
+    ehdr.e_phentsize = sizeof(Phdr);
+    ehdr.e_phnum = num_phdrs;
+
+    std::string phdrs;
+    std::string data;
+    uint64_t offset = sizeof(ehdr) + num_phdrs * sizeof(Phdr);
+    Phdr note = {};
+    note.p_type = PT_NOTE;
+    note.p_offset = offset;
+    note.p_filesz = notes.size();
+    phdrs.append(reinterpret_cast<const char *>(&note), sizeof(note));
+    data = notes;
+    offset += notes.size();
+    for (const auto &segment : segments) {
+      offset = (offset + kPageSize - 1) & ~(kPageSize - 1);
+      data.resize(offset - sizeof(ehdr) - num_phdrs * sizeof(Phdr));
+      Phdr phdr = {};
+      phdr.p_type = PT_LOAD;
+      phdr.p_flags = segment.flags;
+      phdr.p_offset = offset;
+      phdr.p_vaddr = segment.address;
+      phdr.p_filesz = segment.size;
+      phdr.p_memsz = segment.size;
+      phdr.p_align = kPageSize;
+      phdrs.append(reinterpret_cast<const char *>(&phdr), sizeof(phdr));
+      data.append(SegmentData(segment.address, segment.size));
+      offset += segment.size;
+    }
+
+    core_.assign(reinterpret_cast<const char *>(&ehdr), sizeof(ehdr));
+    core_.append(phdrs);
+    core_.append(data);
+    ASSERT_EQ(static_cast<int>(core_.size()),
+              base::WriteFile(input_path_, core_.data(), core_.size()));
+  }
+
+  // Runs a CoreStripper over the input file and reads its output.
+  void Strip(bool strip, std::string *output) {
+    base::ScopedFD input(open(input_path_.value().c_str(), O_RDONLY));
+    ASSERT_TRUE(input.is_valid());
+    CoreStripper stripper(input.get());
+    ASSERT_TRUE(stripper.WriteTo(output_path_, strip));
+    ASSERT_TRUE(base::ReadFileToString(output_path_, output));
+    EXPECT_EQ(core_.size(), stripper.bytes_read());
+    // Alignment padding is left as holes, which are not written.
+    EXPECT_GE(output->size(), stripper.bytes_written());
+  }
+
+  // Returns the program header for the segment at |address| in |core|.
+  static Phdr FindSegment(const std::string &core, uint64_t address) {
+    Ehdr ehdr;
+    memcpy(&ehdr, core.data(), sizeof(ehdr));
+    for (size_t i = 0; i < ehdr.e_phnum; ++i) {
+      Phdr phdr;
+      memcpy(&phdr, core.data() + ehdr.e_phoff + i * sizeof(phdr),
+             sizeof(phdr));
+      if (phdr.p_type == PT_LOAD && phdr.p_vaddr == address)
+        return phdr;
+    }
+    ADD_FAILURE() << "No segment at " << address;
+    return Phdr();
+  }
+
+  base::ScopedTempDir temp_dir_;
+  FilePath input_path_;
+  FilePath output_path_;
+  std::string core_;
+};
+
+}  // namespace
+
+TEST_F(CoreStripperTest, CopiesUnchanged) {
+  WriteCore();
+  std::string output;
+  Strip(false, &output);
+  EXPECT_EQ(core_, output);
+}
+
+TEST_F(CoreStripperTest, KeepsOnlyNeededSegments) {
+  WriteCore();
+  std::string output;
+  Strip(true, &output);
+  EXPECT_LT(output.size(), core_.size() / 2);
+
+  // The head, up to the end of the notes, is unchanged but for the program
+  // headers of the segments.
+  Ehdr ehdr;
+  memcpy(&ehdr, output.data(), sizeof(ehdr));
+  EXPECT_EQ(0, memcmp(output.data(), core_.data(), sizeof(ehdr)));
+  Phdr note;
+  memcpy(&note, output.data() + ehdr.e_phoff, sizeof(note));
+  EXPECT_EQ(PT_NOTE, note.p_type);
+  EXPECT_EQ(core_.substr(note.p_offset, note.p_filesz),
+            output.substr(note.p_offset, note.p_filesz));
+
+  EXPECT_EQ(0u, FindSegment(output, kHeapAddress).p_filesz);
+
+  // Only the first page of the code mapping is kept.
+  const Phdr code = FindSegment(output, kCodeAddress);
+  EXPECT_EQ(kPageSize, code.p_filesz);
+  EXPECT_EQ(4 * kPageSize, code.p_memsz);
+
+  for (const Phdr &phdr : { code,
+                            FindSegment(output, kStackAddress),
+                            FindSegment(output, kDataAddress) }) {
+    EXPECT_EQ(0u, phdr.p_offset % kPageSize);
+    ASSERT_LE(phdr.p_offset + phdr.p_filesz, output.size());
+    EXPECT_EQ(SegmentData(phdr.p_vaddr, phdr.p_memsz).substr(0, phdr.p_filesz),
+              output.substr(phdr.p_offset, phdr.p_filesz));
+  }
+}
+
+TEST_F(CoreStripperTest, KeepsRelroSegments) {
+  WriteCore();
+  std::string output;
+  Strip(true, &output);
+
+  // Made read-only after relocation, the mapping holds data such as the
+  // dynamic section that is not in the file.
+  const Phdr relro = FindSegment(output, kRelroAddress);
+  EXPECT_EQ(2 * kPageSize, relro.p_filesz);
+  ASSERT_LE(relro.p_offset + relro.p_filesz, output.size());
+  EXPECT_EQ(SegmentData(kRelroAddress, 2 * kPageSize),
+            output.substr(relro.p_offset, relro.p_filesz));
+}
+
+TEST_F(CoreStripperTest, CopiesUnexpectedInputUnchanged) {
+  core_ = "not a core file";
+  ASSERT_EQ(static_cast<int>(core_.size()),
+            base::WriteFile(input_path_, core_.data(), core_.size()));
+  std::string output;
+  Strip(true, &output);
+  EXPECT_EQ(core_, output);
+}
@@ -31,9 +31,13 @@
       },
       'sources': [
         'chrome_collector.cc',
+        'core_stripper.cc',
         'crash_collector.cc',
+        'crash_rate_limiter.cc',
         'kernel_collector.cc',
+        'kernel_log_analyzer.cc',
         'kernel_warning_collector.cc',
+        'log_command.cc',
         'udev_collector.cc',
         'unclean_shutdown_collector.cc',
         'user_collector.cc',
@@ -154,11 +158,14 @@
           'dependencies': ['libcrash'],
           'sources': [
             'chrome_collector_test.cc',
+            'core_stripper_test.cc',
             'crash_collector_test.cc',
             'crash_collector_test.h',
+            'crash_rate_limiter_test.cc',
             'crash_reporter_logs_test.cc',
             'kernel_collector_test.cc',
             'kernel_collector_test.h',
+            'kernel_log_analyzer_test.cc',
             'testrunner.cc',
             'udev_collector_test.cc',
             'unclean_shutdown_collector_test.cc',
@@ -172,6 +179,22 @@
             }],
           ],
         },
+        {
+          'target_name': 'core_stripper_benchmark',
+          'type': 'executable',
+          'dependencies': ['libcrash'],
+          'sources': [
+            'core_stripper_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'kernel_log_analyzer_benchmark',
+          'type': 'executable',
+          'dependencies': ['libcrash'],
+          'sources': [
+            'kernel_log_analyzer_benchmark.cc',
+          ],
+        },
       ],
     }],
   ],
@@ -26,7 +26,8 @@
 #include <base/strings/stringprintf.h>
 #include <brillo/cryptohome.h>
 #include <brillo/key_value_store.h>
-#include <brillo/process.h>
+
+#include "crash-reporter/log_command.h"
 
 namespace {
 
@@ -36,8 +37,8 @@ const char kCrashTestInProgressPath[] = "/tmp/crash-test-in-progress";
 const char kDefaultLogConfig[] = "/etc/crash_reporter_logs.conf";
 const char kDefaultUserName[] = "chronos";
 const char kLeaveCoreFile[] = "/root/.leave_core";
+const char kLogCacheDirectory[] = "/var/run/crash_reporter/log_cache";
 const char kLsbRelease[] = "/etc/lsb-release";
-const char kShellPath[] = "/bin/sh";
 const char kSystemCrashPath[] = "/var/spool/crash";
 const char kUploadVarPrefix[] = "upload_var_";
 const char kUploadTextPrefix[] = "upload_text_";
@@ -91,6 +92,7 @@ CrashCollector::CrashCollector()
 CrashCollector::CrashCollector(bool force_user_crash_dir)
     : lsb_release_(kLsbRelease),
       log_config_path_(kDefaultLogConfig),
+      log_cache_directory_(kLogCacheDirectory),
       force_user_crash_dir_(force_user_crash_dir) {
 }
 
@@ -414,6 +416,13 @@ bool CrashCollector::CheckHasCapacity(const FilePath &crash_directory) {
 bool CrashCollector::GetLogContents(const FilePath &config_path,
                                     const std::string &exec_name,
                                     const FilePath &output_file) {
+  return StartLogContents(config_path, exec_name, output_file) &&
+         FinishLogContents();
+}
+
+bool CrashCollector::StartLogContents(const FilePath &config_path,
+                                      const std::string &exec_name,
+                                      const FilePath &output_file) {
   brillo::KeyValueStore store;
   if (!store.Load(config_path)) {
     LOG(INFO) << "Unable to read log configuration file "
@@ -425,19 +434,25 @@ bool CrashCollector::GetLogContents(const FilePath &config_path,
   if (!store.GetString(exec_name, &command))
     return false;
 
-  brillo::ProcessImpl diag_process;
-  diag_process.AddArg(kShellPath);
-  diag_process.AddStringOption("-c", command);
-  diag_process.RedirectOutput(output_file.value());
-
-  const int result = diag_process.Run();
-  if (result != 0) {
-    LOG(INFO) << "Log command \"" << command << "\" exited with " << result;
+  // Crash tests expect the logs of each crash to be gathered anew.
+  log_command_.reset(new LogCommand(
+      command,
+      IsCrashTestInProgress() ? FilePath() : log_cache_directory_));
+  if (!log_command_->Start(output_file)) {
+    log_command_.reset();
     return false;
   }
   return true;
 }
 
+bool CrashCollector::FinishLogContents() {
+  if (!log_command_)
+    return false;
+  const bool result = log_command_->Wait();
+  log_command_.reset();
+  return result;
+}
+
 void CrashCollector::AddCrashMetaData(const std::string &key,
                                       const std::string &value) {
   extra_metadata_.append(StringPrintf("%s=%s\n", key.c_str(), value.c_str()));
@@ -16,6 +16,8 @@
 #include <gtest/gtest_prod.h>  // for FRIEND_TEST
 #include <session_manager/dbus-proxies.h>
 
+class LogCommand;
+
 // User crash collector.
 class CrashCollector {
  public:
@@ -41,6 +43,7 @@ class CrashCollector {
   FRIEND_TEST(CrashCollectorTest, GetCrashDirectoryInfo);
   FRIEND_TEST(CrashCollectorTest, GetCrashPath);
   FRIEND_TEST(CrashCollectorTest, GetLogContents);
+  FRIEND_TEST(CrashCollectorTest, GetLogContentsCached);
   FRIEND_TEST(CrashCollectorTest, ForkExecAndPipe);
   FRIEND_TEST(CrashCollectorTest, FormatDumpBasename);
   FRIEND_TEST(CrashCollectorTest, Initialize);
@@ -132,6 +135,14 @@ class CrashCollector {
                       const std::string &exec_name,
                       const base::FilePath &output_file);
 
+  // Like GetLogContents, but return as soon as the log command is started,
+  // so that the crash can be collected while it runs.  FinishLogContents
+  // waits for the command and returns whether the log was written.
+  bool StartLogContents(const base::FilePath &config_path,
+                        const std::string &exec_name,
+                        const base::FilePath &output_file);
+  bool FinishLogContents();
+
   // Add non-standard meta data to the crash metadata file.  Call
   // before calling WriteCrashMetaData.  Key must not contain "=" or
   // "\n" characters.  Value must not contain "\n" characters.
@@ -175,6 +186,8 @@ class CrashCollector {
   base::FilePath forced_crash_directory_;
   std::string lsb_release_;
   base::FilePath log_config_path_;
+  // Where the output of log commands is cached.  See LogCommand.
+  base::FilePath log_cache_directory_;
 
   scoped_refptr<dbus::Bus> bus_;
 
@@ -186,6 +199,9 @@ class CrashCollector {
   // True if reports should always be stored in the user crash directory.
   const bool force_user_crash_dir_;
 
+  // The log command started by StartLogContents.
+  std::unique_ptr<LogCommand> log_command_;
+
   DISALLOW_COPY_AND_ASSIGN(CrashCollector);
 };
 
@@ -49,6 +49,7 @@ class CrashCollectorTest : public ::testing::Test {
     collector_.Initialize(CountCrash, IsMetrics);
     test_dir_ = FilePath("test");
     base::CreateDirectory(test_dir_);
+    collector_.log_cache_directory_ = test_dir_.Append("log_cache");
     brillo::ClearLog();
   }
 
@@ -297,3 +298,26 @@ TEST_F(CrashCollectorTest, GetLogContents) {
   EXPECT_TRUE(base::ReadFileToString(output_file, &contents));
   EXPECT_EQ("hello world\n", contents);
 }
+
+TEST_F(CrashCollectorTest, GetLogContentsCached) {
+  FilePath config_file = test_dir_.Append("crash_config");
+  FilePath output_file = test_dir_.Append("crash_log");
+  // Each run of the command adds a line to its output.
+  const char kConfigContents[] =
+      "foobar=echo run >> test/runs; cat test/runs";
+  ASSERT_TRUE(
+      base::WriteFile(config_file, kConfigContents, strlen(kConfigContents)));
+  std::string contents;
+  for (int i = 0; i < 2; ++i) {
+    base::DeleteFile(output_file, false);
+    EXPECT_TRUE(collector_.GetLogContents(config_file, "foobar", output_file));
+    EXPECT_TRUE(base::ReadFileToString(output_file, &contents));
+    EXPECT_EQ("run\n", contents);
+  }
+
+  // Without the cache, the command runs again.
+  collector_.log_cache_directory_.clear();
+  EXPECT_TRUE(collector_.GetLogContents(config_file, "foobar", output_file));
+  EXPECT_TRUE(base::ReadFileToString(output_file, &contents));
+  EXPECT_EQ("run\nrun\n", contents);
+}
@@ -0,0 +1,182 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/crash_rate_limiter.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/strings/string_split.h>
+#include <base/strings/stringprintf.h>
+
+using base::FilePath;
+
+namespace {
+
+// Large enough for kMaxSignatures entries with long signatures.
+const size_t kMaxStateSize = 16 * 1024;
+
+}  // namespace
+
+CrashRateLimiter::CrashRateLimiter(const FilePath &state_path)
+    : state_path_(state_path) {}
+
+CrashRateLimiter::Verdict CrashRateLimiter::RecordCrash(
+    const std::string &signature, time_t now, int *suppressed) {
+  *suppressed = 0;
+  if (!base::CreateDirectory(state_path_.DirName())) {
+    PLOG(ERROR) << "Could not create " << state_path_.DirName().value();
+    return kCollect;
+  }
+  base::ScopedFD fd(HANDLE_EINTR(
+      open(state_path_.value().c_str(),
+           O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600)));
+  if (!fd.is_valid()) {
+    PLOG(ERROR) << "Could not open " << state_path_.value();
+    return kCollect;
+  }
+  // Serializes concurrent crash_reporter invocations.  Released on close.
+  if (HANDLE_EINTR(flock(fd.get(), LOCK_EX)) < 0) {
+    PLOG(ERROR) << "Could not lock " << state_path_.value();
+    return kCollect;
+  }
+
+  char buffer[kMaxStateSize];
+  ssize_t size = HANDLE_EINTR(read(fd.get(), buffer, sizeof(buffer)));
+  if (size < 0) {
+    PLOG(ERROR) << "Could not read " << state_path_.value();
+    return kCollect;
+  }
+  if (!Parse(std::string(buffer, size))) {
+    LOG(WARNING) << "Resetting corrupted " << state_path_.value();
+    tokens_ = kBucketCapacity;
+    refilled_ = now;
+    entries_.clear();
+  }
+
+  // Keep the file line-oriented whatever the executable name.
+  std::string key = signature;
+  std::replace(key.begin(), key.end(), '\n', ' ');
+  Verdict verdict = Decide(key, now, suppressed);
+
+  const std::string contents = Serialize();
+  if (ftruncate(fd.get(), 0) < 0 ||
+      lseek(fd.get(), 0, SEEK_SET) < 0 ||
+      !base::WriteFileDescriptor(fd.get(), contents.data(), contents.size())) {
+    PLOG(ERROR) << "Could not write " << state_path_.value();
+  }
+  return verdict;
+}
+
+CrashRateLimiter::Verdict CrashRateLimiter::Decide(
+    const std::string &signature, time_t now, int *suppressed) {
+  // Refill the bucket for the time elapsed since the last refill.  A clock
+  // that went backward restarts the refill period.
+  if (now < refilled_) {
+    refilled_ = now;
+  } else {
+    const time_t refills = (now - refilled_) / kRefillSeconds;
+    if (refills > 0) {
+      tokens_ = std::min<time_t>(kBucketCapacity, tokens_ + refills);
+      refilled_ = tokens_ == kBucketCapacity
+                      ? now
+                      : refilled_ + refills * kRefillSeconds;
+    }
+  }
+
+  auto entry = std::find_if(entries_.begin(), entries_.end(),
+                            [&signature](const Entry &e) {
+                              return e.signature == signature;
+                            });
+  if (entry == entries_.end()) {
+    if (entries_.size() >= kMaxSignatures) {
+      entries_.erase(std::min_element(entries_.begin(), entries_.end(),
+                                      [](const Entry &a, const Entry &b) {
+                                        return a.last_seen < b.last_seen;
+                                      }));
+    }
+    entries_.push_back(Entry{now, now, 0, 0, signature});
+    entry = entries_.end() - 1;
+  } else if (now < entry->window_start ||
+             now - entry->window_start >= kSignatureWindowSeconds) {
+    entry->window_start = now;
+    entry->reports = 0;
+    entry->suppressed = 0;
+  }
+  entry->last_seen = now;
+
+  Verdict verdict;
+  if (entry->reports >= kMaxReportsPerSignature) {
+    verdict = kDuplicate;
+  } else if (tokens_ <= 0) {
+    verdict = kRateLimited;
+  } else {
+    verdict = kCollect;
+    tokens_--;
+    entry->reports++;
+  }
+  if (verdict != kCollect)
+    entry->suppressed++;
+  *suppressed = entry->suppressed;
+  return verdict;
+}
+
+// The state file holds one line with the bucket state, followed by a line per
+// signature:
+//   <tokens> <refilled>
+//   <window start> <last seen> <reports> <suppressed> <signature>
+// The signature comes last as it may contain spaces.
+bool CrashRateLimiter::Parse(const std::string &contents) {
+  tokens_ = kBucketCapacity;
+  refilled_ = 0;
+  entries_.clear();
+  if (contents.empty())
+    return true;
+
+  std::vector<std::string> lines = base::SplitString(
+      contents, "\n", base::KEEP_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  long long tokens, refilled;  // NOLINT(runtime/int)
+  if (lines.empty() ||
+      sscanf(lines[0].c_str(), "%lld %lld", &tokens, &refilled) != 2 ||
+      tokens < 0 || tokens > kBucketCapacity) {
+    return false;
+  }
+  tokens_ = tokens;
+  refilled_ = refilled;
+
+  for (size_t i = 1; i < lines.size() && i <= kMaxSignatures; ++i) {
+    long long window_start, last_seen;  // NOLINT(runtime/int)
+    int reports, suppressed, offset = 0;
+    if (sscanf(lines[i].c_str(), "%lld %lld %d %d %n", &window_start,
+               &last_seen, &reports, &suppressed, &offset) != 4 ||
+        offset == 0 || lines[i][offset] == '\0') {
+      return false;
+    }
+    entries_.push_back(Entry{static_cast<time_t>(window_start),
+                             static_cast<time_t>(last_seen), reports,
+                             suppressed, lines[i].substr(offset)});
+  }
+  return true;
+}
+
+std::string CrashRateLimiter::Serialize() const {
+  std::string contents = base::StringPrintf(
+      "%d %lld\n", tokens_, static_cast<long long>(refilled_));  // NOLINT
+  for (const Entry &entry : entries_) {
+    base::StringAppendF(&contents, "%lld %lld %d %d %s\n",
+                        static_cast<long long>(entry.window_start),  // NOLINT
+                        static_cast<long long>(entry.last_seen),  // NOLINT
+                        entry.reports, entry.suppressed,
+                        entry.signature.c_str());
+  }
+  return contents;
+}
@@ -0,0 +1,78 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRASH_REPORTER_CRASH_RATE_LIMITER_H_
+#define CRASH_REPORTER_CRASH_RATE_LIMITER_H_
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/macros.h>
+
+// Decides which crashes get a full collection when a process crash-loops.
+// Each crash_reporter invocation records its crash in a small state file
+// shared by all invocations and locked while in use.
+//
+// A signature gets at most kMaxReportsPerSignature full collections per
+// kSignatureWindowSeconds; later crashes with the same signature are only
+// counted.  Across all signatures, collections draw from a token bucket
+// holding up to kBucketCapacity tokens and refilled with one token every
+// kRefillSeconds.
+//
+// Errors accessing the state file never prevent a collection.
+class CrashRateLimiter {
+ public:
+  // Values are reported to UMA; don't renumber.
+  enum Verdict {
+    kCollect = 0,
+    kDuplicate = 1,
+    kRateLimited = 2,
+    kVerdictMax
+  };
+
+  static const int kMaxReportsPerSignature = 3;
+  static const time_t kSignatureWindowSeconds = 60 * 60;
+  static const int kBucketCapacity = 10;
+  static const time_t kRefillSeconds = 30;
+  // Signatures tracked at once; the least recently seen is forgotten first.
+  static const size_t kMaxSignatures = 32;
+
+  explicit CrashRateLimiter(const base::FilePath &state_path);
+
+  // Records a crash with |signature| at |now| and returns whether to collect
+  // it.  Sets |*suppressed| to the number of crashes with |signature| that
+  // were not collected within the current window.
+  Verdict RecordCrash(const std::string &signature, time_t now,
+                      int *suppressed);
+
+ private:
+  struct Entry {
+    time_t window_start;
+    time_t last_seen;
+    int reports;
+    int suppressed;
+    std::string signature;
+  };
+
+  // Parses |contents| of the state file.  Returns false if it is corrupted.
+  bool Parse(const std::string &contents);
+  std::string Serialize() const;
+
+  // Returns the verdict for |signature| at |now| and updates the state.
+  Verdict Decide(const std::string &signature, time_t now, int *suppressed);
+
+  const base::FilePath state_path_;
+
+  // Tokens left in the bucket, and when the bucket was last refilled.
+  int tokens_ = kBucketCapacity;
+  time_t refilled_ = 0;
+  std::vector<Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(CrashRateLimiter);
+};
+
+#endif  // CRASH_REPORTER_CRASH_RATE_LIMITER_H_
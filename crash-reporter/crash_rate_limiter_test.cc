@@ -0,0 +1,100 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/crash_rate_limiter.h"
+
+#include <string>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <gtest/gtest.h>
+
+using base::FilePath;
+
+namespace {
+
+const time_t kStart = 1000000;
+
+}  // namespace
+
+class CrashRateLimiterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    state_path_ = temp_dir_.path().Append("crash_reporter/rate_limit");
+  }
+
+  // Records a crash as a new crash_reporter invocation would.
+  CrashRateLimiter::Verdict Record(const std::string &signature, time_t now,
+                                   int *suppressed = nullptr) {
+    int unused;
+    CrashRateLimiter limiter(state_path_);
+    return limiter.RecordCrash(signature, now,
+                               suppressed ? suppressed : &unused);
+  }
+
+  base::ScopedTempDir temp_dir_;
+  FilePath state_path_;
+};
+
+TEST_F(CrashRateLimiterTest, DuplicatesAreOnlyCounted) {
+  for (int i = 0; i < CrashRateLimiter::kMaxReportsPerSignature; ++i)
+    EXPECT_EQ(CrashRateLimiter::kCollect, Record("foo:11", kStart + i));
+
+  int suppressed = 0;
+  EXPECT_EQ(CrashRateLimiter::kDuplicate,
+            Record("foo:11", kStart + 10, &suppressed));
+  EXPECT_EQ(1, suppressed);
+  EXPECT_EQ(CrashRateLimiter::kDuplicate,
+            Record("foo:11", kStart + 11, &suppressed));
+  EXPECT_EQ(2, suppressed);
+
+  // Other signatures are not affected.
+  EXPECT_EQ(CrashRateLimiter::kCollect, Record("foo:6", kStart + 12));
+  EXPECT_EQ(CrashRateLimiter::kCollect, Record("bar baz:11", kStart + 12));
+
+  // A new window starts after a while.
+  EXPECT_EQ(CrashRateLimiter::kCollect,
+            Record("foo:11",
+                   kStart + CrashRateLimiter::kSignatureWindowSeconds,
+                   &suppressed));
+  EXPECT_EQ(0, suppressed);
+}
+
+TEST_F(CrashRateLimiterTest, BucketLimitsAllSignatures) {
+  for (int i = 0; i < CrashRateLimiter::kBucketCapacity; ++i) {
+    EXPECT_EQ(CrashRateLimiter::kCollect,
+              Record("exec" + std::to_string(i) + ":11", kStart));
+  }
+  EXPECT_EQ(CrashRateLimiter::kRateLimited, Record("other:11", kStart));
+
+  // One token comes back per refill period.
+  const time_t refilled = kStart + CrashRateLimiter::kRefillSeconds;
+  EXPECT_EQ(CrashRateLimiter::kCollect, Record("other:11", refilled));
+  EXPECT_EQ(CrashRateLimiter::kRateLimited, Record("another:11", refilled));
+}
+
+TEST_F(CrashRateLimiterTest, ForgetsLeastRecentlySeenSignature) {
+  time_t now = kStart;
+  for (int i = 0; i < CrashRateLimiter::kMaxReportsPerSignature; ++i)
+    EXPECT_EQ(CrashRateLimiter::kCollect, Record("loop:11", now));
+  // Fill the table with other signatures, spaced to keep the bucket full.
+  for (size_t i = 0; i < CrashRateLimiter::kMaxSignatures; ++i) {
+    now += CrashRateLimiter::kRefillSeconds;
+    EXPECT_EQ(CrashRateLimiter::kCollect,
+              Record("exec" + std::to_string(i) + ":11", now));
+  }
+  now += CrashRateLimiter::kRefillSeconds;
+  EXPECT_EQ(CrashRateLimiter::kCollect, Record("loop:11", now));
+}
+
+TEST_F(CrashRateLimiterTest, CorruptedStateIsReset) {
+  ASSERT_TRUE(base::CreateDirectory(state_path_.DirName()));
+  ASSERT_EQ(4, base::WriteFile(state_path_, "junk", 4));
+  EXPECT_EQ(CrashRateLimiter::kCollect, Record("foo:11", kStart));
+
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(state_path_, &contents));
+  EXPECT_NE(std::string::npos, contents.find(" foo:11\n"));
+}
@@ -26,6 +26,7 @@
 #include "crash-reporter/user_collector.h"
 
 static const char kCrashCounterHistogram[] = "Logging.CrashCounter";
+static const char kSuppressedCrashHistogram[] = "Logging.SuppressedCrash";
 static const char kUserCrashSignal[] =
     "org.chromium.CrashReporter.UserCrash";
 static const char kKernelCrashDetected[] = "/var/run/kernel-crash-detected";
@@ -99,6 +100,11 @@ static void CountUserCrash() {
   LOG_IF(WARNING, status != 0) << "dbus-send running failed";
 }
 
+static void CountSuppressedUserCrash(CrashRateLimiter::Verdict verdict) {
+  s_metrics_lib.SendEnumToUMA(kSuppressedCrashHistogram, verdict,
+                              CrashRateLimiter::kVerdictMax);
+}
+
 static void CountChromeCrash() {
   // For now, consider chrome crashes the same as user crashes for reporting
   // purposes.
@@ -318,6 +324,7 @@ int main(int argc, char *argv[]) {
                            true,  // generate_diagnostics
                            FLAGS_directory_failure,
                            FLAGS_filter_in);
+  arc_collector.set_count_suppressed_crash_function(CountSuppressedUserCrash);
   // Filter out ARC processes.
   if (ArcCollector::IsArcRunning())
     filter_out = std::bind(&ArcCollector::IsArcProcess, &arc_collector,
@@ -331,6 +338,7 @@ int main(int argc, char *argv[]) {
                             FLAGS_directory_failure,
                             FLAGS_filter_in,
                             std::move(filter_out));
+  user_collector.set_count_suppressed_crash_function(CountSuppressedUserCrash);
   UncleanShutdownCollector unclean_shutdown_collector;
   unclean_shutdown_collector.Initialize(CountUncleanShutdown,
                                         IsFeedbackAllowed);
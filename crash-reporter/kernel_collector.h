@@ -5,8 +5,6 @@
 #ifndef CRASH_REPORTER_KERNEL_COLLECTOR_H_
 #define CRASH_REPORTER_KERNEL_COLLECTOR_H_
 
-#include <pcrecpp.h>
-
 #include <string>
 
 #include <base/files/file_path.h>
@@ -86,19 +84,6 @@ class KernelCollector : public CrashCollector {
                           size_t current_record,
                           bool *record_found);
 
-  void ProcessStackTrace(pcrecpp::StringPiece kernel_dump,
-                         bool print_diagnostics,
-                         unsigned *hash,
-                         float *last_stack_timestamp,
-                         bool *is_watchdog_crash);
-  bool FindCrashingFunction(pcrecpp::StringPiece kernel_dump,
-                            bool print_diagnostics,
-                            float stack_trace_timestamp,
-                            std::string *crashing_function);
-  bool FindPanicMessage(pcrecpp::StringPiece kernel_dump,
-                        bool print_diagnostics,
-                        std::string *panic_message);
-
   // Returns the architecture kind for which we are built.
   static ArchKind GetCompilerArch();
 
@@ -0,0 +1,528 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/kernel_log_analyzer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+
+#include <base/strings/stringprintf.h>
+
+using base::StringPiece;
+using base::StringPrintf;
+
+namespace {
+
+const size_t npos = StringPiece::npos;
+
+// Time in seconds from the final kernel log message for a call stack
+// to count towards the signature of the kcrash.
+const int kSignatureTimestampWindow = 2;
+
+// What follows the timestamp on the line with the program counter.
+//
+// For ARM we see:
+//   "<5>[   39.458982] PC is at write_breakme+0xd0/0x1b4"
+// For MIPS we see:
+//   "<5>[ 3378.552000] epc   : 804010f0 lkdtm_do_action+0x68/0x3f8"
+// For x86:
+//   "<0>[   37.474699] EIP: [<790ed488>] write_breakme+0x80/0x108
+//    SS:ESP 0068:e9dd3efc"
+const char* const kPCPrefix[] = {
+  nullptr,
+  " PC is at ",  // " PC is at ([^\\+ ]+).*"
+  " epc",  // " epc\\s+:\\s+\\S+\\s+([^\\+ ]+).*"
+  " EIP: [<",  // " EIP: \\[<.*>\\] ([^\\+ ]+).*"
+  " RIP  [<",  // " RIP  \\[<.*>\\] ([^\\+ ]+).*"
+};
+
+static_assert(arraysize(kPCPrefix) == KernelCollector::kArchCount,
+              "Missing Arch PC prefix");
+
+// The character classes of the regular expressions.  "." is any character
+// but '\n', and "[^...]" includes '\n'.
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+         c == '\r';
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool IsXDigit(char c) {
+  return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// "[^\\+ ]" and "[^\\+ )]".
+bool IsFunctionChar(char c) {
+  return c != '+' && c != ' ';
+}
+
+bool IsStackFunctionChar(char c) {
+  return c != '+' && c != ' ' && c != ')';
+}
+
+// "[\\s\\?(]".
+bool IsCertaintyChar(char c) {
+  return IsSpace(c) || c == '?' || c == '(';
+}
+
+bool HasPrefixAt(StringPiece input, size_t pos, StringPiece prefix) {
+  return input.size() - pos >= prefix.size() &&
+         memcmp(input.data() + pos, prefix.data(), prefix.size()) == 0;
+}
+
+size_t SkipSpaces(StringPiece input, size_t pos) {
+  while (pos < input.size() && IsSpace(input[pos]))
+    ++pos;
+  return pos;
+}
+
+size_t SkipDigits(StringPiece input, size_t pos) {
+  while (pos < input.size() && IsDigit(input[pos]))
+    ++pos;
+  return pos;
+}
+
+// Returns the position of the '\n' ending the line at |pos|, or the end of
+// |input|.  This is where ".*" stops.
+size_t LineEnd(StringPiece input, size_t pos) {
+  const void *newline = memchr(input.data() + pos, '\n', input.size() - pos);
+  return newline ? static_cast<const char *>(newline) - input.data()
+                 : input.size();
+}
+
+// Returns the end of "\\[\\s*(\\d+\\.\\d+)\\]" matched at |pos|, or npos.
+// None of its quantifiers can give back characters for the rest to match.
+size_t MatchTimestamp(StringPiece input, size_t pos, StringPiece *timestamp) {
+  if (pos >= input.size() || input[pos] != '[')
+    return npos;
+  const size_t start = SkipSpaces(input, pos + 1);
+  size_t end = SkipDigits(input, start);
+  if (end == start || end >= input.size() || input[end] != '.')
+    return npos;
+  const size_t fraction = end + 1;
+  end = SkipDigits(input, fraction);
+  if (end == fraction || end >= input.size() || input[end] != ']')
+    return npos;
+  *timestamp = input.substr(start, end - start);
+  return end + 1;
+}
+
+// Converts a captured timestamp the way pcrecpp does.
+bool ParseTimestamp(StringPiece text, float *timestamp) {
+  char buffer[200];
+  if (text.size() >= sizeof(buffer))
+    return false;
+  memcpy(buffer, text.data(), text.size());
+  buffer[text.size()] = '\0';
+  errno = 0;
+  char *end;
+  const double value = strtod(buffer, &end);
+  if (errno || end != buffer + text.size())
+    return false;
+  *timestamp = static_cast<float>(value);
+  return true;
+}
+
+}  // namespace
+
+KernelLogAnalyzer::KernelLogAnalyzer(KernelCollector::ArchKind arch,
+                                     bool print_diagnostics)
+    : arch_(arch), print_diagnostics_(print_diagnostics) {
+}
+
+void KernelLogAnalyzer::Analyze(StringPiece kernel_log) {
+  log_ = kernel_log;
+  for (size_t line = 0; line < log_.size();) {
+    const size_t line_end = LineEnd(log_, line);
+
+    // All the expressions start with "^<.*>\\[\\s*(\\d+\\.\\d+)\\]", where
+    // ".*" is greedy: the last '>' on the line is tried first.
+    prefixes_.clear();
+    if (log_[line] == '<') {
+      for (size_t pos = line_end - 1; pos > line; --pos) {
+        if (log_[pos] != '>')
+          continue;
+        Prefix prefix;
+        prefix.end = MatchTimestamp(log_, pos + 1, &prefix.timestamp);
+        if (prefix.end != npos)
+          prefixes_.push_back(prefix);
+      }
+    }
+
+    if (line_end > line)
+      ProcessStackLine(line, line_end);
+    if (!prefixes_.empty()) {
+      if (!pc_done_ && line >= pc_resume_)
+        ProcessPCLine();
+      if (!panic_done_ && line >= panic_resume_)
+        ProcessPanicLine();
+    }
+    line = line_end + 1;
+  }
+
+  // If the last stack trace contains a watchdog function we assume the panic
+  // is from the watchdog timer, and we hash the previous stack trace rather
+  // than the last one, assuming that the previous stack is that of the hung
+  // thread.
+  //
+  // In addition, if the hashable is empty (meaning all frames are uncertain,
+  // for whatever reason) also use the previous frame, as it cannot be any
+  // worse.
+  if (is_watchdog_ || stack_frames_.empty())
+    stack_frames_ = previous_stack_frames_;
+
+  if (print_diagnostics_) {
+    printf("Hash based on stack trace: \"%s\" at %f.\n",
+           stack_frames_.c_str(), last_stack_timestamp_);
+  }
+}
+
+void KernelLogAnalyzer::ProcessStackLine(size_t line, size_t line_end) {
+  // These expressions are matched against the line alone, so only prefixes
+  // ending on the line count.
+  const StringPiece text = log_.substr(line, line_end - line);
+
+  // Match the start of a stack trace:
+  //   " (Call Trace|Backtrace):$"
+  for (const Prefix &prefix : prefixes_) {
+    if (prefix.end > line_end)
+      continue;
+    const StringPiece rest = log_.substr(prefix.end, line_end - prefix.end);
+    if (rest != " Call Trace:" && rest != " Backtrace:")
+      continue;
+    // No other prefix can end where this one does, so the line is not the
+    // start of a stack trace if its timestamp is not a number.
+    if (!ParseTimestamp(prefix.timestamp, &last_stack_timestamp_))
+      break;
+    if (print_diagnostics_) {
+      printf("Stack trace starting.%s\n",
+             stack_frames_.empty() ? "" : "  Saving prior trace.");
+    }
+    previous_stack_frames_ = stack_frames_;
+    stack_frames_.clear();
+    is_watchdog_ = false;
+    return;
+  }
+
+  // Match lines such as the following and grab out "function_name".
+  // The ? may or may not be present.
+  //
+  // For ARM:
+  // <4>[ 3498.731164] [<c0057220>] ? (function_name+0x20/0x2c) from
+  // [<c018062c>] (foo_bar+0xdc/0x1bc)
+  //
+  // For MIPS:
+  // <5>[ 3378.656000] [<804010f0>] lkdtm_do_action+0x68/0x3f8
+  //
+  // For X86:
+  // <4>[ 6066.849504]  [<7937bcee>] ? function_name+0x66/0x6c
+  //
+  // using
+  //   "\\s+\\[<[[:xdigit:]]+>\\]"  Matches "  [<7937bcee>]"
+  //   "([\\s\\?(]+)"               Matches " ? (" (ARM) or " ? " (X86)
+  //   "([^\\+ )]+)"                Matches until delimiter reached
+  for (const Prefix &prefix : prefixes_) {
+    if (prefix.end > line_end)
+      continue;
+    size_t pos = SkipSpaces(text, prefix.end - line);
+    if (pos == prefix.end - line || !HasPrefixAt(text, pos, "[<"))
+      continue;
+    const size_t address = pos + 2;
+    pos = address;
+    while (pos < text.size() && IsXDigit(text[pos]))
+      ++pos;
+    if (pos == address || !HasPrefixAt(text, pos, ">]"))
+      continue;
+
+    // The certainty is greedy, and gives back characters only for the
+    // function to start with one that both can match.
+    const size_t certainty = pos + 2;
+    pos = certainty;
+    while (pos < text.size() && IsCertaintyChar(text[pos]))
+      ++pos;
+    while (pos > certainty &&
+           (pos == text.size() || !IsStackFunctionChar(text[pos]))) {
+      --pos;
+    }
+    if (pos == certainty)
+      continue;
+    const size_t function = pos;
+    while (pos < text.size() && IsStackFunctionChar(text[pos]))
+      ++pos;
+
+    if (!ParseTimestamp(prefix.timestamp, &last_stack_timestamp_))
+      return;
+    const StringPiece function_name = text.substr(function, pos - function);
+    const bool is_certain =
+        text.substr(certainty, function - certainty).find('?') == npos;
+    if (print_diagnostics_) {
+      printf("@%f: stack entry for %s (%s)\n",
+             last_stack_timestamp_,
+             function_name.as_string().c_str(),
+             is_certain ? "certain" : "uncertain");
+    }
+    // Do not include any uncertain (prefixed by '?') frames in our hash.
+    if (!is_certain)
+      return;
+    if (!stack_frames_.empty())
+      stack_frames_.append("|");
+    if (function_name == "watchdog_timer_fn" || function_name == "watchdog")
+      is_watchdog_ = true;
+    stack_frames_.append(function_name.data(), function_name.size());
+    return;
+  }
+}
+
+void KernelLogAnalyzer::ProcessPCLine() {
+  for (const Prefix &prefix : prefixes_) {
+    StringPiece function;
+    const size_t end = MatchPC(prefix.end, &function);
+    if (end == npos)
+      continue;
+    if (!ParseTimestamp(prefix.timestamp, &pc_timestamp_)) {
+      pc_done_ = true;
+      return;
+    }
+    crashing_function_ = function.as_string();
+    pc_resume_ = end;
+    if (print_diagnostics_) {
+      printf("@%f: found crashing function %s\n",
+             pc_timestamp_,
+             crashing_function_.c_str());
+    }
+    return;
+  }
+}
+
+void KernelLogAnalyzer::ProcessPanicLine() {
+  for (const Prefix &prefix : prefixes_) {
+    StringPiece message;
+    const size_t end = MatchPanic(prefix.end, &message);
+    if (end == npos)
+      continue;
+    if (!ParseTimestamp(prefix.timestamp, &panic_timestamp_)) {
+      panic_done_ = true;
+      return;
+    }
+    panic_message_ = message.as_string();
+    panic_resume_ = end;
+    if (print_diagnostics_) {
+      printf("@%f: panic message %s\n",
+             panic_timestamp_,
+             panic_message_.c_str());
+    }
+    return;
+  }
+}
+
+size_t KernelLogAnalyzer::MatchPC(size_t pos, StringPiece *text) const {
+  const StringPiece prefix(kPCPrefix[arch_]);
+  if (!HasPrefixAt(log_, pos, prefix))
+    return npos;
+  pos += prefix.size();
+
+  // Find where "([^\\+ ]+)" starts, which may be on a later line.
+  size_t start = npos;
+  switch (arch_) {
+    case KernelCollector::kArchArm:
+      start = pos;
+      break;
+
+    case KernelCollector::kArchMips: {
+      // Of "\\s+:\\s+\\S+\\s+", only the last "\\s+" can give back
+      // characters: the function may start with its spaces but ' '.
+      const size_t colon = SkipSpaces(log_, pos);
+      if (colon == pos || colon == log_.size() || log_[colon] != ':')
+        return npos;
+      const size_t address = SkipSpaces(log_, colon + 1);
+      if (address == colon + 1)
+        return npos;
+      pos = address;
+      while (pos < log_.size() && !IsSpace(log_[pos]))
+        ++pos;
+      if (pos == address)
+        return npos;
+      for (size_t end = SkipSpaces(log_, pos); end > pos; --end) {
+        if (end < log_.size() && IsFunctionChar(log_[end])) {
+          start = end;
+          break;
+        }
+      }
+      break;
+    }
+
+    case KernelCollector::kArchX86:
+    case KernelCollector::kArchX86_64: {
+      // ".*>\\] " is greedy: the last ">] " on the line is tried first.
+      for (size_t end = LineEnd(log_, pos); end > pos;) {
+        const void *found = memrchr(log_.data() + pos, '>', end - pos);
+        if (!found)
+          break;
+        end = static_cast<const char *>(found) - log_.data();
+        if (HasPrefixAt(log_, end, ">] ") && end + 3 < log_.size() &&
+            IsFunctionChar(log_[end + 3])) {
+          start = end + 3;
+          break;
+        }
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+  if (start >= log_.size() || !IsFunctionChar(log_[start]))
+    return npos;
+
+  size_t end = start;
+  while (end < log_.size() && IsFunctionChar(log_[end]))
+    ++end;
+  *text = log_.substr(start, end - start);
+  // The trailing ".*".
+  return LineEnd(log_, end);
+}
+
+size_t KernelLogAnalyzer::MatchPanic(size_t pos, StringPiece *text) const {
+  // Match lines such as the following and grab out "Fatal exception"
+  // <0>[  342.841135] Kernel panic - not syncing: Fatal exception
+  // using
+  //   " Kernel panic[^\\:]*\\:\\s*(.*)"
+  // where "[^\\:]*" goes on to the next ':', even on a later line.
+  const StringPiece prefix(" Kernel panic");
+  if (!HasPrefixAt(log_, pos, prefix))
+    return npos;
+  pos += prefix.size();
+  const void *colon = memchr(log_.data() + pos, ':', log_.size() - pos);
+  if (!colon)
+    return npos;
+  const size_t start =
+      SkipSpaces(log_, static_cast<const char *>(colon) - log_.data() + 1);
+  const size_t end = LineEnd(log_, start);
+  *text = log_.substr(start, end - start);
+  return end;
+}
+
+bool KernelLogAnalyzer::GetCrashingFunction(
+    std::string *crashing_function) const {
+  if (pc_timestamp_ == 0) {
+    if (print_diagnostics_) {
+      printf("Found no crashing function.\n");
+    }
+    return false;
+  }
+  if (last_stack_timestamp_ != 0 &&
+      abs(static_cast<int>(last_stack_timestamp_ - pc_timestamp_))
+        > kSignatureTimestampWindow) {
+    if (print_diagnostics_) {
+      printf("Found crashing function but not within window.\n");
+    }
+    return false;
+  }
+  if (print_diagnostics_) {
+    printf("Found crashing function %s\n", crashing_function_.c_str());
+  }
+  *crashing_function = crashing_function_;
+  return true;
+}
+
+bool KernelLogAnalyzer::GetPanicMessage(std::string *panic_message) const {
+  if (panic_timestamp_ == 0) {
+    if (print_diagnostics_) {
+      printf("Found no panic message.\n");
+    }
+    return false;
+  }
+  *panic_message = panic_message_;
+  return true;
+}
+
+// static
+void KernelLogAnalyzer::StripSensitiveData(std::string *kernel_log) {
+  // Strip any data that the user might not want sent up to the crash servers.
+  // At the moment, the only sensitive data we strip is MAC addresses.
+  //
+  // Get rid of things that look like MAC addresses, since they could possibly
+  // give information about where someone has been.  This is strings that look
+  // like this: 11:22:33:44:55:66
+  // Complications:
+  // - Within a given kernel_log, want to be able to tell when the same MAC
+  //   was used more than once.  Thus, we'll consistently replace the first
+  //   MAC found with 00:00:00:00:00:01, the second with ...:02, etc.
+  // - ACPI commands look like MAC addresses.  We'll specifically avoid getting
+  //   rid of those.  They look like this:
+  //     ata1.00: ACPI cmd ef/10:03:00:00:00:a0 (SET FEATURES) filtered out
+  //   A MAC address is taken for an ACPI command if any line since the
+  //   previous MAC address ends with "ACPI cmd ef/", as "ACPI cmd ef/$"
+  //   matched in multi-line mode.
+  const size_t kMacLength = 17;
+  const StringPiece kAcpiCommand("ACPI cmd ef/");
+  const StringPiece input(*kernel_log);
+  std::string result;
+  result.reserve(input.size());
+  std::map<std::string, std::string> mac_map;
+
+  // Start of the data not copied to |result| yet, and where to look for the
+  // next ':' of a MAC address from.
+  size_t copied = 0;
+  size_t pos = 0;
+  while (true) {
+    const void *found = memchr(input.data() + pos, ':', input.size() - pos);
+    if (!found)
+      break;
+    const size_t colon = static_cast<const char *>(found) - input.data();
+    pos = colon + 1;
+    if (colon < copied + 2 || input.size() - (colon - 2) < kMacLength)
+      continue;
+    const size_t start = colon - 2;
+    bool is_mac = true;
+    for (size_t i = 0; i < kMacLength && is_mac; ++i) {
+      is_mac = i % 3 == 2 ? input[start + i] == ':'
+                          : IsXDigit(input[start + i]);
+    }
+    if (!is_mac)
+      continue;
+
+    const StringPiece pre_mac = input.substr(copied, start - copied);
+    const StringPiece mac = input.substr(start, kMacLength);
+    bool is_acpi = false;
+    for (size_t acpi = pre_mac.find(kAcpiCommand); acpi != npos && !is_acpi;
+         acpi = pre_mac.find(kAcpiCommand, acpi + 1)) {
+      const size_t end = acpi + kAcpiCommand.size();
+      is_acpi = end == pre_mac.size() || pre_mac[end] == '\n';
+    }
+    result.append(pre_mac.data(), pre_mac.size());
+    if (is_acpi) {
+      // We really saw an ACPI command; add to result w/ no stripping.
+      result.append(mac.data(), mac.size());
+    } else {
+      // Found a MAC address; look up in our hash for the mapping.
+      std::string &replacement_mac = mac_map[mac.as_string()];
+      if (replacement_mac.empty()) {
+        // It wasn't present, so build up a replacement string.
+        int mac_id = mac_map.size();
+
+        // Handle up to 2^32 unique MAC address; overkill, but doesn't hurt.
+        replacement_mac = StringPrintf("00:00:%02x:%02x:%02x:%02x",
+                                       (mac_id & 0xff000000) >> 24,
+                                       (mac_id & 0x00ff0000) >> 16,
+                                       (mac_id & 0x0000ff00) >> 8,
+                                       (mac_id & 0x000000ff));
+      }
+      result.append(replacement_mac);
+    }
+    copied = start + kMacLength;
+    pos = copied;
+  }
+
+  // One last bit of data might still be in the input.
+  result.append(input.data() + copied, input.size() - copied);
+  kernel_log->swap(result);
+}
@@ -0,0 +1,105 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRASH_REPORTER_KERNEL_LOG_ANALYZER_H_
+#define CRASH_REPORTER_KERNEL_LOG_ANALYZER_H_
+
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/strings/string_piece.h>
+
+#include "crash-reporter/kernel_collector.h"
+
+// Extracts what KernelCollector computes a crash signature from, the last
+// stack traces, the crashing function and the panic message, in one pass
+// over a kernel log.
+//
+// KernelCollector used to run a regular expression over the whole log for
+// each of these.  The scanners here are written by hand to find exactly what
+// those regular expressions found, including on logs mangled by ramoops,
+// so that signatures don't change.  The expressions are quoted next to the
+// code matching them.
+class KernelLogAnalyzer {
+ public:
+  // |arch| selects the format of the lines holding the program counter.
+  KernelLogAnalyzer(KernelCollector::ArchKind arch, bool print_diagnostics);
+
+  // Scans |kernel_log|.  The results below refer to it.
+  void Analyze(base::StringPiece kernel_log);
+
+  // Returns the functions of the stack trace to hash, separated by '|'.
+  // Uncertain frames are left out.  This is the last stack trace, or the one
+  // before if the last one is from the watchdog or has only uncertain frames.
+  const std::string &stack_frames() const { return stack_frames_; }
+
+  // Returns whether the last stack trace is from the watchdog.
+  bool is_watchdog_crash() const { return is_watchdog_; }
+
+  // Returns the timestamp of the last stack trace line, or 0.
+  float last_stack_timestamp() const { return last_stack_timestamp_; }
+
+  // Sets |crashing_function| to the function the program counter was in
+  // when the kernel last reported it.  Returns false if there is no such
+  // report, or if it is not within a couple of seconds of the last stack.
+  bool GetCrashingFunction(std::string *crashing_function) const;
+
+  // Sets |panic_message| to the message of the last kernel panic.  Returns
+  // false if the kernel did not panic.
+  bool GetPanicMessage(std::string *panic_message) const;
+
+  // Replaces MAC addresses in |kernel_log| with 00:00:00:00:00:01, :02 and
+  // so on, consistently within the log.  Leaves alone ACPI commands, which
+  // look like MAC addresses.
+  static void StripSensitiveData(std::string *kernel_log);
+
+ private:
+  // A way to match the "<level>[timestamp]" prefix of a line.
+  struct Prefix {
+    base::StringPiece timestamp;
+    // Where the match ends.
+    size_t end;
+  };
+
+  // Matches the line from |line| to |line_end| against each expression, with
+  // |prefixes_| holding the ways to match its prefix.
+  void ProcessStackLine(size_t line, size_t line_end);
+  void ProcessPCLine();
+  void ProcessPanicLine();
+
+  // Matches what follows the timestamp on a program counter or panic line at
+  // |pos|.  Sets |*text| to the captured function or message and returns the
+  // end of the match, or npos.
+  size_t MatchPC(size_t pos, base::StringPiece *text) const;
+  size_t MatchPanic(size_t pos, base::StringPiece *text) const;
+
+  const KernelCollector::ArchKind arch_;
+  const bool print_diagnostics_;
+  base::StringPiece log_;
+  // In the order a backtracking regular expression engine tries them.
+  std::vector<Prefix> prefixes_;
+
+  std::string stack_frames_;
+  std::string previous_stack_frames_;
+  bool is_watchdog_ = false;
+  float last_stack_timestamp_ = 0;
+
+  // Matches of the program counter and panic lines don't overlap: scanning
+  // for them resumes at the end of the last match, and stops for good if a
+  // timestamp is not a number.
+  size_t pc_resume_ = 0;
+  bool pc_done_ = false;
+  float pc_timestamp_ = 0;
+  std::string crashing_function_;
+
+  size_t panic_resume_ = 0;
+  bool panic_done_ = false;
+  float panic_timestamp_ = 0;
+  std::string panic_message_;
+
+  DISALLOW_COPY_AND_ASSIGN(KernelLogAnalyzer);
+};
+
+#endif  // CRASH_REPORTER_KERNEL_LOG_ANALYZER_H_
@@ -0,0 +1,247 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runs the kernel crash signature computation and MAC address stripping over
+// a corpus of kernel logs, such as ramoops dumps collected from devices, both
+// with the regular expressions KernelCollector used to run and with
+// KernelLogAnalyzer.  Checks that both give the same results for each
+// architecture, and compares the time taken.
+//
+// Usage: kernel_log_analyzer_benchmark --corpus=/path/to/dumps
+//            [--iterations=10]
+
+#include <pcrecpp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <base/files/file_enumerator.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+#include <brillo/flag_helper.h>
+
+#include "crash-reporter/kernel_collector.h"
+#include "crash-reporter/kernel_log_analyzer.h"
+
+using base::FilePath;
+using base::StringPrintf;
+
+namespace {
+
+// The implementation KernelLogAnalyzer replaced, for reference.
+
+const char kTimestampRegex[] = "^<.*>\\[\\s*(\\d+\\.\\d+)\\]";
+const char* const kPCRegex[] = {
+  0,
+  " PC is at ([^\\+ ]+).*",
+  " epc\\s+:\\s+\\S+\\s+([^\\+ ]+).*",
+  " EIP: \\[<.*>\\] ([^\\+ ]+).*",
+  " RIP  \\[<.*>\\] ([^\\+ ]+).*",
+};
+
+unsigned HashString(const std::string &input) {
+  unsigned hash = 0;
+  for (auto c : input)
+    hash = hash * 16127 + c;
+  return hash;
+}
+
+void ReferenceStripSensitiveData(std::string *kernel_dump) {
+  std::ostringstream result;
+  std::string pre_mac_str;
+  std::string mac_str;
+  std::map<std::string, std::string> mac_map;
+  pcrecpp::StringPiece input(*kernel_dump);
+  pcrecpp::RE mac_re("(.*?)("
+                     "[0-9a-fA-F][0-9a-fA-F]:"
+                     "[0-9a-fA-F][0-9a-fA-F]:"
+                     "[0-9a-fA-F][0-9a-fA-F]:"
+                     "[0-9a-fA-F][0-9a-fA-F]:"
+                     "[0-9a-fA-F][0-9a-fA-F]:"
+                     "[0-9a-fA-F][0-9a-fA-F])",
+                     pcrecpp::RE_Options()
+                       .set_multiline(true)
+                       .set_dotall(true));
+  pcrecpp::RE acpi_re("ACPI cmd ef/$",
+                      pcrecpp::RE_Options()
+                        .set_multiline(true)
+                        .set_dotall(true));
+  while (mac_re.Consume(&input, &pre_mac_str, &mac_str)) {
+    if (acpi_re.PartialMatch(pre_mac_str)) {
+      result << pre_mac_str << mac_str;
+    } else {
+      std::string replacement_mac = mac_map[mac_str];
+      if (replacement_mac == "") {
+        int mac_id = mac_map.size();
+        replacement_mac = StringPrintf("00:00:%02x:%02x:%02x:%02x",
+                                       (mac_id & 0xff000000) >> 24,
+                                       (mac_id & 0x00ff0000) >> 16,
+                                       (mac_id & 0x0000ff00) >> 8,
+                                       (mac_id & 0x000000ff));
+        mac_map[mac_str] = replacement_mac;
+      }
+      result << pre_mac_str << replacement_mac;
+    }
+  }
+  result << input;
+  *kernel_dump = result.str();
+}
+
+bool ReferenceComputeKernelStackSignature(KernelCollector::ArchKind arch,
+                                          const std::string &kernel_dump,
+                                          std::string *kernel_signature) {
+  // KernelCollector::ProcessStackTrace().
+  pcrecpp::StringPiece input(kernel_dump);
+  pcrecpp::RE line_re("(.+)", pcrecpp::MULTILINE());
+  pcrecpp::RE stack_trace_start_re(std::string(kTimestampRegex) +
+        " (Call Trace|Backtrace):$");
+  pcrecpp::RE stack_entry_re(std::string(kTimestampRegex) +
+    "\\s+\\[<[[:xdigit:]]+>\\]"
+    "([\\s\\?(]+)"
+    "([^\\+ )]+)");
+  std::string line;
+  std::string hashable;
+  std::string previous_hashable;
+  bool is_watchdog = false;
+  float last_stack_timestamp = 0;
+  while (line_re.FindAndConsume(&input, &line)) {
+    std::string certainty;
+    std::string function_name;
+    if (stack_trace_start_re.PartialMatch(line, &last_stack_timestamp)) {
+      previous_hashable = hashable;
+      hashable.clear();
+      is_watchdog = false;
+    } else if (stack_entry_re.PartialMatch(line,
+                                           &last_stack_timestamp,
+                                           &certainty,
+                                           &function_name)) {
+      if (certainty.find('?') != std::string::npos)
+        continue;
+      if (!hashable.empty())
+        hashable.append("|");
+      if (function_name == "watchdog_timer_fn" ||
+          function_name == "watchdog") {
+        is_watchdog = true;
+      }
+      hashable.append(function_name);
+    }
+  }
+  if (is_watchdog || hashable.empty())
+    hashable = previous_hashable;
+  const unsigned stack_hash = HashString(hashable);
+
+  // KernelCollector::FindCrashingFunction().
+  std::string human_string;
+  float timestamp = 0;
+  input = kernel_dump;
+  pcrecpp::RE eip_re(std::string(kTimestampRegex) + kPCRegex[arch],
+                     pcrecpp::MULTILINE());
+  while (eip_re.FindAndConsume(&input, &timestamp, &human_string)) {}
+  if (timestamp == 0 ||
+      (last_stack_timestamp != 0 &&
+       abs(static_cast<int>(last_stack_timestamp - timestamp)) > 2)) {
+    // KernelCollector::FindPanicMessage().
+    timestamp = 0;
+    input = kernel_dump;
+    pcrecpp::RE kernel_panic_re(std::string(kTimestampRegex) +
+                                " Kernel panic[^\\:]*\\:\\s*(.*)",
+                                pcrecpp::MULTILINE());
+    while (kernel_panic_re.FindAndConsume(&input, &timestamp,
+                                          &human_string)) {}
+    if (timestamp == 0)
+      human_string.clear();
+  }
+
+  if (human_string.empty() && stack_hash == 0)
+    return false;
+  *kernel_signature = StringPrintf("kernel-%s%s-%08X",
+                                   (is_watchdog ? "(HANG)-" : ""),
+                                   human_string.substr(0, 40).c_str(),
+                                   stack_hash);
+  return true;
+}
+
+struct Result {
+  bool computed;
+  std::string signature;
+  std::string stripped;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  DEFINE_string(corpus, "", "directory holding the kernel logs");
+  DEFINE_int32(iterations, 10, "number of times to process each log");
+  brillo::FlagHelper::Init(argc, argv, "Kernel log analysis benchmark");
+  if (FLAGS_corpus.empty()) {
+    LOG(ERROR) << "--corpus is required";
+    return 1;
+  }
+
+  std::vector<std::string> logs;
+  size_t total_size = 0;
+  base::FileEnumerator files(FilePath(FLAGS_corpus), false,
+                             base::FileEnumerator::FILES);
+  for (FilePath path = files.Next(); !path.empty(); path = files.Next()) {
+    std::string log;
+    CHECK(base::ReadFileToString(path, &log)) << path.value();
+    total_size += log.size();
+    logs.push_back(log);
+  }
+  printf("%zu logs, %zu bytes\n", logs.size(), total_size);
+
+  KernelCollector collector;
+  int mismatches = 0;
+  for (int arch = KernelCollector::kArchArm;
+       arch < KernelCollector::kArchCount; ++arch) {
+    const KernelCollector::ArchKind kind =
+        static_cast<KernelCollector::ArchKind>(arch);
+    collector.set_arch(kind);
+    base::TimeDelta reference_time;
+    base::TimeDelta analyzer_time;
+    for (size_t i = 0; i < logs.size(); ++i) {
+      Result reference;
+      Result analyzer;
+      base::TimeTicks start = base::TimeTicks::Now();
+      for (int j = 0; j < FLAGS_iterations; ++j) {
+        reference.stripped = logs[i];
+        ReferenceStripSensitiveData(&reference.stripped);
+        reference.computed = ReferenceComputeKernelStackSignature(
+            kind, reference.stripped, &reference.signature);
+      }
+      base::TimeTicks middle = base::TimeTicks::Now();
+      for (int j = 0; j < FLAGS_iterations; ++j) {
+        analyzer.stripped = logs[i];
+        KernelLogAnalyzer::StripSensitiveData(&analyzer.stripped);
+        analyzer.computed = collector.ComputeKernelStackSignature(
+            analyzer.stripped, &analyzer.signature, false);
+      }
+      base::TimeTicks end = base::TimeTicks::Now();
+      reference_time += middle - start;
+      analyzer_time += end - middle;
+
+      if (reference.computed != analyzer.computed ||
+          reference.signature != analyzer.signature ||
+          reference.stripped != analyzer.stripped) {
+        printf("Log %zu differs for arch %d: \"%s\" vs \"%s\"%s\n", i, arch,
+               reference.signature.c_str(), analyzer.signature.c_str(),
+               reference.stripped == analyzer.stripped
+                   ? "" : ", stripped logs differ");
+        ++mismatches;
+      }
+    }
+    printf("arch %d: regular expressions %10.1f ms, analyzer %10.1f ms\n",
+           arch, reference_time.InMillisecondsF(),
+           analyzer_time.InMillisecondsF());
+  }
+
+  return mismatches ? 1 : 0;
+}
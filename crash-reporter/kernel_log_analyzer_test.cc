@@ -0,0 +1,84 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/kernel_log_analyzer.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+// KernelCollectorTest covers well-formed logs.  These cover the corners of
+// the regular expressions KernelCollector used to run.
+
+TEST(KernelLogAnalyzerTest, StackTraces) {
+  const char kLog[] =
+      "<4>[ 1.000000] Call Trace:\n"
+      "<4>[ 1.000001]  [<c0057220>] ? (uncertain+0x20/0x2c) from\n"
+      "<4>[ 1.000002]  [<c0057220>] (first+0x20/0x2c) from\n"
+      "<4>[ 1.000003]  [<c0057220>] (+0x20/0x2c)\n"
+      "<4>[ 2.000000] Backtrace:\n"
+      "<4>[ 2.000001]  [<c0057220>] watchdog+0x20/0x2c\n";
+  KernelLogAnalyzer analyzer(KernelCollector::kArchArm, false);
+  analyzer.Analyze(kLog);
+  // The certainty gives back the "(" of " (" for a function to match.
+  EXPECT_EQ("first|(", analyzer.stack_frames());
+  EXPECT_TRUE(analyzer.is_watchdog_crash());
+  EXPECT_FLOAT_EQ(2.000001, analyzer.last_stack_timestamp());
+}
+
+TEST(KernelLogAnalyzerTest, TimestampAfterLastPrefix) {
+  // "<.*>" is greedy.
+  KernelLogAnalyzer analyzer(KernelCollector::kArchArm, false);
+  analyzer.Analyze("<5>[ 1.000000] <6>[ 5.000000] PC is at foo+0x1/0x2\n");
+  std::string function;
+  EXPECT_TRUE(analyzer.GetCrashingFunction(&function));
+  EXPECT_EQ("foo", function);
+  EXPECT_FLOAT_EQ(0, analyzer.last_stack_timestamp());
+}
+
+TEST(KernelLogAnalyzerTest, CrashingFunctionAcrossLines) {
+  // The function goes on to the next space or '+', and the next search
+  // starts after it.
+  KernelLogAnalyzer analyzer(KernelCollector::kArchArm, false);
+  analyzer.Analyze(
+      "<5>[ 1.000000] PC is at foo\n"
+      "<5>[ 1.000001] PC is at bar+0x1/0x2\n");
+  std::string function;
+  EXPECT_TRUE(analyzer.GetCrashingFunction(&function));
+  EXPECT_EQ("foo\n<5>[", function);
+}
+
+TEST(KernelLogAnalyzerTest, CrashingFunctionX86) {
+  KernelLogAnalyzer analyzer(KernelCollector::kArchX86, false);
+  analyzer.Analyze(
+      "<0>[ 3.000000] EIP: [<790ed488>] a>] write_breakme+0x80/0x108 >]  x\n");
+  std::string function;
+  EXPECT_TRUE(analyzer.GetCrashingFunction(&function));
+  EXPECT_EQ("write_breakme", function);
+}
+
+TEST(KernelLogAnalyzerTest, PanicMessageAcrossLines) {
+  KernelLogAnalyzer analyzer(KernelCollector::kArchX86_64, false);
+  analyzer.Analyze(
+      "<0>[ 3.000000] Kernel panic - not syncing:\n"
+      "<0>[ 3.000001] Fatal exception\n");
+  std::string message;
+  EXPECT_FALSE(analyzer.GetCrashingFunction(&message));
+  EXPECT_TRUE(analyzer.GetPanicMessage(&message));
+  EXPECT_EQ("<0>[ 3.000001] Fatal exception", message);
+}
+
+TEST(KernelLogAnalyzerTest, StripSensitiveData) {
+  std::string log =
+      "ata1.00: ACPI cmd ef/\n"
+      "wlan0: 00:11:22:33:44:55 aa:bb:cc:dd:ee:ff:01\n"
+      "wlan0: aa:bb:cc:dd:ee:ff\n";
+  KernelLogAnalyzer::StripSensitiveData(&log);
+  // The first address is taken for an ACPI command.
+  EXPECT_EQ(
+      "ata1.00: ACPI cmd ef/\n"
+      "wlan0: 00:11:22:33:44:55 00:00:00:00:00:01:01\n"
+      "wlan0: 00:00:00:00:00:01\n",
+      log);
+}
@@ -0,0 +1,183 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crash-reporter/log_command.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <base/bind.h>
+#include <base/files/file.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/sha1.h>
+#include <base/strings/string_number_conversions.h>
+
+using base::FilePath;
+using base::TimeDelta;
+
+namespace {
+
+const char kShellPath[] = "/bin/sh";
+
+// Niceness of log commands, so that collecting the crash comes first.
+const int kLogCommandNiceness = 10;
+
+// Runs in the child before exec.
+bool SetUpLogCommand() {
+  // Put the command in a process group of its own, so that the processes it
+  // starts can be killed with it.
+  return setpgid(0, 0) == 0 &&
+         setpriority(PRIO_PROCESS, 0, kLogCommandNiceness) == 0;
+}
+
+}  // namespace
+
+LogCommand::LogCommand(const std::string &command,
+                       const FilePath &cache_directory)
+    : command_(command), cache_directory_(cache_directory) {
+}
+
+LogCommand::~LogCommand() {
+  if (process_.pid() != 0)
+    Kill();
+}
+
+bool LogCommand::Start(const FilePath &output_file) {
+  output_file_ = output_file;
+  if (!cache_directory_.empty()) {
+    const std::string hash = base::SHA1HashString(command_);
+    cache_file_ =
+        cache_directory_.Append(base::HexEncode(hash.data(), hash.size()));
+    if (CopyFromCache()) {
+      LOG(INFO) << "Using the cached output of log command \"" << command_
+                << "\"";
+      from_cache_ = true;
+      return true;
+    }
+  }
+
+  process_.AddArg(kShellPath);
+  process_.AddStringOption("-c", command_);
+  process_.RedirectOutput(output_file.value());
+  process_.SetPreExecCallback(base::Bind(&SetUpLogCommand));
+  if (!process_.Start()) {
+    LOG(ERROR) << "Could not start log command \"" << command_ << "\"";
+    return false;
+  }
+  deadline_ = base::TimeTicks::Now() + TimeDelta::FromSeconds(kTimeoutSeconds);
+  return true;
+}
+
+bool LogCommand::Wait() {
+  if (from_cache_)
+    return true;
+  const pid_t pid = process_.pid();
+  if (pid == 0)
+    return false;
+
+  // Block SIGCHLD before checking on the command, so that an exit after the
+  // check leaves it pending for sigtimedwait() rather than discarded.
+  sigset_t child_signal;
+  sigemptyset(&child_signal);
+  sigaddset(&child_signal, SIGCHLD);
+  sigset_t old_mask;
+  sigprocmask(SIG_BLOCK, &child_signal, &old_mask);
+
+  int status = 0;
+  pid_t result;
+  while (true) {
+    result = HANDLE_EINTR(waitpid(pid, &status, WNOHANG));
+    if (result < 0)
+      PLOG(ERROR) << "Could not wait for log command \"" << command_ << "\"";
+    if (result != 0)
+      break;
+    const TimeDelta remaining = deadline_ - base::TimeTicks::Now();
+    if (remaining <= TimeDelta())
+      break;
+    // Sleep until a child exits or the deadline passes.  Other children
+    // exiting only cost an extra check.
+    const struct timespec wait_time = remaining.ToTimeSpec();
+    sigtimedwait(&child_signal, nullptr, &wait_time);
+  }
+  sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+
+  if (result == 0) {
+    LOG(WARNING) << "Log command \"" << command_ << "\" ran out of time, "
+                 << "keeping its output so far";
+    Kill();
+    return true;
+  }
+  // Reaped, or not our child anymore.
+  process_.Release();
+  if (result < 0)
+    return false;
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    LOG(INFO) << "Log command \"" << command_ << "\" exited with "
+              << (WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    return false;
+  }
+  if (!cache_file_.empty())
+    WriteCache();
+  return true;
+}
+
+void LogCommand::Kill() {
+  const pid_t pid = process_.Release();
+  // The command may not have its own process group yet.
+  kill(-pid, SIGKILL);
+  kill(pid, SIGKILL);
+  HANDLE_EINTR(waitpid(pid, nullptr, 0));
+}
+
+bool LogCommand::CopyFromCache() {
+  base::File::Info info;
+  if (!base::GetFileInfo(cache_file_, &info))
+    return false;
+  const TimeDelta age = base::Time::Now() - info.last_modified;
+  if (age < TimeDelta() || age > TimeDelta::FromSeconds(kCacheSeconds))
+    return false;
+
+  std::string contents;
+  if (!base::ReadFileToString(cache_file_, &contents))
+    return false;
+  // Open the output file as brillo::Process does for RedirectOutput().
+  base::ScopedFD output(HANDLE_EINTR(
+      open(output_file_.value().c_str(),
+           O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0666)));
+  if (!output.is_valid()) {
+    PLOG(ERROR) << "Could not open " << output_file_.value();
+    return false;
+  }
+  return base::WriteFileDescriptor(output.get(), contents.data(),
+                                   contents.size());
+}
+
+void LogCommand::WriteCache() {
+  std::string contents;
+  if (!base::ReadFileToString(output_file_, &contents))
+    return;
+  // The cache holds logs of all users, so only root may read it.
+  if (!base::CreateDirectory(cache_directory_) ||
+      !base::SetPosixFilePermissions(cache_directory_, 0700)) {
+    PLOG(WARNING) << "Could not create " << cache_directory_.value();
+    return;
+  }
+  // Replace the cached output at once, for other crash_reporter instances
+  // reading it.
+  const FilePath temp_file = cache_file_.AddExtension("new");
+  if (base::WriteFile(temp_file, contents.data(), contents.size()) !=
+          static_cast<int>(contents.size()) ||
+      !base::ReplaceFile(temp_file, cache_file_, nullptr)) {
+    PLOG(WARNING) << "Could not write " << cache_file_.value();
+    base::DeleteFile(temp_file, false);
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRASH_REPORTER_LOG_COMMAND_H_
+#define CRASH_REPORTER_LOG_COMMAND_H_
+
+#include <string>
+
+#include <base/files/file_path.h>
+#include <base/macros.h>
+#include <base/time/time.h>
+#include <brillo/process.h>
+
+// Runs a command from crash_reporter_logs.conf through the shell, writing
+// its standard output and standard error to a file.
+//
+// The command runs in the background, at a lower priority, so that the crash
+// can be collected meanwhile.  It gets kTimeoutSeconds from its start:
+// after that, it is killed along with the processes it started, and what it
+// wrote so far is kept.
+//
+// When given a cache directory, the output of a command that succeeded is
+// kept there for kCacheSeconds and used instead of running the same command
+// again, as happens when a process crashes repeatedly.
+class LogCommand {
+ public:
+  static const int kTimeoutSeconds = 10;
+  static const int kCacheSeconds = 15;
+
+  // No cache is used if |cache_directory| is empty.
+  LogCommand(const std::string &command,
+             const base::FilePath &cache_directory);
+
+  // Kills the command if it is still running.
+  ~LogCommand();
+
+  // Starts writing the output of the command to |output_file|.  Returns
+  // false if the command could not be started.
+  bool Start(const base::FilePath &output_file);
+
+  // Waits for the command started by Start() until it exits or runs out of
+  // time.  Returns false if it exited with an error.
+  bool Wait();
+
+ private:
+  // Kills the command and the processes it started, and reaps it.
+  void Kill();
+
+  // Writes the cached output of the command to |output_file_|.  Returns
+  // false if there is no recent enough output cached.
+  bool CopyFromCache();
+  void WriteCache();
+
+  const std::string command_;
+  const base::FilePath cache_directory_;
+  base::FilePath cache_file_;
+  base::FilePath output_file_;
+  bool from_cache_ = false;
+
+  brillo::ProcessImpl process_;
+  base::TimeTicks deadline_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogCommand);
+};
+
+#endif  // CRASH_REPORTER_LOG_COMMAND_H_
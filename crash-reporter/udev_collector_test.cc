@@ -117,6 +117,8 @@ class UdevCollectorTest : public ::testing::Test {
     FilePath log_config_path =
         temp_dir_generator_.path().Append(kLogConfigFileName);
     collector_.log_config_path_ = log_config_path;
+    collector_.log_cache_directory_ =
+        temp_dir_generator_.path().Append("log_cache");
     collector_.ForceCrashDirectory(temp_dir_generator_.path());
 
     FilePath dev_coredump_path =
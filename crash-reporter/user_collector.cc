@@ -19,6 +19,8 @@
 #include <base/strings/stringprintf.h>
 #include <brillo/process.h>
 
+#include "crash-reporter/core_stripper.h"
+
 using base::FilePath;
 using base::StringPrintf;
 
@@ -181,9 +183,12 @@ UserCollector::ErrorType UserCollector::ValidateCoreFile(
 }
 
 bool UserCollector::CopyStdinToCoreFile(const FilePath &core_path) {
-  // Copy off all stdin to a core file.
-  FilePath stdin_path("/dev/fd/0");
-  if (base::CopyFile(stdin_path, core_path)) {
+  // Copy off all stdin to a core file.  Developer images keep the whole core
+  // for debugging; otherwise only the parts core2md needs are written out.
+  CoreStripper stripper(STDIN_FILENO);
+  if (stripper.WriteTo(core_path, !IsDeveloperImage())) {
+    LOG(INFO) << "Wrote " << stripper.bytes_written() << " of "
+              << stripper.bytes_read() << " bytes of core file";
     return true;
   }
 
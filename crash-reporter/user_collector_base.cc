@@ -22,6 +22,10 @@ const uid_t kUnknownUid = -1;
 const char kCollectionErrorSignature[] = "crash_reporter-user-collection";
 const char kStatePrefix[] = "State:\t";
 
+// Shared by all crash_reporter invocations.  On tmpfs, so that crash loops are
+// forgotten across reboots.
+const char kRateLimitStatePath[] = "/var/run/crash_reporter/rate_limit";
+
 }  // namespace
 
 const char *UserCollectorBase::kUserId = "Uid:\t";
@@ -29,7 +33,9 @@ const char *UserCollectorBase::kGroupId = "Gid:\t";
 
 UserCollectorBase::UserCollectorBase(const char *tag,
                                      bool force_user_crash_dir)
-    : CrashCollector(force_user_crash_dir), tag_(tag) {
+    : CrashCollector(force_user_crash_dir),
+      tag_(tag),
+      rate_limit_state_path_(kRateLimitStatePath) {
 }
 
 void UserCollectorBase::Initialize(
@@ -94,7 +100,7 @@ bool UserCollectorBase::HandleCrash(const std::string &crash_attributes,
   if (dump) {
     count_crash_function_();
 
-    if (generate_diagnostics_) {
+    if (generate_diagnostics_ && ShouldCollect(exec, signal)) {
       bool out_of_capacity = false;
       ErrorType error_type =
           ConvertAndEnqueueCrash(pid, exec, supplied_ruid, &out_of_capacity);
@@ -109,6 +115,28 @@ bool UserCollectorBase::HandleCrash(const std::string &crash_attributes,
   return true;
 }
 
+bool UserCollectorBase::ShouldCollect(const std::string &exec, int signal) {
+  // Tests of the crash reporter expect every crash to be collected.
+  if (IsCrashTestInProgress() || !filter_in_.empty())
+    return true;
+
+  CrashRateLimiter limiter(rate_limit_state_path_);
+  int suppressed = 0;
+  CrashRateLimiter::Verdict verdict = limiter.RecordCrash(
+      StringPrintf("%s:%d", exec.c_str(), signal), time(nullptr), &suppressed);
+  if (verdict == CrashRateLimiter::kCollect)
+    return true;
+
+  LOG(WARNING) << '[' << tag_ << "] Not collecting crash of " << exec
+               << (verdict == CrashRateLimiter::kDuplicate
+                       ? ": crash-looping"
+                       : ": too many crashes")
+               << " (" << suppressed << " not collected recently)";
+  if (count_suppressed_crash_function_)
+    count_suppressed_crash_function_(verdict);
+  return false;
+}
+
 bool UserCollectorBase::ParseCrashAttributes(
     const std::string &crash_attributes,
     pid_t *pid, int *signal, uid_t *uid, std::string *kernel_supplied_name) {
@@ -238,11 +266,14 @@ UserCollectorBase::ErrorType UserCollectorBase::ConvertAndEnqueueCrash(
   FilePath minidump_path = GetCrashPath(crash_path, dump_basename, "dmp");
   FilePath log_path = GetCrashPath(crash_path, dump_basename, "log");
 
-  if (GetLogContents(FilePath(log_config_path_), exec, log_path))
-    AddCrashMetaData("log", log_path.value());
+  // Gather logs while the core is read and converted.
+  const bool log_started =
+      StartLogContents(FilePath(log_config_path_), exec, log_path);
 
   ErrorType error_type =
       ConvertCoreToMinidump(pid, container_dir, core_path, minidump_path);
+  if (log_started && FinishLogContents())
+    AddCrashMetaData("log", log_path.value());
   if (error_type != kErrorNone) {
     if (error_type != kErrorReadCoreData)
       LOG(INFO) << "Leaving core file at " << core_path.value()
@@ -11,10 +11,13 @@
 #include <base/files/file_path.h>
 
 #include "crash-reporter/crash_collector.h"
+#include "crash-reporter/crash_rate_limiter.h"
 
 // Common functionality shared by user collectors.
 class UserCollectorBase : public CrashCollector {
  public:
+  typedef void (*CountSuppressedCrashFunction)(CrashRateLimiter::Verdict);
+
   UserCollectorBase(const char *tag, bool force_user_crash_dir);
 
   void Initialize(CountCrashFunction count_crash,
@@ -27,6 +30,18 @@ class UserCollectorBase : public CrashCollector {
   bool HandleCrash(const std::string &crash_attributes,
                    const char *force_exec);
 
+  // Set the function called for each crash that is counted but not collected
+  // because its process is crash-looping.  See CrashRateLimiter.
+  void set_count_suppressed_crash_function(
+      CountSuppressedCrashFunction function) {
+    count_suppressed_crash_function_ = function;
+  }
+
+  // Set (override the default) crash rate limiter state file.
+  void set_rate_limit_state_path(const base::FilePath &path) {
+    rate_limit_state_path_ = path;
+  }
+
  protected:
   // Enumeration to pass to GetIdFromStatus.  Must match the order
   // that the kernel lists IDs in the status file.
@@ -102,6 +117,10 @@ class UserCollectorBase : public CrashCollector {
       const base::FilePath &core_path,
       const base::FilePath &minidump_path) = 0;
 
+  // Returns true if the crash of |exec| with |signal| should be collected,
+  // or false if only counting it is enough because |exec| is crash-looping.
+  bool ShouldCollect(const std::string &exec, int signal);
+
   ErrorType ConvertAndEnqueueCrash(pid_t pid,
                                    const std::string &exec,
                                    uid_t supplied_ruid,
@@ -126,6 +145,8 @@ class UserCollectorBase : public CrashCollector {
   bool generate_diagnostics_ = false;
   bool directory_failure_ = false;
   std::string filter_in_;
+  CountSuppressedCrashFunction count_suppressed_crash_function_ = nullptr;
+  base::FilePath rate_limit_state_path_;
 };
 
 #endif  // CRASH_REPORTER_USER_COLLECTOR_BASE_H_
@@ -113,6 +113,14 @@
             'usb_device_info_unittest.cc',
           ]
         },
+        {
+          'target_name': 'mount_info_benchmark',
+          'type': 'executable',
+          'dependencies': ['libdisks'],
+          'sources': [
+            'mount_info_benchmark.cc',
+          ]
+        },
       ],
     }],
   ],
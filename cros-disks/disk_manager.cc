@@ -7,6 +7,7 @@
 #include <libudev.h>
 #include <string.h>
 #include <sys/mount.h>
+#include <sys/statvfs.h>
 
 #include <memory>
 
@@ -43,24 +44,12 @@ const char kScsiSubsystem[] = "scsi";
 const char kScsiDevice[] = "scsi_device";
 const char kUdevAddAction[] = "add";
 const char kUdevChangeAction[] = "change";
+const char kUdevMoveAction[] = "move";
 const char kUdevRemoveAction[] = "remove";
+const char kPropertyDevicePathOld[] = "DEVPATH_OLD";
 const char kPropertyDiskEjectRequest[] = "DISK_EJECT_REQUEST";
 const char kPropertyDiskMediaChange[] = "DISK_MEDIA_CHANGE";
 
-// An EnumerateBlockDevices callback that appends a Disk object, created from
-// |dev|, to |disks| if |dev| should not be ignored by cros-disks. Always
-// returns true to continue the enumeration in EnumerateBlockDevices.
-bool AppendDiskIfNotIgnored(vector<Disk>* disks, udev_device* dev) {
-  DCHECK(disks);
-  DCHECK(dev);
-
-  UdevDevice device(dev);
-  if (!device.IsIgnored())
-    disks->push_back(device.ToDisk());
-
-  return true;  // Continue the enumeration.
-}
-
 // An EnumerateBlockDevices callback that checks if |dev| matches |path|. If
 // it's a match, sets |match| to true and |disk| (if not NULL) to a Disk object
 // created from |dev|, and returns false to stop the enumeration in
@@ -95,7 +84,8 @@ DiskManager::DiskManager(const string& mount_root, Platform* platform,
       device_ejector_(device_ejector),
       udev_(udev_new()),
       udev_monitor_fd_(0),
-      eject_device_on_unmount_(true) {
+      eject_device_on_unmount_(true),
+      disk_inventory_loaded_(false) {
   CHECK(device_ejector_) << "Invalid device ejector";
   CHECK(udev_) << "Failed to initialize udev";
   udev_monitor_ = udev_monitor_new_from_netlink(udev_, "udev");
@@ -121,10 +111,13 @@ bool DiskManager::Initialize() {
 
   // Since there are no udev add events for the devices that already exist
   // when the disk manager starts, emulate udev add events for these devices
-  // to correctly populate |disks_detected_|.
+  // to correctly populate |disks_detected_| and |disk_inventory_|.
+  disk_inventory_.clear();
+  disk_inventory_paths_.clear();
   EnumerateBlockDevices(base::Bind(&DiskManager::EmulateBlockDeviceEvent,
                                    base::Unretained(this),
                                    kUdevAddAction));
+  disk_inventory_loaded_ = true;
 
   return MountManager::Initialize();
 }
@@ -139,17 +132,129 @@ bool DiskManager::EmulateBlockDeviceEvent(const char* action,
 
   DeviceEventList events;
   ProcessBlockDeviceEvents(dev, action, &events);
+  UpdateDiskInventory(action, dev);
 
   return true;  // Continue the enumeration.
 }
 
 vector<Disk> DiskManager::EnumerateDisks() const {
+  if (!disk_inventory_loaded_)
+    LoadDiskInventory();
+
+  mount_info_.RetrieveFromCurrentProcess();
   vector<Disk> disks;
-  EnumerateBlockDevices(
-      base::Bind(&AppendDiskIfNotIgnored, base::Unretained(&disks)));
+  disks.reserve(disk_inventory_.size());
+  for (const auto& inventory_disk : disk_inventory_)
+    disks.push_back(GetCurrentDisk(inventory_disk.second, mount_info_));
   return disks;
 }
 
+DiskManager::InventoryDisk::InventoryDisk()
+    : has_device_size(false), device_size(0) {}
+
+void DiskManager::LoadDiskInventory() const {
+  disk_inventory_.clear();
+  disk_inventory_paths_.clear();
+  EnumerateBlockDevices(base::Bind(&DiskManager::UpdateDiskInventory,
+                                   base::Unretained(this),
+                                   kUdevAddAction));
+  disk_inventory_loaded_ = true;
+}
+
+bool DiskManager::UpdateDiskInventory(const char* action,
+                                      udev_device* dev) const {
+  DCHECK(dev);
+
+  UdevDevice device(dev);
+  string sys_path = device.NativePath();
+  if (strcmp(action, kUdevMoveAction) == 0) {
+    const char* old_dev_path =
+        udev_device_get_property_value(dev, kPropertyDevicePathOld);
+    if (old_dev_path) {
+      auto old_path = disk_inventory_paths_.find(old_dev_path);
+      if (old_path != disk_inventory_paths_.end()) {
+        const string old_sys_path = old_path->second;
+        RemoveFromDiskInventory(old_sys_path);
+      }
+    }
+  }
+  RemoveFromDiskInventory(sys_path);
+  if (strcmp(action, kUdevRemoveAction) == 0 || device.IsIgnored())
+    return true;  // Continue the enumeration.
+
+  InventoryDisk& inventory_disk = disk_inventory_[sys_path];
+  inventory_disk.disk = device.ToDisk();
+  inventory_disk.has_device_size =
+      device.GetDeviceSize(&inventory_disk.device_size);
+  const char* dev_path = udev_device_get_devpath(dev);
+  if (dev_path) {
+    inventory_disk.dev_path = dev_path;
+    disk_inventory_paths_[dev_path] = sys_path;
+  }
+  const string& dev_file = inventory_disk.disk.device_file();
+  if (!dev_file.empty())
+    disk_inventory_paths_[dev_file] = sys_path;
+
+  return true;  // Continue the enumeration.
+}
+
+void DiskManager::RemoveFromDiskInventory(const string& sys_path) const {
+  auto inventory_disk = disk_inventory_.find(sys_path);
+  if (inventory_disk == disk_inventory_.end())
+    return;
+
+  for (const string& path : {inventory_disk->second.dev_path,
+                             inventory_disk->second.disk.device_file()}) {
+    auto alias = disk_inventory_paths_.find(path);
+    if (alias != disk_inventory_paths_.end() && alias->second == sys_path)
+      disk_inventory_paths_.erase(alias);
+  }
+  disk_inventory_.erase(inventory_disk);
+}
+
+const DiskManager::InventoryDisk* DiskManager::FindInventoryDisk(
+    const string& path) const {
+  if (!disk_inventory_loaded_)
+    LoadDiskInventory();
+
+  auto inventory_disk = disk_inventory_.find(path);
+  if (inventory_disk == disk_inventory_.end()) {
+    auto alias = disk_inventory_paths_.find(path);
+    if (alias == disk_inventory_paths_.end())
+      return nullptr;
+    inventory_disk = disk_inventory_.find(alias->second);
+    if (inventory_disk == disk_inventory_.end())
+      return nullptr;
+  }
+  return &inventory_disk->second;
+}
+
+// static
+Disk DiskManager::GetCurrentDisk(const InventoryDisk& inventory_disk,
+                                 const MountInfo& mount_info) {
+  Disk disk = inventory_disk.disk;
+  vector<string> mount_paths;
+  if (!disk.device_file().empty())
+    mount_paths = mount_info.GetMountPaths(disk.device_file());
+  disk.set_is_mounted(!mount_paths.empty());
+  disk.set_mount_paths(mount_paths);
+
+  // Determine the sizes the way UdevDevice::GetSizeInfo() does.
+  uint64_t total_size = 0, remaining_size = 0;
+  if (!mount_paths.empty()) {
+    struct statvfs stat;
+    if (statvfs(mount_paths[0].c_str(), &stat) == 0) {
+      total_size = stat.f_blocks * stat.f_frsize;
+      remaining_size = stat.f_bfree * stat.f_frsize;
+    }
+  }
+  if (inventory_disk.has_device_size)
+    total_size = inventory_disk.device_size;
+  disk.set_device_capacity(total_size);
+  disk.set_bytes_remaining(remaining_size);
+  return disk;
+}
+
 void DiskManager::EnumerateBlockDevices(
     const base::Callback<bool(udev_device* dev)>& callback) const {
   udev_enumerate *enumerate = udev_enumerate_new(udev_);
@@ -305,6 +410,7 @@ bool DiskManager::GetDeviceEvents(DeviceEventList* events) {
   // subsystem is either "block", "mmc", or "scsi".
   if (strcmp(subsystem, kBlockSubsystem) == 0) {
     ProcessBlockDeviceEvents(dev, action, events);
+    UpdateDiskInventory(action, dev);
   } else {
     // strcmp(subsystem, kMmcSubsystem) == 0 ||
     // strcmp(subsystem, kScsiSubsystem) == 0
@@ -320,6 +426,18 @@ bool DiskManager::GetDiskByDevicePath(const string& device_path,
   if (device_path.empty())
     return false;
 
+  const InventoryDisk* inventory_disk = FindInventoryDisk(device_path);
+  if (inventory_disk) {
+    if (disk) {
+      mount_info_.RetrieveFromCurrentProcess();
+      *disk = GetCurrentDisk(*inventory_disk, mount_info_);
+    }
+    return true;
+  }
+
+  // Devices ignored by cros-disks aren't in the inventory, and a device that
+  // was just added may not be either if its udev event hasn't been read yet.
+  // Look for them in sysfs.
   bool disk_found = false;
   EnumerateBlockDevices(base::Bind(&MatchDiskByPath,
                                    device_path,
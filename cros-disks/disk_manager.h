@@ -6,6 +6,7 @@
 #define CROS_DISKS_DISK_MANAGER_H_
 
 #include <libudev.h>
+#include <stdint.h>
 
 #include <map>
 #include <set>
@@ -19,12 +20,13 @@
 #include "cros-disks/device_ejector.h"
 #include "cros-disks/device_event.h"
 #include "cros-disks/device_event_source_interface.h"
+#include "cros-disks/disk.h"
+#include "cros-disks/mount_info.h"
 #include "cros-disks/mount_manager.h"
 
 namespace cros_disks {
 
 class DeviceEjector;
-class Disk;
 class Filesystem;
 class Mounter;
 class Platform;
@@ -32,6 +34,9 @@ class Platform;
 // The DiskManager is responsible for reading device state from udev.
 // Said changes could be the result of a udev notification or a synchronous
 // call to enumerate the relevant storage devices attached to the system.
+// Queries for disks are answered from an inventory of the block devices that
+// is built by a single enumeration and then kept current by the udev events
+// read in GetDeviceEvents().
 //
 // Sample Usage:
 //
@@ -108,6 +113,25 @@ class DiskManager : public MountManager,
   bool ShouldReserveMountPathOnError(MountErrorType error_type) const override;
 
  private:
+  // A block device in |disk_inventory_|.
+  struct InventoryDisk {
+    InventoryDisk();
+
+    // The disk as of the last udev event for the device. Its mount state and
+    // sizes are refreshed whenever it's returned, as they change without udev
+    // events.
+    Disk disk;
+
+    // The device path of the device, i.e. its sysfs path without the mount
+    // point of sysfs.
+    std::string dev_path;
+
+    // Size of the device as reported by udev, if |has_device_size| is true.
+    // It takes precedence over the size of the mounted filesystem.
+    bool has_device_size;
+    uint64_t device_size;
+  };
+
   // Creates an appropriate mounter object for a given filesystem.
   // The caller is responsible for deleting the mounter object.
   Mounter* CreateMounter(const Disk& disk, const Filesystem& filesystem,
@@ -130,6 +154,29 @@ class DiskManager : public MountManager,
   void EnumerateBlockDevices(
       const base::Callback<bool(udev_device* dev)>& callback) const;
 
+  // Enumerates the block devices on the system and rebuilds |disk_inventory_|
+  // from scratch.
+  void LoadDiskInventory() const;
+
+  // An EnumerateBlockDevices callback that updates |disk_inventory_| for a
+  // block device event defined by |action| on |dev|. Also called for the
+  // events read from |udev_monitor_|. Always returns true to continue
+  // enumeration in EnumerateBlockDevices.
+  bool UpdateDiskInventory(const char* action, udev_device* dev) const;
+
+  // Removes the entry of the device at |sys_path| from |disk_inventory_|.
+  void RemoveFromDiskInventory(const std::string& sys_path) const;
+
+  // Returns the inventory entry of the device whose sysfs path, device path or
+  // device file is |path|, or nullptr if there is none. Loads the inventory if
+  // it hasn't been yet.
+  const InventoryDisk* FindInventoryDisk(const std::string& path) const;
+
+  // Returns the disk of |inventory_disk| with its mount state and sizes
+  // updated according to |mount_info|.
+  static Disk GetCurrentDisk(const InventoryDisk& inventory_disk,
+                             const MountInfo& mount_info);
+
   // Determines one or more device/disk events from a udev block device change.
   void ProcessBlockDeviceEvents(udev_device* device,
                                 const char *action,
@@ -178,6 +225,20 @@ class DiskManager : public MountManager,
   // to a set of sysfs paths of the immediate children of the disk.
   std::map<std::string, std::set<std::string>> disks_detected_;
 
+  // Set to true once |disk_inventory_| has been loaded.
+  mutable bool disk_inventory_loaded_;
+
+  // The block devices not ignored by cros-disks, indexed by sysfs path.
+  mutable std::map<std::string, InventoryDisk> disk_inventory_;
+
+  // A mapping from the device path and device file of each device in
+  // |disk_inventory_| to its sysfs path.
+  mutable std::map<std::string, std::string> disk_inventory_paths_;
+
+  // The mount points of the current process, refreshed before each query for
+  // disks.
+  mutable MountInfo mount_info_;
+
   // A set of supported filesystems indexed by filesystem type.
   std::map<std::string, Filesystem> filesystems_;
 
@@ -187,6 +248,7 @@ class DiskManager : public MountManager,
   FRIEND_TEST(DiskManagerTest, CreateSystemMounter);
   FRIEND_TEST(DiskManagerTest, GetFilesystem);
   FRIEND_TEST(DiskManagerTest, RegisterFilesystem);
+  FRIEND_TEST(DiskManagerTest, DiskInventoryMatchesRescan);
   FRIEND_TEST(DiskManagerTest, DoMountDiskWithNonexistentSourcePath);
   FRIEND_TEST(DiskManagerTest, DoUnmountDiskWithInvalidUnmountOptions);
   FRIEND_TEST(DiskManagerTest, ScheduleEjectOnUnmount);
@@ -8,6 +8,7 @@
 
 #include <memory>
 
+#include <base/bind.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/stl_util.h>
@@ -23,6 +24,7 @@
 #include "cros-disks/mounter.h"
 #include "cros-disks/ntfs_mounter.h"
 #include "cros-disks/platform.h"
+#include "cros-disks/udev_device.h"
 
 using std::map;
 using std::string;
@@ -35,6 +37,16 @@ namespace {
 
 const char kMountRootDirectory[] = "/media/removable";
 
+// An EnumerateBlockDevices callback that appends a Disk object, created from
+// |dev|, to |disks| if |dev| should not be ignored by cros-disks. Always
+// returns true to continue the enumeration in EnumerateBlockDevices.
+bool AppendDiskIfNotIgnored(vector<cros_disks::Disk>* disks, udev_device* dev) {
+  cros_disks::UdevDevice device(dev);
+  if (!device.IsIgnored())
+    disks->push_back(device.ToDisk());
+  return true;
+}
+
 }  // namespace
 
 namespace cros_disks {
@@ -160,6 +172,47 @@ TEST_F(DiskManagerTest, GetDiskByNonexistentDevicePath) {
   EXPECT_FALSE(manager_.GetDiskByDevicePath(device_path, &disk));
 }
 
+TEST_F(DiskManagerTest, DiskInventoryMatchesRescan) {
+  vector<Disk> disks = manager_.EnumerateDisks();
+  for (const auto& disk : disks) {
+    Disk found_disk;
+    EXPECT_TRUE(manager_.GetDiskByDevicePath(disk.native_path(), &found_disk));
+    EXPECT_EQ(disk.device_file(), found_disk.device_file());
+    if (!disk.device_file().empty()) {
+      EXPECT_TRUE(
+          manager_.GetDiskByDevicePath(disk.device_file(), &found_disk));
+      EXPECT_EQ(disk.native_path(), found_disk.native_path());
+    }
+  }
+
+  // Rescanning the block devices and converting each of them, as was done
+  // before the inventory was kept, should yield the same disks.
+  vector<Disk> rescanned_disks;
+  manager_.EnumerateBlockDevices(
+      base::Bind(&AppendDiskIfNotIgnored, base::Unretained(&rescanned_disks)));
+  ASSERT_EQ(rescanned_disks.size(), disks.size());
+  map<string, const Disk*> disks_by_path;
+  for (const auto& disk : disks)
+    disks_by_path[disk.native_path()] = &disk;
+  for (const auto& rescanned_disk : rescanned_disks) {
+    SCOPED_TRACE(rescanned_disk.native_path());
+    auto it = disks_by_path.find(rescanned_disk.native_path());
+    ASSERT_TRUE(it != disks_by_path.end());
+    const Disk& disk = *it->second;
+    EXPECT_EQ(rescanned_disk.device_file(), disk.device_file());
+    EXPECT_EQ(rescanned_disk.filesystem_type(), disk.filesystem_type());
+    EXPECT_EQ(rescanned_disk.uuid(), disk.uuid());
+    EXPECT_EQ(rescanned_disk.label(), disk.label());
+    EXPECT_EQ(rescanned_disk.is_drive(), disk.is_drive());
+    EXPECT_EQ(rescanned_disk.is_hidden(), disk.is_hidden());
+    EXPECT_EQ(rescanned_disk.is_media_available(), disk.is_media_available());
+    EXPECT_EQ(rescanned_disk.is_mounted(), disk.is_mounted());
+    EXPECT_EQ(rescanned_disk.mount_paths(), disk.mount_paths());
+    EXPECT_EQ(rescanned_disk.device_capacity(), disk.device_capacity());
+    EXPECT_EQ(rescanned_disk.bytes_remaining(), disk.bytes_remaining());
+  }
+}
+
 TEST_F(DiskManagerTest, GetFilesystem) {
   EXPECT_EQ(nullptr, manager_.GetFilesystem("nonexistent-fs"));
 
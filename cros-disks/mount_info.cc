@@ -4,17 +4,25 @@
 
 #include "cros-disks/mount_info.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/strings/string_piece.h>
 #include <base/strings/string_split.h>
 
-#include "cros-disks/file_reader.h"
-
 using base::FilePath;
 using std::string;
 using std::vector;
 
 namespace {
 
+const char kMountInfoFile[] = "/proc/self/mountinfo";
+
 bool IsOctalDigit(char digit) {
   return digit >= '0' && digit <= '7';
 }
@@ -65,47 +73,109 @@ string MountInfo::DecodePath(const string& encoded_path) const {
 
 vector<string> MountInfo::GetMountPaths(const string& source_path) const {
   vector<string> mount_paths;
-  for (const auto& mount_point : mount_points_) {
-    if (mount_point.source_path == source_path)
-      mount_paths.push_back(mount_point.mount_path);
-  }
+  const auto indices = source_mount_points_.find(source_path);
+  if (indices == source_mount_points_.end())
+    return mount_paths;
+
+  mount_paths.reserve(indices->second.size());
+  for (size_t index : indices->second)
+    mount_paths.push_back(mount_points_[index].mount_path);
   return mount_paths;
 }
 
 bool MountInfo::HasMountPath(const string& mount_path) const {
-  for (const auto& mount_point : mount_points_) {
-    if (mount_point.mount_path == mount_path)
-      return true;
-  }
-  return false;
+  return mount_paths_.count(mount_path) != 0;
 }
-bool MountInfo::RetrieveFromFile(const string& path) {
+
+void MountInfo::ClearMountPoints() {
   mount_points_.clear();
+  source_mount_points_.clear();
+  mount_paths_.clear();
+}
 
-  FileReader reader;
-  if (!reader.Open(FilePath(path))) {
-    LOG(ERROR) << "Failed to retrieve mount info from '" << path << "'";
-    return false;
-  }
+void MountInfo::ParseMountInfo(const string& content) {
+  ClearMountPoints();
 
-  string line;
-  while (reader.ReadLine(&line)) {
-    vector<string> tokens = base::SplitString(line, " ", base::KEEP_WHITESPACE,
-                                              base::SPLIT_WANT_ALL);
+  for (const base::StringPiece& line : base::SplitStringPiece(
+           content, "\n", base::KEEP_WHITESPACE, base::SPLIT_WANT_NONEMPTY)) {
+    vector<base::StringPiece> tokens = base::SplitStringPiece(
+        line, " ", base::KEEP_WHITESPACE, base::SPLIT_WANT_ALL);
     size_t num_tokens = tokens.size();
     if (num_tokens >= 10 && tokens[num_tokens - 4] == "-") {
       MountPoint mount_point;
-      mount_point.source_path = DecodePath(tokens[num_tokens - 2]);
-      mount_point.mount_path = DecodePath(tokens[4]);
-      mount_point.filesystem_type = tokens[num_tokens - 3];
+      mount_point.source_path = DecodePath(tokens[num_tokens - 2].as_string());
+      mount_point.mount_path = DecodePath(tokens[4].as_string());
+      tokens[num_tokens - 3].CopyToString(&mount_point.filesystem_type);
+      source_mount_points_[mount_point.source_path].push_back(
+          mount_points_.size());
+      mount_paths_.insert(mount_point.mount_path);
       mount_points_.push_back(mount_point);
     }
   }
+}
+
+bool MountInfo::RetrieveFromFile(const string& path) {
+  mount_info_file_.reset();
+
+  string content;
+  if (!base::ReadFileToString(FilePath(path), &content)) {
+    LOG(ERROR) << "Failed to retrieve mount info from '" << path << "'";
+    ClearMountPoints();
+    return false;
+  }
+  ParseMountInfo(content);
   return true;
 }
 
 bool MountInfo::RetrieveFromCurrentProcess() {
-  return RetrieveFromFile("/proc/self/mountinfo");
+  if (mount_info_file_.is_valid()) {
+    // The kernel flags the file with POLLERR and POLLPRI once the mount
+    // table has changed since the last poll. Keep the parsed mount points
+    // if it hasn't.
+    struct pollfd poll_fd = {mount_info_file_.get(), POLLPRI, 0};
+    int result = HANDLE_EINTR(poll(&poll_fd, 1, 0));
+    if (result == 0)
+      return true;
+    if (result < 0)
+      PLOG(WARNING) << "Failed to poll '" << kMountInfoFile << "'";
+  } else {
+    mount_info_file_.reset(
+        HANDLE_EINTR(open(kMountInfoFile, O_RDONLY | O_CLOEXEC)));
+    if (!mount_info_file_.is_valid()) {
+      PLOG(ERROR) << "Failed to retrieve mount info from '" << kMountInfoFile
+                  << "'";
+      ClearMountPoints();
+      return false;
+    }
+  }
+
+  string content;
+  if (!ReadMountInfoFile(&content)) {
+    PLOG(ERROR) << "Failed to retrieve mount info from '" << kMountInfoFile
+                << "'";
+    mount_info_file_.reset();
+    ClearMountPoints();
+    return false;
+  }
+  ParseMountInfo(content);
+  return true;
+}
+
+bool MountInfo::ReadMountInfoFile(string* content) const {
+  if (lseek(mount_info_file_.get(), 0, SEEK_SET) != 0)
+    return false;
+
+  content->clear();
+  char buffer[4096];
+  while (true) {
+    ssize_t bytes_read =
+        HANDLE_EINTR(read(mount_info_file_.get(), buffer, sizeof(buffer)));
+    if (bytes_read < 0)
+      return false;
+    if (bytes_read == 0)
+      return true;
+    content->append(buffer, bytes_read);
+  }
 }
 
 }  // namespace cros_disks
@@ -6,8 +6,11 @@
 #define CROS_DISKS_MOUNT_INFO_H_
 
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <base/files/scoped_file.h>
 #include <base/macros.h>
 #include <gtest/gtest_prod.h>
 
@@ -15,7 +18,10 @@ namespace cros_disks {
 
 struct MountPoint;
 
-// A class for querying information about mount points.
+// A class for querying information about mount points. Lookups by source path
+// and mount path take constant time. An instance that is kept around can be
+// refreshed with RetrieveFromCurrentProcess(), which only rereads the mount
+// table when the kernel reports that it changed.
 class MountInfo {
  public:
   MountInfo();
@@ -39,10 +45,23 @@ class MountInfo {
   bool RetrieveFromFile(const std::string& path);
 
   // Retrieves the list of mount points of the current process by reading
-  // /proc/self/mountinfo. Returns true on success.
+  // /proc/self/mountinfo. Returns true on success. The file is kept open, and
+  // later calls skip rereading it unless polling it indicates that mount points
+  // have been added or removed since.
   bool RetrieveFromCurrentProcess();
 
  private:
+  // Clears the list of mount points and its indices.
+  void ClearMountPoints();
+
+  // Replaces the list of mount points with those in |content|, which has the
+  // same format as /proc/self/mountinfo.
+  void ParseMountInfo(const std::string& content);
+
+  // Reads the whole of |mount_info_file_| into |content|. Returns true on
+  // success.
+  bool ReadMountInfoFile(std::string* content) const;
+
   // Converts a 3-character octal string into a decimal integer.
   // Returns -1 if the conversion fails.
   int ConvertOctalStringToInt(const std::string& octal) const;
@@ -50,6 +69,15 @@ class MountInfo {
   // A list of mount points gathered by the last call to RetrieveMountInfo().
   std::vector<MountPoint> mount_points_;
 
+  // The indices in |mount_points_| of the mount points of each source path.
+  std::unordered_map<std::string, std::vector<size_t>> source_mount_points_;
+
+  // The mount paths of |mount_points_|.
+  std::unordered_set<std::string> mount_paths_;
+
+  // /proc/self/mountinfo, once RetrieveFromCurrentProcess() has opened it.
+  base::ScopedFD mount_info_file_;
+
   FRIEND_TEST(MountInfoTest, ConvertOctalStringToInt);
 
   DISALLOW_COPY_AND_ASSIGN(MountInfo);
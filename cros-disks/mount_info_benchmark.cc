@@ -0,0 +1,186 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Writes a mountinfo file with a given number of mount points, such as a
+// session with many archive and FUSE mounts would have, and looks up every
+// source and mount path in it, both with the implementation MountInfo used to
+// have and with the current one. Checks that both give the same answers and
+// reports the time each takes. Also reports how long refreshing the mount
+// points of the current process takes when they haven't changed.
+//
+// Usage: mount_info_benchmark [--mounts=5000] [--iterations=10]
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/macros.h>
+#include <base/strings/string_split.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+#include <brillo/flag_helper.h>
+
+#include "cros-disks/file_reader.h"
+#include "cros-disks/mount_info.h"
+
+using base::FilePath;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The implementation MountInfo replaced, for reference.
+class ReferenceMountInfo {
+ public:
+  ReferenceMountInfo() {}
+
+  bool RetrieveFromFile(const string& path) {
+    mount_points_.clear();
+
+    cros_disks::FileReader reader;
+    if (!reader.Open(FilePath(path)))
+      return false;
+
+    string line;
+    while (reader.ReadLine(&line)) {
+      vector<string> tokens = base::SplitString(
+          line, " ", base::KEEP_WHITESPACE, base::SPLIT_WANT_ALL);
+      size_t num_tokens = tokens.size();
+      if (num_tokens >= 10 && tokens[num_tokens - 4] == "-") {
+        MountPoint mount_point;
+        mount_point.source_path = decoder_.DecodePath(tokens[num_tokens - 2]);
+        mount_point.mount_path = decoder_.DecodePath(tokens[4]);
+        mount_point.filesystem_type = tokens[num_tokens - 3];
+        mount_points_.push_back(mount_point);
+      }
+    }
+    return true;
+  }
+
+  vector<string> GetMountPaths(const string& source_path) const {
+    vector<string> mount_paths;
+    for (const auto& mount_point : mount_points_) {
+      if (mount_point.source_path == source_path)
+        mount_paths.push_back(mount_point.mount_path);
+    }
+    return mount_paths;
+  }
+
+  bool HasMountPath(const string& mount_path) const {
+    for (const auto& mount_point : mount_points_) {
+      if (mount_point.mount_path == mount_path)
+        return true;
+    }
+    return false;
+  }
+
+ private:
+  struct MountPoint {
+    string source_path;
+    string mount_path;
+    string filesystem_type;
+  };
+
+  // Only used for MountInfo::DecodePath(), which hasn't changed.
+  cros_disks::MountInfo decoder_;
+  vector<MountPoint> mount_points_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReferenceMountInfo);
+};
+
+string GetSourcePath(int index) {
+  return base::StringPrintf("/home/chronos/u-0123/Downloads/archive%05d.zip",
+                            index);
+}
+
+string GetMountPath(int index) {
+  return base::StringPrintf("/media/archive/archive%05d.zip", index);
+}
+
+void PrintTime(const char* phase, int operations, base::TimeDelta time) {
+  printf("%-10s %8d ops %10.1f ms %8.2f us/op\n", phase, operations,
+         time.InMillisecondsF(),
+         operations ? time.InMicroseconds() / static_cast<double>(operations)
+                    : 0.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  DEFINE_int32(mounts, 5000, "number of mount points");
+  DEFINE_int32(iterations, 10, "number of times to load the mount points");
+  brillo::FlagHelper::Init(argc, argv, "MountInfo benchmark");
+  CHECK_GT(FLAGS_mounts, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+
+  // Every mount point is an AVFS mount of a different archive, as mounted by
+  // ArchiveManager.
+  string content;
+  for (int i = 0; i < FLAGS_mounts; ++i) {
+    content += base::StringPrintf(
+        "%d 20 0:%d / %s rw,nosuid,nodev,noexec shared:%d - fuse.avfsd %s "
+        "rw,user_id=0,group_id=0\n",
+        100 + i, 50 + i, GetMountPath(i).c_str(), 200 + i,
+        GetSourcePath(i).c_str());
+  }
+  base::ScopedTempDir temp_dir;
+  CHECK(temp_dir.CreateUniqueTempDir());
+  const FilePath mount_file = temp_dir.path().Append("mountinfo");
+  CHECK_EQ(static_cast<int>(content.size()),
+           base::WriteFile(mount_file, content.data(), content.size()));
+  printf("%d mount points, %zu bytes\n", FLAGS_mounts, content.size());
+
+  // Load the mount points and look up every source and mount path in them.
+  base::TimeDelta reference_time;
+  base::TimeDelta mount_info_time;
+  int mismatches = 0;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    ReferenceMountInfo reference;
+    CHECK(reference.RetrieveFromFile(mount_file.value()));
+    vector<vector<string>> reference_paths(FLAGS_mounts);
+    int reference_found = 0;
+    for (int j = 0; j < FLAGS_mounts; ++j) {
+      reference_paths[j] = reference.GetMountPaths(GetSourcePath(j));
+      reference_found += reference.HasMountPath(GetMountPath(j));
+    }
+
+    base::TimeTicks middle = base::TimeTicks::Now();
+    cros_disks::MountInfo mount_info;
+    CHECK(mount_info.RetrieveFromFile(mount_file.value()));
+    vector<vector<string>> mount_info_paths(FLAGS_mounts);
+    int mount_info_found = 0;
+    for (int j = 0; j < FLAGS_mounts; ++j) {
+      mount_info_paths[j] = mount_info.GetMountPaths(GetSourcePath(j));
+      mount_info_found += mount_info.HasMountPath(GetMountPath(j));
+    }
+    base::TimeTicks end = base::TimeTicks::Now();
+
+    reference_time += middle - start;
+    mount_info_time += end - middle;
+    if (reference_paths != mount_info_paths ||
+        reference_found != mount_info_found) {
+      printf("Iteration %d found different mount points\n", i);
+      ++mismatches;
+    }
+  }
+  PrintTime("reference", FLAGS_iterations * FLAGS_mounts, reference_time);
+  PrintTime("mountinfo", FLAGS_iterations * FLAGS_mounts, mount_info_time);
+
+  // Refreshing the mount points of the current process only rereads them if
+  // they changed, which they don't here.
+  cros_disks::MountInfo mount_info;
+  CHECK(mount_info.RetrieveFromCurrentProcess());
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < FLAGS_mounts; ++i)
+    CHECK(mount_info.RetrieveFromCurrentProcess());
+  PrintTime("refresh", FLAGS_mounts, base::TimeTicks::Now() - start);
+
+  return mismatches ? 1 : 0;
+}
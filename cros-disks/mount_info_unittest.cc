@@ -100,9 +100,32 @@ TEST_F(MountInfoTest, RetrieveFromFile) {
   EXPECT_TRUE(manager_.RetrieveFromFile(mount_file_));
 }
 
+TEST_F(MountInfoTest, RetrieveFromFileReplacesMountPoints) {
+  EXPECT_TRUE(manager_.RetrieveFromFile(mount_file_));
+  EXPECT_TRUE(manager_.HasMountPath("/var"));
+
+  string content = "31 26 8:17 / /media/usb rw - vfat /dev/sdb1 rw\n";
+  ASSERT_EQ(content.size(),
+            base::WriteFile(FilePath(mount_file_), content.c_str(),
+                            content.size()));
+  EXPECT_TRUE(manager_.RetrieveFromFile(mount_file_));
+  EXPECT_FALSE(manager_.HasMountPath("/var"));
+  EXPECT_TRUE(manager_.GetMountPaths("/dev/sda1").empty());
+  vector<string> expected_paths = {"/media/usb"};
+  EXPECT_TRUE(expected_paths == manager_.GetMountPaths("/dev/sdb1"));
+
+  EXPECT_FALSE(manager_.RetrieveFromFile("/nonexistent-path"));
+  EXPECT_FALSE(manager_.HasMountPath("/media/usb"));
+}
+
 TEST_F(MountInfoTest, RetrieveFromCurrentProcess) {
   EXPECT_TRUE(manager_.RetrieveFromCurrentProcess());
   EXPECT_TRUE(manager_.HasMountPath("/proc"));
+
+  // Retrieving again without any mount changes in between should keep the
+  // mount points.
+  EXPECT_TRUE(manager_.RetrieveFromCurrentProcess());
+  EXPECT_TRUE(manager_.HasMountPath("/proc"));
 }
 
 }  // namespace cros_disks
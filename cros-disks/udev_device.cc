@@ -146,7 +146,6 @@ string UdevDevice::GetPropertyFromBlkId(const char *key) {
 
 void UdevDevice::GetSizeInfo(uint64_t *total_size,
                              uint64_t *remaining_size) const {
-  static const int kSectorSize = 512;
   uint64_t total = 0, remaining = 0;
 
   // If the device is mounted, obtain the total and remaining size in bytes
@@ -160,28 +159,39 @@ void UdevDevice::GetSizeInfo(uint64_t *total_size,
     }
   }
 
-  // If the UDISKS_PARTITION_SIZE property is set, use it as the total size
-  // instead. If the UDISKS_PARTITION_SIZE property is not set but sysfs
-  // provides a size value, which is the actual size in bytes divided by 512,
-  // use that as the total size instead.
+  // The size of the device, if known, takes precedence over that of the
+  // filesystem.
+  uint64_t device_size;
+  if (GetDeviceSize(&device_size))
+    total = device_size;
+
+  if (total_size)
+    *total_size = total;
+  if (remaining_size)
+    *remaining_size = remaining;
+}
+
+bool UdevDevice::GetDeviceSize(uint64_t *device_size) const {
+  static const int kSectorSize = 512;
+
+  // If the UDISKS_PARTITION_SIZE property is set, use it as the size. If the
+  // UDISKS_PARTITION_SIZE property is not set but sysfs provides a size value,
+  // which is the actual size in bytes divided by 512, use that instead.
   const char *partition_size =
       udev_device_get_property_value(dev_, kPropertyPartitionSize);
   int64_t size = 0;
   if (partition_size) {
     base::StringToInt64(partition_size, &size);
-    total = size;
-  } else {
-    const char *size_attr = udev_device_get_sysattr_value(dev_, kAttributeSize);
-    if (size_attr) {
-      base::StringToInt64(size_attr, &size);
-      total = size * kSectorSize;
-    }
+    *device_size = size;
+    return true;
   }
-
-  if (total_size)
-    *total_size = total;
-  if (remaining_size)
-    *remaining_size = remaining;
+  const char *size_attr = udev_device_get_sysattr_value(dev_, kAttributeSize);
+  if (size_attr) {
+    base::StringToInt64(size_attr, &size);
+    *device_size = size * kSectorSize;
+    return true;
+  }
+  return false;
 }
 
 size_t UdevDevice::GetPartitionCount() const {
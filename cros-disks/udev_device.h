@@ -51,6 +51,10 @@ class UdevDevice {
   // Gets the total and remaining capacity of the device.
   void GetSizeInfo(uint64_t *total_size, uint64_t *remaining_size) const;
 
+  // Gets the size of the device in bytes as reported by udev or sysfs.
+  // Returns false if neither reports one.
+  bool GetDeviceSize(uint64_t *device_size) const;
+
   // Gets the number of partitions on the device.
   size_t GetPartitionCount() const;
 
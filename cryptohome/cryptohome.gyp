@@ -307,6 +307,7 @@
       'type': 'executable',
       'link_settings': {
         'libraries': [
+          '-lbootstat',
           '-lvboot_host',
         ],
       },
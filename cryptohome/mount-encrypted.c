@@ -30,6 +30,8 @@
 
 #include <openssl/rand.h>
 
+#include <metrics/bootstat.h>
+
 #define CHROMEOS_ENVIRONMENT
 #include <vboot/tlcl.h>
 #include <vboot/crossystem.h>
@@ -702,10 +704,17 @@ static int finalize_from_cmdline(char *key)
 	return EXIT_SUCCESS;
 }
 
-static void spawn_resizer(const char *device, uint64_t blocks,
-			  uint64_t blocks_max)
+/* Spawns a filesystem resizing process. */
+static void spawn_resizer(const char *device, const char *mount_point,
+			  uint64_t blocks, uint64_t blocks_max)
 {
 	pid_t pid;
+	uint64_t current;
+
+	/* The superblock knows how far any earlier resizer got. */
+	current = filesystem_blocks(device, kExt4BlockSize);
+	if (current > blocks)
+		blocks = current;
 
 	/* Skip resize before forking, if it's not going to happen. */
 	if (blocks >= blocks_max) {
@@ -734,7 +743,9 @@ static void spawn_resizer(const char *device, uint64_t blocks,
 		goto out;
 	}
 
-	filesystem_resize(device, blocks, blocks_max);
+	if (filesystem_resize(device, mount_point, kExt4BlockSize, blocks,
+			      blocks_max))
+		bootstat_log("encstateful-resize-done");
 
 out:
 	INFO_DONE("Done.");
@@ -951,9 +962,13 @@ static int setup_encrypted(int mode)
 		goto dm_cleanup;
 	}
 
-	/* Always spawn filesystem resizer, in case growth was interrupted. */
-	/* TODO(keescook): if already full size, don't resize. */
-	spawn_resizer(dmcrypt_dev, blocks_min, blocks_max);
+	bootstat_log("encstateful-mounted");
+
+	/* Spawn the filesystem resizer unless the filesystem is already
+	 * full size; it resumes from the size recorded in the superblock
+	 * in case growth was interrupted.
+	 */
+	spawn_resizer(dmcrypt_dev, encrypted_mount, blocks_min, blocks_max);
 
 	/* If the legacy lockbox NVRAM area exists, we've rebuilt the
 	 * filesystem, and there are old bind sources on disk, attempt
@@ -1353,7 +1368,9 @@ int main(int argc, char *argv[])
 
 	check_mount_states();
 
+	bootstat_log("pre-mount-encrypted");
 	okay = setup_encrypted(mode);
+	bootstat_log("post-mount-encrypted");
 	/* If we fail, let chromeos_startup handle the stateful wipe. */
 
 	if (okay)
@@ -22,6 +22,8 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/mount.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
 #include <linux/fs.h>
 #include <linux/loop.h>
 
@@ -38,7 +40,9 @@ static const gchar kLoopTemplate[] = "/dev/loop%d";
 static const int kLoopMajor = 7;
 static const int kLoopMax = 8;
 static const unsigned int kResizeStepSeconds = 2;
+static const unsigned int kResizeIdleSeconds = 60;
 static const uint64_t kResizeBlocks = 32768 * 10;
+static const uint64_t kResizeHeadroomBlocks = 32768 * 10;
 static const uint64_t kBlocksPerGroup = 32768;
 static const uint64_t kInodeRatioDefault = 16384;
 static const uint64_t kInodeRatioMinimum = 2048;
@@ -582,29 +586,200 @@ out:
 	return rc;
 }
 
-/* Spawns a filesystem resizing process. */
-int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max)
+/* ext4 superblock fields needed to find the current filesystem size. */
+#define EXT4_SUPERBLOCK_OFFSET		1024
+#define EXT4_SUPERBLOCK_SIZE		1024
+#define EXT4_SB_BLOCKS_COUNT_LO		0x04
+#define EXT4_SB_LOG_BLOCK_SIZE		0x18
+#define EXT4_SB_MAGIC			0x38
+#define EXT4_SB_FEATURE_INCOMPAT	0x60
+#define EXT4_SB_BLOCKS_COUNT_HI		0x150
+#define EXT4_SUPER_MAGIC		0xEF53
+#define EXT4_FEATURE_INCOMPAT_64BIT	0x80
+
+static uint32_t le32_at(const uint8_t *buf, size_t offset)
 {
-	/* Ignore resizing if we know the filesystem was built to max size. */
+	return (uint32_t)buf[offset] |
+	       ((uint32_t)buf[offset + 1] << 8) |
+	       ((uint32_t)buf[offset + 2] << 16) |
+	       ((uint32_t)buf[offset + 3] << 24);
+}
+
+/* Reads the block count and block size of the filesystem on "device" from
+ * its superblock. Since resize2fs updates the superblock as each step
+ * completes, the block count doubles as the persisted progress of an
+ * interrupted resize. Returns 1 on success, 0 on failure.
+ */
+static int filesystem_geometry(const char *device, uint64_t *blocks,
+			       uint64_t *fs_block_bytes)
+{
+	uint8_t sb[EXT4_SUPERBLOCK_SIZE];
+	uint32_t log_block_size;
+	ssize_t count;
+	int fd;
+
+	fd = open(device, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0) {
+		PERROR("open(%s)", device);
+		return 0;
+	}
+	count = pread(fd, sb, sizeof(sb), EXT4_SUPERBLOCK_OFFSET);
+	close(fd);
+	if (count != sizeof(sb)) {
+		ERROR("Short superblock read on %s", device);
+		return 0;
+	}
+
+	if ((sb[EXT4_SB_MAGIC] | (sb[EXT4_SB_MAGIC + 1] << 8)) !=
+	    EXT4_SUPER_MAGIC) {
+		ERROR("No ext4 superblock found on %s", device);
+		return 0;
+	}
+
+	log_block_size = le32_at(sb, EXT4_SB_LOG_BLOCK_SIZE);
+	if (log_block_size > 6) {
+		ERROR("Invalid block size in superblock on %s", device);
+		return 0;
+	}
+	*fs_block_bytes = 1024ULL << log_block_size;
+
+	*blocks = le32_at(sb, EXT4_SB_BLOCKS_COUNT_LO);
+	if (le32_at(sb, EXT4_SB_FEATURE_INCOMPAT) & EXT4_FEATURE_INCOMPAT_64BIT)
+		*blocks |= (uint64_t)le32_at(sb, EXT4_SB_BLOCKS_COUNT_HI) << 32;
+
+	return 1;
+}
+
+/* Returns the number of "block_bytes"-sized blocks the filesystem on
+ * "device" currently spans, as recorded in its superblock, or 0 on
+ * failure.
+ */
+uint64_t filesystem_blocks(const char *device, uint64_t block_bytes)
+{
+	uint64_t blocks, fs_block_bytes;
+
+	if (!filesystem_geometry(device, &blocks, &fs_block_bytes))
+		return 0;
+	return blocks * fs_block_bytes / block_bytes;
+}
+
+/* Drop the resizer to the idle I/O class so that it only competes for the
+ * disk when nothing else (e.g. login) wants it.
+ */
+static void resize_throttle(void)
+{
+	const int kIoprioClassShift = 13;
+	const int kIoprioClassIdle = 3;
+	const int kIoprioWhoProcess = 1;
+
+	if (syscall(SYS_ioprio_set, kIoprioWhoProcess, 0,
+		    kIoprioClassIdle << kIoprioClassShift))
+		PERROR("ioprio_set");
+}
+
+/* Returns the number of free blocks available on the filesystem mounted at
+ * "mount_point", or UINT64_MAX if it cannot be determined (which forces
+ * growth to proceed unthrottled).
+ */
+static uint64_t filesystem_free_blocks(const char *mount_point,
+				       uint64_t block_bytes)
+{
+	struct statvfs buf;
+
+	if (statvfs(mount_point, &buf)) {
+		PERROR("statvfs(%s)", mount_point);
+		return UINT64_MAX;
+	}
+	return (uint64_t)buf.f_bavail * buf.f_frsize / block_bytes;
+}
+
+/* Returns how long to wait before checking the free space again, given
+ * that "consumed" blocks were used up over the last "elapsed" seconds and
+ * "free_blocks" remain. Polls at half the time the observed fill rate
+ * needs to eat into the headroom, so a filesystem filling up quickly (e.g.
+ * during a first-login sync) is grown before it runs out, while an idle one
+ * is only checked every kResizeIdleSeconds. With no measurement yet
+ * ("elapsed" of 0), polls again soon to take one.
+ */
+static unsigned int resize_poll_seconds(uint64_t free_blocks,
+					uint64_t consumed,
+					unsigned int elapsed)
+{
+	uint64_t seconds;
+
+	if (!elapsed)
+		return kResizeStepSeconds;
+	if (!consumed || free_blocks <= kResizeHeadroomBlocks)
+		return kResizeIdleSeconds;
+
+	seconds = (free_blocks - kResizeHeadroomBlocks) * elapsed /
+		  consumed / 2;
+	if (seconds < kResizeStepSeconds)
+		return kResizeStepSeconds;
+	if (seconds > kResizeIdleSeconds)
+		return kResizeIdleSeconds;
+	return seconds;
+}
+
+/* Grows the filesystem on "device", mounted at "mount_point", towards
+ * "blocks_max" (in "block_bytes" units) kResizeBlocks at a time, whenever
+ * fewer than kResizeHeadroomBlocks remain free. This runs in the resizer
+ * daemon that mount-encrypted forks at boot, which lives until the
+ * filesystem reaches full size or resize2fs fails, and is otherwise only
+ * ended by shutdown. Progress is kept in the superblock, so the next boot's
+ * resizer picks up where this one stopped. Returns 1 once full size is
+ * reached, 0 on failure.
+ */
+int filesystem_resize(const char *device, const char *mount_point,
+		      uint64_t block_bytes, uint64_t blocks,
+		      uint64_t blocks_max)
+{
+	uint64_t current, fs_block_bytes;
+	uint64_t last_free_blocks = UINT64_MAX;
+	unsigned int poll_seconds = 0;
+
+	/* Work in the filesystem's own block size, which is what resize2fs
+	 * expects, and prefer the size recorded in the superblock, which
+	 * reflects any growth completed by an earlier (possibly interrupted)
+	 * resizer.
+	 */
+	if (filesystem_geometry(device, &current, &fs_block_bytes)) {
+		blocks = current;
+		blocks_max = blocks_max * block_bytes / fs_block_bytes;
+	} else {
+		fs_block_bytes = block_bytes;
+	}
+
 	if (blocks >= blocks_max) {
 		INFO("Resizing aborted. blocks:%" PRIu64 " >= blocks_max:%" PRIu64,
 		     blocks, blocks_max);
 		return 1;
 	}
 
-	/* TODO(keescook): Read superblock to find out the current size of
-	 * the filesystem (since statvfs does not report the correct value).
-	 * For now, instead of doing multi-step resizing, just resize to the
-	 * full size of the block device in one step.
-	 */
-	blocks = blocks_max;
+	resize_throttle();
 
-	INFO("Resizing started in %d second steps.", kResizeStepSeconds);
+	INFO("Resizing started from %" PRIu64 " blocks, keeping %" PRIu64
+	     " blocks free.", blocks, kResizeHeadroomBlocks);
 
 	do {
 		gchar *blocks_str;
+		uint64_t free_blocks;
 
-		sleep(kResizeStepSeconds);
+		/* Only grow when the filesystem is running low on space,
+		 * so that first-boot growth doesn't compete with login I/O.
+		 */
+		free_blocks = filesystem_free_blocks(mount_point,
+						     fs_block_bytes);
+		if (free_blocks != UINT64_MAX &&
+		    free_blocks >= kResizeHeadroomBlocks) {
+			poll_seconds = resize_poll_seconds(free_blocks,
+				last_free_blocks > free_blocks ?
+					last_free_blocks - free_blocks : 0,
+				poll_seconds);
+			last_free_blocks = free_blocks;
+			sleep(poll_seconds);
+			continue;
+		}
 
 		blocks += kResizeBlocks;
 		if (blocks > blocks_max)
@@ -624,12 +799,21 @@ int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max)
 			NULL
 		};
 
-		INFO("Resizing filesystem on %s to %" PRIu64 ".", device, blocks);
+		INFO("Resizing filesystem on %s to %" PRIu64 " (%" PRIu64
+		     " blocks free).", device, blocks, free_blocks);
 		if (runcmd(resize, NULL)) {
 			ERROR("resize2fs failed");
+			g_free(blocks_str);
 			return 0;
 		}
 		g_free(blocks_str);
+
+		/* The step just added free space; start measuring the fill
+		 * rate afresh.
+		 */
+		last_free_blocks = UINT64_MAX;
+		poll_seconds = 0;
+		sleep(kResizeStepSeconds);
 	} while (blocks < blocks_max);
 
 	INFO("Resizing finished.");
@@ -33,7 +33,10 @@ int sparse_create(const char *path, uint64_t bytes);
 /* Filesystem creation. */
 int filesystem_build(const char *device, uint64_t block_bytes,
                      uint64_t blocks_min, uint64_t blocks_max);
-int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max);
+uint64_t filesystem_blocks(const char *device, uint64_t block_bytes);
+int filesystem_resize(const char *device, const char *mount_point,
+                      uint64_t block_bytes, uint64_t blocks,
+                      uint64_t blocks_max);
 
 /* Encrypted keyfile handling. */
 char *keyfile_read(const char *keyfile, uint8_t *system_key);
@@ -286,11 +286,20 @@
             'src/helpers/dev_features_password_utils_test.cc',
             'src/log_tool_test.cc',
             'src/modem_status_tool_test.cc',
+            'src/perf_tool_test.cc',
             'src/process_with_id_test.cc',
             'src/sandboxed_process_test.cc',
             'src/testrunner.cc',
           ]
         },
+        {
+          'target_name': 'anonymizer_tool_benchmark',
+          'type': 'executable',
+          'dependencies': ['libdebugd'],
+          'sources': [
+            'src/anonymizer_tool_benchmark.cc',
+          ],
+        },
       ],
     }],
     ['USE_wimax == 1', {
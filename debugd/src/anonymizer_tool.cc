@@ -46,10 +46,41 @@ const char *kCustomPatterns[] = {
   "(?-s)(\\[SSID=)(.+?)(\\])",  // shill
 };
 
+// Length of a MAC address in the "aa:bb:cc:dd:ee:ff" form.
+const size_t kMacAddressLength = 17;
+
+// Length of the OUI (Organizationally Unique Identifier) part of a MAC
+// address, "aa:bb:cc".
+const size_t kOuiLength = 8;
+
+// Returns true if |input| holds a MAC address at |pos|: six pairs of hex
+// digits separated by colons.
+bool IsMacAddressAt(const string& input, size_t pos) {
+  if (pos + kMacAddressLength > input.size())
+    return false;
+  for (size_t i = 0; i < kMacAddressLength; ++i) {
+    const char c = input[pos + i];
+    if (i % 3 == 2 ? c != ':' : !base::IsHexDigit(c))
+      return false;
+  }
+  return true;
+}
+
+pcrecpp::RE_Options GetCustomPatternOptions() {
+  return pcrecpp::RE_Options().set_multiline(true).set_dotall(true);
+}
+
 }  // namespace
 
 AnonymizerTool::AnonymizerTool()
-    : custom_patterns_(arraysize(kCustomPatterns)) {}
+    : custom_patterns_(arraysize(kCustomPatterns)) {
+  for (size_t i = 0; i < arraysize(kCustomPatterns); i++) {
+    custom_pattern_res_.emplace_back(
+        new pcrecpp::RE(kCustomPatterns[i], GetCustomPatternOptions()));
+  }
+}
+
+AnonymizerTool::~AnonymizerTool() {}
 
 string AnonymizerTool::Anonymize(const string& input) {
   string anonymized = AnonymizeMACAddresses(input);
@@ -58,56 +89,53 @@ string AnonymizerTool::Anonymize(const string& input) {
 }
 
 string AnonymizerTool::AnonymizeMACAddresses(const string& input) {
-  // This regular expression finds the next MAC address. It splits the data into
-  // a section preceding the MAC address, an OUI (Organizationally Unique
-  // Identifier) part and a NIC (Network Interface Controller) specific part.
-  pcrecpp::RE mac_re("(.*?)("
-                     "[0-9a-fA-F][0-9a-fA-F]:"
-                     "[0-9a-fA-F][0-9a-fA-F]:"
-                     "[0-9a-fA-F][0-9a-fA-F]):("
-                     "[0-9a-fA-F][0-9a-fA-F]:"
-                     "[0-9a-fA-F][0-9a-fA-F]:"
-                     "[0-9a-fA-F][0-9a-fA-F])",
-                     pcrecpp::RE_Options()
-                     .set_multiline(true)
-                     .set_dotall(true));
-
+  // Every MAC address has a colon two characters in, so only the positions
+  // before colons need to be checked. Checking them left to right finds the
+  // same, non-overlapping addresses that a "(.*?)(mac)" regular expression
+  // consuming the input would, without copying the text between them.
   string result;
   result.reserve(input.size());
 
-  // Keep consuming, building up a result string as we go.
-  pcrecpp::StringPiece text(input);
-  string pre_mac, oui, nic;
-  while (mac_re.Consume(&text, &pre_mac, &oui, &nic)) {
+  size_t copied = 0;
+  size_t colon = input.find(':', copied + 2);
+  while (colon != string::npos) {
+    const size_t start = colon - 2;
+    if (!IsMacAddressAt(input, start)) {
+      colon = input.find(':', colon + 1);
+      continue;
+    }
+
     // Look up the MAC address in the hash.
-    oui = base::ToLowerASCII(oui);
-    nic = base::ToLowerASCII(nic);
-    string mac = oui + ":" + nic;
+    const string mac =
+        base::ToLowerASCII(input.substr(start, kMacAddressLength));
     string replacement_mac = mac_addresses_[mac];
     if (replacement_mac.empty()) {
-      // If not found, build up a replacement MAC address by generating a new
-      // NIC part.
+      // If not found, build up a replacement MAC address by keeping the OUI
+      // and generating a new NIC (Network Interface Controller) part.
       int mac_id = mac_addresses_.size();
       replacement_mac = StringPrintf("%s:%02x:%02x:%02x",
-                                     oui.c_str(),
+                                     mac.substr(0, kOuiLength).c_str(),
                                      (mac_id & 0x00ff0000) >> 16,
                                      (mac_id & 0x0000ff00) >> 8,
                                      (mac_id & 0x000000ff));
       mac_addresses_[mac] = replacement_mac;
     }
 
-    result += pre_mac;
+    result.append(input, copied, start - copied);
     result += replacement_mac;
+    copied = start + kMacAddressLength;
+    colon = input.find(':', copied + 2);
   }
 
-  return result + text.as_string();
+  result.append(input, copied, string::npos);
+  return result;
 }
 
 string AnonymizerTool::AnonymizeCustomPatterns(const string& input) {
   string anonymized = input;
-  for (size_t i = 0; i < arraysize(kCustomPatterns); i++) {
+  for (size_t i = 0; i < custom_pattern_res_.size(); i++) {
     anonymized = AnonymizeCustomPattern(anonymized,
-                                        kCustomPatterns[i],
+                                        *custom_pattern_res_[i],
                                         &custom_patterns_[i]);
   }
   return anonymized;
@@ -118,32 +146,44 @@ string AnonymizerTool::AnonymizeCustomPattern(
     const string& input,
     const string& pattern,
     map<string, string>* identifier_space) {
-  pcrecpp::RE re("(.*?)" + pattern,
-                 pcrecpp::RE_Options()
-                 .set_multiline(true)
-                 .set_dotall(true));
-  DCHECK_EQ(4, re.NumberOfCapturingGroups());
+  return AnonymizeCustomPattern(
+      input, pcrecpp::RE(pattern, GetCustomPatternOptions()),
+      identifier_space);
+}
+
+// static
+string AnonymizerTool::AnonymizeCustomPattern(
+    const string& input,
+    const pcrecpp::RE& re,
+    map<string, string>* identifier_space) {
+  DCHECK_EQ(3, re.NumberOfCapturingGroups());
 
   string result;
   result.reserve(input.size());
 
-  // Keep consuming, building up a result string as we go.
+  // Keep finding matches, building up a result string as we go. The groups
+  // are captured as pieces of |input| and the text between matches is copied
+  // straight from it. Since the groups cover the whole match, the text
+  // preceding a match ends where its first group starts.
   pcrecpp::StringPiece text(input);
-  string pre_match, pre_matched_id, matched_id, post_matched_id;
-  while (re.Consume(&text, &pre_match,
-                    &pre_matched_id, &matched_id, &post_matched_id)) {
-    string replacement_id = (*identifier_space)[matched_id];
+  pcrecpp::StringPiece pre_matched_id, matched_id, post_matched_id;
+  const char* copied = input.data();
+  while (re.FindAndConsume(&text,
+                           &pre_matched_id, &matched_id, &post_matched_id)) {
+    const string id = matched_id.as_string();
+    string replacement_id = (*identifier_space)[id];
     if (replacement_id.empty()) {
       replacement_id = IntToString(identifier_space->size());
-      (*identifier_space)[matched_id] = replacement_id;
+      (*identifier_space)[id] = replacement_id;
     }
 
-    result += pre_match;
-    result += pre_matched_id;
+    result.append(copied, pre_matched_id.data() - copied);
+    result.append(pre_matched_id.data(), pre_matched_id.size());
     result += replacement_id;
-    result += post_matched_id;
+    result.append(post_matched_id.data(), post_matched_id.size());
+    copied = text.data();
   }
-  result += text.as_string();
+  result.append(copied, input.data() + input.size() - copied);
   return result;
 }
 
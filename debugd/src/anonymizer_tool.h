@@ -6,17 +6,22 @@
 #define DEBUGD_SRC_ANONYMIZER_TOOL_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <base/macros.h>
 
+namespace pcrecpp {
+class RE;
+}  // namespace pcrecpp
+
 namespace debugd {
 
 class AnonymizerTool {
  public:
   AnonymizerTool();
-  ~AnonymizerTool() = default;
+  ~AnonymizerTool();
 
   // Returns an anonymized version of |input|. PII-sensitive data (such as MAC
   // addresses) in |input| is replaced with unique identifiers.
@@ -31,10 +36,17 @@ class AnonymizerTool {
       const std::string& input,
       const std::string& pattern,
       std::map<std::string, std::string>* identifier_space);
+  static std::string AnonymizeCustomPattern(
+      const std::string& input,
+      const pcrecpp::RE& re,
+      std::map<std::string, std::string>* identifier_space);
 
   std::map<std::string, std::string> mac_addresses_;
   std::vector<std::map<std::string, std::string>> custom_patterns_;
 
+  // kCustomPatterns, compiled once rather than on every call.
+  std::vector<std::unique_ptr<pcrecpp::RE>> custom_pattern_res_;
+
   DISALLOW_COPY_AND_ASSIGN(AnonymizerTool);
 };
 
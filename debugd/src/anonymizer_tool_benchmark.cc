@@ -0,0 +1,198 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Anonymizes a corpus of logs, such as the files of an unpacked feedback
+// report, both with the implementation AnonymizerTool used to have and with
+// the current one. Checks that both give the same output and reports the
+// throughput of each.
+//
+// Usage: anonymizer_tool_benchmark --corpus=/path/to/logs [--iterations=10]
+
+#include <pcrecpp.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/files/file_enumerator.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/logging.h>
+#include <base/macros.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+#include <brillo/flag_helper.h>
+
+#include "debugd/src/anonymizer_tool.h"
+
+using base::FilePath;
+using std::map;
+using std::string;
+
+namespace {
+
+// The implementation AnonymizerTool replaced, for reference.
+
+const char *kCustomPatterns[] = {
+  "(\\bCell ID: ')([0-9a-fA-F]+)(')",
+  "(\\bLocation area code: ')([0-9a-fA-F]+)(')",
+  "(?i-s)(\\bssid[= ]')(.+)(')",
+  "(?-s)(\\bSSID - hexdump\\(len=[0-9]+\\): )(.+)()",
+  "(?-s)(\\[SSID=)(.+?)(\\])",
+};
+
+class ReferenceAnonymizer {
+ public:
+  ReferenceAnonymizer() : custom_patterns_(arraysize(kCustomPatterns)) {}
+
+  string Anonymize(const string& input) {
+    string anonymized = AnonymizeMACAddresses(input);
+    for (size_t i = 0; i < arraysize(kCustomPatterns); i++) {
+      anonymized = AnonymizeCustomPattern(anonymized, kCustomPatterns[i],
+                                          &custom_patterns_[i]);
+    }
+    return anonymized;
+  }
+
+ private:
+  string AnonymizeMACAddresses(const string& input) {
+    pcrecpp::RE mac_re("(.*?)("
+                       "[0-9a-fA-F][0-9a-fA-F]:"
+                       "[0-9a-fA-F][0-9a-fA-F]:"
+                       "[0-9a-fA-F][0-9a-fA-F]):("
+                       "[0-9a-fA-F][0-9a-fA-F]:"
+                       "[0-9a-fA-F][0-9a-fA-F]:"
+                       "[0-9a-fA-F][0-9a-fA-F])",
+                       pcrecpp::RE_Options()
+                       .set_multiline(true)
+                       .set_dotall(true));
+    string result;
+    result.reserve(input.size());
+    pcrecpp::StringPiece text(input);
+    string pre_mac, oui, nic;
+    while (mac_re.Consume(&text, &pre_mac, &oui, &nic)) {
+      oui = base::ToLowerASCII(oui);
+      nic = base::ToLowerASCII(nic);
+      string mac = oui + ":" + nic;
+      string replacement_mac = mac_addresses_[mac];
+      if (replacement_mac.empty()) {
+        int mac_id = mac_addresses_.size();
+        replacement_mac = base::StringPrintf("%s:%02x:%02x:%02x",
+                                             oui.c_str(),
+                                             (mac_id & 0x00ff0000) >> 16,
+                                             (mac_id & 0x0000ff00) >> 8,
+                                             (mac_id & 0x000000ff));
+        mac_addresses_[mac] = replacement_mac;
+      }
+      result += pre_mac;
+      result += replacement_mac;
+    }
+    return result + text.as_string();
+  }
+
+  static string AnonymizeCustomPattern(const string& input,
+                                       const string& pattern,
+                                       map<string, string>* identifier_space) {
+    pcrecpp::RE re("(.*?)" + pattern,
+                   pcrecpp::RE_Options()
+                   .set_multiline(true)
+                   .set_dotall(true));
+    string result;
+    result.reserve(input.size());
+    pcrecpp::StringPiece text(input);
+    string pre_match, pre_matched_id, matched_id, post_matched_id;
+    while (re.Consume(&text, &pre_match,
+                      &pre_matched_id, &matched_id, &post_matched_id)) {
+      string replacement_id = (*identifier_space)[matched_id];
+      if (replacement_id.empty()) {
+        replacement_id = base::IntToString(identifier_space->size());
+        (*identifier_space)[matched_id] = replacement_id;
+      }
+      result += pre_match;
+      result += pre_matched_id;
+      result += replacement_id;
+      result += post_matched_id;
+    }
+    result += text.as_string();
+    return result;
+  }
+
+  map<string, string> mac_addresses_;
+  std::vector<map<string, string>> custom_patterns_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReferenceAnonymizer);
+};
+
+double GetMegabytesPerSecond(size_t bytes, base::TimeDelta time) {
+  return bytes / (1024.0 * 1024.0) / time.InSecondsF();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  DEFINE_string(corpus, "", "directory holding the logs");
+  DEFINE_int32(iterations, 10, "number of times to anonymize the corpus");
+  brillo::FlagHelper::Init(argc, argv, "Log anonymization benchmark");
+  if (FLAGS_corpus.empty()) {
+    LOG(ERROR) << "--corpus is required";
+    return 1;
+  }
+
+  std::vector<string> logs;
+  size_t total_size = 0;
+  base::FileEnumerator files(FilePath(FLAGS_corpus), true,
+                             base::FileEnumerator::FILES);
+  for (FilePath path = files.Next(); !path.empty(); path = files.Next()) {
+    string log;
+    CHECK(base::ReadFileToString(path, &log)) << path.value();
+    total_size += log.size();
+    logs.push_back(log);
+  }
+  printf("%zu logs, %zu bytes\n", logs.size(), total_size);
+
+  // As in LogTool, a single anonymizer handles all of the logs, so that
+  // identifiers are consistent across them.
+  base::TimeDelta reference_time;
+  base::TimeDelta anonymizer_time;
+  int mismatches = 0;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    std::vector<string> reference_output(logs.size());
+    std::vector<string> anonymizer_output(logs.size());
+
+    ReferenceAnonymizer reference;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t j = 0; j < logs.size(); ++j)
+      reference_output[j] = reference.Anonymize(logs[j]);
+
+    debugd::AnonymizerTool anonymizer;
+    base::TimeTicks middle = base::TimeTicks::Now();
+    for (size_t j = 0; j < logs.size(); ++j)
+      anonymizer_output[j] = anonymizer.Anonymize(logs[j]);
+    base::TimeTicks end = base::TimeTicks::Now();
+
+    reference_time += middle - start;
+    anonymizer_time += end - middle;
+    if (i == 0) {
+      for (size_t j = 0; j < logs.size(); ++j) {
+        if (reference_output[j] != anonymizer_output[j]) {
+          printf("Log %zu is anonymized differently\n", j);
+          ++mismatches;
+        }
+      }
+    }
+  }
+
+  const size_t processed = total_size * FLAGS_iterations;
+  printf("regular expressions %10.1f ms %8.1f MB/s\n",
+         reference_time.InMillisecondsF(),
+         GetMegabytesPerSecond(processed, reference_time));
+  printf("anonymizer          %10.1f ms %8.1f MB/s\n",
+         anonymizer_time.InMillisecondsF(),
+         GetMegabytesPerSecond(processed, anonymizer_time));
+
+  return mismatches ? 1 : 0;
+}
@@ -60,6 +60,8 @@ TEST_F(AnonymizerToolTest, AnonymizeMACAddresses) {
                                   "x bb:cc:dd:ee:ff:00 cc:dd:ee:ff:00:11 x\n"));
   EXPECT_EQ("Remember bb:cc:dd:00:00:02?",
             AnonymizeMACAddresses("Remember bB:Cc:DD:ee:ff:00?"));
+  EXPECT_EQ("x:12:34:56:00:00:04:00:11",
+            AnonymizeMACAddresses("x:12:34:56:78:9a:bc:00:11"));
 }
 
 TEST_F(AnonymizerToolTest, AnonymizeCustomPatterns) {
@@ -4,16 +4,26 @@
 
 #include "debugd/src/log_tool.h"
 
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 #include <glib.h>
 
+#include <base/bind.h>
+#include <base/callback.h>
 #include <base/files/file_util.h>
-#include <base/json/json_writer.h>
+#include <base/json/string_escape.h>
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 #include <base/strings/string_split.h>
 #include <base/strings/string_util.h>
-#include <base/values.h>
+#include <base/time/time.h>
 
 #include <chromeos/dbus/service_constants.h>
 #include <shill/dbus_proxies/org.chromium.flimflam.Manager.h>
@@ -37,13 +47,13 @@ const char *kShell = "/bin/sh";
 // Minimum time in seconds needed to allow shill to test active connections.
 const int kConnectionTesterTimeoutSeconds = 5;
 
-struct Log {
-  const char *name;
-  const char *command;
-  const char *user;
-  const char *group;
-  const char *size_cap;  // passed as arg to 'tail'
-};
+// Maximum number of log commands that RunLogs() runs at once.
+const size_t kMaxConcurrentLogCommands = 8;
+
+// Time in seconds after which a log command run by RunLogs() is killed.
+const int kLogCommandTimeoutSeconds = 60;
+
+const char kNotAvailable[] = "<not available>";
 
 const Log common_logs[] = {
   { "CLIENT_ID", "/bin/cat '/home/chronos/Consent To Send Stats'" },
@@ -240,45 +250,105 @@ string EnsureUTF8String(const string& value) {
   return "<invalid>";
 }
 
+// Starts |log|'s command, with its output going to a temporary file, under
+// minijail0 if |use_minijail|. |pre_exec|, unless null, is run in the child
+// before exec(). Returns null if the command couldn't be started.
 // TODO(ellyjones): sandbox. crosbug.com/35122
-string Run(const Log& log) {
-  string output;
-  ProcessWithOutput p;
+std::unique_ptr<ProcessWithOutput> StartLog(
+    const Log& log,
+    bool use_minijail,
+    const base::Callback<bool()>& pre_exec) {
+  std::unique_ptr<ProcessWithOutput> p(new ProcessWithOutput);
   string tailed_cmdline = std::string(log.command) + " | tail -c " +
                           (log.size_cap ? log.size_cap : "256K");
   if (log.user && log.group)
-    p.SandboxAs(log.user, log.group);
-  if (!p.Init())
-    return "<not available>";
-  p.AddArg(kShell);
-  p.AddStringOption("-c", tailed_cmdline);
-  if (p.Run())
-    return "<not available>";
-  p.GetOutput(&output);
+    p->SandboxAs(log.user, log.group);
+  p->set_use_minijail(use_minijail);
+  if (!p->Init())
+    return nullptr;
+  p->AddArg(kShell);
+  p->AddStringOption("-c", tailed_cmdline);
+  if (!pre_exec.is_null())
+    p->SetPreExecCallback(pre_exec);
+  if (!p->Start())
+    return nullptr;
+  return p;
+}
+
+// Returns the output of the successfully-finished command |p|.
+string GetLogOutput(ProcessWithOutput* p) {
+  string output;
+  p->GetOutput(&output);
   if (!output.size())
     return "<empty>";
   return EnsureUTF8String(output);
 }
 
-// Fills |dictionary| with the anonymized contents of the logs in |logs|.
-void GetLogsInDictionary(const struct Log* logs,
-                         AnonymizerTool* anonymizer,
-                         base::DictionaryValue* dictionary) {
-  for (size_t i = 0; logs[i].name; ++i) {
-    dictionary->SetStringWithoutPathExpansion(
-        logs[i].name, anonymizer->Anonymize(Run(logs[i])));
+string Run(const Log& log) {
+  std::unique_ptr<ProcessWithOutput> p =
+      StartLog(log, true, base::Callback<bool()>());
+  if (!p || p->Wait())
+    return kNotAvailable;
+  return GetLogOutput(p.get());
+}
+
+// A log command started by RunLogs().
+struct LogCommand {
+  enum State {
+    RUNNING,
+    SUCCEEDED,
+    FAILED,
+  };
+
+  LogCommand() : state(FAILED) {}
+
+  std::unique_ptr<ProcessWithOutput> process;
+  State state;
+  base::TimeTicks deadline;
+};
+
+// Checks whether |command|'s process exited or ran out of time, updating its
+// state. |log| describes the command.
+void UpdateLogCommand(const Log& log, LogCommand* command) {
+  const pid_t pid = command->process->pid();
+  int status = 0;
+  const pid_t result = HANDLE_EINTR(waitpid(pid, &status, WNOHANG));
+  if (result == pid) {
+    // Already reaped.
+    command->process->Release();
+    command->state = WIFEXITED(status) && WEXITSTATUS(status) == 0 ?
+        LogCommand::SUCCEEDED : LogCommand::FAILED;
+  } else if (result < 0) {
+    PLOG(ERROR) << "Could not wait for log " << log.name;
+    command->process->Release();
+    command->state = LogCommand::FAILED;
+  } else if (base::TimeTicks::Now() >= command->deadline) {
+    LOG(WARNING) << "Log " << log.name << " timed out";
+    // Without minijail0 the command shares our process group, so at least
+    // kill the shell.
+    if (!command->process->KillProcessGroup())
+      kill(pid, SIGKILL);
+    // Reap it right away rather than leaving a zombie. It can't survive
+    // SIGKILL, so this doesn't block for long.
+    HANDLE_EINTR(waitpid(pid, nullptr, 0));
+    command->process->Release();
+    command->state = LogCommand::FAILED;
   }
 }
 
-// Serializes the |dictionary| into the file with the given |fd| in a JSON
-// format.
-void SerializeLogsAsJSON(const base::DictionaryValue& dictionary,
-                         const DBus::FileDescriptor& fd) {
-  std::string logs_json;
-  base::JSONWriter::WriteWithOptions(dictionary,
-                                     base::JSONWriter::OPTIONS_PRETTY_PRINT,
-                                     &logs_json);
-  base::WriteFileDescriptor(fd.get(), logs_json.c_str(), logs_json.size());
+// A pre-exec callback that sets the child's signal mask to |mask|.
+bool SetSignalMask(sigset_t mask) {
+  return sigprocmask(SIG_SETMASK, &mask, nullptr) == 0;
+}
+
+// Appends the logs in the NULL-terminated array |logs| to |log_list|.
+void AppendLogs(const struct Log* logs, vector<const Log*>* log_list) {
+  for (size_t i = 0; logs[i].name; ++i)
+    log_list->push_back(&logs[i]);
+}
+
+void StoreLog(LogTool::LogMap* map, const Log& log, const string& output) {
+  (*map)[log.name] = output;
 }
 
 bool GetNamedLogFrom(const string& name, const struct Log* logs,
@@ -293,13 +363,111 @@ bool GetNamedLogFrom(const string& name, const struct Log* logs,
   return false;
 }
 
-void GetLogsFrom(const struct Log* logs, LogTool::LogMap* map) {
-  for (size_t i = 0; logs[i].name; i++)
-    (*map)[logs[i].name] = Run(logs[i]);
+// Runs the logs in |log_list| and stores their output in |map|.
+void GetLogsFrom(const vector<const Log*>& log_list, LogTool::LogMap* map) {
+  RunLogs(log_list, base::TimeDelta::FromSeconds(kLogCommandTimeoutSeconds),
+          true, base::Bind(&StoreLog, base::Unretained(map)));
 }
 
 }  // namespace
 
+void RunLogs(const vector<const Log*>& logs,
+             base::TimeDelta timeout,
+             bool use_minijail,
+             const LogOutputCallback& callback) {
+  // Outputs wait in their temporary files until they're passed to |callback|,
+  // so only the one being passed is held in memory. SIGCHLD is blocked
+  // meanwhile so that each exit leaves it pending for sigtimedwait() rather
+  // than discarded, but the commands start with the original mask.
+  sigset_t child_signal;
+  sigemptyset(&child_signal);
+  sigaddset(&child_signal, SIGCHLD);
+  sigset_t old_mask;
+  sigprocmask(SIG_BLOCK, &child_signal, &old_mask);
+  const base::Callback<bool()> restore_mask =
+      base::Bind(&SetSignalMask, old_mask);
+
+  vector<LogCommand> commands(logs.size());
+  size_t num_started = 0;
+  size_t num_reported = 0;
+  size_t num_running = 0;
+  while (num_reported < logs.size()) {
+    while (num_running < kMaxConcurrentLogCommands &&
+           num_started < logs.size()) {
+      LogCommand* command = &commands[num_started];
+      command->process =
+          StartLog(*logs[num_started], use_minijail, restore_mask);
+      if (command->process) {
+        command->state = LogCommand::RUNNING;
+        command->deadline = base::TimeTicks::Now() + timeout;
+        num_running++;
+      }
+      num_started++;
+    }
+
+    for (size_t i = num_reported; i < num_started; ++i) {
+      if (commands[i].state != LogCommand::RUNNING)
+        continue;
+      UpdateLogCommand(*logs[i], &commands[i]);
+      if (commands[i].state != LogCommand::RUNNING)
+        num_running--;
+    }
+
+    const size_t previously_reported = num_reported;
+    while (num_reported < num_started &&
+           commands[num_reported].state != LogCommand::RUNNING) {
+      LogCommand* command = &commands[num_reported];
+      callback.Run(*logs[num_reported],
+                   command->state == LogCommand::SUCCEEDED ?
+                       GetLogOutput(command->process.get()) : kNotAvailable);
+      // Deletes the output file.
+      command->process.reset();
+      num_reported++;
+    }
+    if (num_reported != previously_reported || num_running == 0)
+      continue;
+
+    // Sleep until a command exits or the earliest deadline passes. Spurious
+    // wakeups, e.g. for other children, only cost an extra check.
+    base::TimeTicks earliest_deadline;
+    for (size_t i = num_reported; i < num_started; ++i) {
+      if (commands[i].state == LogCommand::RUNNING &&
+          (earliest_deadline.is_null() ||
+           commands[i].deadline < earliest_deadline)) {
+        earliest_deadline = commands[i].deadline;
+      }
+    }
+    const struct timespec wait_time =
+        std::max(base::TimeDelta(),
+                 earliest_deadline - base::TimeTicks::Now()).ToTimeSpec();
+    sigtimedwait(&child_signal, nullptr, &wait_time);
+  }
+
+  sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+}
+
+JSONLogWriter::JSONLogWriter(int fd, AnonymizerTool* anonymizer)
+    : fd_(fd), anonymizer_(anonymizer), empty_(true) {
+  Write("{\n");
+}
+
+JSONLogWriter::~JSONLogWriter() {
+  Write("\n}\n");
+}
+
+void JSONLogWriter::WriteLog(const Log& log, const string& output) {
+  string member = empty_ ? "   " : ",\n   ";
+  base::EscapeJSONString(log.name, true, &member);
+  member += ": ";
+  base::EscapeJSONString(anonymizer_->Anonymize(output), true, &member);
+  Write(member);
+  empty_ = false;
+}
+
+void JSONLogWriter::Write(const string& data) {
+  base::WriteFileDescriptor(fd_, data.data(), data.size());
+}
+
 void LogTool::CreateConnectivityReport(DBus::Connection* connection) {
   // Perform ConnectivityTrial to report connection state in feedback log.
   ManagerProxy shill(connection,
@@ -324,18 +492,22 @@ string LogTool::GetLog(const string& name, DBus::Error* error) {
 LogTool::LogMap LogTool::GetAllLogs(DBus::Connection* connection,
                                     DBus::Error* error) {
   CreateConnectivityReport(connection);
+  vector<const Log*> log_list;
+  AppendLogs(common_logs, &log_list);
+  AppendLogs(extra_logs, &log_list);
   LogMap result;
-  GetLogsFrom(common_logs, &result);
-  GetLogsFrom(extra_logs, &result);
+  GetLogsFrom(log_list, &result);
   return result;
 }
 
 LogTool::LogMap LogTool::GetFeedbackLogs(DBus::Connection* connection,
                                          DBus::Error* error) {
   CreateConnectivityReport(connection);
+  vector<const Log*> log_list;
+  AppendLogs(common_logs, &log_list);
+  AppendLogs(feedback_logs, &log_list);
   LogMap result;
-  GetLogsFrom(common_logs, &result);
-  GetLogsFrom(feedback_logs, &result);
+  GetLogsFrom(log_list, &result);
   AnonymizeLogMap(&result);
   return result;
 }
@@ -344,11 +516,17 @@ void LogTool::GetBigFeedbackLogs(DBus::Connection* connection,
                                  const DBus::FileDescriptor& fd,
                                  DBus::Error* error) {
   CreateConnectivityReport(connection);
-  base::DictionaryValue dictionary;
-  GetLogsInDictionary(common_logs, &anonymizer_, &dictionary);
-  GetLogsInDictionary(feedback_logs, &anonymizer_, &dictionary);
-  GetLogsInDictionary(big_feedback_logs, &anonymizer_, &dictionary);
-  SerializeLogsAsJSON(dictionary, fd);
+  vector<const Log*> log_list;
+  AppendLogs(common_logs, &log_list);
+  AppendLogs(feedback_logs, &log_list);
+  AppendLogs(big_feedback_logs, &log_list);
+  {
+    // Each log is anonymized and written as soon as it's available.
+    JSONLogWriter writer(fd.get(), &anonymizer_);
+    RunLogs(log_list, base::TimeDelta::FromSeconds(kLogCommandTimeoutSeconds),
+            true, base::Bind(&JSONLogWriter::WriteLog,
+                             base::Unretained(&writer)));
+  }
 
   // We need to manually close the FD here to enable the client to read the
   // contents via a pipe.
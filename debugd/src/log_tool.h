@@ -7,14 +7,67 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
+#include <base/callback.h>
 #include <base/macros.h>
+#include <base/time/time.h>
 #include <dbus-c++/dbus.h>
 
 #include "debugd/src/anonymizer_tool.h"
 
 namespace debugd {
 
+// A log collected by running a shell command.
+struct Log {
+  const char *name;
+  const char *command;
+  const char *user;
+  const char *group;
+  const char *size_cap;  // passed as arg to 'tail'
+};
+
+// Receives the output of each log run by RunLogs().
+typedef base::Callback<void(const Log& log, const std::string& output)>
+    LogOutputCallback;
+
+// Runs the commands of |logs|, up to a few at once, and passes each one's
+// output to |callback| in the order of |logs| as soon as it and the ones
+// before it are done. Commands still running after |timeout| are killed and
+// reported as not available. |use_minijail| is only false in tests, which
+// can't run minijail0.
+void RunLogs(const std::vector<const Log*>& logs,
+             base::TimeDelta timeout,
+             bool use_minijail,
+             const LogOutputCallback& callback);
+
+// Writes logs to a file descriptor as the members of a JSON object as they
+// are produced, so that the whole report never needs to be held in memory.
+// The output is formatted like base::JSONWriter's pretty-printed output for a
+// dictionary of strings, but members are in the order they were written
+// rather than sorted.
+class JSONLogWriter {
+ public:
+  JSONLogWriter(int fd, AnonymizerTool* anonymizer);
+
+  // Closes the JSON object.
+  ~JSONLogWriter();
+
+  // Anonymizes |output| and writes it as a member named after |log|.
+  void WriteLog(const Log& log, const std::string& output);
+
+ private:
+  void Write(const std::string& data);
+
+  int fd_;
+  AnonymizerTool* anonymizer_;  // weak
+
+  // True until the first member is written.
+  bool empty_;
+
+  DISALLOW_COPY_AND_ASSIGN(JSONLogWriter);
+};
+
 class LogTool {
  public:
   LogTool() = default;
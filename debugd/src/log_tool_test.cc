@@ -2,12 +2,60 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/json/json_writer.h>
+#include <base/values.h>
 #include <gtest/gtest.h>
 
 #include "debugd/src/log_tool.h"
 
 namespace debugd {
 
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> LogOutputs;
+
+void AppendLogOutput(LogOutputs* outputs,
+                     const Log& log,
+                     const std::string& output) {
+  outputs->push_back(std::make_pair(log.name, output));
+}
+
+// Writes |logs| with |outputs| through a JSONLogWriter and returns the
+// result.
+std::string WriteJSONLogs(const std::vector<Log>& logs,
+                          const std::vector<std::string>& outputs) {
+  base::ScopedTempDir temp_dir;
+  CHECK(temp_dir.CreateUniqueTempDir());
+  const base::FilePath path = temp_dir.path().Append("logs.json");
+  base::ScopedFILE file(base::OpenFile(path, "w"));
+  CHECK(file.get());
+  AnonymizerTool anonymizer;
+  {
+    JSONLogWriter writer(fileno(file.get()), &anonymizer);
+    for (size_t i = 0; i < logs.size(); ++i)
+      writer.WriteLog(logs[i], outputs[i]);
+  }
+  file.reset();
+
+  std::string contents;
+  CHECK(base::ReadFileToString(path, &contents));
+  return contents;
+}
+
+}  // namespace
+
 class LogToolTest : public testing::Test {
  protected:
   void AnonymizeLogMap(LogTool::LogMap *log_map) {
@@ -33,4 +81,81 @@ TEST_F(LogToolTest, AnonymizeLogMap) {
   EXPECT_EQ(kAnonymousMAC, log_map[kKey2]);
 }
 
+TEST(RunLogsTest, ReportsOutputsInOrder) {
+  // The first log finishes last, but is still reported first.
+  const Log logs[] = {
+    { "slow", "sleep 1; echo slow" },
+    { "fast", "echo fast" },
+    { "empty", "true" },
+  };
+  std::vector<const Log*> log_list;
+  for (const Log& log : logs)
+    log_list.push_back(&log);
+
+  LogOutputs outputs;
+  RunLogs(log_list, base::TimeDelta::FromSeconds(30), false,
+          base::Bind(&AppendLogOutput, base::Unretained(&outputs)));
+  LogOutputs expected_outputs = {
+    { "slow", "slow\n" },
+    { "fast", "fast\n" },
+    { "empty", "<empty>" },
+  };
+  EXPECT_EQ(expected_outputs, outputs);
+}
+
+TEST(RunLogsTest, KillsCommandsThatTimeOut) {
+  const Log logs[] = {
+    { "hang", "sleep 30" },
+    { "after", "echo after" },
+  };
+  std::vector<const Log*> log_list;
+  for (const Log& log : logs)
+    log_list.push_back(&log);
+
+  LogOutputs outputs;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  RunLogs(log_list, base::TimeDelta::FromMilliseconds(500), false,
+          base::Bind(&AppendLogOutput, base::Unretained(&outputs)));
+  EXPECT_LT(base::TimeTicks::Now() - start, base::TimeDelta::FromSeconds(10));
+  LogOutputs expected_outputs = {
+    { "hang", "<not available>" },
+    { "after", "after\n" },
+  };
+  EXPECT_EQ(expected_outputs, outputs);
+
+  // The killed command has been reaped rather than left as a zombie.
+  EXPECT_EQ(-1, waitpid(-1, nullptr, WNOHANG));
+  EXPECT_EQ(ECHILD, errno);
+}
+
+TEST(JSONLogWriterTest, MatchesJSONWriter) {
+  const std::vector<Log> logs = {
+    { "a_log" },
+    { "b_log" },
+    { "c_log" },
+  };
+  const std::vector<std::string> outputs = {
+    "line 1\nline 2\n",
+    "\"quoted\"\t\\ and \xc3\xa9",
+    "",
+  };
+  base::DictionaryValue expected;
+  for (size_t i = 0; i < logs.size(); ++i)
+    expected.SetStringWithoutPathExpansion(logs[i].name, outputs[i]);
+
+  std::string expected_json;
+  ASSERT_TRUE(base::JSONWriter::WriteWithOptions(
+      expected, base::JSONWriter::OPTIONS_PRETTY_PRINT, &expected_json));
+  EXPECT_EQ(expected_json, WriteJSONLogs(logs, outputs));
+}
+
+TEST(JSONLogWriterTest, EmptyMatchesJSONWriter) {
+  std::string expected_json;
+  ASSERT_TRUE(base::JSONWriter::WriteWithOptions(
+      base::DictionaryValue(), base::JSONWriter::OPTIONS_PRETTY_PRINT,
+      &expected_json));
+  EXPECT_EQ(expected_json, WriteJSONLogs(std::vector<Log>(),
+                                         std::vector<std::string>()));
+}
+
 }  // namespace debugd
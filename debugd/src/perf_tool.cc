@@ -4,17 +4,22 @@
 
 #include "debugd/src/perf_tool.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <map>
 
+#include <base/bind.h>
 #include <base/callback.h>
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/string_split.h>
 #include <base/strings/string_util.h>
 
-#include "debugd/src/process_with_output.h"
+#include "debugd/src/sandboxed_process.h"
 
 using base::StringPrintf;
 
@@ -29,6 +34,20 @@ const char kProcessErrorName[] = "org.chromium.debugd.error.RunProcess";
 // Location of quipper on ChromeOS.
 const char kQuipperLocation[] = "/usr/bin/quipper";
 
+// Location of head, which caps the output streamed by GetPerfOutputFd().
+const char kHeadLocation[] = "/usr/bin/head";
+
+// Maximum size of the output returned by GetPerfOutput(), which has to fit in
+// a D-Bus message along with everything else.
+const size_t kMaxPerfOutputBytes = 32 * 1024 * 1024;
+
+// Maximum size of the output streamed by GetPerfOutputFd(). quipper is
+// stopped by SIGPIPE if it writes more than this.
+const size_t kMaxPerfOutputFdBytes = 256 * 1024 * 1024;
+
+// Size of the reads GetPerfOutputHelper() makes from quipper's stdout.
+const size_t kReadChunkBytes = 64 * 1024;
+
 enum PerfSubcommand {
   PERF_COMMAND_RECORD,
   PERF_COMMAND_STAT,
@@ -73,6 +92,35 @@ bool Orphan() {
   ::_Exit(EXIT_SUCCESS);
 }
 
+// A pre-exec callback that makes |fd| the child's |target_fd| and then calls
+// Orphan().
+bool RedirectAndOrphan(int fd, int target_fd) {
+  if (HANDLE_EINTR(dup2(fd, target_fd)) != target_fd)
+    return false;
+  return Orphan();
+}
+
+// Reads |fd| to EOF, appending to |output|. Returns false on error or if more
+// than |max_bytes| are available.
+bool ReadToEnd(int fd, size_t max_bytes, std::vector<uint8_t>* output) {
+  while (output->size() <= max_bytes) {
+    // Read straight into |output| rather than into a buffer that would need
+    // to be copied.
+    const size_t old_size = output->size();
+    output->resize(old_size + kReadChunkBytes);
+    const ssize_t bytes_read =
+        HANDLE_EINTR(read(fd, output->data() + old_size, kReadChunkBytes));
+    if (bytes_read <= 0) {
+      output->resize(old_size);
+      if (bytes_read < 0)
+        PLOG(ERROR) << "Reading perf output failed";
+      return bytes_read == 0;
+    }
+    output->resize(old_size + bytes_read);
+  }
+  LOG(ERROR) << "Perf output exceeds " << max_bytes << " bytes";
+  return false;
+}
 
 }  // namespace
 
@@ -91,24 +139,22 @@ int PerfTool::GetPerfOutput(const uint32_t& duration_secs,
     return -1;
   }
 
-  std::string output_string;
-  int result =
-      GetPerfOutputHelper(duration_secs, perf_args, error, &output_string);
-
+  // Read the output straight into the protobuf it holds.
+  std::vector<uint8_t>* output = nullptr;
   switch (subcommand) {
   case PERF_COMMAND_RECORD:
   case PERF_COMMAND_MEM:
-    perf_data->assign(output_string.begin(), output_string.end());
+    output = perf_data;
     break;
   case PERF_COMMAND_STAT:
-    perf_stat->assign(output_string.begin(), output_string.end());
+    output = perf_stat;
     break;
   default:
-    // Discard the output.
-    break;
+    NOTREACHED();
+    return -1;
   }
 
-  return result;
+  return GetPerfOutputHelper(duration_secs, perf_args, error, output);
 }
 
 void PerfTool::GetPerfOutputFd(const uint32_t& duration_secs,
@@ -123,44 +169,83 @@ void PerfTool::GetPerfOutputFd(const uint32_t& duration_secs,
     return;
   }
 
-  SandboxedProcess process;
-  process.SandboxAs("root", "root");
-  if (!process.Init()) {
+  SandboxedProcess head;
+  SandboxedProcess quipper;
+  quipper.SandboxAs("root", "root");
+  if (!head.Init() || !quipper.Init()) {
     error->set(kProcessErrorName, "Process initialization failure.");
     return;
   }
 
-  AddQuipperArguments(&process, duration_secs, perf_args);
-
-  process.SetPreExecCallback(base::Bind(Orphan));
-  process.BindFd(stdout_fd.get(), 1);
-
-  if (process.Run() != 0) {
+  AddQuipperArguments(&quipper, duration_secs, perf_args);
+  if (!RunWithCappedOutput(&quipper, &head, kMaxPerfOutputFdBytes,
+                           stdout_fd.get())) {
     error->set(kProcessErrorName, "Process start failure.");
   }
 }
 
+bool RunWithCappedOutput(brillo::Process* producer,
+                         brillo::Process* head,
+                         size_t max_bytes,
+                         int stdout_fd) {
+  // |producer| writes to a pipe that head copies to |stdout_fd|, so the pipe
+  // applies backpressure to |producer| if the caller reads slowly, and head
+  // closes it once |max_bytes| have been copied. Both are orphaned so that
+  // this doesn't wait for them. The pipe is created close-on-exec, and this
+  // process closes its own ends when returning, so that head sees EOF once
+  // |producer| exits and |producer| gets SIGPIPE once head exits. The ends are
+  // passed by the pre-exec callbacks rather than BindFd(), which would leave
+  // closing them to the processes: SandboxedProcess only does when it's
+  // destroyed, and brillo::ProcessImpl never does.
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+    PLOG(ERROR) << "pipe2() failed";
+    return false;
+  }
+  base::ScopedFD read_fd(pipe_fds[0]);
+  base::ScopedFD write_fd(pipe_fds[1]);
+
+  head->AddArg(kHeadLocation);
+  head->AddStringOption("-c", base::SizeTToString(max_bytes));
+  head->BindFd(stdout_fd, STDOUT_FILENO);
+  head->SetPreExecCallback(
+      base::Bind(RedirectAndOrphan, read_fd.get(), STDIN_FILENO));
+
+  producer->SetPreExecCallback(
+      base::Bind(RedirectAndOrphan, write_fd.get(), STDOUT_FILENO));
+
+  return head->Run() == 0 && producer->Run() == 0;
+}
+
 int PerfTool::GetPerfOutputHelper(const uint32_t& duration_secs,
                                   const std::vector<std::string>& perf_args,
                                   DBus::Error* error,
-                                  std::string* data_string) {
-  // This whole method is synchronous, so we create a subprocess, let it run to
-  // completion, then gather up its output to return it.
-  ProcessWithOutput process;
+                                  std::vector<uint8_t>* output) {
+  // This whole method is synchronous: quipper's output is read from a pipe
+  // until it exits, without going through a temporary file.
+  SandboxedProcess process;
   process.SandboxAs("root", "root");
-  if (!process.Init())
-    *data_string = "<process init failed>";
+  if (!process.Init()) {
+    error->set(kProcessErrorName, "Process initialization failure.");
+    return -1;
+  }
 
   AddQuipperArguments(&process, duration_secs, perf_args);
+  process.RedirectUsingPipe(STDOUT_FILENO, false /* is_input */);
+  if (!process.Start()) {
+    error->set(kProcessErrorName, "Process start failure.");
+    return -1;
+  }
 
-  // Run the process to completion. If the process might take a while, you may
-  // have to make this asynchronous using .Start().
-  int status = process.Run();
-  if (status != 0)
-    *data_string = StringPrintf("<process exited with status: %d", status);
-  process.GetOutput(data_string);
-
-  return status;
+  output->clear();
+  if (!ReadToEnd(process.GetPipe(STDOUT_FILENO), kMaxPerfOutputBytes,
+                 output)) {
+    process.KillProcessGroup();
+    output->clear();
+    error->set(kProcessErrorName, "Failed to read perf output.");
+    return -1;
+  }
+  return process.Wait();
 }
 
 }  // namespace debugd
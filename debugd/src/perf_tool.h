@@ -15,8 +15,24 @@
 #include <base/macros.h>
 #include <dbus-c++/dbus.h>
 
+namespace brillo {
+class Process;
+}  // namespace brillo
+
 namespace debugd {
 
+// Runs |producer| with its stdout piped into head, which copies the first
+// |max_bytes| of it to |stdout_fd|. Both processes are orphaned, so this
+// returns once they have started. |stdout_fd| reaches EOF once |producer|
+// exits or |max_bytes| have been copied, and |producer| is stopped by SIGPIPE
+// if it writes more. |stdout_fd| is passed to |head| with BindFd(), so a
+// SandboxedProcess closes it when destroyed. Returns false if either process
+// couldn't be started.
+bool RunWithCappedOutput(brillo::Process* producer,
+                         brillo::Process* head,
+                         size_t max_bytes,
+                         int stdout_fd);
+
 class PerfTool {
  public:
   PerfTool();
@@ -24,6 +40,7 @@ class PerfTool {
 
   // Runs the perf tool with the request command for |duration_secs| seconds
   // and returns either a perf_data or perf_stat protobuf in serialized form.
+  // Fails if the protobuf is larger than 32 MiB.
   int GetPerfOutput(const uint32_t& duration_secs,
                     const std::vector<std::string>& perf_args,
                     std::vector<uint8_t>* perf_data,
@@ -33,7 +50,9 @@ class PerfTool {
   // Runs the perf tool with the request command for |duration_secs| seconds
   // and returns either a perf_data or perf_stat protobuf in serialized form
   // over the passed stdout_fd file descriptor, or nothing if there was an
-  // error.
+  // error. The output is streamed to |stdout_fd| as quipper writes it, with
+  // quipper blocking while the caller isn't reading, and is cut off after
+  // 256 MiB.
   void GetPerfOutputFd(const uint32_t& duration_secs,
                        const std::vector<std::string>& perf_args,
                        const DBus::FileDescriptor& stdout_fd,
@@ -41,12 +60,12 @@ class PerfTool {
 
  private:
   // Helper function that runs perf for a given |duration_secs| returning the
-  // collected data in |data_string|. Return value is the status from running
-  // perf.
+  // collected data in |output|. Return value is the status from running perf,
+  // or -1 if it couldn't be run or its output couldn't be read.
   int GetPerfOutputHelper(const uint32_t& duration_secs,
                           const std::vector<std::string>& perf_args,
                           DBus::Error* error,
-                          std::string* data_string);
+                          std::vector<uint8_t>* output);
 
   DISALLOW_COPY_AND_ASSIGN(PerfTool);
 };
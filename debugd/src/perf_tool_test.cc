@@ -0,0 +1,79 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <base/files/scoped_file.h>
+#include <base/posix/eintr_wrapper.h>
+#include <brillo/process.h>
+#include <gtest/gtest.h>
+
+#include "debugd/src/perf_tool.h"
+
+namespace debugd {
+
+namespace {
+
+const int kReadTimeoutMs = 10 * 1000;
+
+// Reads |fd| until EOF into |output|. Returns false if no EOF was seen within
+// kReadTimeoutMs of the last data read.
+bool ReadUntilEof(int fd, std::string* output) {
+  while (true) {
+    struct pollfd poll_fd = {fd, POLLIN, 0};
+    if (HANDLE_EINTR(poll(&poll_fd, 1, kReadTimeoutMs)) != 1)
+      return false;
+    char buffer[256];
+    ssize_t bytes_read = HANDLE_EINTR(read(fd, buffer, sizeof(buffer)));
+    if (bytes_read < 0)
+      return false;
+    if (bytes_read == 0)
+      return true;
+    output->append(buffer, bytes_read);
+  }
+}
+
+}  // namespace
+
+TEST(PerfToolTest, OutputReachesEofWhenProducerExits) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+  base::ScopedFD read_fd(pipe_fds[0]);
+  base::ScopedFD write_fd(pipe_fds[1]);
+
+  brillo::ProcessImpl producer;
+  producer.AddArg("/bin/echo");
+  producer.AddArg("profile");
+  brillo::ProcessImpl head;
+  ASSERT_TRUE(RunWithCappedOutput(&producer, &head, 1024, write_fd.get()));
+  write_fd.reset();
+
+  std::string output;
+  EXPECT_TRUE(ReadUntilEof(read_fd.get(), &output));
+  EXPECT_EQ("profile\n", output);
+}
+
+TEST(PerfToolTest, ProducerStopsWhenOutputIsCapped) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+  base::ScopedFD read_fd(pipe_fds[0]);
+  base::ScopedFD write_fd(pipe_fds[1]);
+
+  // yes never exits by itself, and it inherits |write_fd|, so EOF is only seen
+  // once it is stopped by SIGPIPE after head exits.
+  brillo::ProcessImpl producer;
+  producer.AddArg("/usr/bin/yes");
+  brillo::ProcessImpl head;
+  ASSERT_TRUE(RunWithCappedOutput(&producer, &head, 10, write_fd.get()));
+  write_fd.reset();
+
+  std::string output;
+  EXPECT_TRUE(ReadUntilEof(read_fd.get(), &output));
+  EXPECT_EQ("y\ny\ny\ny\ny\n", output);
+}
+
+}  // namespace debugd
@@ -4,6 +4,8 @@
 
 #include "fides/blob_store.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include <base/logging.h>
@@ -34,8 +36,72 @@ const char kFormatSourcePath[] = "%s/%s/";
 // Defines the maximum supported size of SettingsBlobs in bytes.
 const unsigned int kMaxSettingsBlobSizeBytes = 1024u * 1024u;
 
+// Defines the name of the pack file in the directory of a source.
+const char kPackFilename[] = "blobs.pack";
+
+// The pack file is a sequence of records, each consisting of a PackRecordHeader
+// followed by |size| bytes of blob data. Later records override earlier ones
+// with the same blob id. Records are only ever appended, so a crash while
+// writing can at most leave a truncated record at the end of the file, which
+// is ignored when loading and overwritten by the next append.
+struct PackRecordHeader {
+  uint32_t magic;
+  uint32_t blob_id;
+  uint32_t size;
+  uint32_t flags;
+};
+
+// Marks the start of a record.
+const uint32_t kPackRecordMagic = 0x46424c42u;
+
+// Set in |flags| for records that mark the blob as purged. Such records carry
+// no data.
+const uint32_t kPackRecordFlagPurged = 1u << 0;
+
+// Appends a record for |blob_id| to |out|.
+void AppendPackRecord(unsigned int blob_id,
+                      const uint8_t* data,
+                      size_t size,
+                      uint32_t flags,
+                      std::vector<uint8_t>* out) {
+  PackRecordHeader header;
+  header.magic = kPackRecordMagic;
+  header.blob_id = blob_id;
+  header.size = size;
+  header.flags = flags;
+  const uint8_t* header_data = reinterpret_cast<const uint8_t*>(&header);
+  out->insert(out->end(), header_data, header_data + sizeof(header));
+  out->insert(out->end(), data, data + size);
+}
+
 }  // namespace
 
+struct BlobStore::Pack {
+  // Location of a live blob's data within |file|.
+  struct Record {
+    size_t offset;
+    size_t size;
+  };
+
+  Pack() : max_blob_id(0), end(0), live_bytes(0) {}
+
+  utils::MappedFile file;
+
+  // The blobs that haven't been purged, keyed by blob id.
+  std::map<unsigned int, Record> records;
+
+  // The highest blob id that appears in the pack, including purged ones.
+  unsigned int max_blob_id;
+
+  // Offset just past the last complete record. New records are written here.
+  size_t end;
+
+  // Number of bytes, headers included, taken up by the records in |records|.
+  size_t live_bytes;
+
+  DISALLOW_COPY_AND_ASSIGN(Pack);
+};
+
 BlobStore::Handle::Handle() : blob_id_(0) {}
 
 BlobStore::Handle::Handle(unsigned int blob_id, const std::string& source_id)
@@ -51,6 +117,8 @@ BlobStore::BlobStore(const std::string& storage_path)
             kBlobFilenameLength);
 }
 
+BlobStore::~BlobStore() {}
+
 BlobStore::Handle BlobStore::Store(const std::string& source_id,
                                    BlobRef blob) const {
   DCHECK(!source_id.empty());
@@ -63,12 +131,23 @@ BlobStore::Handle BlobStore::Store(const std::string& source_id,
   if (!utils::PathExists(source_path))
     utils::CreateDirectory(source_path);
 
-  // Determine the next unused blob id, construct the blob path and write blob.
-  unsigned int blob_id = GetNextUnusedBlobId(source_id);
-  std::string blob_path = GetBlobPath(blob_id, source_id);
-  if (blob_path.empty())
+  if (blob.size() > kMaxSettingsBlobSizeBytes) {
+    LOG(ERROR) << "Blob too large: " << blob.size() << " bytes";
+    return Handle();
+  }
+
+  Pack* pack = GetPack(source_id);
+  if (!pack)
     return Handle();
-  if (utils::WriteFileAtomically(blob_path, blob.data(), blob.size()))
+
+  // Determine the next unused blob id and append the blob to the pack.
+  unsigned int blob_id = GetNextUnusedBlobId(source_id);
+  std::vector<uint8_t> record;
+  AppendPackRecord(blob_id, blob.data(), blob.size(), 0, &record);
+  const bool success = utils::AppendToFile(
+      source_path + kPackFilename, pack->end, record.data(), record.size());
+  packs_.erase(source_id);
+  if (success)
     return Handle(blob_id, source_id);
 
   // Failed to write the file. Return an invalid Handle.
@@ -76,6 +155,16 @@ BlobStore::Handle BlobStore::Store(const std::string& source_id,
 }
 
 const std::vector<uint8_t> BlobStore::Load(Handle handle) const {
+  const Pack* pack = GetPack(handle.source_id_);
+  if (!pack)
+    return std::vector<uint8_t>();
+  const auto record = pack->records.find(handle.blob_id_);
+  if (record != pack->records.end()) {
+    const uint8_t* data = pack->file.data() + record->second.offset;
+    return std::vector<uint8_t>(data, data + record->second.size);
+  }
+
+  // Fall back to a blob stored in a file of its own.
   std::vector<uint8_t> blob;
   std::string blob_path = GetBlobPath(handle.blob_id_, handle.source_id_);
   if (blob_path.empty())
@@ -90,24 +179,132 @@ std::vector<BlobStore::Handle> BlobStore::List(
   std::string source_path = GetSourcePath(source_id);
   if (source_path.empty())
     return std::vector<BlobStore::Handle>();
+  const Pack* pack = GetPack(source_id);
+  if (!pack)
+    return std::vector<BlobStore::Handle>();
+
+  std::vector<unsigned int> blob_ids;
+  for (const auto& record : pack->records)
+    blob_ids.push_back(record.first);
   std::vector<std::string> files = utils::ListFiles(source_path);
   for (auto& file : files) {
-    Handle handle(FilenameToBlobId(file), source_id);
-    if (handle.IsValid())
-      handles.push_back(handle);
+    if (file == kPackFilename)
+      continue;
+    unsigned int blob_id = FilenameToBlobId(file);
+    if (blob_id)
+      blob_ids.push_back(blob_id);
   }
+
+  std::sort(blob_ids.begin(), blob_ids.end());
+  blob_ids.erase(std::unique(blob_ids.begin(), blob_ids.end()),
+                 blob_ids.end());
+  for (unsigned int blob_id : blob_ids)
+    handles.push_back(Handle(blob_id, source_id));
   return handles;
 }
 
 bool BlobStore::Purge(Handle handle) const {
   if (!handle.IsValid())
     return false;
+  Pack* pack = GetPack(handle.source_id_);
+  if (!pack)
+    return false;
+  const auto record = pack->records.find(handle.blob_id_);
+  if (record != pack->records.end()) {
+    // Rewrite the pack once purged blobs take up more space than live ones.
+    // Otherwise, just record the purge.
+    const size_t live_bytes =
+        pack->live_bytes - sizeof(PackRecordHeader) - record->second.size;
+    bool success;
+    if (pack->end + sizeof(PackRecordHeader) - live_bytes > live_bytes) {
+      success = CompactPack(handle.source_id_, *pack, handle.blob_id_);
+    } else {
+      std::vector<uint8_t> tombstone;
+      AppendPackRecord(handle.blob_id_, nullptr, 0, kPackRecordFlagPurged,
+                       &tombstone);
+      success = utils::AppendToFile(
+          GetSourcePath(handle.source_id_) + kPackFilename, pack->end,
+          tombstone.data(), tombstone.size());
+    }
+    packs_.erase(handle.source_id_);
+    return success;
+  }
+
   std::string blob_path = GetBlobPath(handle.blob_id_, handle.source_id_);
   if (blob_path.empty())
     return false;
   return utils::DeleteFile(blob_path);
 }
 
+BlobStore::Pack* BlobStore::GetPack(const std::string& source_id) const {
+  auto cached = packs_.find(source_id);
+  if (cached != packs_.end())
+    return cached->second.get();
+
+  std::string source_path = GetSourcePath(source_id);
+  if (source_path.empty())
+    return nullptr;
+  std::unique_ptr<Pack> pack(new Pack());
+  const std::string pack_path = source_path + kPackFilename;
+  if (utils::PathExists(pack_path) && !pack->file.Initialize(pack_path))
+    return nullptr;
+
+  // Index the records, stopping at the first one that is truncated or
+  // otherwise invalid.
+  const uint8_t* data = pack->file.data();
+  const size_t size = pack->file.size();
+  size_t offset = 0;
+  while (size - offset >= sizeof(PackRecordHeader)) {
+    PackRecordHeader header;
+    memcpy(&header, data + offset, sizeof(header));
+    if (header.magic != kPackRecordMagic || header.blob_id == 0 ||
+        header.size > kMaxSettingsBlobSizeBytes ||
+        (header.flags & ~kPackRecordFlagPurged) != 0 ||
+        size - offset - sizeof(header) < header.size) {
+      break;
+    }
+    if (header.flags & kPackRecordFlagPurged) {
+      pack->records.erase(header.blob_id);
+    } else {
+      Pack::Record& record = pack->records[header.blob_id];
+      record.offset = offset + sizeof(header);
+      record.size = header.size;
+    }
+    pack->max_blob_id = std::max<unsigned int>(pack->max_blob_id,
+                                               header.blob_id);
+    offset += sizeof(header) + header.size;
+  }
+  if (offset != size) {
+    LOG(WARNING) << "Ignoring " << size - offset << " bytes at end of "
+                 << pack_path;
+  }
+  pack->end = offset;
+  for (const auto& record : pack->records)
+    pack->live_bytes += sizeof(PackRecordHeader) + record.second.size;
+
+  Pack* result = pack.get();
+  packs_[source_id] = std::move(pack);
+  return result;
+}
+
+bool BlobStore::CompactPack(const std::string& source_id,
+                            const Pack& pack,
+                            unsigned int purged_blob_id) const {
+  std::vector<uint8_t> contents;
+  contents.reserve(pack.live_bytes);
+  for (const auto& record : pack.records) {
+    if (record.first == purged_blob_id)
+      continue;
+    AppendPackRecord(record.first, pack.file.data() + record.second.offset,
+                     record.second.size, 0, &contents);
+  }
+  const std::string pack_path = GetSourcePath(source_id) + kPackFilename;
+  if (contents.empty())
+    return utils::DeleteFile(pack_path);
+  return utils::WriteFileAtomically(pack_path, contents.data(),
+                                    contents.size());
+}
+
 std::string BlobStore::GetBlobPath(unsigned int blob_id,
                                    const std::string& source_id) const {
   std::string source_path = GetSourcePath(source_id);
@@ -143,6 +340,8 @@ unsigned int BlobStore::FilenameToBlobId(const std::string& filename) const {
 
 unsigned int BlobStore::GetNextUnusedBlobId(
     const std::string& source_id) const {
+  const Pack* pack = GetPack(source_id);
+  const unsigned int pack_max_blob_id = pack ? pack->max_blob_id : 0;
   std::vector<std::string> files = utils::ListFiles(GetSourcePath(source_id));
 
   // Sort the filenames lexicographically and reverse iterate over them. Note
@@ -157,11 +356,11 @@ unsigned int BlobStore::GetNextUnusedBlobId(
     if (!id)
       continue;
 
-    return id + 1;
+    return std::max(id, pack_max_blob_id) + 1;
   }
 
-  // No previous blob for |source_id| found.
-  return 1;
+  // No previous blob file for |source_id| found.
+  return pack_max_blob_id + 1;
 }
 
 }  // namespace fides
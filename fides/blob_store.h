@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -16,7 +18,10 @@
 
 namespace fides {
 
-// A class that loads and stores Blobs.
+// A class that loads and stores Blobs. The blobs of each source are appended to
+// a single pack file, which is memory-mapped and indexed the first time the
+// source's blobs are accessed. Blobs that earlier versions stored in a file of
+// their own are still listed, loaded and purged.
 class BlobStore {
  public:
   class Handle {
@@ -40,6 +45,7 @@ class BlobStore {
   // fidesd has write access to. If the directory does not already exist, it
   // will be created on the first invocation of the Store() method.
   explicit BlobStore(const std::string& storage_path);
+  ~BlobStore();
 
   // Stores the |blob| originating from the source identified by |source_id| on
   // the disk.
@@ -58,9 +64,30 @@ class BlobStore {
   bool Purge(Handle handle) const;
 
  private:
+  // The mapped and indexed pack file of a source. Defined in the
+  // implementation.
+  struct Pack;
+
   // Path to the root of the directory hierarchy to store blobs in.
   const std::string storage_path_;
 
+  // Packs that have been loaded, keyed by source id. A source's entry is
+  // dropped whenever its pack file is modified, so that the next access maps
+  // the new contents.
+  mutable std::map<std::string, std::unique_ptr<Pack>> packs_;
+
+  // Returns the pack of |source_id|, loading it if it isn't cached yet. A
+  // source without a pack file yields an empty pack. Returns nullptr if
+  // |source_id| is invalid or the pack file can't be mapped.
+  Pack* GetPack(const std::string& source_id) const;
+
+  // Replaces the pack file of |source_id| with one holding only |pack|'s live
+  // blobs, leaving out the one identified by |purged_blob_id|. Returns true on
+  // success.
+  bool CompactPack(const std::string& source_id,
+                   const Pack& pack,
+                   unsigned int purged_blob_id) const;
+
   // Constructs the path for blob with id |blob_id| for |source_id|. If either
   // |blob_id| or |source_id| are invalid (see implementation for comments),
   // this method fails and returns the empty string.
@@ -77,9 +104,10 @@ class BlobStore {
   // fails and returns 0.
   unsigned int FilenameToBlobId(const std::string& filename) const;
 
-  // Returns the next unused blob id for |source_id|. Note that this function is
-  // not safe against race conditions in cases where another process is trying
-  // to find the next unused identifier as well.
+  // Returns the next unused blob id for |source_id|, taking both the pack and
+  // the blobs stored in files of their own into account. Note that this
+  // function is not safe against race conditions in cases where another
+  // process is trying to find the next unused identifier as well.
   unsigned int GetNextUnusedBlobId(const std::string& source_id) const;
 
   DISALLOW_COPY_AND_ASSIGN(BlobStore);
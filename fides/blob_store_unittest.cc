@@ -119,4 +119,81 @@ TEST_F(BlobStoreTest, ListWithBogusFilename) {
   CheckBlobs(expected_blobs, handles, store);
 }
 
+TEST_F(BlobStoreTest, StoreAppendsToPack) {
+  std::string source_id = "SOURCE1";
+  const std::vector<uint8_t> blob0(CreateBlob("DATA0"));
+  const std::vector<uint8_t> blob1(CreateBlob("DATA1"));
+  {
+    BlobStore store(GetStoragePath());
+    EXPECT_TRUE(store.Store(source_id, BlobRef(&blob0)).IsValid());
+    EXPECT_TRUE(store.Store(source_id, BlobRef(&blob1)).IsValid());
+  }
+
+  // Both blobs should end up in a single file.
+  EXPECT_EQ(1, utils::ListFiles(GetSourcePath(source_id)).size());
+
+  // A fresh instance should find them in order.
+  BlobStore store(GetStoragePath());
+  std::vector<BlobStore::Handle> handles = store.List(source_id);
+  ASSERT_EQ(2, handles.size());
+  EXPECT_EQ(blob0, store.Load(handles[0]));
+  EXPECT_EQ(blob1, store.Load(handles[1]));
+}
+
+TEST_F(BlobStoreTest, PurgeFromPack) {
+  BlobStore store(GetStoragePath());
+  std::string source_id = "SOURCE1";
+  const std::vector<uint8_t> blob0(CreateBlob("DATA0"));
+  const std::vector<uint8_t> blob1(CreateBlob("DATA1"));
+  const std::vector<uint8_t> blob2(CreateBlob("DATA2"));
+  BlobStore::Handle h0 = store.Store(source_id, BlobRef(&blob0));
+  BlobStore::Handle h1 = store.Store(source_id, BlobRef(&blob1));
+  BlobStore::Handle h2 = store.Store(source_id, BlobRef(&blob2));
+
+  EXPECT_TRUE(store.Purge(h1));
+  CheckBlobs({blob0, blob2}, store.List(source_id), store);
+  CheckBlobs({blob0, blob2}, store.List(source_id),
+             BlobStore(GetStoragePath()));
+
+  // Purging the remaining blobs should eventually get rid of the pack.
+  EXPECT_TRUE(store.Purge(h0));
+  EXPECT_TRUE(store.Purge(h2));
+  EXPECT_TRUE(store.List(source_id).empty());
+  EXPECT_TRUE(utils::ListFiles(GetSourcePath(source_id)).empty());
+
+  BlobStore::Handle h3 = store.Store(source_id, BlobRef(&blob1));
+  EXPECT_TRUE(h3.IsValid());
+  CheckBlobs({blob1}, store.List(source_id), store);
+}
+
+TEST_F(BlobStoreTest, IgnoreTruncatedRecord) {
+  std::string source_id = "SOURCE1";
+  const std::vector<uint8_t> blob0(CreateBlob("DATA0"));
+  const std::vector<uint8_t> blob1(CreateBlob("DATA1"));
+  {
+    BlobStore store(GetStoragePath());
+    EXPECT_TRUE(store.Store(source_id, BlobRef(&blob0)).IsValid());
+    EXPECT_TRUE(store.Store(source_id, BlobRef(&blob1)).IsValid());
+  }
+
+  // Simulate a crash in the middle of writing the second blob.
+  std::vector<std::string> files = utils::ListFiles(GetSourcePath(source_id));
+  ASSERT_EQ(1, files.size());
+  const std::string pack_path = GetSourcePath(source_id) + "/" + files[0];
+  std::vector<uint8_t> contents;
+  ASSERT_TRUE(utils::ReadFile(pack_path, &contents, 1024));
+  contents.resize(contents.size() - 2);
+  ASSERT_TRUE(utils::WriteFileAtomically(pack_path, contents.data(),
+                                         contents.size()));
+
+  BlobStore store(GetStoragePath());
+  CheckBlobs({blob0}, store.List(source_id), store);
+
+  // Storing should overwrite the truncated record.
+  const std::vector<uint8_t> blob2(CreateBlob("DATA2"));
+  EXPECT_TRUE(store.Store(source_id, BlobRef(&blob2)).IsValid());
+  CheckBlobs({blob0, blob2}, store.List(source_id),
+             BlobStore(GetStoragePath()));
+}
+
 }  // namespace fides
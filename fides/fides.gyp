@@ -109,6 +109,23 @@
         'test_helpers.h',
         'version_stamp_unittest.cc',
       ],
-    }
+    },
+    {
+      'target_name': 'simple_settings_map_benchmark',
+      'type': 'executable',
+      'variables': {
+        'deps': [
+          'libbrillo-<(libbase_ver)',
+        ],
+      },
+      'dependencies': [
+        'fides_common',
+      ],
+      'sources': [
+        'mock_settings_document.cc',
+        'mock_settings_document.h',
+        'simple_settings_map_benchmark.cc',
+      ],
+    },
   ],
 }
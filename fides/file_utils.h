@@ -10,6 +10,8 @@
 #include <string>
 #include <vector>
 
+#include <base/macros.h>
+
 namespace fides {
 
 namespace utils {
@@ -48,6 +50,35 @@ bool WriteFileAtomically(const std::string& path,
                          const uint8_t* data,
                          size_t size);
 
+// Truncates the file at |path| to |offset| bytes, creating it if it doesn't
+// exist, writes |data| of size |size| at |offset| and calls fdatasync() before
+// returning. Returns true on success. Truncating first drops whatever a write
+// that was interrupted by a crash may have left after |offset|.
+bool AppendToFile(const std::string& path,
+                  size_t offset,
+                  const uint8_t* data,
+                  size_t size);
+
+// A read-only memory mapping of a file.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Maps the file at |path|. Returns false if it can't be opened or mapped.
+  // An empty file yields an empty mapping.
+  bool Initialize(const std::string& path);
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  uint8_t* data_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
 }  // namespace utils
 
 }  // namespace fides
@@ -4,7 +4,9 @@
 
 #include "fides/file_utils.h"
 
+#include <fcntl.h>
 #include <fstream>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -13,6 +15,9 @@
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/files/important_file_writer.h>
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 
 namespace fides {
 
@@ -73,6 +78,66 @@ bool WriteFileAtomically(const std::string& path,
       base::FilePath(FILE_PATH_LITERAL(path)), out_data);
 }
 
+bool AppendToFile(const std::string& path,
+                  size_t offset,
+                  const uint8_t* data,
+                  size_t size) {
+  base::ScopedFD fd(
+      HANDLE_EINTR(open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600)));
+  if (!fd.is_valid()) {
+    PLOG(ERROR) << "Failed to open " << path;
+    return false;
+  }
+  if (HANDLE_EINTR(ftruncate(fd.get(), offset)) != 0) {
+    PLOG(ERROR) << "Failed to truncate " << path;
+    return false;
+  }
+  while (size > 0) {
+    const ssize_t written = HANDLE_EINTR(pwrite(fd.get(), data, size, offset));
+    if (written <= 0) {
+      PLOG(ERROR) << "Failed to write " << path;
+      return false;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  if (HANDLE_EINTR(fdatasync(fd.get())) != 0) {
+    PLOG(ERROR) << "Failed to sync " << path;
+    return false;
+  }
+  return true;
+}
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+MappedFile::~MappedFile() {
+  if (data_)
+    munmap(data_, size_);
+}
+
+bool MappedFile::Initialize(const std::string& path) {
+  DCHECK(!data_);
+  base::ScopedFD fd(HANDLE_EINTR(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+  struct stat file_info;
+  if (!fd.is_valid() || fstat(fd.get(), &file_info) != 0) {
+    PLOG(ERROR) << "Failed to open " << path;
+    return false;
+  }
+  if (file_info.st_size == 0)
+    return true;
+
+  void* data = mmap(nullptr, file_info.st_size, PROT_READ, MAP_PRIVATE,
+                    fd.get(), 0);
+  if (data == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map " << path;
+    return false;
+  }
+  data_ = static_cast<uint8_t*>(data);
+  size_ = file_info.st_size;
+  return true;
+}
+
 }  // namespace utils
 
 }  // namespace fides
@@ -93,7 +93,11 @@ Key Key::GetParent() const {
   size_t position = key_.rfind('.');
   if (position == std::string::npos)
     return Key();
-  return Key(key_.substr(0u, position));
+  // A prefix of a valid key that ends before a dot is valid as well, so skip
+  // the check in the constructor. This is called for every ancestor lookup.
+  Key parent;
+  parent.key_.assign(key_, 0u, position);
+  return parent;
 }
 
 Key Key::Append(const Key& other) const {
@@ -161,7 +165,11 @@ bool Key::Suffix(const Key& prefix, Key* suffix) const {
 }
 
 Key Key::PrefixUpperBound() const {
-  return Key(key_ + '0');
+  // Appending a valid character keeps the key valid, so skip the check in the
+  // constructor. This is called for every range lookup.
+  Key upper_bound;
+  upper_bound.key_ = key_ + '0';
+  return upper_bound;
 }
 
 bool Key::IsRootKey() const {
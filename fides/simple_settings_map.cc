@@ -23,12 +23,46 @@ BlobRef SimpleSettingsMap::GetValue(const Key& key) const {
 }
 
 std::set<Key> SimpleSettingsMap::GetKeys(const Key& prefix) const {
+  // The range is sorted, so every key goes right at the end of the set.
   std::set<Key> keys;
   for (const auto& entry : utils::GetRange(prefix, value_map_))
-    keys.insert(entry.first);
+    keys.insert(keys.end(), entry.first);
   return keys;
 }
 
+void SimpleSettingsMap::AssignValue(
+    const Key& key,
+    std::shared_ptr<const SettingsDocument> document) {
+  const auto entry = value_map_.insert(std::make_pair(key, nullptr)).first;
+  if (entry->second)
+    document_keys_[entry->second.get()].values.erase(&entry->first);
+  document_keys_[document.get()].values.insert(&entry->first);
+  entry->second = document;
+}
+
+SimpleSettingsMap::KeyDocumentMap::iterator SimpleSettingsMap::EraseValue(
+    KeyDocumentMap::const_iterator entry) {
+  document_keys_[entry->second.get()].values.erase(&entry->first);
+  return value_map_.erase(entry);
+}
+
+void SimpleSettingsMap::AssignDeletion(
+    const Key& prefix,
+    std::shared_ptr<const SettingsDocument> document) {
+  const auto entry =
+      deletion_map_.insert(std::make_pair(prefix, nullptr)).first;
+  if (entry->second)
+    document_keys_[entry->second.get()].deletions.erase(&entry->first);
+  document_keys_[document.get()].deletions.insert(&entry->first);
+  entry->second = document;
+}
+
+SimpleSettingsMap::KeyDocumentMap::iterator SimpleSettingsMap::EraseDeletion(
+    KeyDocumentMap::const_iterator entry) {
+  document_keys_[entry->second.get()].deletions.erase(&entry->first);
+  return deletion_map_.erase(entry);
+}
+
 bool SimpleSettingsMap::HasLaterValueAssignment(
     const Key& key,
     const VersionStamp& lower_bound) {
@@ -79,7 +113,7 @@ void SimpleSettingsMap::DeleteSubtree(const Key& prefix,
   const auto deletion_range = utils::GetRange(prefix, deletion_map_);
   for (auto it = deletion_range.begin(); it != deletion_range.end();) {
     if (it->second->GetVersionStamp().IsBefore(upper_limit))
-      deletion_map_.erase(it++);
+      it = EraseDeletion(it);
     else
       ++it;
   }
@@ -90,7 +124,7 @@ void SimpleSettingsMap::DeleteSubtree(const Key& prefix,
     if (it->second->GetVersionStamp().IsBefore(upper_limit)) {
       if (modified_keys)
         modified_keys->insert(it->first);
-      value_map_.erase(it++);
+      it = EraseValue(it);
     } else {
       ++it;
     }
@@ -104,7 +138,27 @@ void SimpleSettingsMap::InsertDocumentSubset(
   // Convenience shortcuts.
   const VersionStamp& version_stamp = document->GetVersionStamp();
 
-  for (const auto& prefix : prefixes) {
+  // When restoring after a removal, |prefixes| holds every key the removed
+  // document provided, and most documents have nothing under most of them.
+  // |prefixes| is sorted, so siblings are adjacent: check their parent once
+  // and skip all of them if |document| has nothing there, much like skipping
+  // a subtree of a trie. Otherwise, check each prefix before building its
+  // (probably empty) key sets.
+  Key populated_parent;
+  for (auto it = prefixes.begin(); it != prefixes.end();) {
+    const Key& prefix = *it;
+    const Key parent = prefix.GetParent();
+    if (!parent.IsRootKey() && parent != populated_parent) {
+      if (!document->HasKeysOrDeletions(parent)) {
+        it = prefixes.lower_bound(parent.PrefixUpperBound());
+        continue;
+      }
+      populated_parent = parent;
+    }
+    ++it;
+    if (!document->HasKeysOrDeletions(prefix))
+      continue;
+
     // Deletions are always processed first, so that value assignments in key
     // prefixes affected by a deletion in the same document are not clobbered by
     // those deletions.
@@ -113,7 +167,7 @@ void SimpleSettingsMap::InsertDocumentSubset(
       // ancestorial key hierarchy which renders this deletion obsolete.
       if (!HasLaterSubtreeDeletion(prefix_deletion, version_stamp)) {
         DeleteSubtree(prefix_deletion, version_stamp, modified_keys);
-        deletion_map_[prefix_deletion] = document;
+        AssignDeletion(prefix_deletion, document);
       }
     }
 
@@ -127,7 +181,7 @@ void SimpleSettingsMap::InsertDocumentSubset(
           !HasLaterValueAssignment(key, version_stamp)) {
         if (modified_keys)
           modified_keys->insert(key);
-        value_map_[key] = document;
+        AssignValue(key, document);
       }
     }
   }
@@ -200,29 +254,29 @@ void SimpleSettingsMap::RemoveDocument(
   // Acquire a shared_ptr.
   std::shared_ptr<const SettingsDocument> document(*position);
 
-  // Get a list of all keys from |document| currently providing values and
-  // remove them from the |value_map_|.
+  // Take the keys for which |document| currently provides values or
+  // deletions from the index. A document that is in |documents_| is
+  // referenced, so it has an entry.
+  const auto keys_entry = document_keys_.find(document_ptr);
+  DCHECK(keys_entry != document_keys_.end());
+  DocumentKeys keys;
+  std::swap(keys, keys_entry->second);
+
+  // Remove the keys |document| is currently providing values for from the
+  // |value_map_|.
   std::set<Key> prefixes_to_restore;
-  for (auto it = value_map_.begin(); it != value_map_.end();) {
-    if (it->second == document) {
-      prefixes_to_restore.insert(it->first);
-      if (modified_keys)
-        modified_keys->insert(it->first);
-      value_map_.erase(it++);
-    } else {
-      ++it;
-    }
+  for (const Key* key : keys.values) {
+    const Key& prefix = *prefixes_to_restore.insert(*key).first;
+    if (modified_keys)
+      modified_keys->insert(prefix);
+    value_map_.erase(prefix);
   }
 
   // Add all keys identifying prefixes which have been deleted by |document| and
   // remove them from the |deletion_map_|.
-  for (auto it = deletion_map_.begin(); it != deletion_map_.end();) {
-    if (it->second == document) {
-      prefixes_to_restore.insert(it->first);
-      deletion_map_.erase(it++);
-    } else {
-      ++it;
-    }
+  for (const Key* key : keys.deletions) {
+    const Key& prefix = *prefixes_to_restore.insert(*key).first;
+    deletion_map_.erase(prefix);
   }
 
   // |document| should be the only remaining shared_ptr to the settings
@@ -263,12 +317,14 @@ void SimpleSettingsMap::OnDocumentUnreferenced(
                        return doc.expired();
                      });
   documents_.erase(position, documents_.end());
+  document_keys_.erase(document);
   unreferenced_documents_.push_back(document);
 }
 
 void SimpleSettingsMap::Clear() {
   deletion_map_.clear();
   value_map_.clear();
+  document_keys_.clear();
 }
 
 }  // namespace fides
@@ -8,6 +8,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <unordered_set>
 #include <vector>
 
 #include <base/macros.h>
@@ -57,6 +58,25 @@ class SimpleSettingsMap : public SettingsMap {
   using KeyDocumentMap = std::map<Key, std::shared_ptr<const SettingsDocument>>;
   friend class SimpleSettingsMapTest;
 
+  // The keys in |value_map_| and |deletion_map_| that a document provides.
+  // These point to the keys of the map entries, which are stable until the
+  // entries are erased.
+  struct DocumentKeys {
+    std::unordered_set<const Key*> values;
+    std::unordered_set<const Key*> deletions;
+  };
+
+  // Helpers that modify |value_map_| and |deletion_map_| while keeping
+  // |document_keys_| in sync. The Erase*() methods return the iterator
+  // following the erased entry.
+  void AssignValue(const Key& key,
+                   std::shared_ptr<const SettingsDocument> document);
+  KeyDocumentMap::iterator EraseValue(KeyDocumentMap::const_iterator entry);
+  void AssignDeletion(const Key& prefix,
+                      std::shared_ptr<const SettingsDocument> document);
+  KeyDocumentMap::iterator EraseDeletion(
+      KeyDocumentMap::const_iterator entry);
+
   // Helper method that deletes all entries in |value_map_| and |deletion_map_|
   // whose keys lie in the subtree rooted at |prefix| and where the VersionStamp
   // of the document that is currently providing them is before |upper_limit|.
@@ -114,6 +134,12 @@ class SimpleSettingsMap : public SettingsMap {
   // The list of currently unreferenced documents.
   DocumentPtrList unreferenced_documents_;
 
+  // Reverse index of |value_map_| and |deletion_map_|, so that the entries a
+  // document provides can be found without scanning both maps. Documents are
+  // removed from it once they become unreferenced. This is declared before the
+  // maps, which call OnDocumentUnreferenced() when they are destroyed.
+  std::map<const SettingsDocument*, DocumentKeys> document_keys_;
+
   // |value_map_| maps keys to the respective SettingsDocument which is
   // currently providing the active value. The entries in this map indirectly
   // control the lifetime of the SettingsDocument: Once the number of entries in
@@ -0,0 +1,120 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Fills a SimpleSettingsMap with a stack of overlapping documents, enumerates
+// its subtrees and removes the documents again, newest first, so that every
+// removal has to restore the values of the documents below. Reports the time
+// each phase takes.
+//
+// Usage: simple_settings_map_benchmark [--keys=100000] [--documents=100]
+//                                      [--overlap=4]
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <base/logging.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+#include <brillo/flag_helper.h>
+
+#include "fides/key.h"
+#include "fides/mock_settings_document.h"
+#include "fides/simple_settings_map.h"
+#include "fides/version_stamp.h"
+
+namespace {
+
+// Number of keys that share a section, i.e. a first key component.
+const int kKeysPerSection = 1000;
+
+fides::Key GetSectionKey(int section) {
+  return fides::Key(base::StringPrintf("Section%04d", section));
+}
+
+fides::Key GetKey(int index) {
+  return GetSectionKey(index / kKeysPerSection)
+      .Extend({base::StringPrintf("Key%07d", index)});
+}
+
+void PrintTime(const char* phase, int operations, base::TimeDelta time) {
+  printf("%-8s %8d ops %10.1f ms %8.2f us/op\n", phase, operations,
+         time.InMillisecondsF(),
+         operations ? time.InMicroseconds() / static_cast<double>(operations)
+                    : 0.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  DEFINE_int32(keys, 100000, "number of distinct keys");
+  DEFINE_int32(documents, 100, "number of documents");
+  DEFINE_int32(overlap, 4, "number of documents that set each key");
+  brillo::FlagHelper::Init(argc, argv, "SimpleSettingsMap benchmark");
+  CHECK_GT(FLAGS_keys, 0);
+  CHECK_GT(FLAGS_documents, 0);
+  CHECK_GT(FLAGS_overlap, 0);
+
+  // Document i sets a window of keys starting where document i - 1's window
+  // started plus one step, so each key is set by about |overlap| documents.
+  // Every tenth document also deletes the section its window starts in.
+  const int step = std::max(1, FLAGS_keys / FLAGS_documents);
+  const int window = std::min(FLAGS_keys, step * FLAGS_overlap);
+  std::vector<std::unique_ptr<fides::MockSettingsDocument>> documents;
+  for (int i = 0; i < FLAGS_documents; ++i) {
+    fides::VersionStamp version_stamp;
+    version_stamp.Set("A", i + 1);
+    documents.emplace_back(new fides::MockSettingsDocument(version_stamp));
+    const int start = i * step;
+    if (i % 10 == 9)
+      documents.back()->SetDeletion(GetSectionKey(start / kKeysPerSection));
+    for (int j = 0; j < window; ++j) {
+      const int index = (start + j) % FLAGS_keys;
+      documents.back()->SetKey(GetKey(index), base::IntToString(i));
+    }
+  }
+  printf("%d keys, %d documents of %d keys each\n", FLAGS_keys,
+         FLAGS_documents, window);
+
+  fides::SimpleSettingsMap settings_map;
+  std::set<fides::Key> modified_keys;
+  std::vector<const fides::SettingsDocument*> unreferenced_documents;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  size_t modifications = 0;
+  for (const auto& document : documents) {
+    modified_keys.clear();
+    CHECK(settings_map.InsertDocument(document.get(), &modified_keys,
+                                      &unreferenced_documents));
+    modifications += modified_keys.size();
+  }
+  PrintTime("insert", FLAGS_documents, base::TimeTicks::Now() - start);
+
+  const int sections = (FLAGS_keys + kKeysPerSection - 1) / kKeysPerSection;
+  start = base::TimeTicks::Now();
+  size_t enumerated = settings_map.GetKeys(fides::Key()).size();
+  for (int i = 0; i < sections; ++i)
+    enumerated += settings_map.GetKeys(GetSectionKey(i)).size();
+  PrintTime("getkeys", sections + 1, base::TimeTicks::Now() - start);
+
+  start = base::TimeTicks::Now();
+  for (auto it = documents.rbegin(); it != documents.rend(); ++it) {
+    modified_keys.clear();
+    settings_map.RemoveDocument(it->get(), &modified_keys,
+                                &unreferenced_documents);
+    modifications += modified_keys.size();
+  }
+  PrintTime("remove", FLAGS_documents, base::TimeTicks::Now() - start);
+
+  // Keep the results alive and check that everything got removed.
+  printf("%zu modifications, %zu keys enumerated\n", modifications,
+         enumerated);
+  CHECK(settings_map.GetKeys(fides::Key()).empty());
+  return 0;
+}
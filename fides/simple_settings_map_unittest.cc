@@ -154,6 +154,37 @@ TEST_F(SimpleSettingsMapTest, DocumentRemoval) {
   CheckSettingsMapContents(expected_values, expected_deletions, settings_map);
 }
 
+TEST_F(SimpleSettingsMapTest, RemovalOfPartiallyShadowedDocument) {
+  document_A_->SetKey(Key("A"), "1");
+  document_A_->SetKey(Key("D"), "0");
+  document_B_->SetKey(Key("A"), "2");
+  document_B_->SetKey(Key("B"), "3");
+  document_C_->SetKey(Key("B"), "4");
+  document_C_->SetKey(Key("C"), "5");
+
+  // Only B's remaining value for "A" should change when B goes away, and
+  // removing C afterwards shouldn't bring back B's value for "B".
+  SimpleSettingsMap settings_map;
+  EXPECT_TRUE(settings_map.InsertDocument(document_A_.get(), nullptr, nullptr));
+  EXPECT_TRUE(settings_map.InsertDocument(document_B_.get(), nullptr, nullptr));
+  EXPECT_TRUE(settings_map.InsertDocument(document_C_.get(), nullptr, nullptr));
+  std::set<Key> modified_keys;
+  settings_map.RemoveDocument(document_B_.get(), &modified_keys, nullptr);
+  std::set<Key> expected_modifications = {Key("A")};
+  EXPECT_EQ(expected_modifications, modified_keys);
+
+  modified_keys.clear();
+  settings_map.RemoveDocument(document_C_.get(), &modified_keys, nullptr);
+  expected_modifications = {Key("B"), Key("C")};
+  EXPECT_EQ(expected_modifications, modified_keys);
+
+  std::set<Key> expected_deletions = {};
+  std::map<Key, std::string> expected_values = {
+      {Key("A"), "1"}, {Key("D"), "0"},
+  };
+  CheckSettingsMapContents(expected_values, expected_deletions, settings_map);
+}
+
 TEST_F(SimpleSettingsMapTest, RemovalOfDeletion) {
   document_A_->SetKey(Key("A"), "1");
   document_A_->SetKey(Key("B.C"), "2");
@@ -12,13 +12,24 @@
 #include <base/files/file_util.h>
 #include <base/logging.h>
 #include <base/memory/scoped_ptr.h>
+#include <base/strings/string_piece.h>
 #include <crypto/rsa_private_key.h>
+#include <crypto/sha2.h>
 
 #include "login_manager/nss_util.h"
 #include "login_manager/system_utils_impl.h"
 
 namespace login_manager {
 
+namespace {
+
+// Maximum number of entries in PolicyKey::verified_signatures_. There is one
+// for device policy and one for each user and device-local account, so this
+// is only reached if a key sees many different blobs, e.g. through rotation.
+const size_t kMaxVerifiedSignatures = 64;
+
+}  // namespace
+
 PolicyKey::PolicyKey(const base::FilePath& key_file, NssUtil* nss)
     : key_file_(key_file),
       have_checked_disk_(false),
@@ -157,6 +168,11 @@ bool PolicyKey::Verify(const uint8_t* data,
                        uint32_t data_len,
                        const uint8_t* signature,
                        uint32_t sig_len) {
+  const std::string digest =
+      GetSignatureDigest(data, data_len, signature, sig_len);
+  if (verified_signatures_.count(digest))
+    return true;
+
   if (!nss_->Verify(signature,
                     sig_len,
                     data,
@@ -166,7 +182,25 @@ bool PolicyKey::Verify(const uint8_t* data,
     LOG(ERROR) << "Signature verification of " << data << " failed";
     return false;
   }
+
+  if (verified_signatures_.size() >= kMaxVerifiedSignatures)
+    verified_signatures_.clear();
+  verified_signatures_.insert(digest);
   return true;
 }
 
+std::string PolicyKey::GetSignatureDigest(const uint8_t* data,
+                                          uint32_t data_len,
+                                          const uint8_t* signature,
+                                          uint32_t sig_len) const {
+  // Hash each part separately so that moving bytes from one to another yields
+  // a different digest.
+  return crypto::SHA256HashString(
+      crypto::SHA256HashString(std::string(key_.begin(), key_.end())) +
+      crypto::SHA256HashString(
+          base::StringPiece(reinterpret_cast<const char*>(data), data_len)) +
+      crypto::SHA256HashString(base::StringPiece(
+          reinterpret_cast<const char*>(signature), sig_len)));
+}
+
 }  // namespace login_manager
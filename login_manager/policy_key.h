@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -80,6 +81,8 @@ class PolicyKey {
   // Verify that |signature| is a valid sha1 w/ RSA signature over the data in
   // |data| with |key_|.
   // Returns false if the sig is invalid, or there's an error.
+  // Successful verifications are remembered, so checking the same blob and
+  // signature against the same key again doesn't redo the RSA operation.
   virtual bool Verify(const uint8_t* data,
                       uint32_t data_len,
                       const uint8_t* signature,
@@ -89,6 +92,13 @@ class PolicyKey {
   virtual const std::vector<uint8_t>& public_key_der() const { return key_; }
 
  private:
+  // Returns the digest identifying |signature| over |data| with |key_| in
+  // |verified_signatures_|.
+  std::string GetSignatureDigest(const uint8_t* data,
+                                 uint32_t data_len,
+                                 const uint8_t* signature,
+                                 uint32_t sig_len) const;
+
   const base::FilePath key_file_;
   bool have_checked_disk_;
   bool have_replaced_;
@@ -96,6 +106,10 @@ class PolicyKey {
   NssUtil* nss_;
   scoped_ptr<SystemUtils> utils_;
 
+  // Digests from GetSignatureDigest() of signatures that verified. The key is
+  // part of the digest, so entries for a replaced key simply stop matching.
+  std::set<std::string> verified_signatures_;
+
   DISALLOW_COPY_AND_ASSIGN(PolicyKey);
 };
 }  // namespace login_manager
@@ -17,11 +17,15 @@
 #include <crypto/nss_util.h>
 #include <crypto/nss_util_internal.h>
 #include <crypto/rsa_private_key.h>
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "login_manager/mock_nss_util.h"
 #include "login_manager/nss_util.h"
 
+using ::testing::Return;
+using ::testing::_;
+
 namespace login_manager {
 
 class PolicyKeyTest : public ::testing::Test {
@@ -206,6 +210,36 @@ TEST_F(PolicyKeyTest, SignVerify) {
       key.Verify(data_p, data.length(), &signature[0], signature.size()));
 }
 
+TEST_F(PolicyKeyTest, VerifyCachesSuccess) {
+  StartUnowned();
+  MockNssUtil nss;
+  PolicyKey key(tmpfile_, &nss);
+  ASSERT_TRUE(key.PopulateFromDiskIfPossible());
+  ASSERT_TRUE(key.PopulateFromBuffer(std::vector<uint8_t>(1, 1)));
+
+  const uint8_t data[] = {1, 2, 3};
+  const uint8_t good_sig[] = {4, 5};
+  const uint8_t bad_sig[] = {6, 7};
+  EXPECT_CALL(nss, Verify(good_sig, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(nss, Verify(bad_sig, _, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(false));
+
+  // A signature that verified once shouldn't be checked again, but failures
+  // aren't remembered.
+  EXPECT_TRUE(key.Verify(data, sizeof(data), good_sig, sizeof(good_sig)));
+  EXPECT_TRUE(key.Verify(data, sizeof(data), good_sig, sizeof(good_sig)));
+  EXPECT_FALSE(key.Verify(data, sizeof(data), bad_sig, sizeof(bad_sig)));
+  EXPECT_FALSE(key.Verify(data, sizeof(data), bad_sig, sizeof(bad_sig)));
+
+  // A new key has to check the signature itself.
+  ASSERT_TRUE(key.ClobberCompromisedKey(std::vector<uint8_t>(1, 2)));
+  EXPECT_CALL(nss, Verify(good_sig, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(key.Verify(data, sizeof(data), good_sig, sizeof(good_sig)));
+}
+
 TEST_F(PolicyKeyTest, RotateKey) {
   scoped_ptr<NssUtil> nss(NssUtil::Create());
   StartUnowned();
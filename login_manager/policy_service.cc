@@ -7,6 +7,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include <base/bind.h>
 #include <base/callback.h>
@@ -15,6 +16,7 @@
 #include <base/memory/weak_ptr.h>
 #include <base/stl_util.h>
 #include <base/synchronization/waitable_event.h>
+#include <base/time/time.h>
 #include <brillo/message_loops/message_loop.h>
 
 #include "bindings/device_management_backend.pb.h"
@@ -28,6 +30,14 @@ namespace em = enterprise_management;
 
 namespace login_manager {
 
+namespace {
+
+// Policy writes requested within this long of the first one are coalesced
+// into a single write of the latest policy.
+const int kPersistPolicyDelayMs = 100;
+
+}  // namespace
+
 PolicyService::Error::Error() : code_(dbus_error::kNone) {
 }
 
@@ -50,6 +60,7 @@ PolicyService::PolicyService(
     : policy_store_(std::move(policy_store)),
       policy_key_(policy_key),
       delegate_(NULL),
+      persist_policy_task_id_(brillo::MessageLoop::kTaskIdNull),
       weak_ptr_factory_(this) {
 }
 
@@ -83,11 +94,16 @@ bool PolicyService::Retrieve(std::vector<uint8_t>* policy_blob) {
 }
 
 bool PolicyService::PersistPolicySync() {
+  if (persist_policy_task_id_ != brillo::MessageLoop::kTaskIdNull) {
+    brillo::MessageLoop::current()->CancelTask(persist_policy_task_id_);
+    persist_policy_task_id_ = brillo::MessageLoop::kTaskIdNull;
+  }
+  const Completion completion = TakePendingCompletions();
   if (store()->Persist()) {
-    OnPolicyPersisted(Completion(), dbus_error::kNone);
+    OnPolicyPersisted(completion, dbus_error::kNone);
     return true;
   } else {
-    OnPolicyPersisted(Completion(), dbus_error::kSigEncodeFail);
+    OnPolicyPersisted(completion, dbus_error::kSigEncodeFail);
     return false;
   }
 }
@@ -99,15 +115,21 @@ void PolicyService::PersistKey() {
 }
 
 void PolicyService::PersistPolicy() {
-  brillo::MessageLoop::current()->PostTask(
-      FROM_HERE, base::Bind(&PolicyService::PersistPolicyOnLoop,
-                            weak_ptr_factory_.GetWeakPtr(), Completion()));
+  PersistPolicyWithCompletion(Completion());
 }
 
 void PolicyService::PersistPolicyWithCompletion(const Completion& completion) {
-  brillo::MessageLoop::current()->PostTask(
-      FROM_HERE, base::Bind(&PolicyService::PersistPolicyOnLoop,
-                            weak_ptr_factory_.GetWeakPtr(), completion));
+  if (!completion.is_null())
+    pending_completions_.push_back(completion);
+  // The store always writes its latest policy, so a write that is already
+  // scheduled covers this one too.
+  if (persist_policy_task_id_ != brillo::MessageLoop::kTaskIdNull)
+    return;
+  persist_policy_task_id_ = brillo::MessageLoop::current()->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&PolicyService::PersistPendingPolicyOnLoop,
+                 weak_ptr_factory_.GetWeakPtr()),
+      base::TimeDelta::FromMilliseconds(kPersistPolicyDelayMs));
 }
 
 bool PolicyService::StorePolicy(const em::PolicyFetchResponse& policy,
@@ -181,6 +203,28 @@ void PolicyService::PersistKeyOnLoop() {
   OnKeyPersisted(key()->Persist());
 }
 
+void PolicyService::PersistPendingPolicyOnLoop() {
+  persist_policy_task_id_ = brillo::MessageLoop::kTaskIdNull;
+  PersistPolicyOnLoop(TakePendingCompletions());
+}
+
+PolicyService::Completion PolicyService::TakePendingCompletions() {
+  std::vector<Completion> completions;
+  completions.swap(pending_completions_);
+  if (completions.empty())
+    return Completion();
+  if (completions.size() == 1)
+    return completions[0];
+  return base::Bind(&PolicyService::RunCompletions, completions);
+}
+
+// static
+void PolicyService::RunCompletions(const std::vector<Completion>& completions,
+                                   const Error& error) {
+  for (const Completion& completion : completions)
+    completion.Run(error);
+}
+
 void PolicyService::PersistPolicyOnLoop(const Completion& completion) {
   if (store()->Persist()) {
     OnPolicyPersisted(completion, dbus_error::kNone);
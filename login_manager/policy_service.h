@@ -14,6 +14,7 @@
 #include <base/files/file_path.h>
 #include <base/memory/ref_counted.h>
 #include <base/memory/weak_ptr.h>
+#include <brillo/message_loops/message_loop.h>
 #include <chromeos/dbus/service_constants.h>
 
 namespace enterprise_management {
@@ -92,7 +93,8 @@ class PolicyService {
   virtual bool Retrieve(std::vector<uint8_t>* policy_blob);
 
   // Policy is persisted to disk on the IO loop. The current thread waits for
-  // completion and reports back the status afterwards.
+  // completion and reports back the status afterwards. Completions of pending
+  // asynchronous writes are run with the result as well.
   virtual bool PersistPolicySync();
 
   // Accessors for the delegate. PolicyService doesn't own the delegate, thus
@@ -114,7 +116,8 @@ class PolicyService {
   void PersistPolicy();
 
   // Triggers persisting the policy to disk and reports the result to the given
-  // completion context.
+  // completion context. Writes requested before the scheduled one has run are
+  // folded into it, and all of their completions see its result.
   void PersistPolicyWithCompletion(const Completion& completion);
 
   // Store a policy blob. This does the heavy lifting for Store(), making the
@@ -143,11 +146,28 @@ class PolicyService {
   // Takes care of persisting the policy key to disk.
   void PersistKeyOnLoop();
 
+  // Persists the policy once for all writes requested since the last one.
+  void PersistPendingPolicyOnLoop();
+
+  // Returns a completion that runs all of |pending_completions_|, which are
+  // cleared. Returns a null completion if there are none.
+  Completion TakePendingCompletions();
+
+  // Runs each of |completions| with |error|.
+  static void RunCompletions(const std::vector<Completion>& completions,
+                             const Error& error);
+
  private:
   std::unique_ptr<PolicyStore> policy_store_;
   PolicyKey* policy_key_;
   Delegate* delegate_;
 
+  // Completions of the writes that the scheduled one will satisfy.
+  std::vector<Completion> pending_completions_;
+
+  // Task that persists the policy, or kTaskIdNull if none is scheduled.
+  brillo::MessageLoop::TaskId persist_policy_task_id_;
+
   base::WeakPtrFactory<PolicyService> weak_ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(PolicyService);
@@ -375,6 +375,55 @@ TEST_F(PolicyServiceTest, Retrieve) {
       std::equal(policy_str_.begin(), policy_str_.end(), policy_data.begin()));
 }
 
+TEST_F(PolicyServiceTest, StoreCoalescesWrites) {
+  InitPolicy(fake_data_, fake_sig_, "", "");
+
+  EXPECT_CALL(key_, Equals(_)).WillRepeatedly(Return(false));
+  EXPECT_CALL(key_, IsPopulated()).WillRepeatedly(Return(true));
+  EXPECT_CALL(key_,
+              Verify(CastEq(fake_data_),
+                     fake_data_.size(),
+                     CastEq(fake_sig_),
+                     fake_sig_.size()))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*store_, Set(PolicyStrEq(policy_str_))).Times(2);
+
+  // Both stores should be satisfied by a single write.
+  EXPECT_CALL(*store_, Persist()).WillOnce(Return(true));
+  EXPECT_CALL(delegate_, OnPolicyPersisted(true)).Times(1);
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_,
+                              MockPolicyService::CreateExpectSuccessCallback(),
+                              kAllKeyFlags));
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_,
+                              MockPolicyService::CreateExpectSuccessCallback(),
+                              kAllKeyFlags));
+  fake_loop_.Run();
+}
+
+TEST_F(PolicyServiceTest, PersistPolicySyncFlushesPendingWrite) {
+  InitPolicy(fake_data_, fake_sig_, "", "");
+
+  EXPECT_CALL(key_, Equals(_)).WillRepeatedly(Return(false));
+  EXPECT_CALL(key_, IsPopulated()).WillRepeatedly(Return(true));
+  EXPECT_CALL(key_,
+              Verify(CastEq(fake_data_),
+                     fake_data_.size(),
+                     CastEq(fake_sig_),
+                     fake_sig_.size()))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*store_, Set(PolicyStrEq(policy_str_))).Times(1);
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_,
+                              MockPolicyService::CreateExpectFailureCallback(),
+                              kAllKeyFlags));
+
+  // The synchronous write should report its result to the pending store and
+  // replace the scheduled write.
+  EXPECT_CALL(*store_, Persist()).WillOnce(Return(false));
+  EXPECT_CALL(delegate_, OnPolicyPersisted(false)).Times(1);
+  EXPECT_FALSE(service_->PersistPolicySync());
+  fake_loop_.Run();
+}
+
 TEST_F(PolicyServiceTest, PersistPolicySyncSuccess) {
   EXPECT_CALL(*store_, Persist()).WillOnce(Return(true));
   EXPECT_CALL(delegate_, OnPolicyPersisted(true)).Times(1);
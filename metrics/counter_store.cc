@@ -0,0 +1,245 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metrics/counter_store.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+namespace chromeos_metrics {
+
+namespace {
+
+const uint32_t kStoreMagic = 0x6d637472;  // "mctr"
+const uint32_t kStoreVersion = 1;
+const uint32_t kChecksumBasis = 2166136261u;
+
+// FNV-1a, continuing from |hash|.  Starting from the offset basis, the hash of
+// any input is unlikely to be 0, so zeroed memory never looks valid.
+uint32_t Checksum(const void* data, size_t size, uint32_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+uint32_t CopyChecksum(uint32_t sequence, int64_t value) {
+  uint32_t hash = Checksum(&sequence, sizeof(sequence), kChecksumBasis);
+  return Checksum(&value, sizeof(value), hash);
+}
+
+}  // namespace
+
+struct CounterStore::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_size;
+  uint8_t reserved[48];
+};
+
+CounterStore::CounterStore(void* mapping, size_t mapping_size)
+    : mapping_(mapping), mapping_size_(mapping_size), dirty_(false) {}
+
+CounterStore::~CounterStore() {
+  munmap(mapping_, mapping_size_);
+}
+
+// static
+size_t CounterStore::MappingSize() {
+  static_assert(sizeof(Header) % 16 == 0 && sizeof(Slot) % 16 == 0,
+                "counter copies must not cross a page boundary");
+  return sizeof(Header) + kSlotCount * sizeof(Slot);
+}
+
+// static
+bool CounterStore::IsValid(const void* mapping) {
+  const Header* header = static_cast<const Header*>(mapping);
+  return header->magic == kStoreMagic && header->version == kStoreVersion &&
+         header->slot_count == kSlotCount && header->slot_size == sizeof(Slot);
+}
+
+// static
+std::unique_ptr<CounterStore> CounterStore::Open(const std::string& path) {
+  base::ScopedFD fd(HANDLE_EINTR(open(path.c_str(),
+                                      O_RDWR | O_CREAT | O_CLOEXEC,
+                                      S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH)));
+  if (!fd.is_valid()) {
+    PLOG(ERROR) << "cannot open " << path;
+    return std::unique_ptr<CounterStore>();
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd.get(), &stat_buf) < 0) {
+    PLOG(ERROR) << "cannot stat " << path;
+    return std::unique_ptr<CounterStore>();
+  }
+  size_t size = MappingSize();
+  bool resized = static_cast<size_t>(stat_buf.st_size) != size;
+  if (resized &&
+      (ftruncate(fd.get(), 0) < 0 || ftruncate(fd.get(), size) < 0)) {
+    PLOG(ERROR) << "cannot resize " << path;
+    return std::unique_ptr<CounterStore>();
+  }
+
+  void* mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "cannot map " << path;
+    return std::unique_ptr<CounterStore>();
+  }
+
+  std::unique_ptr<CounterStore> store(new CounterStore(mapping, size));
+  if (!IsValid(mapping)) {
+    if (!resized || stat_buf.st_size != 0)
+      LOG(WARNING) << path << ": invalid counter store, reinitializing";
+    memset(mapping, 0, size);
+    Header* header = static_cast<Header*>(mapping);
+    header->version = kStoreVersion;
+    header->slot_count = kSlotCount;
+    header->slot_size = sizeof(Slot);
+    header->magic = kStoreMagic;
+    store->dirty_ = true;
+  }
+  store->Load();
+  return store;
+}
+
+void CounterStore::Load() {
+  for (int i = 0; i < kSlotCount; i++) {
+    Slot* slot = SlotAt(i);
+    if (slot->name_length == 0)
+      continue;
+    if (slot->name_length <= kMaxNameLength &&
+        slot->name_checksum ==
+            Checksum(slot->name, slot->name_length, kChecksumBasis)) {
+      index_[std::string(slot->name, slot->name_length)] = i;
+    } else {
+      LOG(WARNING) << "freeing corrupted counter slot " << i;
+      memset(slot, 0, sizeof(*slot));
+      dirty_ = true;
+    }
+  }
+}
+
+CounterStore::Slot* CounterStore::SlotAt(int index) const {
+  char* slots = static_cast<char*>(mapping_) + sizeof(Header);
+  return reinterpret_cast<Slot*>(slots + index * sizeof(Slot));
+}
+
+int CounterStore::Find(const std::string& name, bool* created) {
+  *created = false;
+  auto it = index_.find(name);
+  if (it != index_.end())
+    return it->second;
+  if (name.empty() || name.size() > kMaxNameLength) {
+    LOG(ERROR) << "invalid counter name \"" << name << "\"";
+    return -1;
+  }
+
+  for (int i = 0; i < kSlotCount; i++) {
+    Slot* slot = SlotAt(i);
+    if (slot->name_length != 0)
+      continue;
+    memcpy(slot->name, name.data(), name.size());
+    slot->name_length = name.size();
+    slot->name_checksum = Checksum(name.data(), name.size(), kChecksumBasis);
+    index_[name] = i;
+    dirty_ = true;
+    *created = true;
+    return i;
+  }
+  LOG(ERROR) << "counter store is full, cannot add " << name;
+  return -1;
+}
+
+// static
+int CounterStore::NewestCopy(const Slot* slot) {
+  int newest = -1;
+  for (int i = 0; i < 2; i++) {
+    const Slot::Copy& copy = slot->copies[i];
+    if (copy.checksum != CopyChecksum(copy.sequence, copy.value))
+      continue;
+    // Sequence numbers may wrap around.
+    if (newest < 0 || static_cast<int32_t>(
+            copy.sequence - slot->copies[newest].sequence) > 0) {
+      newest = i;
+    }
+  }
+  return newest;
+}
+
+int64_t CounterStore::Get(int index) const {
+  DCHECK(index >= 0 && index < kSlotCount);
+  const Slot* slot = SlotAt(index);
+  int newest = NewestCopy(slot);
+  return newest < 0 ? 0 : slot->copies[newest].value;
+}
+
+void CounterStore::Set(int index, int64_t value) {
+  DCHECK(index >= 0 && index < kSlotCount);
+  Slot* slot = SlotAt(index);
+  int newest = NewestCopy(slot);
+  uint32_t sequence = newest < 0 ? 1 : slot->copies[newest].sequence + 1;
+  // Overwrite the other copy, checksum last, so that an interrupted update
+  // leaves |newest| as the value.
+  Slot::Copy* copy = &slot->copies[newest == 0 ? 1 : 0];
+  copy->value = value;
+  copy->sequence = sequence;
+  copy->checksum = CopyChecksum(sequence, value);
+  dirty_ = true;
+}
+
+int CounterStore::Retain(const std::set<std::string>& names) {
+  int freed = 0;
+  for (auto it = index_.begin(); it != index_.end();) {
+    if (names.count(it->first)) {
+      ++it;
+      continue;
+    }
+    // Clearing the length first frees the slot even if the rest of the clear
+    // is interrupted.
+    Slot* slot = SlotAt(it->second);
+    slot->name_length = 0;
+    memset(slot, 0, sizeof(*slot));
+    it = index_.erase(it);
+    dirty_ = true;
+    freed++;
+  }
+  return freed;
+}
+
+bool CounterStore::Flush() {
+  if (!dirty_)
+    return true;
+  // The kernel writes the pages back on its own schedule; this only makes sure
+  // they are queued, and leaves |dirty_| set for Sync().
+  if (msync(mapping_, mapping_size_, MS_ASYNC) < 0) {
+    PLOG(ERROR) << "cannot flush counter store";
+    return false;
+  }
+  return true;
+}
+
+bool CounterStore::Sync() {
+  if (!dirty_)
+    return true;
+  if (msync(mapping_, mapping_size_, MS_SYNC) < 0) {
+    PLOG(ERROR) << "cannot sync counter store";
+    return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+}  // namespace chromeos_metrics
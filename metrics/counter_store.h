@@ -0,0 +1,113 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef METRICS_COUNTER_STORE_H_
+#define METRICS_COUNTER_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <base/macros.h>
+
+namespace chromeos_metrics {
+
+// A fixed-size table of named 64-bit counters kept in a single memory-mapped
+// file.  Updates are plain stores into the mapping, so they survive a crash of
+// the process; Flush() and Sync() additionally write them back to storage.
+//
+// Each counter has two checksummed copies of its value, and an update writes
+// the older one.  A write torn by a crash or a power loss therefore leaves the
+// previous value readable.
+//
+// The store is meant to be used by a single process.
+class CounterStore {
+ public:
+  // Number of counters the store can hold.
+  static const int kSlotCount = 128;
+  // Longest counter name the store can hold.
+  static const size_t kMaxNameLength = 119;
+
+  ~CounterStore();
+
+  // Maps the store at |path|, creating it if it does not exist.  An invalid
+  // store is reinitialized with no counters.  Returns nullptr on error.
+  static std::unique_ptr<CounterStore> Open(const std::string& path);
+
+  // Returns the index of the counter named |name|, adding it with a value of 0
+  // if it does not exist.  In that case sets |*created| to true.  Returns -1 if
+  // the name is too long or the store is full.
+  int Find(const std::string& name, bool* created);
+
+  // Returns the value of the counter at |index|.
+  int64_t Get(int index) const;
+
+  // Sets the value of the counter at |index|.
+  void Set(int index, int64_t value);
+
+  // Frees the counters whose names are not in |names|, making room for new
+  // ones.  Returns the number of counters freed.
+  int Retain(const std::set<std::string>& names);
+
+  // Starts writing pending updates back to storage, without waiting for the
+  // writes to complete.  Returns false on error.
+  bool Flush();
+
+  // Writes pending updates back to storage and waits for the writes to
+  // complete.  Returns false on error.
+  bool Sync();
+
+ private:
+  friend class CounterStoreTest;
+
+  struct Header;
+
+  // A slot is free when |name_length| is 0.  The name is written before its
+  // checksum, so a slot whose allocation was interrupted is detected and freed
+  // by Load().  Copies are 16-byte aligned so that none crosses a page.
+  struct Slot {
+    struct Copy {
+      uint32_t sequence;
+      uint32_t checksum;
+      int64_t value;
+    };
+
+    uint32_t name_length;
+    uint32_t name_checksum;
+    char name[kMaxNameLength + 1];
+    Copy copies[2];
+  };
+
+  CounterStore(void* mapping, size_t mapping_size);
+
+  // Returns the size of the mapping.
+  static size_t MappingSize();
+
+  // Returns true if |mapping| holds a valid store header.
+  static bool IsValid(const void* mapping);
+
+  // Builds |index_| from the slots in the mapping, freeing invalid ones.
+  void Load();
+
+  Slot* SlotAt(int index) const;
+
+  // Returns the index of the valid copy of |slot| with the highest sequence
+  // number, or -1 if neither copy is valid.
+  static int NewestCopy(const Slot* slot);
+
+  void* mapping_;
+  size_t mapping_size_;
+  std::map<std::string, int> index_;
+  bool dirty_;
+
+  DISALLOW_COPY_AND_ASSIGN(CounterStore);
+};
+
+}  // namespace chromeos_metrics
+
+#endif  // METRICS_COUNTER_STORE_H_
@@ -0,0 +1,133 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+
+#include "metrics/counter_store.h"
+
+namespace chromeos_metrics {
+
+class CounterStoreTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().Append("counters").value();
+  }
+
+  // Simulates an update of the counter at |index| interrupted before its
+  // checksum was written.
+  void TearNextUpdate(CounterStore* store, int index, int64_t value) {
+    CounterStore::Slot* slot = store->SlotAt(index);
+    int newest = CounterStore::NewestCopy(slot);
+    CounterStore::Slot::Copy* copy = &slot->copies[newest == 0 ? 1 : 0];
+    copy->value = value;
+    copy->sequence = newest < 0 ? 1 : slot->copies[newest].sequence + 1;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  std::string path_;
+};
+
+TEST_F(CounterStoreTest, ValuesPersist) {
+  std::unique_ptr<CounterStore> store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  bool created = false;
+  int a = store->Find("a", &created);
+  EXPECT_TRUE(created);
+  int b = store->Find("b", &created);
+  EXPECT_TRUE(created);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(0, store->Get(a));
+
+  store->Set(a, 1);
+  store->Set(a, 2);
+  store->Set(b, -3);
+  EXPECT_TRUE(store->Flush());
+
+  store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  EXPECT_EQ(a, store->Find("a", &created));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(b, store->Find("b", &created));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(2, store->Get(a));
+  EXPECT_EQ(-3, store->Get(b));
+}
+
+TEST_F(CounterStoreTest, TornUpdateKeepsPreviousValue) {
+  std::unique_ptr<CounterStore> store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  bool created = false;
+  int index = store->Find("counter", &created);
+  store->Set(index, 5);
+  store->Set(index, 6);
+  TearNextUpdate(store.get(), index, 7);
+
+  store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  index = store->Find("counter", &created);
+  EXPECT_FALSE(created);
+  EXPECT_EQ(6, store->Get(index));
+
+  // The next update overwrites the torn copy.
+  store->Set(index, 8);
+  EXPECT_EQ(8, store->Get(index));
+}
+
+TEST_F(CounterStoreTest, InvalidStoreIsReinitialized) {
+  ASSERT_EQ(4, base::WriteFile(base::FilePath(path_), "junk", 4));
+  std::unique_ptr<CounterStore> store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  bool created = false;
+  int index = store->Find("counter", &created);
+  EXPECT_TRUE(created);
+  EXPECT_EQ(0, store->Get(index));
+}
+
+TEST_F(CounterStoreTest, RejectsBadNamesAndOverflow) {
+  std::unique_ptr<CounterStore> store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  bool created = false;
+  EXPECT_EQ(-1, store->Find("", &created));
+  EXPECT_EQ(-1, store->Find(
+      std::string(CounterStore::kMaxNameLength + 1, 'x'), &created));
+
+  for (int i = 0; i < CounterStore::kSlotCount; i++)
+    EXPECT_LE(0, store->Find(std::to_string(i), &created));
+  EXPECT_EQ(-1, store->Find("one too many", &created));
+  EXPECT_FALSE(created);
+}
+
+TEST_F(CounterStoreTest, RetainFreesOtherCounters) {
+  std::unique_ptr<CounterStore> store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  bool created = false;
+  for (int i = 0; i < CounterStore::kSlotCount; i++)
+    store->Set(store->Find(std::to_string(i), &created), i);
+  ASSERT_EQ(-1, store->Find("new", &created));
+
+  std::set<std::string> names = {"1", "2"};
+  EXPECT_EQ(CounterStore::kSlotCount - 2, store->Retain(names));
+  EXPECT_LE(0, store->Find("new", &created));
+  EXPECT_TRUE(created);
+  EXPECT_TRUE(store->Sync());
+
+  // Freed counters stay freed, and the kept ones keep their values.
+  store = CounterStore::Open(path_);
+  ASSERT_TRUE(store);
+  EXPECT_EQ(2, store->Get(store->Find("2", &created)));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(0, store->Get(store->Find("3", &created)));
+  EXPECT_TRUE(created);
+}
+
+}  // namespace chromeos_metrics
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -26,7 +26,9 @@
         ],
       },
       'sources': [
+        'counter_store.cc',
         'persistent_integer.cc',
+        'proc_scanner.cc',
         'metrics_daemon.cc',
         'metrics_daemon_main.cc',
       ],
@@ -109,11 +111,21 @@
     }],
     ['USE_test == 1', {
       'targets': [
+        {
+          'target_name': 'counter_store_test',
+          'type': 'executable',
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'counter_store.cc',
+            'counter_store_test.cc',
+          ]
+        },
         {
           'target_name': 'persistent_integer_test',
           'type': 'executable',
           'includes': ['../common-mk/common_test.gypi'],
           'sources': [
+            'counter_store.cc',
             'persistent_integer.cc',
             'persistent_integer_test.cc',
           ]
@@ -135,6 +147,15 @@
             ]
           }
         },
+        {
+          'target_name': 'proc_scanner_test',
+          'type': 'executable',
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'proc_scanner.cc',
+            'proc_scanner_test.cc',
+          ]
+        },
         {
           'target_name': 'timer_test',
           'type': 'executable',
@@ -148,6 +169,7 @@
           'target_name': 'upload_service_test',
           'type': 'executable',
           'sources': [
+            'counter_store.cc',
             'persistent_integer.cc',
             'uploader/metrics_hashes_unittest.cc',
             'uploader/metrics_log_base_unittest.cc',
@@ -178,6 +200,17 @@
           ],
           'include_dirs': ['.'],
         },
+        {
+          'target_name': 'proc_scanner_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libmetrics_daemon',
+          ],
+          'sources': [
+            'proc_scanner_benchmark.cc',
+          ],
+          'include_dirs': ['.'],
+        },
       ],
     }],
   ]
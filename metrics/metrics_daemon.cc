@@ -16,7 +16,6 @@
 #include <base/hash.h>
 #include <base/logging.h>
 #include <base/strings/string_number_conversions.h>
-#include <base/strings/string_split.h>
 #include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
 #include <base/sys_info.h>
@@ -31,6 +30,10 @@ using base::Time;
 using base::TimeDelta;
 using base::TimeTicks;
 using chromeos_metrics::PersistentInteger;
+using chromeos_metrics::ProcField;
+using chromeos_metrics::ProcFileReader;
+using chromeos_metrics::ProcLineScanner;
+using chromeos_metrics::ScanProcFields;
 using std::map;
 using std::string;
 using std::vector;
@@ -63,6 +66,11 @@ const char kKernelCrashDetectedFile[] = "/var/run/kernel-crash-detected";
 const char kUncleanShutdownDetectedFile[] =
     "/var/run/unclean-shutdown-detected";
 
+const char kMetricsMeminfoFileName[] = "/proc/meminfo";
+
+// Largest number of fields FillMeminfo() can be asked to collect.
+const size_t kMeminfoMaxFields = 32;
+
 }  // namespace
 
 // disk stats metrics
@@ -189,7 +197,7 @@ void MetricsDaemon::RunUploaderTest() {
                                                                  config_root_),
                                           metrics_lib_,
                                           server_));
-  upload_service_->Init(upload_interval_, metrics_file_);
+  upload_service_->Init(upload_interval_, metrics_file_, metrics_ring_file_);
   upload_service_->UploadEvent();
 }
 
@@ -227,6 +235,7 @@ void MetricsDaemon::Init(bool testing,
                          const base::TimeDelta& upload_interval,
                          const string& server,
                          const string& metrics_file,
+                         const string& metrics_ring_file,
                          const string& config_root) {
   testing_ = testing;
   uploader_active_ = uploader_active;
@@ -237,6 +246,7 @@ void MetricsDaemon::Init(bool testing,
   upload_interval_ = upload_interval;
   server_ = server;
   metrics_file_ = metrics_file;
+  metrics_ring_file_ = metrics_ring_file;
 
   // Get ticks per second (HZ) on this system.
   // Sysconf cannot fail, so no sanity checks are needed.
@@ -281,6 +291,11 @@ void MetricsDaemon::Init(bool testing,
 
   diskstats_path_ = diskstats_path;
   vmstats_path_ = vmstats_path;
+  if (!diskstats_path_.empty())
+    diskstats_reader_.reset(new ProcFileReader(diskstats_path_));
+  vmstats_reader_.reset(new ProcFileReader(vmstats_path_));
+  meminfo_reader_.reset(new ProcFileReader(kMetricsMeminfoFileName));
+  proc_stat_reader_.reset(new ProcFileReader(kMetricsProcStatFileName));
   scaling_max_freq_path_ = scaling_max_freq_path;
   cpuinfo_max_freq_path_ = cpuinfo_max_freq_path;
 
@@ -339,12 +354,17 @@ int MetricsDaemon::OnInit() {
       LOG(INFO) << "uploader enabled";
       upload_service_.reset(
           new UploadService(new SystemProfileCache(), metrics_lib_, server_));
-      upload_service_->Init(upload_interval_, metrics_file_);
+      upload_service_->Init(upload_interval_, metrics_file_,
+                            metrics_ring_file_);
     } else {
       LOG(INFO) << "uploader disabled on non-official build";
     }
   }
 
+  // Every counter the daemon uses exists by now.  Free the ones left behind
+  // by earlier versions so that the store doesn't fill up over updates.
+  PersistentInteger::ReclaimUnusedCounters();
+
   return EX_OK;
 }
 
@@ -366,6 +386,7 @@ void MetricsDaemon::OnShutdown(int* return_code) {
           << error.name << ": " << error.message;
     }
   }
+  PersistentInteger::Sync();
   brillo::DBusDaemon::OnShutdown(return_code);
 }
 
@@ -402,34 +423,43 @@ DBusHandlerResult MetricsDaemon::MessageFilter(DBusConnection* connection,
 // One might argue that parts of this should go into
 // chromium/src/base/sys_info_chromeos.c instead, but put it here for now.
 
-TimeDelta MetricsDaemon::GetIncrementalCpuUse() {
-  FilePath proc_stat_path = FilePath(kMetricsProcStatFileName);
-  std::string proc_stat_string;
-  if (!base::ReadFileToString(proc_stat_path, &proc_stat_string)) {
-    LOG(WARNING) << "cannot open " << kMetricsProcStatFileName;
-    return TimeDelta();
+// static
+bool MetricsDaemon::ParseProcStat(base::StringPiece proc_stat,
+                                  uint64_t* user_ticks,
+                                  uint64_t* user_nice_ticks,
+                                  uint64_t* system_ticks) {
+  // The first line has the totals: "cpu <user> <nice> <system> ...".
+  ProcLineScanner scanner(proc_stat);
+  base::StringPiece name;
+  if (!scanner.NextLine() || !scanner.NextToken(&name) || name != "cpu" ||
+      !scanner.NextUint64(user_ticks) ||
+      !scanner.NextUint64(user_nice_ticks) ||
+      !scanner.NextUint64(system_ticks)) {
+    LOG(WARNING) << "cannot parse first line of " << kMetricsProcStatFileName;
+    return false;
+  }
+  int items = 4;
+  base::StringPiece item;
+  while (scanner.NextToken(&item))
+    items++;
+  if (items != kMetricsProcStatFirstLineItemsCount) {
+    LOG(WARNING) << "found " << items << " items on first line of "
+                 << kMetricsProcStatFileName << ", expected "
+                 << kMetricsProcStatFirstLineItemsCount;
+    return false;
   }
+  return true;
+}
 
-  std::vector<std::string> proc_stat_lines =
-      base::SplitString(proc_stat_string, "\n", base::KEEP_WHITESPACE,
-                        base::SPLIT_WANT_ALL);
-  if (proc_stat_lines.empty()) {
-    LOG(WARNING) << "cannot parse " << kMetricsProcStatFileName
-                 << ": " << proc_stat_string;
+TimeDelta MetricsDaemon::GetIncrementalCpuUse() {
+  base::StringPiece proc_stat;
+  if (!proc_stat_reader_->Read(&proc_stat))
     return TimeDelta();
-  }
-  std::vector<std::string> proc_stat_totals =
-      base::SplitString(proc_stat_lines[0], base::kWhitespaceASCII,
-                        base::KEEP_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
 
   uint64_t user_ticks, user_nice_ticks, system_ticks;
-  if (proc_stat_totals.size() != kMetricsProcStatFirstLineItemsCount ||
-      proc_stat_totals[0] != "cpu" ||
-      !base::StringToUint64(proc_stat_totals[1], &user_ticks) ||
-      !base::StringToUint64(proc_stat_totals[2], &user_nice_ticks) ||
-      !base::StringToUint64(proc_stat_totals[3], &system_ticks)) {
-    LOG(WARNING) << "cannot parse first line: " << proc_stat_lines[0];
-    return TimeDelta(base::TimeDelta::FromSeconds(0));
+  if (!ParseProcStat(proc_stat, &user_ticks, &user_nice_ticks,
+                     &system_ticks)) {
+    return TimeDelta();
   }
 
   uint64_t total_cpu_use_ticks = user_ticks + user_nice_ticks + system_ticks;
@@ -522,101 +552,67 @@ void MetricsDaemon::ScheduleStatsCallback(int wait) {
       base::TimeDelta::FromSeconds(wait));
 }
 
+// static
+bool MetricsDaemon::DiskStatsParseStats(base::StringPiece stats,
+                                        uint64_t* read_sectors,
+                                        uint64_t* write_sectors) {
+  // The stat file has a single line, where the 3rd and 7th fields are the
+  // number of sectors read and written.
+  ProcLineScanner scanner(stats);
+  base::StringPiece skipped;
+  return scanner.NextLine() &&
+         scanner.NextToken(&skipped) && scanner.NextToken(&skipped) &&
+         scanner.NextUint64(read_sectors) &&
+         scanner.NextToken(&skipped) && scanner.NextToken(&skipped) &&
+         scanner.NextToken(&skipped) &&
+         scanner.NextUint64(write_sectors);
+}
+
 bool MetricsDaemon::DiskStatsReadStats(uint64_t* read_sectors,
                                        uint64_t* write_sectors) {
-  int nchars;
-  int nitems;
-  bool success = false;
-  char line[200];
-  if (diskstats_path_.empty()) {
+  if (!diskstats_reader_)
     return false;
-  }
-  int file = HANDLE_EINTR(open(diskstats_path_.c_str(), O_RDONLY));
-  if (file < 0) {
-    PLOG(WARNING) << "cannot open " << diskstats_path_;
+  base::StringPiece stats;
+  if (!diskstats_reader_->Read(&stats))
     return false;
-  }
-  nchars = HANDLE_EINTR(read(file, line, sizeof(line)));
-  if (nchars < 0) {
-    PLOG(WARNING) << "cannot read from " << diskstats_path_;
+  if (!DiskStatsParseStats(stats, read_sectors, write_sectors)) {
+    LOG(WARNING) << "cannot parse " << diskstats_path_;
     return false;
-  } else {
-    LOG_IF(WARNING, nchars == sizeof(line))
-        << "line too long in " << diskstats_path_;
-    line[nchars] = '\0';
-    nitems = sscanf(line, "%*d %*d %" PRIu64 " %*d %*d %*d %" PRIu64,
-                    read_sectors, write_sectors);
-    if (nitems == 2) {
-      success = true;
-    } else {
-      LOG(WARNING) << "found " << nitems << " items in "
-                   << diskstats_path_ << ", expected 2";
-    }
   }
-  IGNORE_EINTR(close(file));
-  return success;
+  return true;
 }
 
-bool MetricsDaemon::VmStatsParseStats(const char* stats,
+// static
+bool MetricsDaemon::VmStatsParseStats(base::StringPiece stats,
                                       struct VmstatRecord* record) {
-  // a mapping of string name to field in VmstatRecord and whether we found it
-  struct mapping {
-    const string name;
-    uint64_t* value_p;
-    bool found;
-  } map[] =
-      { { .name = "pgmajfault",
-          .value_p = &record->page_faults_,
-          .found = false },
-        { .name = "pswpin",
-          .value_p = &record->swap_in_,
-          .found = false },
-        { .name = "pswpout",
-          .value_p = &record->swap_out_,
-          .found = false }, };
-
   // Each line in the file has the form
   // <ID> <VALUE>
   // for instance:
   // nr_free_pages 213427
-  vector<string> lines = base::SplitString(stats, "\n", base::KEEP_WHITESPACE,
-                                           base::SPLIT_WANT_NONEMPTY);
-  for (vector<string>::iterator it = lines.begin();
-       it != lines.end(); ++it) {
-    vector<string> tokens = base::SplitString(*it, " ", base::KEEP_WHITESPACE,
-                                              base::SPLIT_WANT_ALL);
-    if (tokens.size() == 2) {
-      for (unsigned int i = 0; i < sizeof(map)/sizeof(struct mapping); i++) {
-        if (!tokens[0].compare(map[i].name)) {
-          if (!base::StringToUint64(tokens[1], map[i].value_p))
-            return false;
-          map[i].found = true;
-        }
-      }
-    } else {
-      LOG(WARNING) << "unexpected vmstat format";
-    }
-  }
-  // make sure we got all the stats
-  for (unsigned i = 0; i < sizeof(map)/sizeof(struct mapping); i++) {
-    if (map[i].found == false) {
-      LOG(WARNING) << "vmstat missing " << map[i].name;
-      return false;
+  // The fields are listed in the order the kernel prints them.
+  ProcField fields[] = {
+    { "pswpin" },
+    { "pswpout" },
+    { "pgmajfault" },
+  };
+  if (ScanProcFields(stats, fields, arraysize(fields)) != arraysize(fields)) {
+    // make sure we got all the stats
+    for (const ProcField& field : fields) {
+      LOG_IF(WARNING, !field.found) << "vmstat missing " << field.name;
     }
+    return false;
   }
+  record->swap_in_ = fields[0].value;
+  record->swap_out_ = fields[1].value;
+  record->page_faults_ = fields[2].value;
   return true;
 }
 
 bool MetricsDaemon::VmStatsReadStats(struct VmstatRecord* stats) {
-  string value_string;
-  FilePath* path = new FilePath(vmstats_path_);
-  if (!base::ReadFileToString(*path, &value_string)) {
-    delete path;
-    LOG(WARNING) << "cannot read " << vmstats_path_;
+  base::StringPiece value_string;
+  if (!vmstats_reader_->Read(&value_string))
     return false;
-  }
-  delete path;
-  return VmStatsParseStats(value_string.c_str(), stats);
+  return VmStatsParseStats(value_string, stats);
 }
 
 bool MetricsDaemon::ReadFreqToInt(const string& sysfs_file_name, int* value) {
@@ -796,12 +792,9 @@ void MetricsDaemon::ScheduleMeminfoCallback(int wait) {
 }
 
 void MetricsDaemon::MeminfoCallback(base::TimeDelta wait) {
-  string meminfo_raw;
-  const FilePath meminfo_path("/proc/meminfo");
-  if (!base::ReadFileToString(meminfo_path, &meminfo_raw)) {
-    LOG(WARNING) << "cannot read " << meminfo_path.value().c_str();
+  base::StringPiece meminfo_raw;
+  if (!meminfo_reader_->Read(&meminfo_raw))
     return;
-  }
   // Make both calls even if the first one fails.  Only stop rescheduling if
   // both calls fail, since some platforms do not support zram.
   bool success = ProcessMeminfo(meminfo_raw);
@@ -874,38 +867,47 @@ bool MetricsDaemon::ReportZram(const base::FilePath& zram_dir) {
   return true;
 }
 
-bool MetricsDaemon::ProcessMeminfo(const string& meminfo_raw) {
-  static const MeminfoRecord fields_array[] = {
-    { "MemTotal", "MemTotal" },  // SPECIAL CASE: total system memory
-    { "MemFree", "MemFree" },
-    { "Buffers", "Buffers" },
-    { "Cached", "Cached" },
-    // { "SwapCached", "SwapCached" },
-    { "Active", "Active" },
-    { "Inactive", "Inactive" },
-    { "ActiveAnon", "Active(anon)" },
-    { "InactiveAnon", "Inactive(anon)" },
-    { "ActiveFile" , "Active(file)" },
-    { "InactiveFile", "Inactive(file)" },
-    { "Unevictable", "Unevictable", kMeminfoOp_HistLog },
-    // { "Mlocked", "Mlocked" },
-    { "SwapTotal", "SwapTotal", kMeminfoOp_SwapTotal },
-    { "SwapFree", "SwapFree", kMeminfoOp_SwapFree },
-    // { "Dirty", "Dirty" },
-    // { "Writeback", "Writeback" },
-    { "AnonPages", "AnonPages" },
-    { "Mapped", "Mapped" },
-    { "Shmem", "Shmem", kMeminfoOp_HistLog },
-    { "Slab", "Slab", kMeminfoOp_HistLog },
-    // { "SReclaimable", "SReclaimable" },
-    // { "SUnreclaim", "SUnreclaim" },
-  };
-  vector<MeminfoRecord> fields(fields_array,
-                               fields_array + arraysize(fields_array));
-  if (!FillMeminfo(meminfo_raw, &fields)) {
+const MetricsDaemon::MeminfoRecord MetricsDaemon::kMeminfoFields[] = {
+  { "MemTotal", "MemTotal" },  // SPECIAL CASE: total system memory
+  { "MemFree", "MemFree" },
+  { "Buffers", "Buffers" },
+  { "Cached", "Cached" },
+  // { "SwapCached", "SwapCached" },
+  { "Active", "Active" },
+  { "Inactive", "Inactive" },
+  { "ActiveAnon", "Active(anon)" },
+  { "InactiveAnon", "Inactive(anon)" },
+  { "ActiveFile" , "Active(file)" },
+  { "InactiveFile", "Inactive(file)" },
+  { "Unevictable", "Unevictable", kMeminfoOp_HistLog },
+  // { "Mlocked", "Mlocked" },
+  { "SwapTotal", "SwapTotal", kMeminfoOp_SwapTotal },
+  { "SwapFree", "SwapFree", kMeminfoOp_SwapFree },
+  // { "Dirty", "Dirty" },
+  // { "Writeback", "Writeback" },
+  { "AnonPages", "AnonPages" },
+  { "Mapped", "Mapped" },
+  { "Shmem", "Shmem", kMeminfoOp_HistLog },
+  { "Slab", "Slab", kMeminfoOp_HistLog },
+  // { "SReclaimable", "SReclaimable" },
+  // { "SUnreclaim", "SUnreclaim" },
+};
+const size_t MetricsDaemon::kNumMeminfoFields = arraysize(kMeminfoFields);
+
+const MetricsDaemon::MeminfoRecord MetricsDaemon::kMemuseFields[] = {
+  { "MemTotal", "MemTotal" },  // SPECIAL CASE: total system memory
+  { "ActiveAnon", "Active(anon)" },
+  { "InactiveAnon", "Inactive(anon)" },
+};
+const size_t MetricsDaemon::kNumMemuseFields = arraysize(kMemuseFields);
+
+bool MetricsDaemon::ProcessMeminfo(base::StringPiece meminfo_raw) {
+  const MeminfoRecord* fields = kMeminfoFields;
+  int values[arraysize(kMeminfoFields)];
+  if (!FillMeminfo(meminfo_raw, fields, arraysize(kMeminfoFields), values)) {
     return false;
   }
-  int total_memory = fields[0].value;
+  int total_memory = values[0];
   if (total_memory == 0) {
     // this "cannot happen"
     LOG(WARNING) << "borked meminfo parser";
@@ -916,31 +918,31 @@ bool MetricsDaemon::ProcessMeminfo(const string& meminfo_raw) {
   int mem_free_derived = 0;  // free + cached + buffers
   int mem_used_derived = 0;  // total - free_derived
   // Send all fields retrieved, except total memory.
-  for (unsigned int i = 1; i < fields.size(); i++) {
+  for (unsigned int i = 1; i < arraysize(kMeminfoFields); i++) {
     string metrics_name = base::StringPrintf("Platform.Meminfo%s",
                                              fields[i].name);
     int percent;
     switch (fields[i].op) {
       case kMeminfoOp_HistPercent:
         // report value as percent of total memory
-        percent = fields[i].value * 100 / total_memory;
+        percent = values[i] * 100 / total_memory;
         SendLinearSample(metrics_name, percent, 100, 101);
         break;
       case kMeminfoOp_HistLog:
         // report value in kbytes, log scale, 4Gb max
-        SendSample(metrics_name, fields[i].value, 1, 4 * 1000 * 1000, 100);
+        SendSample(metrics_name, values[i], 1, 4 * 1000 * 1000, 100);
         break;
       case kMeminfoOp_SwapTotal:
-        swap_total = fields[i].value;
+        swap_total = values[i];
         break;
       case kMeminfoOp_SwapFree:
-        swap_free = fields[i].value;
+        swap_free = values[i];
         break;
     }
     if (strcmp(fields[i].match, "MemFree") == 0 ||
         strcmp(fields[i].match, "Buffers") == 0 ||
         strcmp(fields[i].match, "Cached") == 0) {
-        mem_free_derived += fields[i].value;
+        mem_free_derived += values[i];
     }
   }
   if (swap_total > 0) {
@@ -958,40 +960,28 @@ bool MetricsDaemon::ProcessMeminfo(const string& meminfo_raw) {
   return true;
 }
 
-bool MetricsDaemon::FillMeminfo(const string& meminfo_raw,
-                                vector<MeminfoRecord>* fields) {
-  vector<string> lines =
-      base::SplitString(meminfo_raw, "\n", base::KEEP_WHITESPACE,
-                        base::SPLIT_WANT_NONEMPTY);
-
-  // Scan meminfo output and collect field values.  Each field name has to
-  // match a meminfo entry (case insensitive) after removing non-alpha
-  // characters from the entry.
-  size_t ifield = 0;
-  for (size_t iline = 0;
-       iline < lines.size() && ifield < fields->size();
-       iline++) {
-    vector<string> tokens =
-        base::SplitString(lines[iline], ": ", base::KEEP_WHITESPACE,
-                          base::SPLIT_WANT_NONEMPTY);
-    if (strcmp((*fields)[ifield].match, tokens[0].c_str()) == 0) {
-      // Name matches. Parse value and save.
-      char* rest;
-      (*fields)[ifield].value =
-          static_cast<int>(strtol(tokens[1].c_str(), &rest, 10));
-      if (*rest != '\0') {
-        LOG(WARNING) << "missing meminfo value";
-        return false;
+// static
+bool MetricsDaemon::FillMeminfo(base::StringPiece meminfo_raw,
+                                const MeminfoRecord* fields,
+                                size_t num_fields,
+                                int* values) {
+  CHECK_LE(num_fields, kMeminfoMaxFields);
+  ProcField proc_fields[kMeminfoMaxFields];
+  for (size_t i = 0; i < num_fields; i++)
+    proc_fields[i].name = fields[i].match;
+
+  // Each field has to match the name of a meminfo entry exactly.
+  if (ScanProcFields(meminfo_raw, proc_fields, num_fields) != num_fields) {
+    for (size_t i = 0; i < num_fields; i++) {
+      if (!proc_fields[i].found) {
+        LOG(WARNING) << "cannot find meminfo field " << fields[i].match;
+        break;
       }
-      ifield++;
     }
-  }
-  if (ifield < fields->size()) {
-    // End of input reached while scanning.
-    LOG(WARNING) << "cannot find field " << (*fields)[ifield].match
-                 << " and following";
     return false;
   }
+  for (size_t i = 0; i < num_fields; i++)
+    values[i] = static_cast<int>(proc_fields[i].value);
   return true;
 }
 
@@ -1026,29 +1016,21 @@ void MetricsDaemon::MemuseCallback() {
 }
 
 bool MetricsDaemon::MemuseCallbackWork() {
-  string meminfo_raw;
-  const FilePath meminfo_path("/proc/meminfo");
-  if (!base::ReadFileToString(meminfo_path, &meminfo_raw)) {
-    LOG(WARNING) << "cannot read " << meminfo_path.value().c_str();
+  base::StringPiece meminfo_raw;
+  if (!meminfo_reader_->Read(&meminfo_raw))
     return false;
-  }
   return ProcessMemuse(meminfo_raw);
 }
 
-bool MetricsDaemon::ProcessMemuse(const string& meminfo_raw) {
-  static const MeminfoRecord fields_array[] = {
-    { "MemTotal", "MemTotal" },  // SPECIAL CASE: total system memory
-    { "ActiveAnon", "Active(anon)" },
-    { "InactiveAnon", "Inactive(anon)" },
-  };
-  vector<MeminfoRecord> fields(fields_array,
-                               fields_array + arraysize(fields_array));
-  if (!FillMeminfo(meminfo_raw, &fields)) {
+bool MetricsDaemon::ProcessMemuse(base::StringPiece meminfo_raw) {
+  int values[arraysize(kMemuseFields)];
+  if (!FillMeminfo(meminfo_raw, kMemuseFields, arraysize(kMemuseFields),
+                   values)) {
     return false;
   }
-  int total = fields[0].value;
-  int active_anon = fields[1].value;
-  int inactive_anon = fields[2].value;
+  int total = values[0];
+  int active_anon = values[1];
+  int inactive_anon = values[2];
   if (total == 0) {
     // this "cannot happen"
     LOG(WARNING) << "borked meminfo parser";
@@ -1181,6 +1163,9 @@ void MetricsDaemon::UpdateStats(TimeTicks now_ticks,
 
 void MetricsDaemon::HandleUpdateStatsTimeout() {
   UpdateStats(TimeTicks::Now(), Time::Now());
+  // Counters are updated in memory; queue them for writeback once per period
+  // rather than on every update.  Only shutdown waits for the writes.
+  PersistentInteger::Flush();
   base::MessageLoop::current()->PostDelayedTask(FROM_HERE,
       base::Bind(&MetricsDaemon::HandleUpdateStatsTimeout,
                  base::Unretained(this)),
@@ -13,12 +13,14 @@
 #include <vector>
 
 #include <base/files/file_path.h>
+#include <base/strings/string_piece.h>
 #include <base/time/time.h>
 #include <brillo/daemons/dbus_daemon.h>
 #include <gtest/gtest_prod.h>  // for FRIEND_TEST
 
 #include "metrics/metrics_library.h"
 #include "metrics/persistent_integer.h"
+#include "metrics/proc_scanner.h"
 #include "uploader/upload_service.h"
 
 using chromeos_metrics::PersistentInteger;
@@ -39,6 +41,7 @@ class MetricsDaemon : public brillo::DBusDaemon {
             const base::TimeDelta& upload_interval,
             const std::string& server,
             const std::string& metrics_file,
+            const std::string& metrics_ring_file,
             const std::string& config_root);
 
   // Initializes DBus and MessageLoop variables before running the MessageLoop.
@@ -53,6 +56,69 @@ class MetricsDaemon : public brillo::DBusDaemon {
   // Triggers an upload event and exit. (Used to test UploadService)
   void RunUploaderTest();
 
+  // Type of scale to use for meminfo histograms.  For most of them we use
+  // percent of total RAM, but for some we use absolute numbers, usually in
+  // megabytes, on a log scale from 0 to 4000, and 0 to 8000 for compressed
+  // swap (since it can be larger than total RAM).
+  enum MeminfoOp {
+    kMeminfoOp_HistPercent = 0,
+    kMeminfoOp_HistLog,
+    kMeminfoOp_SwapTotal,
+    kMeminfoOp_SwapFree,
+  };
+
+  // Record for retrieving and reporting values from /proc/meminfo.
+  struct MeminfoRecord {
+    const char* name;        // print name
+    const char* match;       // string to match in output of /proc/meminfo
+    MeminfoOp op;            // histogram scale selector, or other operator
+  };
+
+  // Record for retrieving and reporting values from /proc/vmstat
+  struct VmstatRecord {
+    uint64_t page_faults_;    // major faults
+    uint64_t swap_in_;        // pages swapped in
+    uint64_t swap_out_;       // pages swapped out
+  };
+
+  // Fields of /proc/meminfo reported by ProcessMeminfo() and ProcessMemuse(),
+  // in the order the kernel prints them.  The first one is MemTotal.
+  static const MeminfoRecord kMeminfoFields[];
+  static const size_t kNumMeminfoFields;
+  static const MeminfoRecord kMemuseFields[];
+  static const size_t kNumMemuseFields;
+
+  // Parsers for the files collected periodically.  They don't depend on the
+  // state of the daemon, and are public so that proc_scanner_benchmark times
+  // the code the daemon runs.
+
+  // Parses the total user, nice and system CPU ticks from the content of
+  // /proc/stat.  Returns true for success.
+  static bool ParseProcStat(base::StringPiece proc_stat,
+                            uint64_t* user_ticks,
+                            uint64_t* user_nice_ticks,
+                            uint64_t* system_ticks);
+
+  // Parses the number of sectors read and written from the content of a
+  // block device stat file.  Returns true for success.
+  static bool DiskStatsParseStats(base::StringPiece stats,
+                                  uint64_t* read_sectors,
+                                  uint64_t* write_sectors);
+
+  // Parse cumulative vm statistics from the content of /proc/vmstat.  Returns
+  // true for success.
+  static bool VmStatsParseStats(base::StringPiece stats,
+                                struct VmstatRecord* record);
+
+  // Parses meminfo data from |meminfo_raw|.  |fields| is an array of
+  // |num_fields| fields of interest, ideally listed in the order in which
+  // /proc/meminfo prints them.  The result of parsing fields[i] is placed in
+  // values[i].  Returns false unless all fields are found.
+  static bool FillMeminfo(base::StringPiece meminfo_raw,
+                          const MeminfoRecord* fields,
+                          size_t num_fields,
+                          int* values);
+
  protected:
   // Used also by the unit tests.
   static const char kComprDataSizeName[];
@@ -97,32 +163,6 @@ class MetricsDaemon : public brillo::DBusDaemon {
     int seconds_;
   };
 
-  // Type of scale to use for meminfo histograms.  For most of them we use
-  // percent of total RAM, but for some we use absolute numbers, usually in
-  // megabytes, on a log scale from 0 to 4000, and 0 to 8000 for compressed
-  // swap (since it can be larger than total RAM).
-  enum MeminfoOp {
-    kMeminfoOp_HistPercent = 0,
-    kMeminfoOp_HistLog,
-    kMeminfoOp_SwapTotal,
-    kMeminfoOp_SwapFree,
-  };
-
-  // Record for retrieving and reporting values from /proc/meminfo.
-  struct MeminfoRecord {
-    const char* name;        // print name
-    const char* match;       // string to match in output of /proc/meminfo
-    MeminfoOp op;            // histogram scale selector, or other operator
-    int value;               // value from /proc/meminfo
-  };
-
-  // Record for retrieving and reporting values from /proc/vmstat
-  struct VmstatRecord {
-    uint64_t page_faults_;    // major faults
-    uint64_t swap_in_;        // pages swapped in
-    uint64_t swap_out_;       // pages swapped out
-  };
-
   // Metric parameters.
   static const char kMetricReadSectorsLongName[];
   static const char kMetricReadSectorsShortName[];
@@ -225,9 +265,6 @@ class MetricsDaemon : public brillo::DBusDaemon {
   // Reads cumulative vm statistics from procfs.  Returns true for success.
   bool VmStatsReadStats(struct VmstatRecord* stats);
 
-  // Parse cumulative vm statistics from a C string.  Returns true for success.
-  bool VmStatsParseStats(const char* stats, struct VmstatRecord* record);
-
   // Reports disk and vm statistics.
   void StatsCallback();
 
@@ -240,14 +277,7 @@ class MetricsDaemon : public brillo::DBusDaemon {
   // Parses content of /proc/meminfo and sends fields of interest to UMA.
   // Returns false on errors.  |meminfo_raw| contains the content of
   // /proc/meminfo.
-  bool ProcessMeminfo(const std::string& meminfo_raw);
-
-  // Parses meminfo data from |meminfo_raw|.  |fields| is a vector containing
-  // the fields of interest.  The order of the fields must be the same in which
-  // /proc/meminfo prints them.  The result of parsing fields[i] is placed in
-  // fields[i].value.
-  bool FillMeminfo(const std::string& meminfo_raw,
-                   std::vector<MeminfoRecord>* fields);
+  bool ProcessMeminfo(base::StringPiece meminfo_raw);
 
   // Schedule a memory use callback in |interval| seconds.
   void ScheduleMemuseCallback(double interval);
@@ -261,7 +291,7 @@ class MetricsDaemon : public brillo::DBusDaemon {
   bool MemuseCallbackWork();
 
   // Parses meminfo data and sends it to UMA.
-  bool ProcessMemuse(const std::string& meminfo_raw);
+  bool ProcessMemuse(base::StringPiece meminfo_raw);
 
   // Sends stats for thermal CPU throttling.
   void SendCpuThrottleMetrics();
@@ -362,12 +392,18 @@ class MetricsDaemon : public brillo::DBusDaemon {
 
   std::string diskstats_path_;
   std::string vmstats_path_;
+  // Readers for the files parsed periodically, which reuse their buffers.
+  std::unique_ptr<chromeos_metrics::ProcFileReader> diskstats_reader_;
+  std::unique_ptr<chromeos_metrics::ProcFileReader> vmstats_reader_;
+  std::unique_ptr<chromeos_metrics::ProcFileReader> meminfo_reader_;
+  std::unique_ptr<chromeos_metrics::ProcFileReader> proc_stat_reader_;
   std::string scaling_max_freq_path_;
   std::string cpuinfo_max_freq_path_;
 
   base::TimeDelta upload_interval_;
   std::string server_;
   std::string metrics_file_;
+  std::string metrics_ring_file_;
 
   std::unique_ptr<UploadService> upload_service_;
 };
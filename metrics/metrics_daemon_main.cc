@@ -65,6 +65,10 @@ int main(int argc, char** argv) {
   DEFINE_string(metrics_file,
                 "/var/lib/metrics/uma-events",
                 "File to use as a proxy for uploading the metrics");
+  DEFINE_string(metrics_ring_file,
+                "/var/run/metrics/uma-events.ring",
+                "Shared memory ring clients send metrics through when it "
+                "exists (needs -uploader, empty to disable)");
   DEFINE_string(config_root,
                 "/", "Root of the configuration files (testing only)");
 
@@ -91,6 +95,7 @@ int main(int argc, char** argv) {
               base::TimeDelta::FromSeconds(FLAGS_upload_interval_secs),
               FLAGS_server,
               FLAGS_metrics_file,
+              FLAGS_metrics_ring_file,
               FLAGS_config_root);
 
   if (FLAGS_uploader_test) {
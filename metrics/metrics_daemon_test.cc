@@ -74,6 +74,7 @@ class MetricsDaemonTest : public testing::Test {
                  base::TimeDelta::FromMinutes(30),
                  kMetricsServer,
                  kMetricsFilePath,
+                 "",
                  "/");
 
     // Replace original persistent values with mock ones.
@@ -4,21 +4,29 @@
 
 #include "metrics/metrics_library.h"
 
+#include <base/bind.h>
 #include <base/logging.h>
+#include <base/message_loop/message_loop.h>
 #include <base/strings/stringprintf.h>
 #include <errno.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <utility>
+
+#include <base/memory/scoped_vector.h>
 
 #include "metrics/serialization/metric_sample.h"
+#include "metrics/serialization/sample_ring.h"
 #include "metrics/serialization/serialization_utils.h"
 
 #include "policy/device_policy.h"
 
 static const char kUMAEventsPath[] = "/var/lib/metrics/uma-events";
+static const char kUMAEventsRingPath[] = "/var/run/metrics/uma-events.ring";
 static const char kConsentFile[] = "/home/chronos/Consent To Send Stats";
 static const char kCrosEventHistogramName[] = "Platform.CrOSEvent";
 static const int kCrosEventHistogramMax = 100;
@@ -54,8 +62,12 @@ static const char *kCrosEventNames[] = {
 time_t MetricsLibrary::cached_enabled_time_ = 0;
 bool MetricsLibrary::cached_enabled_ = false;
 
-MetricsLibrary::MetricsLibrary() : consent_file_(kConsentFile) {}
-MetricsLibrary::~MetricsLibrary() {}
+MetricsLibrary::MetricsLibrary()
+    : consent_file_(kConsentFile), aggregation_enabled_(false) {}
+
+MetricsLibrary::~MetricsLibrary() {
+  FlushAggregatedSamples();
+}
 
 // We take buffer and buffer_size as parameters in order to simplify testing
 // of various alignments of the |device_name| with |buffer_size|.
@@ -158,6 +170,88 @@ bool MetricsLibrary::AreMetricsEnabled() {
 
 void MetricsLibrary::Init() {
   uma_events_file_ = kUMAEventsPath;
+  // The ring only exists when metrics_daemon drains it; otherwise samples go
+  // to the uma-events file as before.
+  ring_ = metrics::SampleRing::Open(kUMAEventsRingPath);
+}
+
+bool MetricsLibrary::SendSample(const metrics::MetricSample& sample) {
+  if (ring_ && metrics::SerializationUtils::WriteMetricToRing(sample,
+                                                              ring_.get())) {
+    return true;
+  }
+  return metrics::SerializationUtils::WriteMetricToFile(sample,
+                                                        kUMAEventsPath);
+}
+
+bool MetricsLibrary::RecordSample(
+    std::unique_ptr<metrics::MetricSample> sample) {
+  if (!aggregation_enabled_)
+    return SendSample(*sample);
+  if (!sample->IsValid())
+    return false;
+
+  std::string key = sample->ToString();
+  AggregatedSample& aggregated = aggregated_samples_[key];
+  if (!aggregated.sample) {
+    aggregated.sample = std::move(sample);
+    aggregated.count = 1;
+  } else {
+    aggregated.count++;
+  }
+
+  // A sample can't stand for more than kMaxNumSamples recordings.
+  if (aggregated.count >= metrics::MetricSample::kMaxNumSamples ||
+      base::TimeTicks::Now() - last_aggregation_flush_ >=
+          aggregation_flush_interval_) {
+    return FlushAggregatedSamples();
+  }
+  ScheduleAggregationFlush();
+  return true;
+}
+
+void MetricsLibrary::ScheduleAggregationFlush() {
+  if (aggregation_flush_timer_.IsRunning() || !base::MessageLoop::current())
+    return;
+  base::TimeDelta delay = last_aggregation_flush_ +
+                          aggregation_flush_interval_ - base::TimeTicks::Now();
+  aggregation_flush_timer_.Start(
+      FROM_HERE, std::max(delay, base::TimeDelta()),
+      base::Bind(base::IgnoreResult(&MetricsLibrary::FlushAggregatedSamples),
+                 base::Unretained(this)));
+}
+
+void MetricsLibrary::EnableAggregation(base::TimeDelta flush_interval) {
+  aggregation_enabled_ = true;
+  aggregation_flush_interval_ = flush_interval;
+  last_aggregation_flush_ = base::TimeTicks::Now();
+}
+
+bool MetricsLibrary::FlushAggregatedSamples() {
+  last_aggregation_flush_ = base::TimeTicks::Now();
+  aggregation_flush_timer_.Stop();
+  if (aggregated_samples_.empty())
+    return true;
+
+  // Repeated samples go through the ring when possible.  Whatever doesn't fit
+  // is written to the file in one batch, expanded back into single samples
+  // since Chrome may be the one reading it.
+  ScopedVector<metrics::MetricSample> unsent;
+  for (auto& entry : aggregated_samples_) {
+    std::unique_ptr<metrics::MetricSample> repeated =
+        metrics::MetricSample::RepeatedSample(*entry.second.sample,
+                                              entry.second.count);
+    if (ring_ && metrics::SerializationUtils::WriteMetricToRing(*repeated,
+                                                                ring_.get())) {
+      continue;
+    }
+    unsent.push_back(repeated.release());
+  }
+  aggregated_samples_.clear();
+
+  return unsent.empty() ||
+         metrics::SerializationUtils::WriteMetricsToFile(unsent,
+                                                         kUMAEventsPath);
 }
 
 bool MetricsLibrary::SendToUMA(const std::string& name,
@@ -165,40 +259,32 @@ bool MetricsLibrary::SendToUMA(const std::string& name,
                                int min,
                                int max,
                                int nbuckets) {
-  return metrics::SerializationUtils::WriteMetricToFile(
-      *metrics::MetricSample::HistogramSample(name, sample, min, max, nbuckets)
-           .get(),
-      kUMAEventsPath);
+  return RecordSample(
+      metrics::MetricSample::HistogramSample(name, sample, min, max, nbuckets));
 }
 
 bool MetricsLibrary::SendEnumToUMA(const std::string& name, int sample,
                                    int max) {
-  return metrics::SerializationUtils::WriteMetricToFile(
-      *metrics::MetricSample::LinearHistogramSample(name, sample, max).get(),
-      kUMAEventsPath);
+  return RecordSample(
+      metrics::MetricSample::LinearHistogramSample(name, sample, max));
 }
 
 bool MetricsLibrary::SendBoolToUMA(const std::string& name, bool sample) {
-  return metrics::SerializationUtils::WriteMetricToFile(
-      *metrics::MetricSample::LinearHistogramSample(name,
-                                                    sample ? 1 : 0, 2).get(),
-      kUMAEventsPath);
+  return RecordSample(
+      metrics::MetricSample::LinearHistogramSample(name, sample ? 1 : 0, 2));
 }
 
 bool MetricsLibrary::SendSparseToUMA(const std::string& name, int sample) {
-  return metrics::SerializationUtils::WriteMetricToFile(
-      *metrics::MetricSample::SparseHistogramSample(name, sample).get(),
-      kUMAEventsPath);
+  return RecordSample(
+      metrics::MetricSample::SparseHistogramSample(name, sample));
 }
 
 bool MetricsLibrary::SendUserActionToUMA(const std::string& action) {
-  return metrics::SerializationUtils::WriteMetricToFile(
-      *metrics::MetricSample::UserActionSample(action).get(), kUMAEventsPath);
+  return SendSample(*metrics::MetricSample::UserActionSample(action).get());
 }
 
 bool MetricsLibrary::SendCrashToUMA(const char *crash_kind) {
-  return metrics::SerializationUtils::WriteMetricToFile(
-      *metrics::MetricSample::CrashSample(crash_kind).get(), kUMAEventsPath);
+  return SendSample(*metrics::MetricSample::CrashSample(crash_kind).get());
 }
 
 void MetricsLibrary::SetPolicyProvider(policy::PolicyProvider* provider) {
@@ -5,6 +5,7 @@
 #ifndef METRICS_METRICS_LIBRARY_H_
 #define METRICS_METRICS_LIBRARY_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <sys/types.h>
@@ -12,10 +13,17 @@
 
 #include <base/compiler_specific.h>
 #include <base/macros.h>
+#include <base/time/time.h>
+#include <base/timer/timer.h>
 #include <gtest/gtest_prod.h>  // for FRIEND_TEST
 
 #include "policy/libpolicy.h"
 
+namespace metrics {
+class MetricSample;
+class SampleRing;
+}  // namespace metrics
+
 class MetricsLibraryInterface {
  public:
   virtual void Init() = 0;
@@ -113,9 +121,29 @@ class MetricsLibrary : public MetricsLibraryInterface {
   // number in the histograms dashboard).
   bool SendCrosEventToUMA(const std::string& event);
 
+  // Enables client-side aggregation for clients that report the same
+  // histograms at a high rate.  Histogram, enum, bool and sparse samples are
+  // then counted in memory per histogram and value, and sent as one record per
+  // distinct value by FlushAggregatedSamples().  That happens |flush_interval|
+  // after the previous flush if the calling thread runs a base::MessageLoop,
+  // and otherwise on the first sample recorded after that; either way also
+  // when a value has been recorded MetricSample::kMaxNumSamples times and
+  // when the library is destroyed.  Clients without a message loop must call
+  // FlushAggregatedSamples() themselves before going idle, or samples wait
+  // for the next one.  Crashes and user actions are still sent immediately.
+  // The library must then only be used on the calling thread.
+  void EnableAggregation(base::TimeDelta flush_interval);
+
+  // Sends all aggregated samples and returns true on success.  A no-op when
+  // aggregation is disabled.
+  bool FlushAggregatedSamples();
+
  private:
   friend class CMetricsLibraryTest;
   friend class MetricsLibraryTest;
+  FRIEND_TEST(MetricsLibraryTest, AggregatedSamplesAreFlushed);
+  FRIEND_TEST(MetricsLibraryTest, AggregatedSamplesAreFlushedAtMaxCount);
+  FRIEND_TEST(MetricsLibraryTest, AggregatedSamplesAreFlushedByTimer);
   FRIEND_TEST(MetricsLibraryTest, AreMetricsEnabled);
   FRIEND_TEST(MetricsLibraryTest, FormatChromeMessage);
   FRIEND_TEST(MetricsLibraryTest, FormatChromeMessageTooLong);
@@ -131,6 +159,19 @@ class MetricsLibrary : public MetricsLibraryInterface {
                        char* buffer, int buffer_size,
                        bool* result);
 
+  // Sends |sample| through the shared memory ring if one is available, and
+  // falls back to appending it to the uma-events file otherwise.
+  bool SendSample(const metrics::MetricSample& sample);
+
+  // Sends |sample| right away, or adds it to |aggregated_samples_| when
+  // aggregation is enabled.
+  bool RecordSample(std::unique_ptr<metrics::MetricSample> sample);
+
+  // Starts |aggregation_flush_timer_| to flush the aggregated samples at the
+  // end of the current interval, if it isn't running already and the calling
+  // thread has a message loop.
+  void ScheduleAggregationFlush();
+
   // This function is used by tests only to mock the device policies.
   void SetPolicyProvider(policy::PolicyProvider* provider);
 
@@ -145,6 +186,22 @@ class MetricsLibrary : public MetricsLibraryInterface {
 
   std::unique_ptr<policy::PolicyProvider> policy_provider_;
 
+  // Shared memory transport to metrics_daemon, if it created one.
+  std::unique_ptr<metrics::SampleRing> ring_;
+
+  // Histogram samples waiting to be flushed, keyed by their serialized form
+  // (which identifies both the histogram and the value), along with the
+  // number of times each was recorded.
+  struct AggregatedSample {
+    std::unique_ptr<metrics::MetricSample> sample;
+    int count;
+  };
+  std::map<std::string, AggregatedSample> aggregated_samples_;
+  bool aggregation_enabled_;
+  base::TimeDelta aggregation_flush_interval_;
+  base::TimeTicks last_aggregation_flush_;
+  base::OneShotTimer aggregation_flush_timer_;
+
   DISALLOW_COPY_AND_ASSIGN(MetricsLibrary);
 };
 
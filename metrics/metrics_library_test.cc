@@ -5,6 +5,10 @@
 #include <cstring>
 
 #include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_vector.h>
+#include <base/message_loop/message_loop.h>
+#include <base/run_loop.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <policy/mock_device_policy.h>
@@ -12,6 +16,9 @@
 
 #include "metrics/c_metrics_library.h"
 #include "metrics/metrics_library.h"
+#include "metrics/serialization/metric_sample.h"
+#include "metrics/serialization/sample_ring.h"
+#include "metrics/serialization/serialization_utils.h"
 
 using base::FilePath;
 using ::testing::_;
@@ -119,6 +126,100 @@ TEST_F(MetricsLibraryTest, IsDeviceMounted) {
   }
 }
 
+TEST_F(MetricsLibraryTest, AggregatedSamplesAreFlushed) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  std::string ring_path = temp_dir.path().Append("ring").value();
+  std::unique_ptr<metrics::SampleRing> consumer =
+      metrics::SampleRing::Create(ring_path,
+                                  metrics::SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(consumer.get());
+  lib_.ring_ = metrics::SampleRing::Open(ring_path);
+  ASSERT_TRUE(lib_.ring_.get());
+
+  lib_.EnableAggregation(base::TimeDelta::FromHours(1));
+  for (int i = 0; i < 3; i++)
+    EXPECT_TRUE(lib_.SendEnumToUMA("Test.Enum", 1, 5));
+  EXPECT_TRUE(lib_.SendEnumToUMA("Test.Enum", 2, 5));
+  EXPECT_TRUE(lib_.SendSparseToUMA("Test.Sparse", 7));
+
+  // Nothing is sent before the flush.
+  ScopedVector<metrics::MetricSample> samples;
+  metrics::SerializationUtils::ReadMetricsFromRing(consumer.get(), &samples);
+  EXPECT_EQ(size_t(0), samples.size());
+
+  EXPECT_TRUE(lib_.FlushAggregatedSamples());
+  metrics::SerializationUtils::ReadMetricsFromRing(consumer.get(), &samples);
+  ASSERT_EQ(size_t(3), samples.size());
+  EXPECT_TRUE(samples[0]->IsEqual(*metrics::MetricSample::RepeatedSample(
+      *metrics::MetricSample::LinearHistogramSample("Test.Enum", 1, 5), 3)));
+  EXPECT_TRUE(samples[1]->IsEqual(
+      *metrics::MetricSample::LinearHistogramSample("Test.Enum", 2, 5)));
+  EXPECT_TRUE(samples[2]->IsEqual(
+      *metrics::MetricSample::SparseHistogramSample("Test.Sparse", 7)));
+}
+
+TEST_F(MetricsLibraryTest, AggregatedSamplesAreFlushedAtMaxCount) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  std::string ring_path = temp_dir.path().Append("ring").value();
+  std::unique_ptr<metrics::SampleRing> consumer =
+      metrics::SampleRing::Create(ring_path,
+                                  metrics::SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(consumer.get());
+  lib_.ring_ = metrics::SampleRing::Open(ring_path);
+  ASSERT_TRUE(lib_.ring_.get());
+
+  // A value recorded kMaxNumSamples times is sent without waiting for the
+  // interval, so that no sample stands for more recordings than that.
+  lib_.EnableAggregation(base::TimeDelta::FromHours(1));
+  for (int i = 0; i < metrics::MetricSample::kMaxNumSamples + 1; i++)
+    EXPECT_TRUE(lib_.SendSparseToUMA("Test.Sparse", 7));
+  ScopedVector<metrics::MetricSample> samples;
+  metrics::SerializationUtils::ReadMetricsFromRing(consumer.get(), &samples);
+  ASSERT_EQ(size_t(1), samples.size());
+  EXPECT_TRUE(samples[0]->IsEqual(*metrics::MetricSample::RepeatedSample(
+      *metrics::MetricSample::SparseHistogramSample("Test.Sparse", 7),
+      metrics::MetricSample::kMaxNumSamples)));
+
+  EXPECT_TRUE(lib_.FlushAggregatedSamples());
+  metrics::SerializationUtils::ReadMetricsFromRing(consumer.get(), &samples);
+  ASSERT_EQ(size_t(2), samples.size());
+  EXPECT_TRUE(samples[1]->IsEqual(
+      *metrics::MetricSample::SparseHistogramSample("Test.Sparse", 7)));
+}
+
+TEST_F(MetricsLibraryTest, AggregatedSamplesAreFlushedByTimer) {
+  base::MessageLoop message_loop;
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  std::string ring_path = temp_dir.path().Append("ring").value();
+  std::unique_ptr<metrics::SampleRing> consumer =
+      metrics::SampleRing::Create(ring_path,
+                                  metrics::SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(consumer.get());
+  lib_.ring_ = metrics::SampleRing::Open(ring_path);
+  ASSERT_TRUE(lib_.ring_.get());
+
+  // The samples are sent once the interval has passed, even though no other
+  // sample is recorded after it.
+  lib_.EnableAggregation(base::TimeDelta::FromMilliseconds(10));
+  EXPECT_TRUE(lib_.SendEnumToUMA("Test.Enum", 1, 5));
+  EXPECT_TRUE(lib_.SendEnumToUMA("Test.Enum", 1, 5));
+  ScopedVector<metrics::MetricSample> samples;
+  metrics::SerializationUtils::ReadMetricsFromRing(consumer.get(), &samples);
+  EXPECT_EQ(size_t(0), samples.size());
+
+  base::RunLoop run_loop;
+  message_loop.PostDelayedTask(FROM_HERE, run_loop.QuitClosure(),
+                               base::TimeDelta::FromMilliseconds(500));
+  run_loop.Run();
+  metrics::SerializationUtils::ReadMetricsFromRing(consumer.get(), &samples);
+  ASSERT_EQ(size_t(1), samples.size());
+  EXPECT_TRUE(samples[0]->IsEqual(*metrics::MetricSample::RepeatedSample(
+      *metrics::MetricSample::LinearHistogramSample("Test.Enum", 1, 5), 2)));
+}
+
 TEST_F(MetricsLibraryTest, AreMetricsEnabledFalse) {
   EXPECT_CALL(*device_policy_, GetMetricsEnabled(_))
       .WillOnce(SetMetricsPolicy(false));
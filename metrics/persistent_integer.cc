@@ -5,10 +5,13 @@
 #include "metrics/persistent_integer.h"
 
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <base/logging.h>
 #include <base/posix/eintr_wrapper.h>
 
+#include "metrics/counter_store.h"
 #include "metrics/metrics_library.h"
 
 namespace {
@@ -16,26 +19,42 @@ namespace {
 // The directory for the persistent storage.
 const char kBackingFilesDirectory[] = "/var/lib/metrics/";
 
+// The name of the counter store in the persistent storage directory.  In
+// testing mode, the store is in the current directory and its name follows
+// the convention of test backing files.
+const char kCounterStoreName[] = "persistent_integers";
+const char kTestingCounterStoreName[] = "persistent_integers.pibakf";
+
 }
 
 namespace chromeos_metrics {
 
 // Static class member instantiation.
 bool PersistentInteger::testing_ = false;
+CounterStore* PersistentInteger::store_ = nullptr;
+int PersistentInteger::store_generation_ = 0;
+std::multiset<std::string>* PersistentInteger::names_ = nullptr;
 
 PersistentInteger::PersistentInteger(const std::string& name) :
       value_(0),
       version_(kVersion),
       name_(name),
-      synced_(false) {
+      synced_(false),
+      index_(-1),
+      generation_(-1) {
   if (testing_) {
     backing_file_name_ = name_;
   } else {
     backing_file_name_ = kBackingFilesDirectory + name_;
   }
+  if (!names_)
+    names_ = new std::multiset<std::string>;
+  names_->insert(name_);
 }
 
-PersistentInteger::~PersistentInteger() {}
+PersistentInteger::~PersistentInteger() {
+  names_->erase(names_->find(name_));
+}
 
 void PersistentInteger::Set(int64_t value) {
   value_ = value;
@@ -43,9 +62,8 @@ void PersistentInteger::Set(int64_t value) {
 }
 
 int64_t PersistentInteger::Get() {
-  // If not synced, then read.  If the read fails, it's a good idea to write.
-  if (!synced_ && !Read())
-    Write();
+  if (!synced_)
+    Read();
   return value_;
 }
 
@@ -60,41 +78,127 @@ void PersistentInteger::Add(int64_t x) {
 }
 
 void PersistentInteger::Write() {
-  int fd = HANDLE_EINTR(open(backing_file_name_.c_str(),
-                             O_WRONLY | O_CREAT | O_TRUNC,
-                             S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH));
-  PCHECK(fd >= 0) << "cannot open " << backing_file_name_ << " for writing";
-  PCHECK((HANDLE_EINTR(write(fd, &version_, sizeof(version_))) ==
-          sizeof(version_)) &&
-         (HANDLE_EINTR(write(fd, &value_, sizeof(value_))) ==
-          sizeof(value_)))
-      << "cannot write to " << backing_file_name_;
-  close(fd);
+  int index = Index();
+  if (index < 0)
+    WriteBackingFile();
+  else
+    GetStore()->Set(index, value_);
+  synced_ = true;
+}
+
+void PersistentInteger::Read() {
+  int index = Index();
+  if (index < 0) {
+    if (!ReadBackingFile(&value_))
+      value_ = 0;
+  } else {
+    value_ = GetStore()->Get(index);
+  }
   synced_ = true;
 }
 
-bool PersistentInteger::Read() {
+int PersistentInteger::Index() {
+  // Opening the store bumps the generation, so do it before the check.
+  CounterStore* store = GetStore();
+  if (generation_ == store_generation_)
+    return index_;
+  bool created = false;
+  index_ = store->Find(name_, &created);
+  generation_ = store_generation_;
+  if (index_ < 0)
+    LOG(WARNING) << "keeping " << name_ << " in " << backing_file_name_;
+  else if (created)
+    ImportBackingFile();
+  return index_;
+}
+
+void PersistentInteger::ImportBackingFile() {
+  int64_t value;
+  if (ReadBackingFile(&value)) {
+    // Only the store takes the value.  |value_| may hold a value that Set()
+    // is about to write, which must win over the legacy one.
+    GetStore()->Set(index_, value);
+  } else if (access(backing_file_name_.c_str(), F_OK) < 0) {
+    return;
+  }
+  // The store now owns the value.  Don't import a stale one if the store is
+  // ever lost.
+  if (unlink(backing_file_name_.c_str()) < 0)
+    PLOG(WARNING) << "cannot remove " << backing_file_name_;
+}
+
+bool PersistentInteger::ReadBackingFile(int64_t* value) {
   int fd = HANDLE_EINTR(open(backing_file_name_.c_str(), O_RDONLY));
-  if (fd < 0) {
-    PLOG(WARNING) << "cannot open " << backing_file_name_ << " for reading";
+  if (fd < 0)
     return false;
-  }
   int32_t version;
-  int64_t value;
-  bool read_succeeded = false;
-  if (HANDLE_EINTR(read(fd, &version, sizeof(version))) == sizeof(version) &&
+  bool read_succeeded =
+      HANDLE_EINTR(read(fd, &version, sizeof(version))) == sizeof(version) &&
       version == version_ &&
-      HANDLE_EINTR(read(fd, &value, sizeof(value))) == sizeof(value)) {
-    value_ = value;
-    read_succeeded = true;
-    synced_ = true;
-  }
+      HANDLE_EINTR(read(fd, value, sizeof(*value))) == sizeof(*value);
+  if (!read_succeeded)
+    LOG(WARNING) << "ignoring invalid " << backing_file_name_;
   close(fd);
   return read_succeeded;
 }
 
+void PersistentInteger::WriteBackingFile() {
+  int fd = HANDLE_EINTR(open(backing_file_name_.c_str(),
+                             O_WRONLY | O_CREAT | O_TRUNC,
+                             S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH));
+  if (fd < 0) {
+    PLOG(ERROR) << "cannot open " << backing_file_name_ << " for writing";
+    return;
+  }
+  if (HANDLE_EINTR(write(fd, &version_, sizeof(version_))) !=
+          sizeof(version_) ||
+      HANDLE_EINTR(write(fd, &value_, sizeof(value_))) != sizeof(value_)) {
+    PLOG(ERROR) << "cannot write to " << backing_file_name_;
+  }
+  close(fd);
+}
+
+// static
+CounterStore* PersistentInteger::GetStore() {
+  if (!store_) {
+    std::string path = testing_ ? kTestingCounterStoreName :
+        std::string(kBackingFilesDirectory) + kCounterStoreName;
+    store_ = CounterStore::Open(path).release();
+    CHECK(store_) << "cannot open " << path;
+    store_generation_++;
+  }
+  return store_;
+}
+
 void PersistentInteger::SetTestingMode(bool testing) {
   testing_ = testing;
+  // Instances created from now on use the store of the new mode.
+  delete store_;
+  store_ = nullptr;
+}
+
+// static
+void PersistentInteger::Flush() {
+  if (store_)
+    store_->Flush();
+}
+
+// static
+void PersistentInteger::Sync() {
+  if (store_)
+    store_->Sync();
+}
+
+// static
+void PersistentInteger::ReclaimUnusedCounters() {
+  std::set<std::string> names;
+  if (names_)
+    names.insert(names_->begin(), names_->end());
+  int freed = GetStore()->Retain(names);
+  if (freed > 0)
+    LOG(INFO) << "freed " << freed << " unused counters";
+  // Integers kept in backing files retry the store.
+  store_generation_++;
 }
 
 
@@ -7,13 +7,20 @@
 
 #include <stdint.h>
 
+#include <set>
 #include <string>
 
 namespace chromeos_metrics {
 
-// PersistentIntegers is a named 64-bit integer value backed by a file.
-// The in-memory value acts as a write-through cache of the file value.
-// If the backing file doesn't exist or has bad content, the value is 0.
+class CounterStore;
+
+// PersistentIntegers is a named 64-bit integer value backed by a counter in a
+// CounterStore shared by all instances.  The in-memory value acts as a
+// write-through cache of the stored value.  If the counter doesn't exist or is
+// corrupted, the value is 0.  A counter that doesn't exist yet takes its value
+// from the per-integer backing file used by earlier versions, if any.  An
+// integer that doesn't fit the store, because it is full or because the name
+// is too long, keeps using that backing file instead.
 
 class PersistentInteger {
  public:
@@ -43,23 +50,62 @@ class PersistentInteger {
   // directory for the backing files.
   static void SetTestingMode(bool testing);
 
+  // Starts writing the values of all instances back to storage, without
+  // waiting.  Values survive a crash of the process without it, but not a
+  // power loss.
+  static void Flush();
+
+  // Writes the values of all instances back to storage and waits for the
+  // writes to complete.  Meant for shutdown.
+  static void Sync();
+
+  // Frees the stored counters that no current instance is named after, making
+  // room for new ones.  The values of the freed counters are lost, so this
+  // must only be called once the process has created all the instances it
+  // uses.  Integers that didn't fit the store move into it if they fit now.
+  static void ReclaimUnusedCounters();
+
  private:
   static const int kVersion = 1001;
 
-  // Writes |value_| to the backing file, creating it if necessary.
+  // Writes |value_| to the store.
   void Write();
 
-  // Reads the value from the backing file, stores it in |value_|, and returns
-  // true if the backing file is valid.  Returns false otherwise, and creates
-  // a valid backing file as a side effect.
-  bool Read();
+  // Reads the value from the store and stores it in |value_|.
+  void Read();
+
+  // Returns the index of the counter in the store, adding it if necessary.
+  // Returns -1 if the store can't hold it.
+  int Index();
+
+  // Copies the value of the legacy backing file, if any, into the store, then
+  // removes the file.  Leaves |value_| alone; Read() picks the value up.
+  void ImportBackingFile();
+
+  // Reads the legacy backing file into |*value|.  Returns false if the file
+  // doesn't exist or is invalid.
+  bool ReadBackingFile(int64_t* value);
+
+  // Writes |value_| to the legacy backing file.
+  void WriteBackingFile();
+
+  // Returns the store shared by all instances, opening it if necessary.
+  static CounterStore* GetStore();
 
   int64_t value_;
   int32_t version_;
   std::string name_;
   std::string backing_file_name_;
   bool synced_;
+  int index_;
+  // Value of |store_generation_| when |index_| was looked up.
+  int generation_;
   static bool testing_;
+  static CounterStore* store_;
+  // Incremented whenever |store_| is replaced or counters are freed.
+  static int store_generation_;
+  // Names of the current instances, one entry per instance.
+  static std::multiset<std::string>* names_;
 };
 
 }  // namespace chromeos_metrics
@@ -4,6 +4,10 @@
 
 #include <gtest/gtest.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <base/compiler_specific.h>
 #include <base/files/file_enumerator.h>
 #include <base/files/file_util.h>
@@ -61,6 +65,92 @@ TEST_F(PersistentIntegerTest, BasicChecks) {
   EXPECT_EQ(0, pi->Get());
 }
 
+TEST_F(PersistentIntegerTest, ImportsBackingFile) {
+  // Backing file of earlier versions: a version number and the value.
+  const int32_t version = 1001;
+  const int64_t value = 42;
+  std::string contents(reinterpret_cast<const char*>(&version),
+                       sizeof(version));
+  contents.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(base::FilePath(kBackingFileName), contents.data(),
+                            contents.size()));
+
+  std::unique_ptr<PersistentInteger> pi(
+      new PersistentInteger(kBackingFileName));
+  EXPECT_EQ(42, pi->Get());
+  EXPECT_FALSE(base::PathExists(base::FilePath(kBackingFileName)));
+
+  pi->Add(1);
+  pi.reset(new PersistentInteger(kBackingFileName));
+  EXPECT_EQ(43, pi->Get());
+}
+
+TEST_F(PersistentIntegerTest, SetOverridesBackingFile) {
+  const int32_t version = 1001;
+  const int64_t value = 42;
+  std::string contents(reinterpret_cast<const char*>(&version),
+                       sizeof(version));
+  contents.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(base::FilePath(kBackingFileName), contents.data(),
+                            contents.size()));
+
+  // Setting a value before ever reading it must not be undone by the import.
+  std::unique_ptr<PersistentInteger> pi(
+      new PersistentInteger(kBackingFileName));
+  pi->Set(0);
+  EXPECT_EQ(0, pi->Get());
+  EXPECT_FALSE(base::PathExists(base::FilePath(kBackingFileName)));
+
+  pi.reset(new PersistentInteger(kBackingFileName));
+  EXPECT_EQ(0, pi->Get());
+}
+
+TEST_F(PersistentIntegerTest, ValuesSurviveStoreReopen) {
+  std::unique_ptr<PersistentInteger> pi(
+      new PersistentInteger(kBackingFileName));
+  pi->Set(7);
+  PersistentInteger::Flush();
+
+  // Drops the shared store, as a restart of the process would.
+  PersistentInteger::SetTestingMode(true);
+  pi.reset(new PersistentInteger(kBackingFileName));
+  EXPECT_EQ(7, pi->Get());
+}
+
+TEST_F(PersistentIntegerTest, FallsBackToBackingFileWhenStoreIsFull) {
+  std::vector<std::unique_ptr<PersistentInteger>> fillers;
+  for (int i = 0; i < 128; i++) {
+    fillers.emplace_back(
+        new PersistentInteger(std::to_string(i) + ".filler.pibakf"));
+    fillers.back()->Set(i);
+  }
+
+  std::unique_ptr<PersistentInteger> pi(
+      new PersistentInteger(kBackingFileName));
+  pi->Set(9);
+  EXPECT_TRUE(base::PathExists(base::FilePath(kBackingFileName)));
+  pi.reset(new PersistentInteger(kBackingFileName));
+  EXPECT_EQ(9, pi->Get());
+
+  // Once unused counters are freed, the integer moves into the store.
+  fillers.clear();
+  PersistentInteger::ReclaimUnusedCounters();
+  pi->Add(1);
+  EXPECT_FALSE(base::PathExists(base::FilePath(kBackingFileName)));
+  pi.reset(new PersistentInteger(kBackingFileName));
+  EXPECT_EQ(10, pi->Get());
+}
+
+TEST_F(PersistentIntegerTest, LongNameUsesBackingFile) {
+  const std::string name = std::string(200, 'x') + ".pibakf";
+  std::unique_ptr<PersistentInteger> pi(new PersistentInteger(name));
+  pi->Set(3);
+  pi.reset(new PersistentInteger(name));
+  EXPECT_EQ(3, pi->Get());
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,153 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metrics/proc_scanner.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+namespace chromeos_metrics {
+
+namespace {
+
+// Initial size of the read buffer; enough for /proc/meminfo and /proc/stat on
+// most systems.  /proc/vmstat may need one or two doublings.
+const size_t kInitialBufferSize = 4096;
+
+bool IsSeparator(char c) {
+  return c == ' ' || c == '\t';
+}
+
+}  // namespace
+
+ProcFileReader::ProcFileReader(const std::string& path)
+    : path_(path), buffer_(kInitialBufferSize) {}
+
+ProcFileReader::~ProcFileReader() {}
+
+bool ProcFileReader::Read(base::StringPiece* contents) {
+  base::ScopedFD fd(HANDLE_EINTR(open(path_.c_str(), O_RDONLY | O_CLOEXEC)));
+  if (!fd.is_valid()) {
+    PLOG(WARNING) << "cannot open " << path_;
+    return false;
+  }
+
+  // procfs files don't report a useful size, so read until EOF and grow the
+  // buffer when it fills up.  The buffer is kept for the next read.
+  size_t size = 0;
+  for (;;) {
+    if (size == buffer_.size())
+      buffer_.resize(buffer_.size() * 2);
+    ssize_t count = HANDLE_EINTR(
+        read(fd.get(), buffer_.data() + size, buffer_.size() - size));
+    if (count < 0) {
+      PLOG(WARNING) << "cannot read " << path_;
+      return false;
+    }
+    if (count == 0)
+      break;
+    size += count;
+  }
+  *contents = base::StringPiece(buffer_.data(), size);
+  return true;
+}
+
+ProcLineScanner::ProcLineScanner(base::StringPiece text)
+    : text_(text), next_line_(0), next_token_(0) {}
+
+bool ProcLineScanner::NextLine() {
+  while (next_line_ < text_.size()) {
+    size_t end = text_.find('\n', next_line_);
+    if (end == base::StringPiece::npos)
+      end = text_.size();
+    line_ = text_.substr(next_line_, end - next_line_);
+    next_line_ = end + 1;
+    next_token_ = 0;
+    if (!line_.empty())
+      return true;
+  }
+  line_ = base::StringPiece();
+  next_token_ = 0;
+  return false;
+}
+
+bool ProcLineScanner::NextToken(base::StringPiece* token) {
+  size_t start = next_token_;
+  while (start < line_.size() && IsSeparator(line_[start]))
+    start++;
+  if (start == line_.size())
+    return false;
+  size_t end = start;
+  while (end < line_.size() && !IsSeparator(line_[end]))
+    end++;
+  *token = line_.substr(start, end - start);
+  next_token_ = end;
+  return true;
+}
+
+bool ProcLineScanner::NextUint64(uint64_t* value) {
+  base::StringPiece token;
+  if (!NextToken(&token))
+    return false;
+  uint64_t result = 0;
+  for (char c : token) {
+    if (c < '0' || c > '9')
+      return false;
+    uint64_t digit = c - '0';
+    if (result > (UINT64_MAX - digit) / 10)
+      return false;
+    result = result * 10 + digit;
+  }
+  *value = result;
+  return true;
+}
+
+size_t ScanProcFields(base::StringPiece text,
+                      ProcField* fields,
+                      size_t num_fields) {
+  for (size_t i = 0; i < num_fields; i++)
+    fields[i].found = false;
+
+  ProcLineScanner scanner(text);
+  size_t num_found = 0;
+  size_t expected = 0;
+  while (num_found < num_fields && scanner.NextLine()) {
+    base::StringPiece name;
+    if (!scanner.NextToken(&name))
+      continue;
+    if (name.ends_with(":"))
+      name.remove_suffix(1);
+
+    // Try the field following the last match first, so that tables in file
+    // order cost one comparison per line.
+    size_t match = num_fields;
+    for (size_t n = 0; n < num_fields; n++) {
+      size_t i = (expected + n) % num_fields;
+      if (!fields[i].found &&
+          strncmp(fields[i].name, name.data(), name.size()) == 0 &&
+          fields[i].name[name.size()] == '\0') {
+        match = i;
+        break;
+      }
+    }
+    if (match == num_fields)
+      continue;
+
+    if (!scanner.NextUint64(&fields[match].value)) {
+      LOG(WARNING) << "cannot parse value of " << fields[match].name;
+      return 0;
+    }
+    fields[match].found = true;
+    num_found++;
+    expected = match + 1;
+  }
+  return num_found;
+}
+
+}  // namespace chromeos_metrics
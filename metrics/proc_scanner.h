@@ -0,0 +1,84 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef METRICS_PROC_SCANNER_H_
+#define METRICS_PROC_SCANNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/strings/string_piece.h>
+
+namespace chromeos_metrics {
+
+// Reads a procfs or sysfs file into a buffer that is reused across reads, so
+// that periodic collection doesn't allocate once the buffer has grown to fit
+// the file.
+class ProcFileReader {
+ public:
+  explicit ProcFileReader(const std::string& path);
+  ~ProcFileReader();
+
+  // Reads the whole file.  On success, points |contents| at the data, which
+  // stays valid until the next call to Read().
+  bool Read(base::StringPiece* contents);
+
+  const std::string& path() const { return path_; }
+
+ private:
+  const std::string path_;
+  std::vector<char> buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProcFileReader);
+};
+
+// Walks text line by line and token by token without copying it.  Tokens are
+// separated by spaces and tabs.
+class ProcLineScanner {
+ public:
+  explicit ProcLineScanner(base::StringPiece text);
+
+  // Moves to the next non-empty line.  Returns false at the end of the text.
+  bool NextLine();
+
+  // Stores the next token of the current line in |token|.  Returns false if
+  // the line has no more tokens.
+  bool NextToken(base::StringPiece* token);
+
+  // Parses the next token of the current line as a decimal number.
+  bool NextUint64(uint64_t* value);
+
+ private:
+  base::StringPiece text_;
+  size_t next_line_;
+  base::StringPiece line_;
+  size_t next_token_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProcLineScanner);
+};
+
+// Entry of a table of fields to extract from files made of "name value" lines,
+// such as /proc/meminfo ("MemTotal:  2000000 kB") or /proc/vmstat
+// ("pgmajfault 42").
+struct ProcField {
+  const char* name;  // field name, without the trailing colon if any
+  uint64_t value;    // parsed value
+  bool found;        // whether |name| was found
+};
+
+// Fills in the fields of |fields| found in |text|, and returns the number of
+// them that were found.  Tables listed in the order the file prints them are
+// matched with a single comparison per line.  Returns 0 if the value of a
+// matching line cannot be parsed.
+size_t ScanProcFields(base::StringPiece text,
+                      ProcField* fields,
+                      size_t num_fields);
+
+}  // namespace chromeos_metrics
+
+#endif  // METRICS_PROC_SCANNER_H_
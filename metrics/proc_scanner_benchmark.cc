@@ -0,0 +1,321 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmark for the /proc parsers used by metrics_daemon's periodic
+// collection.  Runs the parsers MetricsDaemon calls, and the string splitting
+// implementations they replaced for reference, over a representative snapshot
+// of each file, so results are comparable across devices.  Checks that both
+// give the same answers and reports the time each takes.
+//
+// Usage: proc_scanner_benchmark [--iterations=100000]
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <base/logging.h>
+#include <base/macros.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_split.h>
+#include <base/strings/string_util.h>
+#include <base/time/time.h>
+#include <brillo/flag_helper.h>
+
+#include "metrics/metrics_daemon.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// The implementations MetricsDaemon used before parsing with proc_scanner,
+// for reference.  They differ from the originals only in taking the contents
+// of the files instead of reading them.
+
+// Number of items on the first line of /proc/stat, as
+// MetricsDaemon::kMetricsProcStatFirstLineItemsCount.
+const size_t kProcStatFirstLineItemsCount = 11;
+
+bool ReferenceParseProcStat(const string& proc_stat_string,
+                            uint64_t* user_ticks,
+                            uint64_t* user_nice_ticks,
+                            uint64_t* system_ticks) {
+  vector<string> proc_stat_lines =
+      base::SplitString(proc_stat_string, "\n", base::KEEP_WHITESPACE,
+                        base::SPLIT_WANT_ALL);
+  if (proc_stat_lines.empty())
+    return false;
+  vector<string> proc_stat_totals =
+      base::SplitString(proc_stat_lines[0], base::kWhitespaceASCII,
+                        base::KEEP_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  return proc_stat_totals.size() == kProcStatFirstLineItemsCount &&
+         proc_stat_totals[0] == "cpu" &&
+         base::StringToUint64(proc_stat_totals[1], user_ticks) &&
+         base::StringToUint64(proc_stat_totals[2], user_nice_ticks) &&
+         base::StringToUint64(proc_stat_totals[3], system_ticks);
+}
+
+bool ReferenceDiskStatsParseStats(const string& stats,
+                                  uint64_t* read_sectors,
+                                  uint64_t* write_sectors) {
+  char line[200];
+  size_t nchars = std::min(stats.size(), sizeof(line) - 1);
+  memcpy(line, stats.data(), nchars);
+  line[nchars] = '\0';
+  int nitems = sscanf(line, "%*d %*d %" PRIu64 " %*d %*d %*d %" PRIu64,
+                      read_sectors, write_sectors);
+  return nitems == 2;
+}
+
+bool ReferenceVmStatsParseStats(const char* stats,
+                                MetricsDaemon::VmstatRecord* record) {
+  // a mapping of string name to field in VmstatRecord and whether we found it
+  struct mapping {
+    const string name;
+    uint64_t* value_p;
+    bool found;
+  } map[] =
+      { { .name = "pgmajfault",
+          .value_p = &record->page_faults_,
+          .found = false },
+        { .name = "pswpin",
+          .value_p = &record->swap_in_,
+          .found = false },
+        { .name = "pswpout",
+          .value_p = &record->swap_out_,
+          .found = false }, };
+
+  vector<string> lines = base::SplitString(stats, "\n", base::KEEP_WHITESPACE,
+                                           base::SPLIT_WANT_NONEMPTY);
+  for (vector<string>::iterator it = lines.begin();
+       it != lines.end(); ++it) {
+    vector<string> tokens = base::SplitString(*it, " ", base::KEEP_WHITESPACE,
+                                              base::SPLIT_WANT_ALL);
+    if (tokens.size() == 2) {
+      for (unsigned int i = 0; i < sizeof(map)/sizeof(struct mapping); i++) {
+        if (!tokens[0].compare(map[i].name)) {
+          if (!base::StringToUint64(tokens[1], map[i].value_p))
+            return false;
+          map[i].found = true;
+        }
+      }
+    }
+  }
+  for (unsigned i = 0; i < sizeof(map)/sizeof(struct mapping); i++) {
+    if (map[i].found == false)
+      return false;
+  }
+  return true;
+}
+
+// Used to copy the field table into a vector on every call, which |values|
+// stands for.
+bool ReferenceFillMeminfo(const string& meminfo_raw,
+                          const MetricsDaemon::MeminfoRecord* fields,
+                          size_t num_fields,
+                          vector<int>* values) {
+  vector<string> lines =
+      base::SplitString(meminfo_raw, "\n", base::KEEP_WHITESPACE,
+                        base::SPLIT_WANT_NONEMPTY);
+
+  size_t ifield = 0;
+  for (size_t iline = 0;
+       iline < lines.size() && ifield < num_fields;
+       iline++) {
+    vector<string> tokens =
+        base::SplitString(lines[iline], ": ", base::KEEP_WHITESPACE,
+                          base::SPLIT_WANT_NONEMPTY);
+    if (strcmp(fields[ifield].match, tokens[0].c_str()) == 0) {
+      char* rest;
+      (*values)[ifield] =
+          static_cast<int>(strtol(tokens[1].c_str(), &rest, 10));
+      if (*rest != '\0')
+        return false;
+      ifield++;
+    }
+  }
+  return ifield == num_fields;
+}
+
+const char kMeminfo[] =
+    "MemTotal:        3972884 kB\nMemFree:          206452 kB\n"
+    "MemAvailable:    2310252 kB\nBuffers:          156364 kB\n"
+    "Cached:          2119012 kB\nSwapCached:        24896 kB\n"
+    "Active:          2036884 kB\nInactive:        1247680 kB\n"
+    "Active(anon):     757716 kB\nInactive(anon):   482512 kB\n"
+    "Active(file):    1279168 kB\nInactive(file):   765168 kB\n"
+    "Unevictable:      104996 kB\nMlocked:               0 kB\n"
+    "SwapTotal:       5818980 kB\nSwapFree:        5715716 kB\n"
+    "Dirty:              456 kB\nWriteback:             0 kB\n"
+    "AnonPages:       1092364 kB\nMapped:           558840 kB\n"
+    "Shmem:           231712 kB\nSlab:             179124 kB\n"
+    "SReclaimable:    121576 kB\nSUnreclaim:        57548 kB\n"
+    "KernelStack:       9520 kB\nPageTables:        37464 kB\n"
+    "NFS_Unstable:          0 kB\nBounce:                0 kB\n"
+    "WritebackTmp:          0 kB\nCommitLimit:     7805420 kB\n"
+    "Committed_AS:   6281744 kB\nVmallocTotal:   34359738367 kB\n"
+    "VmallocUsed:           0 kB\nVmallocChunk:          0 kB\n"
+    "DirectMap4k:     150464 kB\nDirectMap2M:     3981312 kB\n";
+
+const char kVmstat[] =
+    "nr_free_pages 51613\nnr_alloc_batch 1214\nnr_inactive_anon 120628\n"
+    "nr_active_anon 189429\nnr_inactive_file 191292\n"
+    "nr_active_file 319792\nnr_unevictable 26249\nnr_mlock 0\n"
+    "nr_anon_pages 273091\nnr_mapped 139710\nnr_file_pages 579604\n"
+    "nr_dirty 114\nnr_writeback 0\nnr_slab_reclaimable 30394\n"
+    "nr_slab_unreclaimable 14387\nnr_page_table_pages 9366\n"
+    "nr_kernel_stack 595\nnr_unstable 0\nnr_bounce 0\n"
+    "pgpgin 12219132\npgpgout 7306536\npswpin 14541\npswpout 41427\n"
+    "pgalloc_dma 1\npgalloc_dma32 48230155\npgalloc_normal 0\n"
+    "pgfree 49119254\npgactivate 2563364\npgdeactivate 372613\n"
+    "pgfault 70838063\npgmajfault 92213\npgrefill_dma 0\n"
+    "pgrefill_dma32 529838\npgsteal_kswapd_dma32 1002116\n"
+    "pgscan_kswapd_dma32 1082541\nslabs_scanned 455936\n"
+    "kswapd_inodesteal 3338\npageoutrun 5310\nallocstall 186\n"
+    "pgrotated 31079\nthp_fault_alloc 0\nthp_split 0\n";
+
+const char kProcStat[] =
+    "cpu  1129741 10394 336591 15476483 29232 0 6213 0 0 0\n"
+    "cpu0 285213 2590 84862 3865627 7427 0 3915 0 0 0\n"
+    "cpu1 282087 2655 84122 3872008 7263 0 1045 0 0 0\n"
+    "intr 51838914 9 0 0 0 0 0 0 0 1 0 0 0 0 0 0 0\n"
+    "ctxt 119538393\nbtime 1462286133\nprocesses 102347\n";
+
+const char kDiskStats[] =
+    "  158425    46357  8706566   124376   109416   134735  6908472  "
+    "1174484        0   247436  1298796\n";
+
+// Runs |parse| |iterations| times and returns the time it took.  Adds the
+// values it returns to |checksum|.
+template <typename Parser>
+base::TimeDelta Run(int iterations, Parser parse, uint64_t* checksum) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < iterations; i++)
+    *checksum += parse();
+  return base::TimeTicks::Now() - start;
+}
+
+// Times |reference| and |current| and prints the results.  Returns false if
+// they don't give the same answers.
+template <typename Reference, typename Current>
+bool Compare(const char* name,
+             int iterations,
+             Reference reference,
+             Current current) {
+  uint64_t reference_checksum = 0;
+  uint64_t current_checksum = 0;
+  base::TimeDelta reference_time =
+      Run(iterations, reference, &reference_checksum);
+  base::TimeDelta current_time = Run(iterations, current, &current_checksum);
+  printf("%-10s reference %8.1f ns/parse, daemon %8.1f ns/parse\n", name,
+         reference_time.InMicrosecondsF() * 1000 / iterations,
+         current_time.InMicrosecondsF() * 1000 / iterations);
+  if (reference_checksum != current_checksum) {
+    printf("%-10s gave different results\n", name);
+    return false;
+  }
+  return true;
+}
+
+// Sums the values of parsed fields, or returns 0 if parsing failed, so that
+// checksums compare the results and not just the success.
+uint64_t Sum(bool success, const int* values, size_t num_values) {
+  uint64_t sum = 0;
+  for (size_t i = 0; success && i < num_values; i++)
+    sum += values[i];
+  return sum;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  DEFINE_int32(iterations, 100000, "number of times each parser runs");
+  brillo::FlagHelper::Init(argc, argv, "/proc parser microbenchmark");
+  CHECK_GT(FLAGS_iterations, 0);
+
+  // The reference implementations took the files as strings.
+  const string meminfo(kMeminfo);
+  const string vmstat(kVmstat);
+  const string proc_stat(kProcStat);
+  const string disk_stats(kDiskStats);
+  int mismatches = 0;
+
+  mismatches += !Compare("meminfo", FLAGS_iterations, [&meminfo] {
+    vector<int> values(MetricsDaemon::kNumMeminfoFields);
+    bool success = ReferenceFillMeminfo(meminfo, MetricsDaemon::kMeminfoFields,
+                                        MetricsDaemon::kNumMeminfoFields,
+                                        &values);
+    return Sum(success, values.data(), values.size());
+  }, [] {
+    int values[64];
+    CHECK_LE(MetricsDaemon::kNumMeminfoFields, arraysize(values));
+    bool success = MetricsDaemon::FillMeminfo(
+        kMeminfo, MetricsDaemon::kMeminfoFields,
+        MetricsDaemon::kNumMeminfoFields, values);
+    return Sum(success, values, MetricsDaemon::kNumMeminfoFields);
+  });
+
+  mismatches += !Compare("memuse", FLAGS_iterations, [&meminfo] {
+    vector<int> values(MetricsDaemon::kNumMemuseFields);
+    bool success = ReferenceFillMeminfo(meminfo, MetricsDaemon::kMemuseFields,
+                                        MetricsDaemon::kNumMemuseFields,
+                                        &values);
+    return Sum(success, values.data(), values.size());
+  }, [] {
+    int values[64];
+    CHECK_LE(MetricsDaemon::kNumMemuseFields, arraysize(values));
+    bool success = MetricsDaemon::FillMeminfo(
+        kMeminfo, MetricsDaemon::kMemuseFields,
+        MetricsDaemon::kNumMemuseFields, values);
+    return Sum(success, values, MetricsDaemon::kNumMemuseFields);
+  });
+
+  mismatches += !Compare("vmstat", FLAGS_iterations, [&vmstat] {
+    MetricsDaemon::VmstatRecord record;
+    if (!ReferenceVmStatsParseStats(vmstat.c_str(), &record))
+      return uint64_t{0};
+    return record.page_faults_ + record.swap_in_ + record.swap_out_;
+  }, [] {
+    MetricsDaemon::VmstatRecord record;
+    if (!MetricsDaemon::VmStatsParseStats(kVmstat, &record))
+      return uint64_t{0};
+    return record.page_faults_ + record.swap_in_ + record.swap_out_;
+  });
+
+  mismatches += !Compare("stat", FLAGS_iterations, [&proc_stat] {
+    uint64_t user = 0, nice = 0, system = 0;
+    if (!ReferenceParseProcStat(proc_stat, &user, &nice, &system))
+      return uint64_t{0};
+    return user + nice + system;
+  }, [] {
+    uint64_t user = 0, nice = 0, system = 0;
+    if (!MetricsDaemon::ParseProcStat(kProcStat, &user, &nice, &system))
+      return uint64_t{0};
+    return user + nice + system;
+  });
+
+  mismatches += !Compare("diskstats", FLAGS_iterations, [&disk_stats] {
+    uint64_t read_sectors = 0, write_sectors = 0;
+    if (!ReferenceDiskStatsParseStats(disk_stats, &read_sectors,
+                                      &write_sectors)) {
+      return uint64_t{0};
+    }
+    return read_sectors + write_sectors;
+  }, [] {
+    uint64_t read_sectors = 0, write_sectors = 0;
+    if (!MetricsDaemon::DiskStatsParseStats(kDiskStats, &read_sectors,
+                                            &write_sectors)) {
+      return uint64_t{0};
+    }
+    return read_sectors + write_sectors;
+  });
+
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+
+#include <string>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/macros.h>
+#include <gtest/gtest.h>
+
+#include "metrics/proc_scanner.h"
+
+namespace chromeos_metrics {
+
+namespace {
+
+const char kMeminfo[] =
+    "MemTotal:        2000000 kB\n"
+    "MemFree:          500000 kB\n"
+    "Buffers:         1000000 kB\n"
+    "Active(anon):      92984 kB\n"
+    "\n"
+    "Inactive(anon):    58860 kB\n";
+
+}  // namespace
+
+TEST(ProcScannerTest, LinesAndTokens) {
+  ProcLineScanner scanner("cpu  10 20\tabc\n\nintr 5\n");
+  base::StringPiece token;
+  uint64_t value;
+
+  ASSERT_TRUE(scanner.NextLine());
+  ASSERT_TRUE(scanner.NextToken(&token));
+  EXPECT_EQ("cpu", token);
+  ASSERT_TRUE(scanner.NextUint64(&value));
+  EXPECT_EQ(10, value);
+  ASSERT_TRUE(scanner.NextUint64(&value));
+  EXPECT_EQ(20, value);
+  EXPECT_FALSE(scanner.NextUint64(&value));
+  EXPECT_FALSE(scanner.NextToken(&token));
+
+  // Empty lines are skipped.
+  ASSERT_TRUE(scanner.NextLine());
+  ASSERT_TRUE(scanner.NextToken(&token));
+  EXPECT_EQ("intr", token);
+  EXPECT_FALSE(scanner.NextLine());
+}
+
+TEST(ProcScannerTest, Uint64Overflow) {
+  ProcLineScanner scanner("18446744073709551615 18446744073709551616");
+  uint64_t value;
+  ASSERT_TRUE(scanner.NextLine());
+  ASSERT_TRUE(scanner.NextUint64(&value));
+  EXPECT_EQ(UINT64_MAX, value);
+  EXPECT_FALSE(scanner.NextUint64(&value));
+}
+
+TEST(ProcScannerTest, FieldsInAnyOrder) {
+  ProcField fields[] = {
+    { "MemTotal" },
+    { "Inactive(anon)" },
+    { "MemFree" },
+  };
+  EXPECT_EQ(arraysize(fields),
+            ScanProcFields(kMeminfo, fields, arraysize(fields)));
+  EXPECT_EQ(2000000, fields[0].value);
+  EXPECT_EQ(58860, fields[1].value);
+  EXPECT_EQ(500000, fields[2].value);
+}
+
+TEST(ProcScannerTest, MissingAndPrefixFields) {
+  // Names must match exactly, not as a prefix.
+  ProcField fields[] = {
+    { "Mem" },
+    { "Buffers" },
+    { "SwapTotal" },
+  };
+  EXPECT_EQ(size_t(1), ScanProcFields(kMeminfo, fields, arraysize(fields)));
+  EXPECT_FALSE(fields[0].found);
+  EXPECT_TRUE(fields[1].found);
+  EXPECT_EQ(1000000, fields[1].value);
+  EXPECT_FALSE(fields[2].found);
+}
+
+TEST(ProcScannerTest, BadValue) {
+  ProcField fields[] = {
+    { "pgmajfault" },
+  };
+  EXPECT_EQ(size_t(0),
+            ScanProcFields("pgmajfault lots\n", fields, arraysize(fields)));
+}
+
+TEST(ProcScannerTest, ReadReusesBuffer) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.path().Append("stat");
+
+  // Larger than the initial buffer, to exercise growing it.
+  std::string contents(10000, 'x');
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(path, contents.data(), contents.size()));
+
+  ProcFileReader reader(path.value());
+  base::StringPiece read;
+  ASSERT_TRUE(reader.Read(&read));
+  EXPECT_EQ(contents, read);
+
+  ASSERT_EQ(2, base::WriteFile(path, "42", 2));
+  ASSERT_TRUE(reader.Read(&read));
+  EXPECT_EQ("42", read);
+
+  ASSERT_TRUE(base::DeleteFile(path, false));
+  EXPECT_FALSE(reader.Read(&read));
+}
+
+}  // namespace chromeos_metrics
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -14,18 +14,54 @@
 
 namespace metrics {
 
+const int MetricSample::kMaxNumSamples;
+
+namespace {
+
+// Returns the suffix appended to serialized histogram samples that stand for
+// more than one recording.  Samples recorded once keep the original format.
+std::string NumSamplesSuffix(int num_samples) {
+  if (num_samples == 1)
+    return std::string();
+  return base::StringPrintf(" %d", num_samples);
+}
+
+// Splits a serialized histogram into its space separated fields.  If there
+// is one more field than |num_fields|, it is taken to be the number of
+// samples and removed.  Returns false if the fields don't match that layout.
+bool SplitHistogramFields(const std::string& serialized,
+                          size_t num_fields,
+                          std::vector<std::string>* parts,
+                          int* num_samples) {
+  *parts = base::SplitString(serialized, " ", base::KEEP_WHITESPACE,
+                             base::SPLIT_WANT_ALL);
+  *num_samples = 1;
+  if (parts->size() == num_fields + 1) {
+    if (!base::StringToInt(parts->back(), num_samples) || *num_samples < 1 ||
+        *num_samples > MetricSample::kMaxNumSamples) {
+      return false;
+    }
+    parts->pop_back();
+  }
+  return parts->size() == num_fields;
+}
+
+}  // namespace
+
 MetricSample::MetricSample(MetricSample::SampleType sample_type,
                            const std::string& metric_name,
                            int sample,
                            int min,
                            int max,
-                           int bucket_count)
+                           int bucket_count,
+                           int num_samples)
     : type_(sample_type),
       name_(metric_name),
       sample_(sample),
       min_(min),
       max_(max),
-      bucket_count_(bucket_count) {
+      bucket_count_(bucket_count),
+      num_samples_(num_samples) {
 }
 
 MetricSample::~MetricSample() {
@@ -43,26 +79,29 @@ std::string MetricSample::ToString() const {
                               name().c_str(),
                               '\0');
   } else if (type_ == SPARSE_HISTOGRAM) {
-    return base::StringPrintf("sparsehistogram%c%s %d%c",
+    return base::StringPrintf("sparsehistogram%c%s %d%s%c",
                               '\0',
                               name().c_str(),
                               sample_,
+                              NumSamplesSuffix(num_samples_).c_str(),
                               '\0');
   } else if (type_ == LINEAR_HISTOGRAM) {
-    return base::StringPrintf("linearhistogram%c%s %d %d%c",
+    return base::StringPrintf("linearhistogram%c%s %d %d%s%c",
                               '\0',
                               name().c_str(),
                               sample_,
                               max_,
+                              NumSamplesSuffix(num_samples_).c_str(),
                               '\0');
   } else if (type_ == HISTOGRAM) {
-    return base::StringPrintf("histogram%c%s %d %d %d %d%c",
+    return base::StringPrintf("histogram%c%s %d %d %d %d%s%c",
                               '\0',
                               name().c_str(),
                               sample_,
                               min_,
                               max_,
                               bucket_count_,
+                              NumSamplesSuffix(num_samples_).c_str(),
                               '\0');
   } else {
     // The type can only be USER_ACTION.
@@ -101,7 +140,7 @@ int MetricSample::bucket_count() const {
 std::unique_ptr<MetricSample> MetricSample::CrashSample(
     const std::string& crash_name) {
   return std::unique_ptr<MetricSample>(
-      new MetricSample(CRASH, crash_name, 0, 0, 0, 0));
+      new MetricSample(CRASH, crash_name, 0, 0, 0, 0, 1));
 }
 
 // static
@@ -112,17 +151,15 @@ std::unique_ptr<MetricSample> MetricSample::HistogramSample(
     int max,
     int bucket_count) {
   return std::unique_ptr<MetricSample>(new MetricSample(
-      HISTOGRAM, histogram_name, sample, min, max, bucket_count));
+      HISTOGRAM, histogram_name, sample, min, max, bucket_count, 1));
 }
 
 // static
 std::unique_ptr<MetricSample> MetricSample::ParseHistogram(
     const std::string& serialized_histogram) {
-  std::vector<std::string> parts =
-      base::SplitString(serialized_histogram, " ", base::KEEP_WHITESPACE,
-                        base::SPLIT_WANT_ALL);
-
-  if (parts.size() != 5)
+  std::vector<std::string> parts;
+  int num_samples;
+  if (!SplitHistogramFields(serialized_histogram, 5, &parts, &num_samples))
     return std::unique_ptr<MetricSample>();
   int sample, min, max, bucket_count;
   if (parts[0].empty() || !base::StringToInt(parts[1], &sample) ||
@@ -132,7 +169,8 @@ std::unique_ptr<MetricSample> MetricSample::ParseHistogram(
     return std::unique_ptr<MetricSample>();
   }
 
-  return HistogramSample(parts[0], sample, min, max, bucket_count);
+  return std::unique_ptr<MetricSample>(new MetricSample(
+      HISTOGRAM, parts[0], sample, min, max, bucket_count, num_samples));
 }
 
 // static
@@ -140,22 +178,22 @@ std::unique_ptr<MetricSample> MetricSample::SparseHistogramSample(
     const std::string& histogram_name,
     int sample) {
   return std::unique_ptr<MetricSample>(
-      new MetricSample(SPARSE_HISTOGRAM, histogram_name, sample, 0, 0, 0));
+      new MetricSample(SPARSE_HISTOGRAM, histogram_name, sample, 0, 0, 0, 1));
 }
 
 // static
 std::unique_ptr<MetricSample> MetricSample::ParseSparseHistogram(
     const std::string& serialized_histogram) {
-  std::vector<std::string> parts =
-      base::SplitString(serialized_histogram, " ", base::KEEP_WHITESPACE,
-                        base::SPLIT_WANT_ALL);
-  if (parts.size() != 2)
+  std::vector<std::string> parts;
+  int num_samples;
+  if (!SplitHistogramFields(serialized_histogram, 2, &parts, &num_samples))
     return std::unique_ptr<MetricSample>();
   int sample;
   if (parts[0].empty() || !base::StringToInt(parts[1], &sample))
     return std::unique_ptr<MetricSample>();
 
-  return SparseHistogramSample(parts[0], sample);
+  return std::unique_ptr<MetricSample>(new MetricSample(
+      SPARSE_HISTOGRAM, parts[0], sample, 0, 0, 0, num_samples));
 }
 
 // static
@@ -164,37 +202,51 @@ std::unique_ptr<MetricSample> MetricSample::LinearHistogramSample(
     int sample,
     int max) {
   return std::unique_ptr<MetricSample>(
-      new MetricSample(LINEAR_HISTOGRAM, histogram_name, sample, 0, max, 0));
+      new MetricSample(LINEAR_HISTOGRAM, histogram_name, sample, 0, max, 0, 1));
 }
 
 // static
 std::unique_ptr<MetricSample> MetricSample::ParseLinearHistogram(
     const std::string& serialized_histogram) {
   int sample, max;
-  std::vector<std::string> parts =
-      base::SplitString(serialized_histogram, " ", base::KEEP_WHITESPACE,
-                        base::SPLIT_WANT_ALL);
-  if (parts.size() != 3)
+  std::vector<std::string> parts;
+  int num_samples;
+  if (!SplitHistogramFields(serialized_histogram, 3, &parts, &num_samples))
     return std::unique_ptr<MetricSample>();
   if (parts[0].empty() || !base::StringToInt(parts[1], &sample) ||
       !base::StringToInt(parts[2], &max)) {
     return std::unique_ptr<MetricSample>();
   }
 
-  return LinearHistogramSample(parts[0], sample, max);
+  return std::unique_ptr<MetricSample>(new MetricSample(
+      LINEAR_HISTOGRAM, parts[0], sample, 0, max, 0, num_samples));
+}
+
+// static
+std::unique_ptr<MetricSample> MetricSample::RepeatedSample(
+    const MetricSample& sample,
+    int num_samples) {
+  CHECK_NE(sample.type_, CRASH);
+  CHECK_NE(sample.type_, USER_ACTION);
+  CHECK_GT(num_samples, 0);
+  CHECK_LE(num_samples, kMaxNumSamples);
+  return std::unique_ptr<MetricSample>(new MetricSample(
+      sample.type_, sample.name_, sample.sample_, sample.min_, sample.max_,
+      sample.bucket_count_, num_samples));
 }
 
 // static
 std::unique_ptr<MetricSample> MetricSample::UserActionSample(
     const std::string& action_name) {
   return std::unique_ptr<MetricSample>(
-      new MetricSample(USER_ACTION, action_name, 0, 0, 0, 0));
+      new MetricSample(USER_ACTION, action_name, 0, 0, 0, 0, 1));
 }
 
 bool MetricSample::IsEqual(const MetricSample& metric) {
   return type_ == metric.type_ && name_ == metric.name_ &&
          sample_ == metric.sample_ && min_ == metric.min_ &&
-         max_ == metric.max_ && bucket_count_ == metric.bucket_count_;
+         max_ == metric.max_ && bucket_count_ == metric.bucket_count_ &&
+         num_samples_ == metric.num_samples_;
 }
 
 }  // namespace metrics
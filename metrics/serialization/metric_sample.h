@@ -27,6 +27,11 @@ class MetricSample {
     USER_ACTION
   };
 
+  // Largest number of recordings a single sample may stand for.  Clients
+  // aggregating more recordings of a value must send it as several samples,
+  // and larger counts are rejected when parsing.
+  static const int kMaxNumSamples = 1000;
+
   ~MetricSample();
 
   // Returns true if the sample is valid (can be serialized without ambiguity).
@@ -48,6 +53,10 @@ class MetricSample {
   int max() const;
   int bucket_count() const;
 
+  // Returns the number of times the sample value was recorded.  Only
+  // histogram samples aggregated by the client can have more than one.
+  int num_samples() const { return num_samples_; }
+
   // Returns a serialized version of the sample.
   //
   // The serialized message for each type is:
@@ -56,6 +65,9 @@ class MetricSample {
   // histogram: histogram\0|name_| |sample_| |min_| |max_| |bucket_count_|\0
   // sparsehistogram: sparsehistogram\0|name_| |sample_|\0
   // linearhistogram: linearhistogram\0|name_| |sample_| |max_|\0
+  //
+  // Histogram samples with |num_samples_| other than 1 have it appended as an
+  // extra field, e.g. sparsehistogram\0|name_| |sample_| |num_samples_|\0.
   std::string ToString() const;
 
   // Builds a crash sample.
@@ -90,12 +102,18 @@ class MetricSample {
   static std::unique_ptr<MetricSample> ParseLinearHistogram(
       const std::string& serialized);
 
+  // Builds a histogram, sparse or linear histogram sample identical to
+  // |sample| except that it stands for |num_samples| recordings of its value.
+  static std::unique_ptr<MetricSample> RepeatedSample(
+      const MetricSample& sample,
+      int num_samples);
+
   // Builds a user action sample.
   static std::unique_ptr<MetricSample> UserActionSample(
       const std::string& action_name);
 
   // Returns true if sample and this object represent the same sample (type,
-  // name, sample, min, max, bucket_count match).
+  // name, sample, min, max, bucket_count, num_samples match).
   bool IsEqual(const MetricSample& sample);
 
  private:
@@ -104,7 +122,8 @@ class MetricSample {
                const int sample,
                const int min,
                const int max,
-               const int bucket_count);
+               const int bucket_count,
+               const int num_samples);
 
   const SampleType type_;
   const std::string name_;
@@ -112,6 +131,7 @@ class MetricSample {
   const int min_;
   const int max_;
   const int bucket_count_;
+  const int num_samples_;
 
   DISALLOW_COPY_AND_ASSIGN(MetricSample);
 };
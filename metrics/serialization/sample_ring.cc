@@ -0,0 +1,286 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metrics/serialization/sample_ring.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "base/files/scoped_file.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "metrics/serialization/serialization_utils.h"
+
+#define READ_WRITE_ALL_FILE_FLAGS \
+  (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
+
+// The ring is shared between processes, so its atomics must not rely on a
+// process-local lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "64-bit atomics must be lock-free for the shared sample ring");
+
+namespace metrics {
+
+namespace {
+
+const uint32_t kRingMagic = 0x6d726e67;  // "mrng"
+const uint32_t kRingVersion = 1;
+
+// Largest message a slot can hold.  Matches the limit on the body of a record
+// in the uma-events file, which also counts the 4-byte length prefix.
+const size_t kSlotDataSize =
+    SerializationUtils::kMessageMaxLength - sizeof(int32_t);
+
+// Time a slot may stay claimed but unwritten before the consumer assumes its
+// producer died and skips it.  A live producer fills its slot right after
+// claiming it, so this only needs to cover producers that are descheduled or
+// stopped for a while in between.
+const int kStalledSlotSeconds = 60;
+
+// Number of consecutive drains that span kStalledSlotSeconds.  Uploads drain
+// the ring too, which can only make the reclaim happen a little sooner.
+const int kMaxStalledDrains =
+    kStalledSlotSeconds / SampleRing::kDrainIntervalSeconds;
+
+}  // namespace
+
+// Slots and positions follow the bounded queue design by Dmitry Vyukov: a
+// slot whose |sequence| equals the enqueue position is free for writing, and
+// one whose |sequence| is one past the dequeue position holds a message.
+struct SampleRing::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t reserved;
+  // Kept on separate cache lines so producers and the consumer don't contend.
+  alignas(64) std::atomic<uint64_t> enqueue_position;
+  alignas(64) std::atomic<uint64_t> dequeue_position;
+};
+
+struct SampleRing::Slot {
+  std::atomic<uint64_t> sequence;
+  uint32_t length;
+  char data[kSlotDataSize];
+};
+
+SampleRing::SampleRing(void* mapping, size_t mapping_size, uint32_t slot_count)
+    : mapping_(mapping),
+      mapping_size_(mapping_size),
+      header_(static_cast<Header*>(mapping)),
+      slot_count_(slot_count),
+      slot_mask_(slot_count - 1),
+      stalled_position_(0),
+      stalled_drains_(0) {}
+
+SampleRing::~SampleRing() {
+  munmap(mapping_, mapping_size_);
+}
+
+// static
+size_t SampleRing::MappingSize(uint32_t slot_count) {
+  return sizeof(Header) + static_cast<size_t>(slot_count) * sizeof(Slot);
+}
+
+// static
+uint32_t SampleRing::GetValidSlotCount(const void* mapping,
+                                       size_t mapping_size) {
+  if (mapping_size < sizeof(Header))
+    return 0;
+  // Derive the count from the size of the mapping, which can't change under
+  // us, rather than trusting the header.
+  size_t slot_count = (mapping_size - sizeof(Header)) / sizeof(Slot);
+  const Header* header = static_cast<const Header*>(mapping);
+  if (header->magic != kRingMagic || header->version != kRingVersion ||
+      slot_count == 0 || slot_count > UINT32_MAX ||
+      (slot_count & (slot_count - 1)) != 0 ||
+      MappingSize(slot_count) != mapping_size ||
+      header->slot_count != slot_count) {
+    return 0;
+  }
+  return slot_count;
+}
+
+// static
+std::unique_ptr<SampleRing> SampleRing::Open(const std::string& path) {
+  base::ScopedFD fd(open(path.c_str(), O_RDWR | O_CLOEXEC | O_NOFOLLOW));
+  if (!fd.is_valid())
+    return std::unique_ptr<SampleRing>();
+
+  // Create() holds an exclusive lock while (re)initializing the ring.
+  if (HANDLE_EINTR(flock(fd.get(), LOCK_SH)) < 0) {
+    DPLOG(ERROR) << path << ": cannot lock";
+    return std::unique_ptr<SampleRing>();
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd.get(), &stat_buf) < 0 ||
+      stat_buf.st_size < static_cast<off_t>(sizeof(Header))) {
+    return std::unique_ptr<SampleRing>();
+  }
+
+  size_t size = stat_buf.st_size;
+  void* mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    DPLOG(ERROR) << path << ": cannot map";
+    return std::unique_ptr<SampleRing>();
+  }
+  // The mapping keeps the open file description, and with it the lock, alive
+  // past close(), so drop the lock explicitly.
+  flock(fd.get(), LOCK_UN);
+  uint32_t slot_count = GetValidSlotCount(mapping, size);
+  if (slot_count == 0) {
+    DLOG(ERROR) << path << ": invalid sample ring";
+    munmap(mapping, size);
+    return std::unique_ptr<SampleRing>();
+  }
+  return std::unique_ptr<SampleRing>(
+      new SampleRing(mapping, size, slot_count));
+}
+
+// static
+std::unique_ptr<SampleRing> SampleRing::Create(const std::string& path,
+                                               uint32_t slot_count) {
+  uint32_t rounded_count = 1;
+  while (rounded_count < slot_count)
+    rounded_count <<= 1;
+  size_t size = MappingSize(rounded_count);
+
+  base::ScopedFD fd(open(path.c_str(),
+                         O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW,
+                         READ_WRITE_ALL_FILE_FLAGS));
+  if (!fd.is_valid()) {
+    DPLOG(ERROR) << path << ": cannot open";
+    return std::unique_ptr<SampleRing>();
+  }
+  fchmod(fd.get(), READ_WRITE_ALL_FILE_FLAGS);
+  if (HANDLE_EINTR(flock(fd.get(), LOCK_EX)) < 0) {
+    DPLOG(ERROR) << path << ": cannot lock";
+    return std::unique_ptr<SampleRing>();
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd.get(), &stat_buf) < 0) {
+    DPLOG(ERROR) << path << ": cannot stat";
+    return std::unique_ptr<SampleRing>();
+  }
+  bool reuse = static_cast<size_t>(stat_buf.st_size) == size;
+  if (!reuse && (ftruncate(fd.get(), 0) < 0 || ftruncate(fd.get(), size) < 0)) {
+    DPLOG(ERROR) << path << ": cannot resize";
+    return std::unique_ptr<SampleRing>();
+  }
+
+  void* mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    DPLOG(ERROR) << path << ": cannot map";
+    return std::unique_ptr<SampleRing>();
+  }
+
+  std::unique_ptr<SampleRing> ring(
+      new SampleRing(mapping, size, rounded_count));
+  if (!reuse || GetValidSlotCount(mapping, size) != rounded_count) {
+    memset(mapping, 0, size);
+    ring->header_->slot_count = rounded_count;
+    ring->header_->enqueue_position.store(0, std::memory_order_relaxed);
+    ring->header_->dequeue_position.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < rounded_count; i++)
+      ring->SlotAt(i)->sequence.store(i, std::memory_order_relaxed);
+    ring->header_->version = kRingVersion;
+    ring->header_->magic = kRingMagic;
+  }
+  // See Open(): the mapping would otherwise keep the lock held.
+  flock(fd.get(), LOCK_UN);
+  return ring;
+}
+
+SampleRing::Slot* SampleRing::SlotAt(uint64_t position) {
+  char* slots = static_cast<char*>(mapping_) + sizeof(Header);
+  uint64_t index = position & slot_mask_;
+  return reinterpret_cast<Slot*>(slots + index * sizeof(Slot));
+}
+
+bool SampleRing::Append(const std::string& message) {
+  if (message.size() > kSlotDataSize) {
+    DLOG(ERROR) << "cannot append message: too long";
+    return false;
+  }
+
+  Slot* slot;
+  uint64_t position =
+      header_->enqueue_position.load(std::memory_order_relaxed);
+  for (;;) {
+    slot = SlotAt(position);
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int64_t difference =
+        static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+    if (difference == 0) {
+      if (header_->enqueue_position.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The consumer hasn't caught up: the ring is full.
+      return false;
+    } else {
+      position = header_->enqueue_position.load(std::memory_order_relaxed);
+    }
+  }
+
+  memcpy(slot->data, message.data(), message.size());
+  slot->length = message.size();
+  // Fails only if the consumer gave up on this slot, see Drain().
+  return slot->sequence.compare_exchange_strong(position, position + 1,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed);
+}
+
+void SampleRing::Drain(std::vector<std::string>* messages) {
+  CHECK(messages);
+
+  uint64_t position =
+      header_->dequeue_position.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot* slot = SlotAt(position);
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence != position + 1) {
+      // Either the ring is empty or a producer has claimed this slot and not
+      // finished writing it yet.
+      bool claimed = sequence == position &&
+                     header_->enqueue_position.load(
+                         std::memory_order_relaxed) > position;
+      if (!claimed || position != stalled_position_) {
+        stalled_position_ = position;
+        stalled_drains_ = claimed ? 1 : 0;
+        break;
+      }
+      if (++stalled_drains_ < kMaxStalledDrains)
+        break;
+      // The slot has been claimed for about kStalledSlotSeconds, so the
+      // producer is gone.  Reclaim the slot unless it completed in the
+      // meantime.
+      if (!slot->sequence.compare_exchange_strong(
+              sequence, position + slot_count_,
+              std::memory_order_acq_rel)) {
+        continue;
+      }
+      LOG(WARNING) << "skipping sample abandoned by its producer";
+      stalled_drains_ = 0;
+    } else {
+      messages->emplace_back(slot->data,
+                             std::min<size_t>(slot->length, kSlotDataSize));
+      slot->sequence.store(position + slot_count_, std::memory_order_release);
+    }
+    position++;
+  }
+  header_->dequeue_position.store(position, std::memory_order_relaxed);
+}
+
+}  // namespace metrics
@@ -0,0 +1,94 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef METRICS_SERIALIZATION_SAMPLE_RING_H_
+#define METRICS_SERIALIZATION_SAMPLE_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace metrics {
+
+// A fixed-size ring of serialized metric samples living in a shared memory
+// mapping.  Any number of processes may append samples concurrently without
+// taking a lock; a single consumer (metrics_daemon) drains them.
+//
+// Each slot holds one message in the same format as the body of a record in
+// the uma-events file (see MetricSample::ToString()).  Producers are expected
+// to fall back to the uma-events file when the ring is missing or full.
+class SampleRing {
+ public:
+  // Number of slots used by the consumer when creating the ring.
+  static const uint32_t kDefaultSlotCount = 256;
+
+  // Interval at which the consumer drains the ring.  Short enough that the
+  // ring absorbs bursts of samples without producers falling back to the
+  // uma-events file.
+  static const int kDrainIntervalSeconds = 5;
+
+  ~SampleRing();
+
+  // Maps an existing ring at |path| for appending samples.  Returns nullptr if
+  // the ring does not exist or is not valid.
+  static std::unique_ptr<SampleRing> Open(const std::string& path);
+
+  // Maps the ring at |path| for draining samples, creating it with
+  // |slot_count| slots (rounded up to a power of two) if it does not exist or
+  // does not match.  An existing valid ring is reused so that producers that
+  // already mapped it keep working across consumer restarts.
+  static std::unique_ptr<SampleRing> Create(const std::string& path,
+                                            uint32_t slot_count);
+
+  // Appends |message| to the ring.  Returns false if the message does not fit
+  // in a slot or the ring is full.
+  bool Append(const std::string& message);
+
+  // Removes every fully written message from the ring, in order, and appends
+  // them to |messages|.
+  void Drain(std::vector<std::string>* messages);
+
+ private:
+  struct Header;
+  struct Slot;
+
+  SampleRing(void* mapping, size_t mapping_size, uint32_t slot_count);
+
+  // Returns the mapping size needed for a ring of |slot_count| slots.
+  static size_t MappingSize(uint32_t slot_count);
+
+  // Returns the number of slots of the ring in |mapping| of |mapping_size|
+  // bytes, or 0 if it does not hold a valid ring.
+  static uint32_t GetValidSlotCount(const void* mapping, size_t mapping_size);
+
+  Slot* SlotAt(uint64_t position);
+
+  void* mapping_;
+  size_t mapping_size_;
+  Header* header_;
+
+  // Number of slots, and the mask that maps a position to a slot index.  The
+  // header is writable by any process, so these are validated once when
+  // mapping the ring and never read from it again.
+  uint32_t slot_count_;
+  uint64_t slot_mask_;
+
+  // Position of the slot the last Drain() found claimed but not yet written,
+  // and the number of consecutive Drain() calls that found it so.  Only used
+  // by the consumer, to recover from producers that died in the middle of an
+  // Append().
+  uint64_t stalled_position_;
+  int stalled_drains_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleRing);
+};
+
+}  // namespace metrics
+
+#endif  // METRICS_SERIALIZATION_SAMPLE_RING_H_
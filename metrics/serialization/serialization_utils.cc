@@ -18,6 +18,7 @@
 #include "base/strings/string_split.h"
 #include "base/strings/string_util.h"
 #include "metrics/serialization/metric_sample.h"
+#include "metrics/serialization/sample_ring.h"
 
 #define READ_WRITE_ALL_FILE_FLAGS \
   (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
@@ -84,6 +85,22 @@ bool ReadMessage(int fd, std::string* message) {
   return true;
 }
 
+// Appends the length-prefixed serialized form of |message| to |buffer|.
+// Returns false if the message is too long.
+bool AppendMessage(const std::string& message, std::string* buffer) {
+  int32_t size = message.length() + sizeof(int32_t);
+  if (size > SerializationUtils::kMessageMaxLength) {
+    DLOG(ERROR) << "cannot write message: too long";
+    return false;
+  }
+
+  // The file containing the metrics samples will only be read by programs on
+  // the same device so we do not check endianness.
+  buffer->append(reinterpret_cast<char*>(&size), sizeof(size));
+  buffer->append(message);
+  return true;
+}
+
 }  // namespace
 
 std::unique_ptr<MetricSample> SerializationUtils::ParseSample(
@@ -174,6 +191,30 @@ void SerializationUtils::ReadAndTruncateMetricsFromFile(
     DPLOG(ERROR) << "unlock metrics log";
 }
 
+void SerializationUtils::ReadMetricsFromRing(
+    SampleRing* ring,
+    ScopedVector<MetricSample>* metrics) {
+  CHECK(ring);
+
+  std::vector<std::string> messages;
+  ring->Drain(&messages);
+  for (const std::string& message : messages) {
+    std::unique_ptr<MetricSample> sample = ParseSample(message);
+    if (sample)
+      metrics->push_back(sample.release());
+  }
+}
+
+bool SerializationUtils::WriteMetricToRing(const MetricSample& sample,
+                                           SampleRing* ring) {
+  CHECK(ring);
+
+  if (!sample.IsValid())
+    return false;
+
+  return ring->Append(sample.ToString());
+}
+
 bool SerializationUtils::WriteMetricToFile(const MetricSample& sample,
                                            const std::string& filename) {
   if (!sample.IsValid())
@@ -222,4 +263,51 @@ bool SerializationUtils::WriteMetricToFile(const MetricSample& sample,
   return true;
 }
 
+bool SerializationUtils::WriteMetricsToFile(
+    const ScopedVector<MetricSample>& samples,
+    const std::string& filename) {
+  bool success = true;
+  std::string buffer;
+  for (const MetricSample* sample : samples) {
+    if (!sample->IsValid()) {
+      success = false;
+      continue;
+    }
+    std::string message = sample->num_samples() == 1 ?
+        sample->ToString() :
+        MetricSample::RepeatedSample(*sample, 1)->ToString();
+    for (int i = 0; i < sample->num_samples(); i++) {
+      if (!AppendMessage(message, &buffer)) {
+        success = false;
+        break;
+      }
+    }
+  }
+  if (buffer.empty())
+    return success;
+
+  base::ScopedFD file_descriptor(open(filename.c_str(),
+                                      O_WRONLY | O_APPEND | O_CREAT,
+                                      READ_WRITE_ALL_FILE_FLAGS));
+  if (file_descriptor.get() < 0) {
+    DPLOG(ERROR) << filename << ": cannot open";
+    return false;
+  }
+
+  fchmod(file_descriptor.get(), READ_WRITE_ALL_FILE_FLAGS);
+  // See WriteMetricToFile().
+  if (HANDLE_EINTR(flock(file_descriptor.get(), LOCK_EX)) < 0) {
+    DPLOG(ERROR) << filename << ": cannot lock";
+    return false;
+  }
+
+  if (!base::WriteFileDescriptor(
+          file_descriptor.get(), buffer.data(), buffer.size())) {
+    DPLOG(ERROR) << "error writing messages";
+    return false;
+  }
+
+  return success;
+}
+
 }  // namespace metrics
@@ -13,6 +13,7 @@
 namespace metrics {
 
 class MetricSample;
+class SampleRing;
 
 // Metrics helpers to serialize and deserialize metrics collected by
 // ChromeOS.
@@ -27,6 +28,16 @@ std::unique_ptr<MetricSample> ParseSample(const std::string& sample);
 void ReadAndTruncateMetricsFromFile(const std::string& filename,
                                     ScopedVector<MetricSample>* metrics);
 
+// Removes all samples from the shared memory |ring| and appends them to
+// |metrics|.
+void ReadMetricsFromRing(SampleRing* ring,
+                         ScopedVector<MetricSample>* metrics);
+
+// Serializes a sample and appends it to the shared memory |ring|. Returns
+// false if the sample is invalid or the ring is full, in which case callers
+// should fall back to WriteMetricToFile().
+bool WriteMetricToRing(const MetricSample& sample, SampleRing* ring);
+
 // Serializes a sample and write it to filename.
 // The format for the message is:
 //  message_size, serialized_message
@@ -39,6 +50,14 @@ void ReadAndTruncateMetricsFromFile(const std::string& filename,
 //  with the architecture's endianness.
 bool WriteMetricToFile(const MetricSample& sample, const std::string& filename);
 
+// Serializes |samples| and appends them to filename with a single locked
+// write, in the same format as WriteMetricToFile().  A sample standing for
+// several recordings is written as that many single-sample messages, so that
+// readers which don't know about repeated samples (e.g. Chrome) can parse the
+// file.  Returns false if any sample could not be written.
+bool WriteMetricsToFile(const ScopedVector<MetricSample>& samples,
+                        const std::string& filename);
+
 // Maximum length of a serialized message
 static const int kMessageMaxLength = 1024;
 
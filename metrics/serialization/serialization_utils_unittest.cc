@@ -4,13 +4,18 @@
 
 #include "metrics/serialization/serialization_utils.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
 #include <base/files/scoped_temp_dir.h>
 #include <base/logging.h>
 #include <base/strings/stringprintf.h>
 #include <gtest/gtest.h>
 
 #include "metrics/serialization/metric_sample.h"
+#include "metrics/serialization/sample_ring.h"
 
 namespace metrics {
 namespace {
@@ -64,6 +69,38 @@ TEST_F(SerializationUtilsTest, UserActionSerializeTest) {
   TestSerialization(MetricSample::UserActionSample("myaction").get());
 }
 
+TEST_F(SerializationUtilsTest, RepeatedSerializeTest) {
+  TestSerialization(MetricSample::RepeatedSample(
+      *MetricSample::HistogramSample("myhist", 13, 1, 100, 10), 5).get());
+  TestSerialization(MetricSample::RepeatedSample(
+      *MetricSample::LinearHistogramSample("linearhist", 12, 30), 2).get());
+  TestSerialization(MetricSample::RepeatedSample(
+      *MetricSample::SparseHistogramSample("mysparse", 30), 1000).get());
+
+  // A single recording keeps the original format.
+  EXPECT_EQ(
+      MetricSample::SparseHistogramSample("mysparse", 30)->ToString(),
+      MetricSample::RepeatedSample(
+          *MetricSample::SparseHistogramSample("mysparse", 30), 1)->ToString());
+}
+
+TEST_F(SerializationUtilsTest, OversizedRepeatCountIsRejectedTest) {
+  std::unique_ptr<MetricSample> sample =
+      SerializationUtils::ParseSample(base::StringPrintf(
+          "sparsehistogram%cname 1 %d%c", '\0', MetricSample::kMaxNumSamples,
+          '\0'));
+  ASSERT_TRUE(sample.get());
+  EXPECT_EQ(MetricSample::kMaxNumSamples, sample->num_samples());
+
+  EXPECT_EQ(nullptr, SerializationUtils::ParseSample(base::StringPrintf(
+      "sparsehistogram%cname 1 %d%c", '\0', MetricSample::kMaxNumSamples + 1,
+      '\0')).get());
+  EXPECT_EQ(nullptr, SerializationUtils::ParseSample(base::StringPrintf(
+      "histogram%cname 1 0 10 5 2147483647%c", '\0', '\0')).get());
+  EXPECT_EQ(nullptr, SerializationUtils::ParseSample(base::StringPrintf(
+      "linearhistogram%cname 1 10 0%c", '\0', '\0')).get());
+}
+
 TEST_F(SerializationUtilsTest, IllegalNameAreFilteredTest) {
   std::unique_ptr<MetricSample> sample1 =
       MetricSample::SparseHistogramSample("no space", 10);
@@ -166,5 +203,128 @@ TEST_F(SerializationUtilsTest, WriteReadTest) {
   ASSERT_EQ(0, size);
 }
 
+TEST_F(SerializationUtilsTest, BatchWriteExpandsRepeatedSamplesTest) {
+  std::unique_ptr<MetricSample> crash = MetricSample::CrashSample("mycrash");
+  std::unique_ptr<MetricSample> sparse =
+      MetricSample::SparseHistogramSample("mysparse", 30);
+  ScopedVector<MetricSample> batch;
+  batch.push_back(MetricSample::CrashSample("mycrash").release());
+  batch.push_back(MetricSample::RepeatedSample(*sparse, 3).release());
+  EXPECT_TRUE(SerializationUtils::WriteMetricsToFile(batch, filename));
+
+  ScopedVector<MetricSample> vect;
+  SerializationUtils::ReadAndTruncateMetricsFromFile(filename, &vect);
+  ASSERT_EQ(size_t(4), vect.size());
+  EXPECT_TRUE(crash->IsEqual(*vect[0]));
+  for (int i = 1; i < 4; i++)
+    EXPECT_TRUE(sparse->IsEqual(*vect[i]));
+}
+
+TEST_F(SerializationUtilsTest, RingWriteReadTest) {
+  std::string ring_filename = filename + ".ring";
+  std::unique_ptr<SampleRing> consumer =
+      SampleRing::Create(ring_filename, SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(consumer.get());
+  std::unique_ptr<SampleRing> producer = SampleRing::Open(ring_filename);
+  ASSERT_TRUE(producer.get());
+
+  std::unique_ptr<MetricSample> hist =
+      MetricSample::HistogramSample("myhist", 1, 2, 3, 4);
+  std::unique_ptr<MetricSample> crash = MetricSample::CrashSample("mycrash");
+  std::unique_ptr<MetricSample> invalid =
+      MetricSample::SparseHistogramSample("no space", 10);
+
+  EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*hist, producer.get()));
+  EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*crash, producer.get()));
+  EXPECT_FALSE(
+      SerializationUtils::WriteMetricToRing(*invalid, producer.get()));
+
+  ScopedVector<MetricSample> vect;
+  SerializationUtils::ReadMetricsFromRing(consumer.get(), &vect);
+  ASSERT_EQ(size_t(2), vect.size());
+  EXPECT_TRUE(hist->IsEqual(*vect[0]));
+  EXPECT_TRUE(crash->IsEqual(*vect[1]));
+
+  vect.clear();
+  SerializationUtils::ReadMetricsFromRing(consumer.get(), &vect);
+  EXPECT_EQ(size_t(0), vect.size());
+}
+
+TEST_F(SerializationUtilsTest, RingFullTest) {
+  std::string ring_filename = filename + ".ring";
+  const uint32_t kSlots = 4;
+  std::unique_ptr<SampleRing> ring = SampleRing::Create(ring_filename, kSlots);
+  ASSERT_TRUE(ring.get());
+
+  std::unique_ptr<MetricSample> crash = MetricSample::CrashSample("mycrash");
+  for (uint32_t i = 0; i < kSlots; i++)
+    EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*crash, ring.get()));
+  EXPECT_FALSE(SerializationUtils::WriteMetricToRing(*crash, ring.get()));
+
+  ScopedVector<MetricSample> vect;
+  SerializationUtils::ReadMetricsFromRing(ring.get(), &vect);
+  EXPECT_EQ(size_t(kSlots), vect.size());
+
+  // Draining frees the slots again, and the ring wraps around.
+  for (uint32_t i = 0; i < kSlots; i++)
+    EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*crash, ring.get()));
+}
+
+TEST_F(SerializationUtilsTest, RingReusedAcrossCreateTest) {
+  std::string ring_filename = filename + ".ring";
+  std::unique_ptr<SampleRing> ring =
+      SampleRing::Create(ring_filename, SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(ring.get());
+  std::unique_ptr<MetricSample> crash = MetricSample::CrashSample("mycrash");
+  EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*crash, ring.get()));
+
+  // A restarted consumer picks up samples left in the existing ring.
+  std::unique_ptr<SampleRing> restarted =
+      SampleRing::Create(ring_filename, SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(restarted.get());
+  ScopedVector<MetricSample> vect;
+  SerializationUtils::ReadMetricsFromRing(restarted.get(), &vect);
+  ASSERT_EQ(size_t(1), vect.size());
+  EXPECT_TRUE(crash->IsEqual(*vect[0]));
+}
+
+TEST_F(SerializationUtilsTest, RingIgnoresChangedSlotCountTest) {
+  std::string ring_filename = filename + ".ring";
+  const uint32_t kSlots = 4;
+  std::unique_ptr<SampleRing> consumer =
+      SampleRing::Create(ring_filename, kSlots);
+  ASSERT_TRUE(consumer.get());
+  std::unique_ptr<SampleRing> producer = SampleRing::Open(ring_filename);
+  ASSERT_TRUE(producer.get());
+
+  // Any process can write to the ring, including its header.  The slot count
+  // follows the magic and version numbers.
+  base::ScopedFD fd(open(ring_filename.c_str(), O_RDWR));
+  ASSERT_TRUE(fd.is_valid());
+  const uint32_t kBogusSlots = 1 << 30;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(kBogusSlots)),
+            pwrite(fd.get(), &kBogusSlots, sizeof(kBogusSlots),
+                   2 * sizeof(uint32_t)));
+
+  // Both ends keep using the slot count they validated.
+  std::unique_ptr<MetricSample> crash = MetricSample::CrashSample("mycrash");
+  for (uint32_t i = 0; i < kSlots; i++)
+    EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*crash, producer.get()));
+  EXPECT_FALSE(SerializationUtils::WriteMetricToRing(*crash, producer.get()));
+
+  ScopedVector<MetricSample> vect;
+  SerializationUtils::ReadMetricsFromRing(consumer.get(), &vect);
+  EXPECT_EQ(size_t(kSlots), vect.size());
+  for (uint32_t i = 0; i < kSlots; i++)
+    EXPECT_TRUE(SerializationUtils::WriteMetricToRing(*crash, producer.get()));
+
+  // A ring whose header no longer matches its size isn't opened again.
+  EXPECT_EQ(nullptr, SampleRing::Open(ring_filename).get());
+}
+
+TEST_F(SerializationUtilsTest, RingMissingTest) {
+  EXPECT_EQ(nullptr, SampleRing::Open(filename + ".ring").get());
+}
+
 }  // namespace
 }  // namespace metrics
@@ -44,9 +44,17 @@ UploadService::UploadService(SystemProfileSetter* setter,
 }
 
 void UploadService::Init(const base::TimeDelta& upload_interval,
-                         const std::string& metrics_file) {
+                         const std::string& metrics_file,
+                         const std::string& metrics_ring_file) {
   base::StatisticsRecorder::Initialize();
   metrics_file_ = metrics_file;
+  if (!metrics_ring_file.empty()) {
+    metrics_ring_ = metrics::SampleRing::Create(
+        metrics_ring_file, metrics::SampleRing::kDefaultSlotCount);
+    if (!metrics_ring_)
+      LOG(WARNING) << "cannot create " << metrics_ring_file
+                   << ", reading samples from " << metrics_file << " only";
+  }
 
   if (!testing_) {
     base::MessageLoop::current()->PostDelayedTask(FROM_HERE,
@@ -54,6 +62,15 @@ void UploadService::Init(const base::TimeDelta& upload_interval,
                    base::Unretained(this),
                    upload_interval),
         upload_interval);
+    if (metrics_ring_) {
+      base::TimeDelta drain_interval = base::TimeDelta::FromSeconds(
+          metrics::SampleRing::kDrainIntervalSeconds);
+      base::MessageLoop::current()->PostDelayedTask(FROM_HERE,
+          base::Bind(&UploadService::DrainRingCallback,
+                     base::Unretained(this),
+                     drain_interval),
+          drain_interval);
+    }
   }
 }
 
@@ -75,6 +92,37 @@ void UploadService::UploadEventCallback(const base::TimeDelta& interval) {
       interval);
 }
 
+void UploadService::DrainRingCallback(const base::TimeDelta& interval) {
+  DrainRing();
+
+  base::MessageLoop::current()->PostDelayedTask(FROM_HERE,
+      base::Bind(&UploadService::DrainRingCallback,
+                 base::Unretained(this),
+                 interval),
+      interval);
+}
+
+void UploadService::DrainRing() {
+  if (!metrics_ring_)
+    return;
+
+  ScopedVector<metrics::MetricSample> vector;
+  metrics::SerializationUtils::ReadMetricsFromRing(metrics_ring_.get(),
+                                                   &vector);
+  for (size_t i = 0; i < vector.size(); i++) {
+    metrics::MetricSample::SampleType type = vector[i]->type();
+    bool in_log = type == metrics::MetricSample::CRASH ||
+                  type == metrics::MetricSample::USER_ACTION;
+    if (in_log && (staged_log_ || !deferred_samples_.empty())) {
+      // The current log can't be started until the staged one is gone.
+      deferred_samples_.push_back(vector[i]);
+      vector[i] = nullptr;
+    } else {
+      AddSample(*vector[i]);
+    }
+  }
+}
+
 void UploadService::UploadEvent() {
   if (staged_log_) {
     // Previous upload failed, retry sending the logs.
@@ -124,6 +172,7 @@ void UploadService::SendStagedLog() {
 void UploadService::Reset() {
   staged_log_.reset();
   current_log_.reset();
+  deferred_samples_.clear();
   failed_upload_count_ = 0;
 }
 
@@ -131,6 +180,14 @@ void UploadService::ReadMetrics() {
   CHECK(!staged_log_)
       << "cannot read metrics until the old logs have been discarded";
 
+  for (metrics::MetricSample* sample : deferred_samples_)
+    AddSample(*sample);
+  deferred_samples_.clear();
+
+  // Drain the ring first: samples only land in the file when the ring was
+  // full or unavailable, so this roughly preserves their order.
+  DrainRing();
+
   ScopedVector<metrics::MetricSample> vector;
   metrics::SerializationUtils::ReadAndTruncateMetricsFromFile(
       metrics_file_, &vector);
@@ -142,7 +199,14 @@ void UploadService::ReadMetrics() {
     AddSample(*sample);
     i++;
   }
-  DLOG(INFO) << i << " samples read";
+  DLOG(INFO) << i << " samples read from " << metrics_file_;
+}
+
+void UploadService::AddRepeatedSample(base::HistogramBase* counter,
+                                      const metrics::MetricSample& sample) {
+  // Samples aggregated by the client stand for several recordings.  Parsing
+  // bounds their number by MetricSample::kMaxNumSamples.
+  counter->AddCount(sample.sample(), sample.num_samples());
 }
 
 void UploadService::AddSample(const metrics::MetricSample& sample) {
@@ -156,13 +220,13 @@ void UploadService::AddSample(const metrics::MetricSample& sample) {
           sample.name(), sample.min(), sample.max(), sample.bucket_count(),
           base::Histogram::kUmaTargetedHistogramFlag);
       CHECK(counter) << "FactoryGet failed for " << sample.name();
-      counter->Add(sample.sample());
+      AddRepeatedSample(counter, sample);
       break;
     case metrics::MetricSample::SPARSE_HISTOGRAM:
       counter = base::SparseHistogram::FactoryGet(
           sample.name(), base::HistogramBase::kUmaTargetedHistogramFlag);
       CHECK(counter) << "FactoryGet failed for " << sample.name();
-      counter->Add(sample.sample());
+      AddRepeatedSample(counter, sample);
       break;
     case metrics::MetricSample::LINEAR_HISTOGRAM:
       counter = base::LinearHistogram::FactoryGet(
@@ -172,7 +236,7 @@ void UploadService::AddSample(const metrics::MetricSample& sample) {
           sample.max() + 1,
           base::Histogram::kUmaTargetedHistogramFlag);
       CHECK(counter) << "FactoryGet failed for " << sample.name();
-      counter->Add(sample.sample());
+      AddRepeatedSample(counter, sample);
       break;
     case metrics::MetricSample::USER_ACTION:
       GetOrCreateCurrentLog()->RecordUserAction(sample.name());
@@ -7,11 +7,13 @@
 
 #include <string>
 
+#include "base/memory/scoped_vector.h"
 #include "base/metrics/histogram_base.h"
 #include "base/metrics/histogram_flattener.h"
 #include "base/metrics/histogram_snapshot_manager.h"
 
 #include "metrics/metrics_library.h"
+#include "metrics/serialization/sample_ring.h"
 #include "metrics/uploader/metrics_log.h"
 #include "metrics/uploader/sender.h"
 #include "metrics/uploader/system_profile_cache.h"
@@ -54,14 +56,23 @@ class SystemProfileSetter;
 //    - if the upload fails, we keep the staged log in memory to retry
 //      uploading later.
 //
+// Independently of uploads, the shared memory ring is drained every
+// SampleRing::kDrainIntervalSeconds so that clients rarely find it full and
+// fall back to the file.  Histogram samples from the ring go straight into the
+// in-memory histograms; crashes and user actions, which are recorded in the
+// log itself, are held back while a staged log awaits a retry.
+//
 class UploadService : public base::HistogramFlattener {
  public:
   explicit UploadService(SystemProfileSetter* setter,
                          MetricsLibraryInterface* metrics_lib,
                          const std::string& server);
 
+  // Samples are read from |metrics_file| and, unless |metrics_ring_file| is
+  // empty, from a shared memory ring created at |metrics_ring_file|.
   void Init(const base::TimeDelta& upload_interval,
-            const std::string& metrics_file);
+            const std::string& metrics_file,
+            const std::string& metrics_ring_file);
 
   // Starts a new log. The log needs to be regenerated after each successful
   // launch as it is destroyed when staging the log.
@@ -73,6 +84,13 @@ class UploadService : public base::HistogramFlattener {
   // Triggers an upload event.
   void UploadEvent();
 
+  // Event callback for draining the shared memory ring.
+  void DrainRingCallback(const base::TimeDelta& interval);
+
+  // Moves the samples queued in the shared memory ring into the in-memory
+  // histograms, or into the current log for samples recorded there.
+  void DrainRing();
+
   // Sends the staged log.
   void SendStagedLog();
 
@@ -89,6 +107,7 @@ class UploadService : public base::HistogramFlattener {
 
   FRIEND_TEST(UploadServiceTest, CanSendMultipleTimes);
   FRIEND_TEST(UploadServiceTest, DiscardLogsAfterTooManyFailedUpload);
+  FRIEND_TEST(UploadServiceTest, DrainRingDefersLogSamplesDuringRetry);
   FRIEND_TEST(UploadServiceTest, EmptyLogsAreNotSent);
   FRIEND_TEST(UploadServiceTest, FailedSendAreRetried);
   FRIEND_TEST(UploadServiceTest, LogContainsAggregatedValues);
@@ -119,6 +138,11 @@ class UploadService : public base::HistogramFlattener {
   // Adds a generic sample to the current log.
   void AddSample(const metrics::MetricSample& sample);
 
+  // Adds |sample|, which may stand for several recordings of its value, to
+  // the histogram |counter|.
+  void AddRepeatedSample(base::HistogramBase* counter,
+                         const metrics::MetricSample& sample);
+
   // Adds a crash to the current log.
   void AddCrash(const std::string& crash_name);
 
@@ -146,6 +170,10 @@ class UploadService : public base::HistogramFlattener {
   std::unique_ptr<MetricsLog> staged_log_;
 
   std::string metrics_file_;
+  std::unique_ptr<metrics::SampleRing> metrics_ring_;
+  // Crashes and user actions drained from the ring while a staged log was
+  // waiting to be resent.  Added to the next log by ReadMetrics().
+  ScopedVector<metrics::MetricSample> deferred_samples_;
 
   bool testing_;
 };
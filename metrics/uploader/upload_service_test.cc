@@ -11,6 +11,8 @@
 #include "base/sys_info.h"
 #include "metrics/metrics_library_mock.h"
 #include "metrics/serialization/metric_sample.h"
+#include "metrics/serialization/sample_ring.h"
+#include "metrics/serialization/serialization_utils.h"
 #include "metrics/uploader/metrics_log.h"
 #include "metrics/uploader/mock/mock_system_profile_setter.h"
 #include "metrics/uploader/mock/sender_mock.h"
@@ -32,7 +34,8 @@ class UploadServiceTest : public testing::Test {
         exit_manager_(new base::AtExitManager()) {
     sender_ = new SenderMock;
     upload_service_.sender_.reset(sender_);
-    upload_service_.Init(base::TimeDelta::FromMinutes(30), kMetricsFilePath);
+    upload_service_.Init(base::TimeDelta::FromMinutes(30), kMetricsFilePath,
+                         "");
   }
 
   virtual void SetUp() {
@@ -122,6 +125,48 @@ TEST_F(UploadServiceTest, DiscardLogsAfterTooManyFailedUpload) {
   EXPECT_FALSE(upload_service_.staged_log_);
 }
 
+TEST_F(UploadServiceTest, DrainRingDefersLogSamplesDuringRetry) {
+  std::string ring_file = dir_.path().Append("uma-events.ring").value();
+  upload_service_.metrics_ring_ = metrics::SampleRing::Create(
+      ring_file, metrics::SampleRing::kDefaultSlotCount);
+  ASSERT_TRUE(upload_service_.metrics_ring_);
+  std::unique_ptr<metrics::SampleRing> producer =
+      metrics::SampleRing::Open(ring_file);
+  ASSERT_TRUE(producer);
+
+  sender_->set_should_succeed(false);
+  upload_service_.AddSample(*Crash("user"));
+  upload_service_.UploadEvent();
+  ASSERT_TRUE(upload_service_.staged_log_);
+
+  // The ring is drained while the failed upload waits for its retry.
+  EXPECT_TRUE(metrics::SerializationUtils::WriteMetricToRing(
+      *metrics::MetricSample::SparseHistogramSample("ring", 1),
+      producer.get()));
+  EXPECT_TRUE(metrics::SerializationUtils::WriteMetricToRing(
+      *Crash("kernel"), producer.get()));
+  upload_service_.DrainRing();
+  EXPECT_FALSE(upload_service_.current_log_);
+  EXPECT_EQ(1u, upload_service_.deferred_samples_.size());
+
+  sender_->set_should_succeed(true);
+  upload_service_.UploadEvent();
+  EXPECT_EQ(0, sender_->last_message_proto()
+                   .system_profile()
+                   .stability()
+                   .kernel_crash_count());
+
+  // Both samples make it into the next log.
+  upload_service_.UploadEvent();
+  EXPECT_EQ(3, sender_->send_call_count());
+  EXPECT_EQ(1, sender_->last_message_proto()
+                   .system_profile()
+                   .stability()
+                   .kernel_crash_count());
+  EXPECT_EQ(1, sender_->last_message_proto().histogram_event().size());
+  EXPECT_TRUE(upload_service_.deferred_samples_.empty());
+}
+
 TEST_F(UploadServiceTest, EmptyLogsAreNotSent) {
   upload_service_.UploadEvent();
   EXPECT_FALSE(upload_service_.current_log_);
@@ -7,19 +7,33 @@
 #include <libudev.h>
 #include <poll.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
 #include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
 #include "permission_broker/rule.h"
 
 namespace permission_broker {
 
+namespace {
+
+const char kUeventSeqnumPath[] = "/sys/kernel/uevent_seqnum";
+
+}  // namespace
+
 RuleEngine::RuleEngine()
-    : udev_(udev_new()) {}
+    : udev_(udev_new()),
+      poll_interval_msecs_(0),
+      verdicts_uevent_seqnum_(0) {}
 
 RuleEngine::RuleEngine(
     const std::string& udev_run_path,
     int poll_interval_msecs)
-    : udev_(udev_new()) {
+    : udev_(udev_new()),
+      verdicts_uevent_seqnum_(0) {
   CHECK(udev_) << "Could not create udev context, is sysfs mounted?";
 
   poll_interval_msecs_ = poll_interval_msecs;
@@ -32,16 +46,36 @@ RuleEngine::~RuleEngine() {
 void RuleEngine::AddRule(Rule* rule) {
   CHECK(rule) << "Cannot add NULL as a rule.";
   rules_.push_back(std::unique_ptr<Rule>(rule));
+  verdicts_.clear();
 }
 
 Rule::Result RuleEngine::ProcessPath(const std::string& path) {
+  // Every change to a device is announced by a uevent. If there hasn't been
+  // one since the verdict for |path| was reached, udev has nothing left to do
+  // for the device and the rules would decide the same way again.
+  const uint64_t uevent_seqnum = GetUeventSequenceNumber();
+  if (uevent_seqnum != verdicts_uevent_seqnum_) {
+    verdicts_.clear();
+    verdicts_uevent_seqnum_ = uevent_seqnum;
+  } else if (uevent_seqnum != 0) {
+    auto verdict = verdicts_.find(path);
+    if (verdict != verdicts_.end()) {
+      LOG(INFO) << "Cached verdict for " << path << ": "
+                << Rule::ResultToString(verdict->second);
+      return verdict->second;
+    }
+  }
+
   WaitForEmptyUdevQueue();
 
   LOG(INFO) << "ProcessPath(" << path << ")";
   Rule::Result result = Rule::IGNORE;
+  bool cacheable = false;
 
   ScopedUdevDevicePtr device(FindUdevDevice(path));
   if (device.get()) {
+    cacheable =
+        uevent_seqnum != 0 && IsDeviceSettled(device.get(), uevent_seqnum);
     for (const std::unique_ptr<Rule>& rule : rules_) {
       Rule::Result rule_result = rule->ProcessDevice(device.get());
       LOG(INFO) << "  " << rule->name() << ": "
@@ -65,6 +99,8 @@ Rule::Result RuleEngine::ProcessPath(const std::string& path) {
   }
 
   LOG(INFO) << "Verdict for " << path << ": " << Rule::ResultToString(result);
+  if (cacheable)
+    verdicts_[path] = result;
   return result;
 }
 
@@ -96,7 +132,38 @@ void RuleEngine::WaitForEmptyUdevQueue() {
   close(udev_poll.fd);
 }
 
+uint64_t RuleEngine::GetUeventSequenceNumber() {
+  std::string contents;
+  if (!base::ReadFileToString(base::FilePath(kUeventSeqnumPath), &contents))
+    return 0;
+
+  base::TrimWhitespaceASCII(contents, base::TRIM_TRAILING, &contents);
+  uint64_t seqnum = 0;
+  if (!base::StringToUint64(contents, &seqnum))
+    return 0;
+  return seqnum;
+}
+
+bool RuleEngine::IsDeviceSettled(udev_device* device,
+                                 uint64_t uevent_seqnum) {
+  return udev_device_get_is_initialized(device) &&
+         udev_device_get_seqnum(device) <= uevent_seqnum;
+}
+
 ScopedUdevDevicePtr RuleEngine::FindUdevDevice(const std::string& path) {
+  // Device nodes can be looked up directly by their device number.
+  struct stat path_stat;
+  if (stat(path.c_str(), &path_stat) == 0 &&
+      (S_ISCHR(path_stat.st_mode) || S_ISBLK(path_stat.st_mode))) {
+    ScopedUdevDevicePtr device(udev_device_new_from_devnum(
+        udev_.get(), S_ISCHR(path_stat.st_mode) ? 'c' : 'b',
+        path_stat.st_rdev));
+    const char* devnode =
+        device.get() ? udev_device_get_devnode(device.get()) : nullptr;
+    if (devnode && !strcmp(devnode, path.c_str()))
+      return device;
+  }
+
   ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev_.get()));
   udev_enumerate_scan_devices(enumerate.get());
 
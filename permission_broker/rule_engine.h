@@ -5,6 +5,9 @@
 #ifndef PERMISSION_BROKER_RULE_ENGINE_H_
 #define PERMISSION_BROKER_RULE_ENGINE_H_
 
+#include <stdint.h>
+
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -35,6 +38,11 @@ class RuleEngine {
   // executing all of the stored rules, no rule has explicitly allowed access to
   // the path then access is denied. If _any_ rule denies access to |path| then
   // processing the rules is aborted early and access is denied.
+  //
+  // Verdicts on devices that udev has finished processing are remembered until
+  // the kernel sends the next uevent or a rule is added, so repeated requests
+  // for a device that hasn't changed skip both waiting for udev and running the
+  // rules.
   Rule::Result ProcessPath(const std::string& path);
 
  protected:
@@ -49,6 +57,15 @@ class RuleEngine {
   // dependency and overhead.
   virtual void WaitForEmptyUdevQueue();
 
+  // Returns the sequence number of the last uevent sent by the kernel, or 0 if
+  // it can't be determined.
+  virtual uint64_t GetUeventSequenceNumber();
+
+  // Returns true if udev has finished processing |device| and its last uevent
+  // is no later than the one numbered |uevent_seqnum|, so that a verdict on it
+  // holds until the next uevent.
+  virtual bool IsDeviceSettled(udev_device* device, uint64_t uevent_seqnum);
+
   // Finds the udev_device where udev_device_get_devnode returns |path|.
   ScopedUdevDevicePtr FindUdevDevice(const std::string& path);
 
@@ -58,6 +75,11 @@ class RuleEngine {
   int poll_interval_msecs_;
   std::string udev_run_path_;
 
+  // Verdicts of ProcessPath() indexed by path, all reached while
+  // |verdicts_uevent_seqnum_| was the sequence number of the last uevent.
+  std::map<std::string, Rule::Result> verdicts_;
+  uint64_t verdicts_uevent_seqnum_;
+
   DISALLOW_COPY_AND_ASSIGN(RuleEngine);
 };
 
@@ -14,6 +14,7 @@
 using std::string;
 using ::testing::_;
 using ::testing::Return;
+using ::testing::ReturnPointee;
 
 namespace permission_broker {
 
@@ -34,6 +35,9 @@ class MockRuleEngine : public RuleEngine {
   ~MockRuleEngine() override = default;
 
   MOCK_METHOD0(WaitForEmptyUdevQueue, void(void));
+  MOCK_METHOD0(GetUeventSequenceNumber, uint64_t(void));
+  MOCK_METHOD2(IsDeviceSettled, bool(udev_device* device,
+                                     uint64_t uevent_seqnum));
 
  private:
   DISALLOW_COPY_AND_ASSIGN(MockRuleEngine);
@@ -96,6 +100,58 @@ TEST_F(RuleEngineTest, LockdownPrecedence) {
   EXPECT_EQ(Rule::ALLOW_WITH_LOCKDOWN, ProcessPath("/dev/null"));
 }
 
+TEST_F(RuleEngineTest, CacheVerdict) {
+  EXPECT_CALL(engine_, GetUeventSequenceNumber()).WillRepeatedly(Return(5));
+  EXPECT_CALL(engine_, IsDeviceSettled(_, 5)).WillRepeatedly(Return(true));
+  EXPECT_CALL(engine_, WaitForEmptyUdevQueue()).Times(1);
+  engine_.AddRule(CreateMockRule(Rule::ALLOW));
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+}
+
+TEST_F(RuleEngineTest, UeventInvalidatesVerdict) {
+  uint64_t uevent_seqnum = 5;
+  EXPECT_CALL(engine_, GetUeventSequenceNumber())
+      .WillRepeatedly(ReturnPointee(&uevent_seqnum));
+  EXPECT_CALL(engine_, IsDeviceSettled(_, _)).WillRepeatedly(Return(true));
+  EXPECT_CALL(engine_, WaitForEmptyUdevQueue()).Times(2);
+  MockRule* rule = new MockRule();
+  EXPECT_CALL(*rule, ProcessDevice(_))
+      .WillOnce(Return(Rule::ALLOW))
+      .WillOnce(Return(Rule::DENY));
+  engine_.AddRule(rule);
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+  uevent_seqnum = 6;
+  EXPECT_EQ(Rule::DENY, ProcessPath("/dev/null"));
+}
+
+TEST_F(RuleEngineTest, UnsettledDeviceVerdictNotCached) {
+  EXPECT_CALL(engine_, GetUeventSequenceNumber()).WillRepeatedly(Return(5));
+  EXPECT_CALL(engine_, IsDeviceSettled(_, 5)).WillRepeatedly(Return(false));
+  EXPECT_CALL(engine_, WaitForEmptyUdevQueue()).Times(2);
+  MockRule* rule = new MockRule();
+  EXPECT_CALL(*rule, ProcessDevice(_))
+      .WillOnce(Return(Rule::DENY))
+      .WillOnce(Return(Rule::ALLOW));
+  engine_.AddRule(rule);
+  EXPECT_EQ(Rule::DENY, ProcessPath("/dev/null"));
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+}
+
+TEST_F(RuleEngineTest, AddRuleInvalidatesVerdict) {
+  EXPECT_CALL(engine_, GetUeventSequenceNumber()).WillRepeatedly(Return(5));
+  EXPECT_CALL(engine_, IsDeviceSettled(_, 5)).WillRepeatedly(Return(true));
+  EXPECT_CALL(engine_, WaitForEmptyUdevQueue()).Times(2);
+  MockRule* rule = new MockRule();
+  EXPECT_CALL(*rule, ProcessDevice(_))
+      .Times(2)
+      .WillRepeatedly(Return(Rule::ALLOW));
+  engine_.AddRule(rule);
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+  engine_.AddRule(CreateMockRule(Rule::DENY));
+  EXPECT_EQ(Rule::DENY, ProcessPath("/dev/null"));
+}
+
 TEST_F(RuleEngineTest, DetachPrecedence) {
   engine_.AddRule(CreateMockRule(Rule::IGNORE));
   engine_.AddRule(CreateMockRule(Rule::ALLOW_WITH_DETACH));
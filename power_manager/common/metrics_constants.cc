@@ -116,4 +116,20 @@ const char kMetricDarkResumeWakeDurationMsName[] =
 const int kMetricDarkResumeWakeDurationMsMin = 0;
 const int kMetricDarkResumeWakeDurationMsMax = 10 * 60 * 1000;
 
+const char kMetricSuspendPhaseDurationMsPrefix[] =
+    "Power.SuspendPhaseDurationMs.";
+const int kMetricSuspendPhaseDurationMsMin = 0;
+const int kMetricSuspendPhaseDurationMsMax = 60 * 1000;
+
+const char kMetricSuspendDelayResponseMsName[] =
+    "Power.SuspendDelayResponseMs";
+const char kMetricDarkSuspendDelayResponseMsName[] =
+    "Power.DarkSuspendDelayResponseMs";
+const int kMetricSuspendDelayResponseMsMin = 0;
+const int kMetricSuspendDelayResponseMsMax = 20 * 1000;
+const char kMetricSuspendDelayTimeoutsName[] = "Power.SuspendDelayTimeouts";
+const char kMetricDarkSuspendDelayTimeoutsName[] =
+    "Power.DarkSuspendDelayTimeouts";
+const int kMetricSuspendDelayTimeoutsMax = 10;
+
 }  // namespace power_manager
@@ -100,6 +100,22 @@ extern const char kMetricDarkResumeWakeDurationMsName[];
 extern const int kMetricDarkResumeWakeDurationMsMin;
 extern const int kMetricDarkResumeWakeDurationMsMax;
 
+// Prefix of the histograms reporting how long each phase of a suspend request
+// took. The phase's name (see SuspendTracer) is appended.
+extern const char kMetricSuspendPhaseDurationMsPrefix[];
+extern const int kMetricSuspendPhaseDurationMsMin;
+extern const int kMetricSuspendPhaseDurationMsMax;
+
+// Time taken by each client with a suspend delay to report readiness, and the
+// number of delays that timed out per request.
+extern const char kMetricSuspendDelayResponseMsName[];
+extern const char kMetricDarkSuspendDelayResponseMsName[];
+extern const int kMetricSuspendDelayResponseMsMin;
+extern const int kMetricSuspendDelayResponseMsMax;
+extern const char kMetricSuspendDelayTimeoutsName[];
+extern const char kMetricDarkSuspendDelayTimeoutsName[];
+extern const int kMetricSuspendDelayTimeoutsMax;
+
 // Enum for kMetricBatteryInfoSample.
 enum BatteryInfoSampleResult {
   BATTERY_INFO_READ,
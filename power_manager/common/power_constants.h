@@ -243,6 +243,10 @@ extern const char kPowerStatusPath[];
 // Program used to run code as root.
 extern const char kSetuidHelperPath[];
 
+// D-Bus method exported by powerd that returns the phases of the last suspend
+// request. Defined here until it's added to system_api.
+extern const char kGetLastSuspendTraceMethod[];
+
 // Small value used when comparing floating-point percentages.
 extern const double kEpsilon;
 
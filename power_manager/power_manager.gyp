@@ -108,6 +108,7 @@
         'powerd/policy/keyboard_backlight_controller.cc',
         'powerd/policy/state_controller.cc',
         'powerd/policy/suspend_delay_controller.cc',
+        'powerd/policy/suspend_tracer.cc',
         'powerd/policy/suspender.cc',
         'powerd/policy/wakeup_controller.cc',
       ],
@@ -357,6 +358,7 @@
             'powerd/policy/keyboard_backlight_controller_unittest.cc',
             'powerd/policy/state_controller_unittest.cc',
             'powerd/policy/suspend_delay_controller_unittest.cc',
+            'powerd/policy/suspend_tracer_unittest.cc',
             'powerd/policy/suspender_unittest.cc',
             'powerd/policy/wakeup_controller_unittest.cc',
           ],
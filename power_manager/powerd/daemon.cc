@@ -68,6 +68,8 @@ const char kDefaultOobeCompletedPath[] = "/home/chronos/.oobe_completed";
 const char kDefaultFlashromLockPath[] = "/run/lock/flashrom_powerd.lock";
 const char kDefaultBatteryToolLockPath[] = "/run/lock/battery_tool_powerd.lock";
 const char kDefaultProcPath[] = "/proc";
+const char kDefaultSuspendPhaseTimingsPath[] =
+    "/var/run/power_manager/root/last_suspend_phase_timings";
 
 // Basename appended to |run_dir| (see Daemon's c'tor) to produce
 // |suspend_announced_path_|.
@@ -266,6 +268,7 @@ Daemon::Daemon(DaemonDelegate* delegate, const base::FilePath& run_dir)
       proc_path_(kDefaultProcPath),
       suspended_state_path_(kDefaultSuspendedStatePath),
       suspend_announced_path_(run_dir.Append(kSuspendAnnouncedFile)),
+      suspend_phase_timings_path_(kDefaultSuspendPhaseTimingsPath),
       session_state_(SESSION_STOPPED),
       created_suspended_state_file_(false),
       lock_vt_before_suspend_(false),
@@ -427,6 +430,29 @@ int Daemon::RunSetuidHelper(const std::string& action,
   }
 }
 
+void Daemon::ReadSuspendPhaseTimings() {
+  last_suspend_attempt_phases_.clear();
+  std::string data;
+  if (!base::ReadFileToString(suspend_phase_timings_path_, &data)) {
+    VLOG(1) << "Couldn't read " << suspend_phase_timings_path_.value();
+    return;
+  }
+  base::StringPairs pairs;
+  base::SplitStringIntoKeyValuePairs(data, ' ', '\n', &pairs);
+  for (const auto& pair : pairs) {
+    int64_t usec = 0;
+    if (pair.first.empty() || !base::StringToInt64(pair.second, &usec) ||
+        usec < 0) {
+      LOG(WARNING) << "Ignoring suspend phase \"" << pair.first << "\" with "
+                   << "duration \"" << pair.second << "\"";
+      continue;
+    }
+    last_suspend_attempt_phases_.push_back(
+        policy::SuspendPhase(pair.first, base::TimeDelta(),
+                             base::TimeDelta::FromMicroseconds(usec)));
+  }
+}
+
 void Daemon::AdjustKeyboardBrightness(int direction) {
   if (!keyboard_backlight_controller_)
     return;
@@ -621,6 +647,8 @@ policy::Suspender::Delegate::SuspendResult Daemon::DoSuspend(
     uint64_t wakeup_count,
     bool wakeup_count_valid,
     base::TimeDelta duration) {
+  last_suspend_attempt_phases_.clear();
+
   // If a firmware update is ongoing, spin for a bit to wait for it to finish:
   // http://crosbug.com/p/38947
   const base::TimeDelta firmware_poll_interval =
@@ -673,6 +701,7 @@ policy::Suspender::Delegate::SuspendResult Daemon::DoSuspend(
 
   const int exit_code = RunSetuidHelper("suspend", args, true);
   LOG(INFO) << "powerd_suspend returned " << exit_code;
+  ReadSuspendPhaseTimings();
 
   if (log_suspend_with_mosys_eventlog_)
     RunSetuidHelper("mosys_eventlog", "--mosys_eventlog_code=0xa8", false);
@@ -698,6 +727,10 @@ policy::Suspender::Delegate::SuspendResult Daemon::DoSuspend(
   }
 }
 
+std::vector<policy::SuspendPhase> Daemon::GetLastSuspendAttemptPhases() {
+  return last_suspend_attempt_phases_;
+}
+
 void Daemon::UndoPrepareToSuspend(bool success,
                                   int num_suspend_attempts,
                                   bool canceled_while_in_dark_resume) {
@@ -905,6 +938,7 @@ void Daemon::InitDBus() {
        &Suspender::HandleDarkSuspendReadiness},
       {kRecordDarkResumeWakeReasonMethod,
        &Suspender::RecordDarkResumeWakeReason},
+      {kGetLastSuspendTraceMethod, &Suspender::GetLastSuspendTrace},
   };
   for (const auto& it : kSuspenderMethods) {
     dbus_wrapper_->ExportMethod(
@@ -92,6 +92,9 @@ class Daemon : public policy::BacklightControllerObserver,
   void set_proc_path_for_testing(const base::FilePath& path) {
     proc_path_ = path;
   }
+  void set_suspend_phase_timings_path_for_testing(const base::FilePath& path) {
+    suspend_phase_timings_path_ = path;
+  }
 
   // Overridden from policy::BacklightControllerObserver:
   void OnBrightnessChange(
@@ -121,6 +124,7 @@ class Daemon : public policy::BacklightControllerObserver,
   SuspendResult DoSuspend(uint64_t wakeup_count,
                           bool wakeup_count_valid,
                           base::TimeDelta duration) override;
+  std::vector<policy::SuspendPhase> GetLastSuspendAttemptPhases() override;
   void UndoPrepareToSuspend(bool success,
                             int num_suspend_attempts,
                             bool canceled_while_in_dark_resume) override;
@@ -168,6 +172,10 @@ class Daemon : public policy::BacklightControllerObserver,
                       const std::string& additional_args,
                       bool wait_for_completion);
 
+  // Reads the durations that powerd_suspend recorded in
+  // |suspend_phase_timings_path_| into |last_suspend_attempt_phases_|.
+  void ReadSuspendPhaseTimings();
+
   // Decreases/increases the keyboard brightness; direction should be +1 for
   // increase and -1 for decrease.
   void AdjustKeyboardBrightness(int direction);
@@ -355,6 +363,14 @@ class Daemon : public policy::BacklightControllerObserver,
   // mid-suspend-attempt and didn't announce that the attempt finished.
   base::FilePath suspend_announced_path_;
 
+  // File where powerd_suspend records how long the phases of a suspend attempt
+  // took, one "<name> <microseconds>" line per phase.
+  base::FilePath suspend_phase_timings_path_;
+
+  // Phases of the last suspend attempt, read from
+  // |suspend_phase_timings_path_| after powerd_suspend returns.
+  std::vector<policy::SuspendPhase> last_suspend_attempt_phases_;
+
   // Last session state that we have been informed of. Initialized as stopped.
   SessionState session_state_;
 
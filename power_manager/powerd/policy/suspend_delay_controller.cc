@@ -5,6 +5,7 @@
 #include "power_manager/powerd/policy/suspend_delay_controller.h"
 
 #include <algorithm>
+#include <utility>
 #include <vector>
 
 #include <base/bind.h>
@@ -13,6 +14,8 @@
 #include <base/strings/string_number_conversions.h>
 #include <chromeos/dbus/service_constants.h>
 
+#include "power_manager/common/metrics_constants.h"
+#include "power_manager/common/metrics_sender.h"
 #include "power_manager/common/util.h"
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
@@ -26,13 +29,41 @@ namespace {
 // ready, in milliseconds.
 const int kMaxDelayTimeoutMs = 20000;
 
+// Number of recent response times kept for each client.
+const size_t kMaxResponseTimes = 10;
+
+// Number of response times needed before the timeout of a client that timed
+// out is derived from them.
+const size_t kMinResponseTimesForAdaptiveTimeout = 5;
+
+// Multiple of a client's slowest recent response time that it's given to
+// report readiness.
+const int kAdaptiveTimeoutMultiplier = 4;
+
+// Shortest timeout that's derived from a client's history, in milliseconds.
+// Clients that time out kMaxConsecutiveTimeouts times in a row are only waited
+// for this long until they report readiness again.
+const int kMinAdaptiveTimeoutMs = 1000;
+const int kMaxConsecutiveTimeouts = 3;
+
+// Number of clients listed by GetSlowestClientsSummary().
+const size_t kNumSlowestClientsToLog = 3;
+
 }  // namespace
 
+SuspendDelayController::ClientHistory::ClientHistory()
+    : consecutive_timeouts(0), num_times_last(0), num_timeouts(0) {}
+
+SuspendDelayController::ClientHistory::~ClientHistory() {}
+
 SuspendDelayController::SuspendDelayController(int initial_delay_id,
                                                const std::string& description)
     : description_(description),
       next_delay_id_(initial_delay_id),
-      current_suspend_id_(0) {
+      current_suspend_id_(0),
+      num_timed_out_delays_(0),
+      min_adaptive_timeout_(
+          base::TimeDelta::FromMilliseconds(kMinAdaptiveTimeoutMs)) {
 }
 
 SuspendDelayController::~SuspendDelayController() {
@@ -100,13 +131,27 @@ void SuspendDelayController::HandleSuspendReadiness(
     return;
   }
 
-  if (!delay_ids_being_waited_on_.count(delay_id)) {
+  if (timed_out_delay_ids_.erase(delay_id)) {
+    // Too late to matter for this request, but the client is still alive.
+    const base::TimeDelta response_time =
+        clock_.GetCurrentTime() - suspend_start_time_;
+    LOG(INFO) << "Delay " << delay_id << " reported readiness "
+              << response_time.InMilliseconds() << " ms after "
+              << GetLogDescription() << " request " << suspend_id
+              << " was announced, past its deadline";
+    DelayInfoMap::const_iterator it = registered_delays_.find(delay_id);
+    if (it != registered_delays_.end())
+      RecordResponseTime(it->second, response_time);
+    return;
+  }
+
+  if (!delay_deadlines_.count(delay_id)) {
     LOG(WARNING) << "Ignoring readiness notification for "
                  << GetLogDescription() << " delay " << delay_id
                  << ", which we weren't waiting for";
     return;
   }
-  RemoveDelayFromWaitList(delay_id);
+  RemoveDelayFromWaitList(delay_id, DELAY_READY);
 }
 
 void SuspendDelayController::HandleDBusClientDisconnected(
@@ -129,30 +174,26 @@ void SuspendDelayController::HandleDBusClientDisconnected(
 
 void SuspendDelayController::PrepareForSuspend(int suspend_id) {
   current_suspend_id_ = suspend_id;
+  suspend_start_time_ = clock_.GetCurrentTime();
+  num_timed_out_delays_ = 0;
+  timed_out_delay_ids_.clear();
 
-  size_t old_count = delay_ids_being_waited_on_.size();
-  delay_ids_being_waited_on_.clear();
+  size_t old_count = delay_deadlines_.size();
+  delay_deadlines_.clear();
   for (DelayInfoMap::const_iterator it = registered_delays_.begin();
-       it != registered_delays_.end(); ++it)
-    delay_ids_being_waited_on_.insert(it->first);
+       it != registered_delays_.end(); ++it) {
+    delay_deadlines_[it->first] =
+        suspend_start_time_ + GetDelayTimeout(it->second);
+  }
 
   LOG(INFO) << "Announcing " << GetLogDescription() << " request "
             << current_suspend_id_ << " with "
-            << delay_ids_being_waited_on_.size() << " pending delay(s) and "
+            << delay_deadlines_.size() << " pending delay(s) and "
             << old_count << " outstanding delay(s) from previous request";
-  if (delay_ids_being_waited_on_.empty()) {
+  if (delay_deadlines_.empty())
     PostNotifyObserversTask(current_suspend_id_);
-  } else {
-    base::TimeDelta max_timeout;
-    for (DelayInfoMap::const_iterator it = registered_delays_.begin();
-         it != registered_delays_.end(); ++it) {
-      max_timeout = std::max(max_timeout, it->second.timeout);
-    }
-    max_timeout = std::min(
-        max_timeout, base::TimeDelta::FromMilliseconds(kMaxDelayTimeoutMs));
-    delay_expiration_timer_.Start(FROM_HERE, max_timeout, this,
-        &SuspendDelayController::OnDelayExpiration);
-  }
+  else
+    ScheduleDelayExpiration();
 }
 
 void SuspendDelayController::FinishSuspend(int suspend_id) {
@@ -160,7 +201,7 @@ void SuspendDelayController::FinishSuspend(int suspend_id) {
     return;
 
   delay_expiration_timer_.Stop();
-  delay_ids_being_waited_on_.clear();
+  delay_deadlines_.clear();
 }
 
 std::string SuspendDelayController::GetLogDescription() const {
@@ -173,45 +214,185 @@ std::string SuspendDelayController::GetDelayDescription(int delay_id) const {
   return it != registered_delays_.end() ? it->second.description : "unknown";
 }
 
+// static
+std::string SuspendDelayController::GetClientKey(const DelayInfo& delay) {
+  return !delay.description.empty() ? delay.description : delay.dbus_client;
+}
+
+base::TimeDelta SuspendDelayController::GetDelayTimeout(
+    const DelayInfo& delay) const {
+  base::TimeDelta timeout = std::min(
+      delay.timeout, base::TimeDelta::FromMilliseconds(kMaxDelayTimeoutMs));
+  const auto it = client_histories_.find(GetClientKey(delay));
+  if (it == client_histories_.end())
+    return timeout;
+
+  // Clients that answered the previous request, even if late, are given as
+  // long as they asked for.
+  const ClientHistory& history = it->second;
+  if (history.consecutive_timeouts == 0)
+    return timeout;
+
+  base::TimeDelta adaptive_timeout;
+  if (history.consecutive_timeouts >= kMaxConsecutiveTimeouts) {
+    adaptive_timeout = min_adaptive_timeout_;
+  } else if (history.response_times.size() >=
+             kMinResponseTimesForAdaptiveTimeout) {
+    const base::TimeDelta slowest = *std::max_element(
+        history.response_times.begin(), history.response_times.end());
+    adaptive_timeout =
+        std::max(min_adaptive_timeout_, slowest * kAdaptiveTimeoutMultiplier);
+  } else {
+    return timeout;
+  }
+
+  if (adaptive_timeout < timeout) {
+    LOG(INFO) << "Waiting " << adaptive_timeout.InMilliseconds() << " ms "
+              << "instead of " << timeout.InMilliseconds() << " ms for "
+              << GetLogDescription() << " delay (" << delay.description
+              << ") after " << history.consecutive_timeouts
+              << " consecutive timeout(s) and "
+              << history.response_times.size() << " recent response(s)";
+    timeout = adaptive_timeout;
+  }
+  return timeout;
+}
+
 void SuspendDelayController::UnregisterDelayInternal(int delay_id) {
   if (!registered_delays_.count(delay_id)) {
     LOG(WARNING) << "Ignoring request to remove unknown " << GetLogDescription()
                  << " delay " << delay_id;
     return;
   }
-  RemoveDelayFromWaitList(delay_id);
+  RemoveDelayFromWaitList(delay_id, DELAY_UNREGISTERED);
   registered_delays_.erase(delay_id);
+  timed_out_delay_ids_.erase(delay_id);
+}
+
+void SuspendDelayController::RecordResponseTime(
+    const DelayInfo& delay,
+    base::TimeDelta response_time) {
+  ClientHistory& history = client_histories_[GetClientKey(delay)];
+  history.response_times.push_back(response_time);
+  if (history.response_times.size() > kMaxResponseTimes)
+    history.response_times.pop_front();
+  history.consecutive_timeouts = 0;
 }
 
-void SuspendDelayController::RemoveDelayFromWaitList(int delay_id) {
-  if (!delay_ids_being_waited_on_.count(delay_id))
+void SuspendDelayController::RemoveDelayFromWaitList(int delay_id,
+                                                     DelayDoneReason reason) {
+  if (!delay_deadlines_.count(delay_id))
     return;
 
-  delay_ids_being_waited_on_.erase(delay_id);
-  if (delay_ids_being_waited_on_.empty()) {
+  delay_deadlines_.erase(delay_id);
+  DelayInfoMap::const_iterator it = registered_delays_.find(delay_id);
+  if (it != registered_delays_.end()) {
+    ClientHistory& history = client_histories_[GetClientKey(it->second)];
+    if (reason == DELAY_READY) {
+      const base::TimeDelta response_time =
+          clock_.GetCurrentTime() - suspend_start_time_;
+      RecordResponseTime(it->second, response_time);
+      if (delay_deadlines_.empty())
+        history.num_times_last++;
+      SendMetric(description_.empty() ?
+                     kMetricSuspendDelayResponseMsName :
+                     kMetricDarkSuspendDelayResponseMsName,
+                 response_time.InMilliseconds(),
+                 kMetricSuspendDelayResponseMsMin,
+                 kMetricSuspendDelayResponseMsMax,
+                 kMetricDefaultBuckets);
+    } else if (reason == DELAY_TIMED_OUT) {
+      timed_out_delay_ids_.insert(delay_id);
+      history.consecutive_timeouts++;
+      history.num_timeouts++;
+      num_timed_out_delays_++;
+    }
+  }
+
+  const std::string description = GetDelayDescription(delay_id);
+  FOR_EACH_OBSERVER(SuspendDelayObserver, observers_,
+                    OnSuspendDelayDone(this, current_suspend_id_, description,
+                                       reason == DELAY_TIMED_OUT));
+  if (delay_deadlines_.empty()) {
     delay_expiration_timer_.Stop();
+    SendEnumMetric(description_.empty() ?
+                       kMetricSuspendDelayTimeoutsName :
+                       kMetricDarkSuspendDelayTimeoutsName,
+                   num_timed_out_delays_, kMetricSuspendDelayTimeoutsMax);
+    if (reason != DELAY_UNREGISTERED) {
+      LOG(INFO) << "Clients that held up the most " << GetLogDescription()
+                << " requests: " << GetSlowestClientsSummary();
+    }
     PostNotifyObserversTask(current_suspend_id_);
   }
 }
 
+void SuspendDelayController::ScheduleDelayExpiration() {
+  if (delay_deadlines_.empty()) {
+    delay_expiration_timer_.Stop();
+    return;
+  }
+  base::TimeTicks earliest_deadline = delay_deadlines_.begin()->second;
+  for (const auto& it : delay_deadlines_)
+    earliest_deadline = std::min(earliest_deadline, it.second);
+  delay_expiration_timer_.Start(FROM_HERE,
+      std::max(base::TimeDelta(), earliest_deadline - clock_.GetCurrentTime()),
+      this, &SuspendDelayController::OnDelayExpiration);
+}
+
 void SuspendDelayController::OnDelayExpiration() {
+  const base::TimeTicks now = clock_.GetCurrentTime();
+  std::vector<int> tardy_delay_ids;
   std::string tardy_delays;
-  for (std::set<int>::const_iterator it = delay_ids_being_waited_on_.begin();
-       it != delay_ids_being_waited_on_.end(); ++it) {
-    const DelayInfo& delay = registered_delays_[*it];
+  for (const auto& it : delay_deadlines_) {
+    if (it.second > now)
+      continue;
+    const DelayInfo& delay = registered_delays_[it.first];
     if (!tardy_delays.empty())
       tardy_delays += ", ";
-    tardy_delays += base::IntToString(*it) + " (" + delay.dbus_client + ": " +
-        delay.description + ")";
+    tardy_delays += base::IntToString(it.first) + " (" + delay.dbus_client +
+        ": " + delay.description + ")";
+    tardy_delay_ids.push_back(it.first);
+  }
+  if (tardy_delay_ids.empty()) {
+    // The delay with the earliest deadline reported readiness in the meantime.
+    ScheduleDelayExpiration();
+    return;
   }
+
   LOG(WARNING) << "Timed out while waiting for " << GetLogDescription()
                << " request " << current_suspend_id_
                << " readiness confirmation for "
-               << delay_ids_being_waited_on_.size() << " delay(s): "
-               << tardy_delays;
+               << tardy_delay_ids.size() << " delay(s): " << tardy_delays;
+  for (int delay_id : tardy_delay_ids)
+    RemoveDelayFromWaitList(delay_id, DELAY_TIMED_OUT);
+  ScheduleDelayExpiration();
+}
 
-  delay_ids_being_waited_on_.clear();
-  PostNotifyObserversTask(current_suspend_id_);
+std::string SuspendDelayController::GetSlowestClientsSummary() const {
+  std::vector<std::pair<int, std::string>> clients;
+  for (const auto& it : client_histories_) {
+    const int count = it.second.num_times_last + it.second.num_timeouts;
+    if (count > 0)
+      clients.push_back(std::make_pair(count, it.first));
+  }
+  std::sort(clients.begin(), clients.end(),
+            [](const std::pair<int, std::string>& a,
+               const std::pair<int, std::string>& b) {
+              return a.first > b.first ||
+                  (a.first == b.first && a.second < b.second);
+            });
+
+  std::string summary;
+  for (size_t i = 0; i < clients.size() && i < kNumSlowestClientsToLog; ++i) {
+    const ClientHistory& history =
+        client_histories_.find(clients[i].second)->second;
+    if (!summary.empty())
+      summary += ", ";
+    summary += clients[i].second + ": " + base::IntToString(clients[i].first) +
+        " (" + base::IntToString(history.num_timeouts) + " timed out)";
+  }
+  return summary.empty() ? "none" : summary;
 }
 
 void SuspendDelayController::PostNotifyObserversTask(int suspend_id) {
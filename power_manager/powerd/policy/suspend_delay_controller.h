@@ -5,6 +5,7 @@
 #ifndef POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_CONTROLLER_H_
 #define POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_CONTROLLER_H_
 
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -14,6 +15,8 @@
 #include <base/time/time.h>
 #include <base/timer/timer.h>
 
+#include "power_manager/common/clock.h"
+
 namespace power_manager {
 
 class RegisterSuspendDelayReply;
@@ -27,12 +30,26 @@ class SuspendDelayObserver;
 
 // Handles D-Bus requests to delay suspending until other processes have had
 // time to do last-minute cleanup.
+//
+// Each delay has its own deadline, so a client that doesn't report readiness
+// only holds up suspend until its own timeout expires. A client that timed out
+// for the previous request is then only waited for a multiple of its slowest
+// recent response, and one that repeatedly times out is only waited for
+// briefly. Readiness reported after a delay timed out still counts as a
+// response, so a client gets its registered timeout back as soon as it answers
+// again. Clients are told apart by the description they supply, which is
+// stable across registrations.
 class SuspendDelayController {
  public:
   SuspendDelayController(int initial_delay_id, const std::string& description);
   ~SuspendDelayController();
 
-  bool ready_for_suspend() const { return delay_ids_being_waited_on_.empty(); }
+  bool ready_for_suspend() const { return delay_deadlines_.empty(); }
+
+  // Sets the shortest timeout that's derived from a client's history.
+  void set_min_adaptive_timeout_for_testing(base::TimeDelta timeout) {
+    min_adaptive_timeout_ = timeout;
+  }
 
   // Adds or removes an observer that will be notified when it's safe to
   // suspend.
@@ -58,7 +75,7 @@ class SuspendDelayController {
   void HandleDBusClientDisconnected(const std::string& client);
 
   // Called when suspend is desired.  Updates |current_suspend_id_| and
-  // |delays_being_waited_on_| and notifies clients that suspend is imminent.
+  // |delay_deadlines_| and notifies clients that suspend is imminent.
   void PrepareForSuspend(int suspend_id);
 
   // Stops |suspend_id| if it is in-progress, i.e. it matches
@@ -81,6 +98,35 @@ class SuspendDelayController {
     std::string description;
   };
 
+  // How the clients that registered delays with a given description responded
+  // to past suspend requests.
+  struct ClientHistory {
+    ClientHistory();
+    ~ClientHistory();
+
+    // Times taken to report readiness for recent requests, oldest first.
+    std::deque<base::TimeDelta> response_times;
+
+    // Number of requests for which the client timed out in a row.
+    int consecutive_timeouts;
+
+    // Numbers of requests that the client held up, either by being the last
+    // to report readiness or by timing out.
+    int num_times_last;
+    int num_timeouts;
+  };
+
+  // Reasons for a delay to stop holding up a request.
+  enum DelayDoneReason {
+    DELAY_READY,
+    DELAY_UNREGISTERED,
+    DELAY_TIMED_OUT,
+  };
+
+  // Returns the key of |delay|'s client in |client_histories_|: its
+  // description, or its D-Bus connection if it has none.
+  static std::string GetClientKey(const DelayInfo& delay);
+
   // Returns a substring to use in log messages to describe the types of
   // suspends controlled by this object. If |description_| is non-empty,
   // |description_| + " suspend"; otherwise, just "suspend".
@@ -89,21 +135,38 @@ class SuspendDelayController {
   // Returns the human-readable description of |delay_id|.
   std::string GetDelayDescription(int delay_id) const;
 
+  // Returns how long to wait for |delay| to report readiness, given its
+  // registered timeout and its client's history.
+  base::TimeDelta GetDelayTimeout(const DelayInfo& delay) const;
+
   // Removes |delay_id| from |registered_delays_| and calls
   // RemoveDelayFromWaitList().
   void UnregisterDelayInternal(int delay_id);
 
-  // Removes |delay_id| from |delay_ids_being_waited_on_|.  If the set goes from
-  // non-empty to empty, cancels the delay expiration timeout and notifies
-  // observers that it's safe to to suspend.
-  void RemoveDelayFromWaitList(int delay_id);
+  // Records in the history of |delay|'s client that it reported readiness
+  // for the current request |response_time| after it was announced.
+  void RecordResponseTime(const DelayInfo& delay,
+                          base::TimeDelta response_time);
 
-  // Called by |delay_expiration_timer_| after a PrepareForSuspend() call if
-  // HandleSuspendReadiness() isn't invoked for all registered delays before the
-  // maximum delay timeout has elapsed.  Notifies observers that it's safe to
-  // suspend.
+  // Removes |delay_id| from |delay_deadlines_|, updates its client's history
+  // according to |reason| and notifies observers that the delay is done.  If
+  // the map goes from non-empty to empty, cancels the delay expiration timeout,
+  // reports metrics and notifies observers that it's safe to to suspend.
+  void RemoveDelayFromWaitList(int delay_id, DelayDoneReason reason);
+
+  // Starts |delay_expiration_timer_| to run OnDelayExpiration() at the
+  // earliest deadline in |delay_deadlines_|.
+  void ScheduleDelayExpiration();
+
+  // Called by |delay_expiration_timer_| when the deadline of one or more
+  // delays has passed.  Notifies observers that each of those delays timed
+  // out, and that it's safe to suspend if no other delays remain.
   void OnDelayExpiration();
 
+  // Returns a comma-separated list of the clients that held up the most
+  // requests, with the numbers of requests.
+  std::string GetSlowestClientsSummary() const;
+
   // Posts a NotifyObservers() call to the message loop.
   void PostNotifyObserversTask(int suspend_id);
 
@@ -126,9 +189,27 @@ class SuspendDelayController {
   // ID corresponding to the current (or most-recent) suspend attempt.
   int current_suspend_id_;
 
-  // IDs of delays registered by clients that haven't yet said they're ready to
-  // suspend.
-  std::set<int> delay_ids_being_waited_on_;
+  // Time at which the current suspend attempt was announced.
+  base::TimeTicks suspend_start_time_;
+
+  // Number of delays that timed out for the current suspend attempt.
+  int num_timed_out_delays_;
+
+  // Deadlines of the delays registered by clients that haven't yet said
+  // they're ready to suspend, keyed by delay ID.
+  std::map<int, base::TimeTicks> delay_deadlines_;
+
+  // IDs of the delays that timed out for the current suspend attempt and
+  // haven't reported readiness since.
+  std::set<int> timed_out_delay_ids_;
+
+  // Keyed by GetClientKey().
+  std::map<std::string, ClientHistory> client_histories_;
+
+  // Shortest timeout that GetDelayTimeout() derives from a client's history.
+  base::TimeDelta min_adaptive_timeout_;
+
+  Clock clock_;
 
   // Used to invoke NotifyObservers().
   base::OneShotTimer notify_observers_timer_;
@@ -38,11 +38,28 @@ class TestObserver : public SuspendDelayObserver {
     return loop_runner_.StartLoop(timeout_);
   }
 
+  // Returns a comma-separated list of the delays reported by
+  // OnSuspendDelayDone(), with "!" appended to ones that timed out, and
+  // clears it.
+  std::string GetDoneDelays() {
+    std::string delays = done_delays_;
+    done_delays_.clear();
+    return delays;
+  }
+
   // SuspendDelayObserver implementation:
   void OnReadyForSuspend(SuspendDelayController* controller,
                          int suspend_id) override {
     loop_runner_.StopLoop();
   }
+  void OnSuspendDelayDone(SuspendDelayController* controller,
+                          int suspend_id,
+                          const std::string& description,
+                          bool timed_out) override {
+    if (!done_delays_.empty())
+      done_delays_ += ",";
+    done_delays_ += description + (timed_out ? "!" : "");
+  }
 
  private:
   // Maximum time to wait for readiness.
@@ -50,6 +67,9 @@ class TestObserver : public SuspendDelayObserver {
 
   TestMainLoopRunner loop_runner_;
 
+  // Delays reported by OnSuspendDelayDone().
+  std::string done_delays_;
+
   DISALLOW_COPY_AND_ASSIGN(TestObserver);
 };
 
@@ -210,6 +230,144 @@ TEST_F(SuspendDelayControllerTest, Timeout) {
   EXPECT_TRUE(controller_.ready_for_suspend());
 }
 
+TEST_F(SuspendDelayControllerTest, ReportDoneDelays) {
+  const std::string kClient1 = "client1";
+  const std::string kClient2 = "client2";
+  const std::string kClient3 = "client3";
+  int delay_id1 =
+      RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kClient1);
+  int delay_id2 =
+      RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kClient2);
+  RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kClient3);
+
+  // Delays that report readiness or go away should be reported as they do,
+  // and the remaining ones once they time out.
+  const int kSuspendId = 5;
+  controller_.PrepareForSuspend(kSuspendId);
+  EXPECT_EQ("", observer_.GetDoneDelays());
+  HandleSuspendReadiness(delay_id2, kSuspendId, kClient2);
+  EXPECT_EQ("client2-desc", observer_.GetDoneDelays());
+  UnregisterSuspendDelay(delay_id1, kClient1);
+  EXPECT_EQ("client1-desc", observer_.GetDoneDelays());
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_EQ("client3-desc!", observer_.GetDoneDelays());
+}
+
+TEST_F(SuspendDelayControllerTest, PerDelayTimeouts) {
+  // A delay that doesn't report readiness shouldn't hold up suspend past its
+  // own timeout, even if other delays have longer ones.
+  const std::string kFastClient = "fast";
+  const std::string kSlowClient = "slow";
+  RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kFastClient);
+  int slow_delay_id =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kSlowClient);
+
+  const int kSuspendId = 5;
+  controller_.PrepareForSuspend(kSuspendId);
+  HandleSuspendReadiness(slow_delay_id, kSuspendId, kSlowClient);
+  EXPECT_FALSE(controller_.ready_for_suspend());
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_TRUE(controller_.ready_for_suspend());
+  EXPECT_EQ("slow-desc,fast-desc!", observer_.GetDoneDelays());
+}
+
+TEST_F(SuspendDelayControllerTest, TimeoutFromResponseTimes) {
+  controller_.set_min_adaptive_timeout_for_testing(
+      base::TimeDelta::FromMilliseconds(10));
+  const std::string kClient = "client";
+  int delay_id =
+      RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(200), kClient);
+
+  int suspend_id = 5;
+  for (int i = 0; i < 5; ++i) {
+    controller_.PrepareForSuspend(++suspend_id);
+    HandleSuspendReadiness(delay_id, suspend_id, kClient);
+    EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  }
+  EXPECT_EQ("client-desc,client-desc,client-desc,client-desc,client-desc",
+            observer_.GetDoneDelays());
+
+  // A client that has been answering quickly should still get its full
+  // timeout.
+  controller_.PrepareForSuspend(++suspend_id);
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(50));
+  EXPECT_FALSE(observer_.RunUntilReadyForSuspend());
+  EXPECT_FALSE(controller_.ready_for_suspend());
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(kSuspendTimeoutMs));
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_EQ("client-desc!", observer_.GetDoneDelays());
+
+  // Once it has timed out, it should only be waited for a multiple of its
+  // slowest response.
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(100));
+  controller_.PrepareForSuspend(++suspend_id);
+  EXPECT_FALSE(controller_.ready_for_suspend());
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_EQ("client-desc!", observer_.GetDoneDelays());
+}
+
+TEST_F(SuspendDelayControllerTest, RepeatedTimeouts) {
+  controller_.set_min_adaptive_timeout_for_testing(
+      base::TimeDelta::FromMilliseconds(1));
+  const std::string kClient = "client";
+  int delay_id = RegisterSuspendDelay(
+      base::TimeDelta::FromMilliseconds(200), kClient);
+
+  // A client that keeps timing out should only be waited for briefly.
+  int suspend_id = 5;
+  for (int i = 0; i < 3; ++i) {
+    controller_.PrepareForSuspend(++suspend_id);
+    EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  }
+  EXPECT_EQ("client-desc!,client-desc!,client-desc!",
+            observer_.GetDoneDelays());
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(100));
+  controller_.PrepareForSuspend(++suspend_id);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_EQ("client-desc!", observer_.GetDoneDelays());
+
+  // Once it reports readiness again, its full timeout should be restored.
+  controller_.PrepareForSuspend(++suspend_id);
+  HandleSuspendReadiness(delay_id, suspend_id, kClient);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(50));
+  controller_.PrepareForSuspend(++suspend_id);
+  EXPECT_FALSE(observer_.RunUntilReadyForSuspend());
+  EXPECT_FALSE(controller_.ready_for_suspend());
+}
+
+TEST_F(SuspendDelayControllerTest, LateReadinessEndsPenalty) {
+  controller_.set_min_adaptive_timeout_for_testing(
+      base::TimeDelta::FromMilliseconds(1));
+  const std::string kClient = "client";
+  int delay_id = RegisterSuspendDelay(
+      base::TimeDelta::FromMilliseconds(200), kClient);
+
+  int suspend_id = 5;
+  for (int i = 0; i < 3; ++i) {
+    controller_.PrepareForSuspend(++suspend_id);
+    EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  }
+  EXPECT_EQ("client-desc!,client-desc!,client-desc!",
+            observer_.GetDoneDelays());
+
+  // The client is only waited for briefly, but reporting readiness after that
+  // should still count as an answer and restore its full timeout.
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(100));
+  controller_.PrepareForSuspend(++suspend_id);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_EQ("client-desc!", observer_.GetDoneDelays());
+  HandleSuspendReadiness(delay_id, suspend_id, kClient);
+  EXPECT_EQ("", observer_.GetDoneDelays());
+
+  observer_.set_timeout(base::TimeDelta::FromMilliseconds(50));
+  controller_.PrepareForSuspend(++suspend_id);
+  EXPECT_FALSE(observer_.RunUntilReadyForSuspend());
+  EXPECT_FALSE(controller_.ready_for_suspend());
+  HandleSuspendReadiness(delay_id, suspend_id, kClient);
+  EXPECT_TRUE(controller_.ready_for_suspend());
+}
+
 TEST_F(SuspendDelayControllerTest, FinishRequest) {
   const std::string kClient = "client";
   RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(1), kClient);
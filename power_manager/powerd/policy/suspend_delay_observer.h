@@ -5,6 +5,8 @@
 #ifndef POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_OBSERVER_H_
 #define POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_OBSERVER_H_
 
+#include <string>
+
 namespace power_manager {
 namespace policy {
 
@@ -19,6 +21,14 @@ class SuspendDelayObserver {
   // identifies the current suspend attempt.
   virtual void OnReadyForSuspend(SuspendDelayController* controller,
                                  int suspend_id) = 0;
+
+  // Called when the delay described by |description| stops holding up
+  // |suspend_id|, either because its client reported readiness or went away
+  // or, if |timed_out| is true, because it didn't report readiness in time.
+  virtual void OnSuspendDelayDone(SuspendDelayController* controller,
+                                  int suspend_id,
+                                  const std::string& description,
+                                  bool timed_out) {}
 };
 
 }  // namespace policy
@@ -0,0 +1,127 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/policy/suspend_tracer.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+
+#include "power_manager/common/clock.h"
+#include "power_manager/common/metrics_constants.h"
+#include "power_manager/common/metrics_sender.h"
+
+namespace power_manager {
+namespace policy {
+
+const char SuspendTracer::kPreparePhase[] = "Prepare";
+const char SuspendTracer::kDelaysPhase[] = "Delays";
+const char SuspendTracer::kDelayPhasePrefix[] = "Delay:";
+const char SuspendTracer::kDarkDelaysPhase[] = "DarkDelays";
+const char SuspendTracer::kDarkDelayPhasePrefix[] = "DarkDelay:";
+const char SuspendTracer::kAttemptPhase[] = "Attempt";
+const char SuspendTracer::kUndoPreparePhase[] = "UndoPrepare";
+
+SuspendPhase::SuspendPhase() {}
+
+SuspendPhase::SuspendPhase(const std::string& name,
+                           base::TimeDelta start,
+                           base::TimeDelta duration)
+    : name(name), start(start), duration(duration) {}
+
+SuspendTrace::SuspendTrace() : suspend_id(0) {}
+
+SuspendTrace::~SuspendTrace() {}
+
+SuspendTracer::SuspendTracer(Clock* clock) : clock_(clock) {
+  DCHECK(clock_);
+}
+
+SuspendTracer::~SuspendTracer() {}
+
+void SuspendTracer::StartRequest(int suspend_id) {
+  DCHECK_NE(suspend_id, 0);
+  request_start_time_ = clock_->GetCurrentTime();
+  current_trace_ = SuspendTrace();
+  current_trace_.suspend_id = suspend_id;
+  running_phases_.clear();
+}
+
+void SuspendTracer::StartPhase(const std::string& name) {
+  if (!tracing())
+    return;
+  running_phases_.push_back(
+      SuspendPhase(name, GetElapsedTime(), base::TimeDelta()));
+}
+
+void SuspendTracer::EndPhase(const std::string& name) {
+  const int index = FindRunningPhase(name);
+  if (index < 0)
+    return;
+  SuspendPhase phase = running_phases_[index];
+  running_phases_.erase(running_phases_.begin() + index);
+  phase.duration = std::max(base::TimeDelta(), GetElapsedTime() - phase.start);
+  current_trace_.phases.push_back(phase);
+}
+
+void SuspendTracer::AddSubphase(const std::string& name,
+                                const std::string& parent) {
+  const int index = FindRunningPhase(parent);
+  if (index < 0)
+    return;
+  const base::TimeDelta start = running_phases_[index].start;
+  current_trace_.phases.push_back(SuspendPhase(
+      name, start, std::max(base::TimeDelta(), GetElapsedTime() - start)));
+}
+
+void SuspendTracer::AddSubphases(const std::vector<SuspendPhase>& phases,
+                                 const std::string& parent) {
+  const int index = FindRunningPhase(parent);
+  if (index < 0)
+    return;
+  base::TimeDelta start = running_phases_[index].start;
+  for (const SuspendPhase& phase : phases) {
+    current_trace_.phases.push_back(
+        SuspendPhase(phase.name, start, phase.duration));
+    start += phase.duration;
+  }
+}
+
+void SuspendTracer::FinishRequest() {
+  if (!tracing())
+    return;
+  while (!running_phases_.empty())
+    EndPhase(running_phases_.back().name);
+
+  for (const SuspendPhase& phase : current_trace_.phases) {
+    VLOG(1) << "Suspend request " << current_trace_.suspend_id << " phase "
+            << phase.name << " started at " << phase.start.InMilliseconds()
+            << " ms and took " << phase.duration.InMilliseconds() << " ms";
+    if (phase.name.find(':') != std::string::npos)
+      continue;
+    SendMetric(kMetricSuspendPhaseDurationMsPrefix + phase.name,
+               phase.duration.InMilliseconds(),
+               kMetricSuspendPhaseDurationMsMin,
+               kMetricSuspendPhaseDurationMsMax,
+               kMetricDefaultBuckets);
+  }
+
+  last_trace_ = current_trace_;
+  current_trace_ = SuspendTrace();
+}
+
+base::TimeDelta SuspendTracer::GetElapsedTime() const {
+  return clock_->GetCurrentTime() - request_start_time_;
+}
+
+int SuspendTracer::FindRunningPhase(const std::string& name) const {
+  for (int i = static_cast<int>(running_phases_.size()) - 1; i >= 0; --i) {
+    if (running_phases_[i].name == name)
+      return i;
+  }
+  return -1;
+}
+
+}  // namespace policy
+}  // namespace power_manager
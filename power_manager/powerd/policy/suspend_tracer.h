@@ -0,0 +1,122 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACER_H_
+#define POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACER_H_
+
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace power_manager {
+
+class Clock;
+
+namespace policy {
+
+// A timed phase of a suspend request.
+struct SuspendPhase {
+  SuspendPhase();
+  SuspendPhase(const std::string& name,
+               base::TimeDelta start,
+               base::TimeDelta duration);
+
+  // Phases named after a suspend delay's client contain a ':', e.g.
+  // "Delay:chrome". Others have fixed names, e.g. "Prepare" or "Sync".
+  std::string name;
+
+  // Time from the start of the request to the start of the phase.
+  base::TimeDelta start;
+
+  base::TimeDelta duration;
+};
+
+// The phases of a suspend request, in the order in which they ended.
+struct SuspendTrace {
+  SuspendTrace();
+  ~SuspendTrace();
+
+  // ID of the request, or 0 if no request was traced.
+  int suspend_id;
+
+  std::vector<SuspendPhase> phases;
+};
+
+// Records how long each phase of a suspend request takes, so that slow
+// suspends and resumes can be attributed to suspend delays, the script's
+// explicit sync or the kernel.
+//
+// Times are monotonic, so they don't include the time the system spent asleep.
+class SuspendTracer {
+ public:
+  // Names of the phases that Suspender records itself.
+  static const char kPreparePhase[];
+  static const char kDelaysPhase[];
+  static const char kDelayPhasePrefix[];
+  static const char kDarkDelaysPhase[];
+  static const char kDarkDelayPhasePrefix[];
+  static const char kAttemptPhase[];
+  static const char kUndoPreparePhase[];
+
+  // |clock| is used to timestamp phases.
+  explicit SuspendTracer(Clock* clock);
+  ~SuspendTracer();
+
+  bool tracing() const { return current_trace_.suspend_id != 0; }
+
+  // Returns the trace of the last request that finished.
+  const SuspendTrace& last_trace() const { return last_trace_; }
+
+  // Starts tracing request |suspend_id|.
+  void StartRequest(int suspend_id);
+
+  // Starts or ends the phase |name| now. Phases may overlap. EndPhase() does
+  // nothing if |name| was not started.
+  void StartPhase(const std::string& name);
+  void EndPhase(const std::string& name);
+
+  // Records that the phase |name| started when the still-running phase
+  // |parent| did and ends now, e.g. a client's suspend delay within the wait
+  // for all delays.
+  void AddSubphase(const std::string& name, const std::string& parent);
+
+  // Records |phases|, which only have durations, back to back from the start
+  // of the still-running phase |parent|. Used for the phases of a suspend
+  // attempt that powerd_suspend times.
+  void AddSubphases(const std::vector<SuspendPhase>& phases,
+                    const std::string& parent);
+
+  // Ends the phases that are still running, moves the current trace to
+  // |last_trace_| and reports the duration of each fixed-name phase to UMA.
+  void FinishRequest();
+
+ private:
+  // Returns the time since the current request started.
+  base::TimeDelta GetElapsedTime() const;
+
+  // Returns the index of the running phase |name| in |running_phases_|, or
+  // -1 if it isn't running.
+  int FindRunningPhase(const std::string& name) const;
+
+  Clock* clock_;  // weak
+
+  // Time at which the current request started.
+  base::TimeTicks request_start_time_;
+
+  SuspendTrace current_trace_;
+  SuspendTrace last_trace_;
+
+  // Phases that were started but haven't ended yet. Their durations are
+  // unset.
+  std::vector<SuspendPhase> running_phases_;
+
+  DISALLOW_COPY_AND_ASSIGN(SuspendTracer);
+};
+
+}  // namespace policy
+}  // namespace power_manager
+
+#endif  // POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACER_H_
@@ -0,0 +1,149 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/policy/suspend_tracer.h"
+
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/strings/stringprintf.h>
+#include <gtest/gtest.h>
+
+#include "power_manager/common/clock.h"
+#include "power_manager/common/metrics_constants.h"
+#include "power_manager/common/metrics_sender_stub.h"
+
+namespace power_manager {
+namespace policy {
+
+namespace {
+
+// Returns a string describing |trace|'s phases as
+// "<name>@<start_ms>+<duration_ms>", separated by commas.
+std::string GetPhases(const SuspendTrace& trace) {
+  std::string phases;
+  for (const SuspendPhase& phase : trace.phases) {
+    if (!phases.empty())
+      phases += ",";
+    phases += base::StringPrintf("%s@%" PRId64 "+%" PRId64,
+                                 phase.name.c_str(),
+                                 phase.start.InMilliseconds(),
+                                 phase.duration.InMilliseconds());
+  }
+  return phases;
+}
+
+}  // namespace
+
+class SuspendTracerTest : public testing::Test {
+ public:
+  SuspendTracerTest() : tracer_(&clock_) {
+    clock_.set_current_time_for_testing(base::TimeTicks::FromInternalValue(
+        1000 * base::Time::kMicrosecondsPerSecond));
+  }
+
+ protected:
+  // Advances |clock_| by |ms| milliseconds.
+  void AdvanceTime(int ms) {
+    clock_.set_current_time_for_testing(
+        clock_.GetCurrentTime() + base::TimeDelta::FromMilliseconds(ms));
+  }
+
+  MetricsSenderStub metrics_sender_;
+  Clock clock_;
+  SuspendTracer tracer_;
+};
+
+TEST_F(SuspendTracerTest, TracePhases) {
+  EXPECT_FALSE(tracer_.tracing());
+  EXPECT_EQ(0, tracer_.last_trace().suspend_id);
+
+  // Phases started outside of a request should be ignored.
+  tracer_.StartPhase(SuspendTracer::kPreparePhase);
+  tracer_.EndPhase(SuspendTracer::kPreparePhase);
+
+  tracer_.StartRequest(5);
+  EXPECT_TRUE(tracer_.tracing());
+  tracer_.StartPhase(SuspendTracer::kPreparePhase);
+  AdvanceTime(10);
+  tracer_.EndPhase(SuspendTracer::kPreparePhase);
+  tracer_.StartPhase(SuspendTracer::kDelaysPhase);
+  AdvanceTime(20);
+  tracer_.AddSubphase("Delay:fast", SuspendTracer::kDelaysPhase);
+  AdvanceTime(30);
+  tracer_.AddSubphase("Delay:slow", SuspendTracer::kDelaysPhase);
+  tracer_.EndPhase(SuspendTracer::kDelaysPhase);
+
+  // Phases timed by powerd_suspend should be laid out back to back from the
+  // start of the attempt.
+  tracer_.StartPhase(SuspendTracer::kAttemptPhase);
+  AdvanceTime(100);
+  std::vector<SuspendPhase> script_phases;
+  script_phases.push_back(SuspendPhase(
+      "Sync", base::TimeDelta(), base::TimeDelta::FromMilliseconds(40)));
+  script_phases.push_back(SuspendPhase(
+      "ResumeDevices", base::TimeDelta(),
+      base::TimeDelta::FromMilliseconds(50)));
+  tracer_.AddSubphases(script_phases, SuspendTracer::kAttemptPhase);
+  tracer_.EndPhase(SuspendTracer::kAttemptPhase);
+
+  // Phases that are still running should be ended by FinishRequest().
+  tracer_.StartPhase(SuspendTracer::kUndoPreparePhase);
+  AdvanceTime(5);
+  tracer_.FinishRequest();
+  EXPECT_FALSE(tracer_.tracing());
+
+  EXPECT_EQ(5, tracer_.last_trace().suspend_id);
+  EXPECT_EQ("Prepare@0+10,Delay:fast@10+20,Delay:slow@10+50,Delays@10+50,"
+            "Sync@60+40,ResumeDevices@100+50,Attempt@60+100,"
+            "UndoPrepare@160+5",
+            GetPhases(tracer_.last_trace()));
+
+  // Only phases with fixed names should be reported to UMA.
+  const struct {
+    const char* phase;
+    int duration_ms;
+  } kExpectedMetrics[] = {
+    {"Prepare", 10},
+    {"Delays", 50},
+    {"Sync", 40},
+    {"ResumeDevices", 50},
+    {"Attempt", 100},
+    {"UndoPrepare", 5},
+  };
+  ASSERT_EQ(static_cast<int>(arraysize(kExpectedMetrics)),
+            metrics_sender_.num_metrics());
+  for (size_t i = 0; i < arraysize(kExpectedMetrics); ++i) {
+    EXPECT_EQ(MetricsSenderStub::Metric::CreateExp(
+                  std::string(kMetricSuspendPhaseDurationMsPrefix) +
+                      kExpectedMetrics[i].phase,
+                  kExpectedMetrics[i].duration_ms,
+                  kMetricSuspendPhaseDurationMsMin,
+                  kMetricSuspendPhaseDurationMsMax,
+                  kMetricDefaultBuckets).ToString(),
+              metrics_sender_.GetMetric(i));
+  }
+}
+
+TEST_F(SuspendTracerTest, NewRequestDiscardsUnfinishedOne) {
+  tracer_.StartRequest(5);
+  tracer_.StartPhase(SuspendTracer::kPreparePhase);
+  AdvanceTime(10);
+
+  // A request that didn't finish (e.g. because the system shut down instead)
+  // should be dropped when the next one starts.
+  tracer_.StartRequest(6);
+  tracer_.EndPhase(SuspendTracer::kPreparePhase);
+  tracer_.StartPhase(SuspendTracer::kAttemptPhase);
+  AdvanceTime(20);
+  tracer_.FinishRequest();
+  EXPECT_EQ(6, tracer_.last_trace().suspend_id);
+  EXPECT_EQ("Attempt@0+20", GetPhases(tracer_.last_trace()));
+}
+
+}  // namespace policy
+}  // namespace power_manager
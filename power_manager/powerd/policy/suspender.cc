@@ -36,6 +36,10 @@ void Suspender::TestApi::SetCurrentWallTime(base::Time wall_time) {
   suspender_->clock_->set_current_wall_time_for_testing(wall_time);
 }
 
+void Suspender::TestApi::SetCurrentTime(base::TimeTicks now) {
+  suspender_->clock_->set_current_time_for_testing(now);
+}
+
 bool Suspender::TestApi::TriggerResuspendTimeout() {
   if (!suspender_->resuspend_timer_.IsRunning())
     return false;
@@ -54,6 +58,7 @@ Suspender::Suspender()
       dbus_wrapper_(NULL),
       dark_resume_(NULL),
       clock_(new Clock),
+      tracer_(clock_.get()),
       state_(STATE_IDLE),
       handling_event_(false),
       processing_queued_events_(false),
@@ -203,6 +208,28 @@ void Suspender::RecordDarkResumeWakeReason(
   response_sender.Run(dbus::Response::FromMethodCall(method_call));
 }
 
+void Suspender::GetLastSuspendTrace(
+    dbus::MethodCall* method_call,
+    dbus::ExportedObject::ResponseSender response_sender) {
+  const SuspendTrace& trace = tracer_.last_trace();
+  std::unique_ptr<dbus::Response> response =
+      dbus::Response::FromMethodCall(method_call);
+  dbus::MessageWriter writer(response.get());
+  writer.AppendInt32(trace.suspend_id);
+  dbus::MessageWriter array_writer(nullptr);
+  writer.OpenArray("(sxx)", &array_writer);
+  for (const SuspendPhase& phase : trace.phases) {
+    dbus::MessageWriter struct_writer(nullptr);
+    array_writer.OpenStruct(&struct_writer);
+    struct_writer.AppendString(phase.name);
+    struct_writer.AppendInt64(phase.start.InMicroseconds());
+    struct_writer.AppendInt64(phase.duration.InMicroseconds());
+    array_writer.CloseContainer(&struct_writer);
+  }
+  writer.CloseContainer(&array_writer);
+  response_sender.Run(std::move(response));
+}
+
 void Suspender::HandleLidOpened() {
   HandleEvent(EVENT_USER_ACTIVITY);
 }
@@ -228,6 +255,7 @@ void Suspender::OnReadyForSuspend(SuspendDelayController* controller,
                                   int suspend_id) {
   if (controller == suspend_delay_controller_.get() &&
       suspend_id == suspend_request_id_) {
+    tracer_.EndPhase(SuspendTracer::kDelaysPhase);
     HandleEvent(EVENT_SUSPEND_DELAYS_READY);
   } else if (controller == dark_suspend_delay_controller_.get() &&
              suspend_id == dark_suspend_id_) {
@@ -244,10 +272,26 @@ void Suspender::OnReadyForSuspend(SuspendDelayController* controller,
     if (!suspend_request_supplied_wakeup_count_)
       wakeup_count_valid_ = delegate_->ReadSuspendWakeupCount(&wakeup_count_);
 
+    tracer_.EndPhase(SuspendTracer::kDarkDelaysPhase);
     HandleEvent(EVENT_READY_TO_RESUSPEND);
   }
 }
 
+void Suspender::OnSuspendDelayDone(SuspendDelayController* controller,
+                                   int suspend_id,
+                                   const std::string& description,
+                                   bool timed_out) {
+  if (controller == suspend_delay_controller_.get() &&
+      suspend_id == suspend_request_id_) {
+    tracer_.AddSubphase(SuspendTracer::kDelayPhasePrefix + description,
+                        SuspendTracer::kDelaysPhase);
+  } else if (controller == dark_suspend_delay_controller_.get() &&
+             suspend_id == dark_suspend_id_) {
+    tracer_.AddSubphase(SuspendTracer::kDarkDelayPhasePrefix + description,
+                        SuspendTracer::kDarkDelaysPhase);
+  }
+}
+
 void Suspender::RegisterSuspendDelayInternal(
     SuspendDelayController *controller,
     dbus::MethodCall* method_call,
@@ -413,7 +457,11 @@ void Suspender::StartRequest() {
   // Call PrepareToSuspend() before emitting SuspendImminent -- powerd needs to
   // set the backlight level to 0 before Chrome turns the display on in response
   // to the signal.
+  tracer_.StartRequest(suspend_request_id_);
+  tracer_.StartPhase(SuspendTracer::kPreparePhase);
   delegate_->PrepareToSuspend();
+  tracer_.EndPhase(SuspendTracer::kPreparePhase);
+  tracer_.StartPhase(SuspendTracer::kDelaysPhase);
   suspend_delay_controller_->PrepareForSuspend(suspend_request_id_);
   dark_resume_->PrepareForSuspendRequest();
   delegate_->SetSuspendAnnounced(true);
@@ -430,9 +478,11 @@ void Suspender::FinishRequest(bool success) {
       clock_->GetCurrentWallTime() - suspend_request_start_time_);
   EmitSuspendDoneSignal(suspend_request_id_, suspend_duration);
   delegate_->SetSuspendAnnounced(false);
+  tracer_.StartPhase(SuspendTracer::kUndoPreparePhase);
   delegate_->UndoPrepareToSuspend(success,
       initial_num_attempts_ ? initial_num_attempts_ : current_num_attempts_,
       dark_resume_->InDarkResume());
+  tracer_.EndPhase(SuspendTracer::kUndoPreparePhase);
 
   // Only report dark resume metrics if it is actually enabled to prevent a
   // bunch of noise in the data.
@@ -441,6 +491,7 @@ void Suspender::FinishRequest(bool success) {
                                          suspend_duration);
   }
   dark_resume_->UndoPrepareForSuspendRequest();
+  tracer_.FinishRequest();
 }
 
 Suspender::State Suspender::Suspend() {
@@ -496,8 +547,12 @@ Suspender::State Suspender::Suspend() {
                  clock_->GetCurrentWallTime() - dark_resume_start_time_);
   }
   current_num_attempts_++;
+  tracer_.StartPhase(SuspendTracer::kAttemptPhase);
   const Delegate::SuspendResult result =
       delegate_->DoSuspend(wakeup_count_, wakeup_count_valid_, duration);
+  tracer_.AddSubphases(delegate_->GetLastSuspendAttemptPhases(),
+                       SuspendTracer::kAttemptPhase);
+  tracer_.EndPhase(SuspendTracer::kAttemptPhase);
 
   if (result == Delegate::SUSPEND_SUCCESSFUL)
     dark_resume_->HandleSuccessfulResume();
@@ -561,6 +616,7 @@ Suspender::State Suspender::Suspend() {
     if (dark_resume_->CanSafelyExitDarkResume()) {
       LOG(INFO) << "Notifying registered dark suspend delays about "
                 << dark_suspend_id_;
+      tracer_.StartPhase(SuspendTracer::kDarkDelaysPhase);
       dark_suspend_delay_controller_->PrepareForSuspend(dark_suspend_id_);
       EmitDarkSuspendImminentSignal(dark_suspend_id_);
     } else {
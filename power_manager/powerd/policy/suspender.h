@@ -21,6 +21,7 @@
 #include <dbus/message.h>
 
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
+#include "power_manager/powerd/policy/suspend_tracer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
 
 namespace power_manager {
@@ -71,6 +72,9 @@ class SuspendDelayController;
 //
 // At any point before Suspend() has been called, user activity can cancel the
 // current suspend attempt.
+//
+// Each phase of a request is recorded by a SuspendTracer; the trace of the last
+// finished request is returned by GetLastSuspendTrace().
 class Suspender : public SuspendDelayObserver {
  public:
   // Information about dark resumes used for histograms.
@@ -143,6 +147,11 @@ class Suspender : public SuspendDelayObserver {
                                     bool wakeup_count_valid,
                                     base::TimeDelta duration) = 0;
 
+    // Returns the phases of the last DoSuspend() call that the powerd_suspend
+    // script timed, in the order in which they happened. Only their names and
+    // durations are set.
+    virtual std::vector<SuspendPhase> GetLastSuspendAttemptPhases() = 0;
+
     // Undoes the preparations performed by PrepareToSuspend(). Called by
     // FinishRequest().
     virtual void UndoPrepareToSuspend(bool success,
@@ -177,8 +186,13 @@ class Suspender : public SuspendDelayObserver {
       return suspender_->dark_suspend_delay_controller_.get();
     }
 
+    const SuspendTrace& last_trace() const {
+      return suspender_->tracer_.last_trace();
+    }
+
     // Sets the time used as "now".
     void SetCurrentWallTime(base::Time wall_time);
+    void SetCurrentTime(base::TimeTicks now);
 
     // Runs Suspender::HandleEvent(EVENT_READY_TO_RESUSPEND) if
     // |resuspend_timer_| is running. Returns false otherwise.
@@ -238,6 +252,13 @@ class Suspender : public SuspendDelayObserver {
       dbus::MethodCall* method_call,
       dbus::ExportedObject::ResponseSender response_sender);
 
+  // Replies with the ID of the last finished suspend request (or 0) and an
+  // array of (name, start, duration) structs describing its phases, with
+  // times in microseconds relative to the start of the request.
+  void GetLastSuspendTrace(
+      dbus::MethodCall* method_call,
+      dbus::ExportedObject::ResponseSender response_sender);
+
   // Handles the lid being opened, user activity, or the system shutting down,
   // any of which may abort an in-progress suspend attempt.
   void HandleLidOpened();
@@ -250,9 +271,13 @@ class Suspender : public SuspendDelayObserver {
                                   const std::string& old_owner,
                                   const std::string& new_owner);
 
-  // SuspendDelayObserver override:
+  // SuspendDelayObserver overrides:
   void OnReadyForSuspend(SuspendDelayController *controller,
                          int suspend_id) override;
+  void OnSuspendDelayDone(SuspendDelayController* controller,
+                          int suspend_id,
+                          const std::string& description,
+                          bool timed_out) override;
 
  private:
   // States that Suspender can be in while the event loop is running.
@@ -331,6 +356,7 @@ class Suspender : public SuspendDelayObserver {
   system::DarkResumeInterface* dark_resume_;  // weak
 
   std::unique_ptr<Clock> clock_;
+  SuspendTracer tracer_;
   std::unique_ptr<SuspendDelayController> suspend_delay_controller_;
   std::unique_ptr<SuspendDelayController> dark_suspend_delay_controller_;
 
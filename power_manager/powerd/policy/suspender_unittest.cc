@@ -8,6 +8,7 @@
 #include <base/callback.h>
 #include <base/compiler_specific.h>
 #include <base/logging.h>
+#include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
 #include <chromeos/dbus/service_constants.h>
 #include <gtest/gtest.h>
@@ -66,6 +67,9 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
   void set_shutdown_callback(base::Closure callback) {
     shutdown_callback_ = callback;
   }
+  void set_suspend_attempt_phases(const std::vector<SuspendPhase>& phases) {
+    suspend_attempt_phases_ = phases;
+  }
 
   bool suspend_announced() const { return suspend_announced_; }
   uint64_t suspend_wakeup_count() const { return suspend_wakeup_count_; }
@@ -121,6 +125,10 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
     return suspend_result_;
   }
 
+  std::vector<SuspendPhase> GetLastSuspendAttemptPhases() override {
+    return suspend_attempt_phases_;
+  }
+
   void UndoPrepareToSuspend(bool success,
                             int num_suspend_attempts,
                             bool canceled_while_in_dark_resume) override {
@@ -188,6 +196,9 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
   bool suspend_wakeup_count_valid_;
   base::TimeDelta suspend_duration_;
 
+  // Phases returned by GetLastSuspendAttemptPhases().
+  std::vector<SuspendPhase> suspend_attempt_phases_;
+
   // Arguments passed to last invocation of UndoPrepareToSuspend().
   bool suspend_was_successful_;
   int num_suspend_attempts_;
@@ -325,6 +336,50 @@ TEST_F(SuspenderTest, SuspendResume) {
   EXPECT_FALSE(test_api_.TriggerResuspendTimeout());
 }
 
+// Tests that the phases of a suspend request are traced.
+TEST_F(SuspenderTest, TraceSuspendRequest) {
+  Init();
+  EXPECT_EQ(0, test_api_.last_trace().suspend_id);
+
+  base::TimeTicks now = base::TimeTicks::FromInternalValue(1000);
+  test_api_.SetCurrentTime(now);
+  suspender_.RequestSuspend();
+  const int suspend_id = test_api_.suspend_id();
+
+  // Readiness of the delays for other requests should be ignored.
+  now += base::TimeDelta::FromMilliseconds(100);
+  test_api_.SetCurrentTime(now);
+  suspender_.OnSuspendDelayDone(test_api_.suspend_delay_controller(),
+                                suspend_id, "chrome", false);
+  suspender_.OnSuspendDelayDone(test_api_.suspend_delay_controller(),
+                                suspend_id - 1, "stale", false);
+  suspender_.OnSuspendDelayDone(test_api_.dark_suspend_delay_controller(),
+                                suspend_id, "dark", false);
+
+  std::vector<SuspendPhase> script_phases;
+  script_phases.push_back(SuspendPhase(
+      "Sync", base::TimeDelta(), base::TimeDelta::FromMilliseconds(30)));
+  delegate_.set_suspend_attempt_phases(script_phases);
+  delegate_.set_suspend_callback(
+      base::Bind(&Suspender::TestApi::SetCurrentTime,
+                 base::Unretained(&test_api_),
+                 now + base::TimeDelta::FromMilliseconds(200)));
+  AnnounceReadyForSuspend(suspend_id);
+  EXPECT_EQ(JoinActions(kSuspend, kUnprepare, NULL), delegate_.GetActions());
+
+  const SuspendTrace& trace = test_api_.last_trace();
+  EXPECT_EQ(suspend_id, trace.suspend_id);
+  std::vector<std::string> phases;
+  for (const SuspendPhase& phase : trace.phases) {
+    phases.push_back(base::StringPrintf(
+        "%s+%d", phase.name.c_str(),
+        static_cast<int>(phase.duration.InMilliseconds())));
+  }
+  EXPECT_EQ("Prepare+0,Delay:chrome+100,Delays+100,Sync+30,Attempt+200,"
+            "UndoPrepare+0",
+            base::JoinString(phases, ","));
+}
+
 // Tests that Suspender doesn't pass a wakeup count to the delegate when it was
 // unable to fetch one.
 TEST_F(SuspenderTest, MissingWakeupCount) {
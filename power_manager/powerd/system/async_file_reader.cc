@@ -5,12 +5,17 @@
 #include "power_manager/powerd/system/async_file_reader.h"
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
+#include <cstring>
 
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 
 #include "power_manager/common/util.h"
 
@@ -23,20 +28,45 @@ namespace {
 // larger chunks.  Start with 4 KB and double the chunk size with each new read.
 const size_t kInitialFileReadSize = 4096;
 
-// How often to poll for the AIO status.
-const int kPollMs = 100;
+// How long to wait for the notification of a canceled read before giving up.
+const int kNotificationTimeoutMs = 1000;
+
+// Runs on a thread started by glibc when an AIO read completes. |value| holds
+// the eventfd to signal.
+void NotifyReadComplete(sigval value) {
+  const uint64_t count = 1;
+  if (HANDLE_EINTR(write(value.sival_int, &count, sizeof(count))) !=
+      sizeof(count))
+    PLOG(ERROR) << "Unable to signal AIO completion";
+}
 
 }  // namespace
 
 AsyncFileReader::AsyncFileReader()
     : read_in_progress_(false),
       fd_(-1),
-      aio_buffer_(NULL),
-      initial_read_size_(kInitialFileReadSize) {
+      event_fd_(-1),
+      pending_notifications_(0),
+      initial_read_size_(kInitialFileReadSize),
+      next_read_size_(kInitialFileReadSize) {
 }
 
 AsyncFileReader::~AsyncFileReader() {
   Reset();
+  // Notifications may still be on their way for canceled reads; wait for them
+  // so that they don't write to a closed (or reused) FD.
+  while (pending_notifications_ > 0 && event_fd_ != -1) {
+    const uint64_t pending = pending_notifications_;
+    ReadEventFd(true);
+    if (pending_notifications_ == pending) {
+      LOG(ERROR) << "Gave up waiting for " << pending
+                 << " AIO notification(s)";
+      break;
+    }
+  }
+  event_fd_watcher_.StopWatchingFileDescriptor();
+  if (event_fd_ != -1)
+    close(event_fd_);
   close(fd_);
 }
 
@@ -49,6 +79,24 @@ bool AsyncFileReader::Init(const std::string& filename) {
     return false;
   }
   filename_ = filename;
+
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ == -1) {
+    PLOG(ERROR) << "Could not create eventfd for " << filename;
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          event_fd_, true, base::MessageLoopForIO::WATCH_READ,
+          &event_fd_watcher_, this)) {
+    LOG(ERROR) << "Unable to watch FD " << event_fd_;
+    close(event_fd_);
+    event_fd_ = -1;
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
   return true;
 }
 
@@ -68,7 +116,7 @@ void AsyncFileReader::StartRead(
     return;
   }
 
-  if (!AsyncRead(initial_read_size_, 0)) {
+  if (!AsyncRead(next_read_size_, 0)) {
     if (!error_cb.is_null())
       error_cb.Run();
     return;
@@ -78,38 +126,43 @@ void AsyncFileReader::StartRead(
   read_in_progress_ = true;
 }
 
+void AsyncFileReader::OnFileCanReadWithoutBlocking(int fd) {
+  DCHECK_EQ(fd, event_fd_);
+  ReadEventFd(false);
+  UpdateState();
+}
+
+void AsyncFileReader::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED() << "Unexpected non-blocking write notification for FD " << fd;
+}
+
 void AsyncFileReader::UpdateState() {
-  if (!read_in_progress_) {
-    update_state_timer_.Reset();
+  if (!read_in_progress_)
     return;
-  }
 
   int status = aio_error(&aio_control_);
 
-  // If the read is still in-progress, keep the timer running.
+  // If the read is still in progress, this was the notification of an earlier,
+  // canceled read. Keep waiting.
   if (status == EINPROGRESS)
     return;
 
-  // Otherwise, we stop the timer.
-  update_state_timer_.Stop();
-
   switch (status) {
     case ECANCELED:
       Reset();
       break;
     case 0: {
       size_t size = aio_return(&aio_control_);
-      // Save the data that was read, and free the buffer.
+      // Save the data that was read.
       stored_data_.insert(
-          stored_data_.end(), aio_buffer_, aio_buffer_ + size);
-      delete [] aio_buffer_;
-      aio_buffer_ = NULL;
+          stored_data_.end(), aio_buffer_.data(), aio_buffer_.data() + size);
 
       if (size == aio_control_.aio_nbytes) {
         // Read more data if the previous read didn't reach the end of file.
         if (AsyncRead(size * 2, aio_control_.aio_offset + size))
           break;
       }
+      next_read_size_ = std::max(initial_read_size_, stored_data_.size() + 1);
       if (!read_cb_.is_null())
         read_cb_.Run(stored_data_);
       Reset();
@@ -130,8 +183,6 @@ void AsyncFileReader::Reset() {
   if (!read_in_progress_)
     return;
 
-  update_state_timer_.Stop();
-
   int cancel_result = aio_cancel(fd_, &aio_control_);
   if (cancel_result == -1) {
     PLOG(ERROR) << "aio_cancel() failed";
@@ -143,8 +194,6 @@ void AsyncFileReader::Reset() {
       PLOG(ERROR) << "aio_suspend() failed";
   }
 
-  delete[] aio_buffer_;
-  aio_buffer_ = NULL;
   stored_data_.clear();
   read_cb_.Reset();
   error_cb_.Reset();
@@ -152,26 +201,41 @@ void AsyncFileReader::Reset() {
 }
 
 bool AsyncFileReader::AsyncRead(int size, int offset) {
-  aio_buffer_ = new char[size];
+  if (aio_buffer_.size() < static_cast<size_t>(size))
+    aio_buffer_.resize(size);
 
   memset(&aio_control_, 0, sizeof(aio_control_));
   aio_control_.aio_nbytes = size;
   aio_control_.aio_fildes = fd_;
   aio_control_.aio_offset = offset;
-  aio_control_.aio_buf = aio_buffer_;
+  aio_control_.aio_buf = aio_buffer_.data();
+  aio_control_.aio_sigevent.sigev_notify = SIGEV_THREAD;
+  aio_control_.aio_sigevent.sigev_notify_function = &NotifyReadComplete;
+  aio_control_.aio_sigevent.sigev_value.sival_int = event_fd_;
 
   if (aio_read(&aio_control_) == -1) {
     LOG(ERROR) << "Unable to access " << filename_;
-    delete [] aio_buffer_;
-    aio_buffer_ = NULL;
     return false;
   }
-
-  update_state_timer_.Start(FROM_HERE,
-      base::TimeDelta::FromMilliseconds(kPollMs), this,
-      &AsyncFileReader::UpdateState);
+  pending_notifications_++;
   return true;
 }
 
+void AsyncFileReader::ReadEventFd(bool block) {
+  if (block) {
+    struct pollfd poll_fd = { event_fd_, POLLIN, 0 };
+    if (HANDLE_EINTR(poll(&poll_fd, 1, kNotificationTimeoutMs)) <= 0)
+      return;
+  }
+  uint64_t count = 0;
+  if (HANDLE_EINTR(read(event_fd_, &count, sizeof(count))) !=
+      sizeof(count)) {
+    if (errno != EAGAIN)
+      PLOG(ERROR) << "Unable to read eventfd for " << filename_;
+    return;
+  }
+  pending_notifications_ -= std::min(count, pending_notifications_);
+}
+
 }  // namespace system
 }  // namespace power_manager
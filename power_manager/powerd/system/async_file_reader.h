@@ -8,22 +8,26 @@
 #include <aio.h>
 #include <unistd.h>
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include <base/callback.h>
 #include <base/macros.h>
-#include <base/timer/timer.h>
+#include <base/message_loop/message_loop.h>
 
 namespace power_manager {
 namespace system {
 
-class AsyncFileReader {
+// Reads files with POSIX AIO. Completed reads are signalled through an eventfd
+// watched by the message loop, so nothing runs while a read is in progress.
+class AsyncFileReader : public base::MessageLoopForIO::Watcher {
  public:
   AsyncFileReader();
   ~AsyncFileReader();
 
   void set_initial_read_size_for_testing(size_t size) {
-    initial_read_size_ = size;
+    initial_read_size_ = next_read_size_ = size;
   }
 
   // Read file asynchronously, passing its contents to |read_cb| when done.
@@ -39,6 +43,10 @@ class AsyncFileReader {
   // Indicates whether a file handle has been opened.
   bool HasOpenedFile() const;
 
+  // base::MessageLoopForIO::Watcher implementation:
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
  private:
   friend class AsyncFileReaderTest;
 
@@ -52,8 +60,9 @@ class AsyncFileReader {
   // StartRead().  Returns true if the AIO read was successfully enqueued.
   bool AsyncRead(int size, int offset);
 
-  // Deletes |update_state_timeout_id_|'s timeout and resets it to 0 if set.
-  void CancelUpdateStateTimeout();
+  // Reads |event_fd_|'s counter, accounting for the notifications in
+  // |pending_notifications_|. If |block| is true, waits for one first.
+  void ReadEventFd(bool block);
 
   // Flag indicating whether there is an active AIO read.
   bool read_in_progress_;
@@ -67,13 +76,27 @@ class AsyncFileReader {
   // File for AIO reads.
   int fd_;
 
-  // Buffer for AIO reads.
-  char* aio_buffer_;
+  // Incremented by AIO completion notifications, which run on threads started
+  // by glibc, and watched by |event_fd_watcher_|.
+  int event_fd_;
+  base::MessageLoopForIO::FileDescriptorWatcher event_fd_watcher_;
+
+  // Number of AIO reads whose completion hasn't been counted from |event_fd_|
+  // yet. Each enqueued read is notified exactly once, even if it's canceled.
+  uint64_t pending_notifications_;
+
+  // Buffer for AIO reads, kept for reuse by later reads.
+  std::vector<char> aio_buffer_;
 
   // Number of bytes to be read for the first chunk.  This is a variable instead
   // of a constant so unit tests can modify it.
   size_t initial_read_size_;
 
+  // Number of bytes to be read for the first chunk of the next read: enough to
+  // reach the end of the file as it was last read, so that files that are read
+  // repeatedly usually take a single chunk.
+  size_t next_read_size_;
+
   // Accumulator for data read by AIO.
   std::string stored_data_;
 
@@ -81,9 +104,6 @@ class AsyncFileReader {
   base::Callback<void(const std::string&)> read_cb_;
   base::Callback<void()> error_cb_;
 
-  // Runs UpdateState().
-  base::RepeatingTimer update_state_timer_;
-
   DISALLOW_COPY_AND_ASSIGN(AsyncFileReader);
 };
 
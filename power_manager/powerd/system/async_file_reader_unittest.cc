@@ -84,13 +84,18 @@ class AsyncFileReaderTest : public ::testing::Test {
   // false if initialization failed or if the reader timed out.
   bool WriteAndReadData(size_t file_size, size_t initial_read_size)
       WARN_UNUSED_RESULT {
-    data_.clear();
-    got_error_ = false;
-
     CreateFile(path_, file_size);
     file_reader_->set_initial_read_size_for_testing(initial_read_size);
     if (!file_reader_->Init(path_.value()))
       return false;
+    return ReadData();
+  }
+
+  // Uses the already-initialized |file_reader_| to read |path_| again.
+  // Returns false if the reader timed out.
+  bool ReadData() WARN_UNUSED_RESULT {
+    data_.clear();
+    got_error_ = false;
     file_reader_->StartRead(
         base::Bind(&AsyncFileReaderTest::ReadCallback, base::Unretained(this)),
         base::Bind(&AsyncFileReaderTest::ErrorCallback,
@@ -171,6 +176,39 @@ TEST_F(AsyncFileReaderTest, MultipleBlockReadFull) {
   EXPECT_EQ(ReadFile(), data_);
 }
 
+// Read a file repeatedly as it changes size, reusing the reader's buffer.
+TEST_F(AsyncFileReaderTest, RepeatedReads) {
+  ASSERT_TRUE(WriteAndReadData(32 * GetMultipleReadFactor(3) + 5, 32));
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+
+  ASSERT_TRUE(ReadData());
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+
+  CreateFile(path_, 10);
+  ASSERT_TRUE(ReadData());
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+
+  CreateFile(path_, 32 * GetMultipleReadFactor(6));
+  ASSERT_TRUE(ReadData());
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+}
+
+// Starting a read while another is in progress should abort the first one.
+TEST_F(AsyncFileReaderTest, RestartRead) {
+  CreateFile(path_, 1000);
+  ASSERT_TRUE(file_reader_->Init(path_.value()));
+  file_reader_->StartRead(
+      base::Bind(&AsyncFileReaderTest::ReadCallback, base::Unretained(this)),
+      base::Bind(&AsyncFileReaderTest::ErrorCallback, base::Unretained(this)));
+  ASSERT_TRUE(ReadData());
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+}
+
 // Initializing the reader with a nonexistent file should fail.
 TEST_F(AsyncFileReaderTest, InitWithMissingFile) {
   EXPECT_FALSE(file_reader_->Init(path_.value()));
@@ -24,6 +24,14 @@ namespace system {
 namespace {
 // C++14's <algorithm> could do std::max(EV_MAX, KEY_MAX, SW_MAX);
 static constexpr int kMaxBit = MAX(MAX(EV_MAX, KEY_MAX), SW_MAX);
+
+// Number of events requested by each read() call.
+const size_t kEventsPerRead = 64;
+
+// Maximum number of read() calls made by a single ReadEvents() call. Bounds
+// the time spent reading from a device that reports events faster than they
+// can be read.
+const int kMaxReadsPerCall = 4;
 };
 
 // EventDevice
@@ -123,31 +131,43 @@ bool EventDevice::GetSwitchBit(int bit) {
 
 bool EventDevice::ReadEvents(std::vector<input_event>* events_out) {
   DCHECK(events_out);
+  // clear() keeps the vector's capacity, so callers that reuse |events_out|
+  // don't reallocate it on every wakeup.
   events_out->clear();
 
-  struct input_event events[64];
-  ssize_t read_size = HANDLE_EINTR(read(fd_, events, sizeof(events)));
-  if (read_size < 0) {
-    // ENODEV is expected if the device was just unplugged.
-    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENODEV)
-      PLOG(ERROR) << "Reading events from " << path_.value() << " failed";
-    return false;
-  } else if (read_size == 0) {
-    LOG(ERROR) << "Read returned 0 when reading events from " << path_.value();
-    return false;
-  }
-
-  const size_t num_events = read_size / sizeof(struct input_event);
-  if (read_size % sizeof(struct input_event)) {
-    LOG(ERROR) << "Read " << read_size << " byte(s) while expecting "
-               << sizeof(struct input_event) << "-byte events";
-    return false;
+  // Read straight into |events_out|, draining whatever accumulated since the
+  // last wakeup so that a burst of input doesn't need a wakeup per read.
+  for (int i = 0; i < kMaxReadsPerCall; ++i) {
+    const size_t old_size = events_out->size();
+    events_out->resize(old_size + kEventsPerRead);
+    const ssize_t read_size = HANDLE_EINTR(
+        read(fd_, events_out->data() + old_size,
+             kEventsPerRead * sizeof(struct input_event)));
+    if (read_size < 0) {
+      // ENODEV is expected if the device was just unplugged.
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENODEV)
+        PLOG(ERROR) << "Reading events from " << path_.value() << " failed";
+      events_out->resize(old_size);
+      break;
+    } else if (read_size == 0) {
+      LOG(ERROR) << "Read returned 0 when reading events from "
+                 << path_.value();
+      events_out->resize(old_size);
+      break;
+    } else if (read_size % sizeof(struct input_event)) {
+      LOG(ERROR) << "Read " << read_size << " byte(s) while expecting "
+                 << sizeof(struct input_event) << "-byte events";
+      events_out->resize(old_size);
+      break;
+    }
+
+    const size_t num_events = read_size / sizeof(struct input_event);
+    events_out->resize(old_size + num_events);
+    // A short read means that the kernel's buffer is empty.
+    if (num_events < kEventsPerRead)
+      break;
   }
-
-  events_out->reserve(num_events);
-  for (size_t i = 0; i < num_events; ++i)
-    events_out->push_back(events[i]);
-  return true;
+  return !events_out->empty();
 }
 
 void EventDevice::WatchForEvents(base::Closure new_events_cb) {
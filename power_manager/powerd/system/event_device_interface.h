@@ -58,8 +58,10 @@ class EventDeviceInterface {
   // Must not be called after ReadEvents() or WatchForEvents().
   virtual TabletMode GetInitialTabletMode() = 0;
 
-  // Reads a number of events into |events_out|. Returns true if the operation
-  // was successful and events were present.
+  // Reads the pending events into |events_out|, replacing its contents.
+  // Returns true if the operation was successful and events were present.
+  // Callers that read repeatedly should pass the same vector each time so its
+  // storage can be reused.
   virtual bool ReadEvents(std::vector<input_event>* events_out) = 0;
 
   // Start watching this device for incoming events, and run |new_events_cb|
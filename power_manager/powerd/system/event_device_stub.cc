@@ -57,6 +57,7 @@ TabletMode EventDeviceStub::GetInitialTabletMode() {
 }
 
 bool EventDeviceStub::ReadEvents(std::vector<input_event>* events_out) {
+  events_out->clear();
   if (events_.empty())
     return false;
 
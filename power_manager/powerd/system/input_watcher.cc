@@ -102,6 +102,7 @@ bool GetPowerButtonStateFromEvent(const input_event& event,
 const char InputWatcher::kInputUdevSubsystem[] = "input";
 const char InputWatcher::kPowerButtonToSkip[] = "LNXPWRBN";
 const char InputWatcher::kPowerButtonToSkipForLegacy[] = "isa";
+const int InputWatcher::kHoverNotificationIntervalMs = 16;
 
 InputWatcher::InputWatcher()
     : dev_input_path_(kDevInputPath),
@@ -114,6 +115,7 @@ InputWatcher::InputWatcher()
       tablet_mode_(TABLET_MODE_OFF),
       detect_hover_(false),
       hovering_(false),
+      reported_hovering_(false),
       current_multitouch_slot_(0),
       multitouch_slots_hover_state_(0),
       single_touch_hover_valid_(false),
@@ -131,6 +133,15 @@ InputWatcher::~InputWatcher() {
     close(console_fd_);
 }
 
+bool InputWatcher::TriggerHoverNotificationTimeoutForTesting() {
+  if (!hover_notification_timer_.IsRunning())
+    return false;
+
+  hover_notification_timer_.Stop();
+  NotifyObserversAboutHover();
+  return true;
+}
+
 bool InputWatcher::Init(
     std::unique_ptr<EventDeviceFactoryInterface> event_device_factory,
     PrefsInterface* prefs,
@@ -187,22 +198,21 @@ LidState InputWatcher::QueryLidState() {
   const uint32_t device_types = GetDeviceTypes(lid_device_);
   while (true) {
     // Stop when we fail to read any more events.
-    std::vector<input_event> events;
-    if (!lid_device_->ReadEvents(&events))
+    if (!lid_device_->ReadEvents(&lid_events_))
       break;
 
-    // Get the state from the last lid event (|events| may also contain non-lid
-    // events).
+    // Get the state from the last lid event (|lid_events_| may also contain
+    // non-lid events).
     for (std::vector<input_event>::const_reverse_iterator it =
-             events.rbegin(); it != events.rend(); ++it) {
+             lid_events_.rbegin(); it != lid_events_.rend(); ++it) {
       if (GetLidStateFromEvent(*it, &lid_state_))
         break;
     }
 
-    queued_events_.reserve(queued_events_.size() + events.size());
-    for (auto event : events)
+    queued_events_.reserve(queued_events_.size() + lid_events_.size());
+    for (const input_event& event : lid_events_)
       queued_events_.push_back(std::make_pair(event, device_types));
-    VLOG(1) << "Queued " << events.size()
+    VLOG(1) << "Queued " << lid_events_.size()
             << " event(s) while querying lid state";
   }
 
@@ -299,20 +309,21 @@ uint32_t InputWatcher::GetDeviceTypes(
 void InputWatcher::OnNewEvents(EventDeviceInterface* device) {
   SendQueuedEvents();
 
-  std::vector<input_event> events;
-  if (!device->ReadEvents(&events))
+  if (!device->ReadEvents(&new_events_))
     return;
 
-  VLOG(1) << "Read " << events.size() << " event(s) from "
+  VLOG(1) << "Read " << new_events_.size() << " event(s) from "
           << device->GetDebugName();
   const uint32_t device_types = GetDeviceTypes(device);
-  for (size_t i = 0; i < events.size(); ++i) {
+  for (const input_event& event : new_events_) {
     // Update |lid_state_| here instead of in ProcessEvent() so we can avoid
     // modifying it in response to queued events.
     if (device_types & DEVICE_LID_SWITCH)
-      GetLidStateFromEvent(events[i], &lid_state_);
-    ProcessEvent(events[i], device_types);
+      GetLidStateFromEvent(event, &lid_state_);
+    ProcessEvent(event, device_types);
   }
+  if (device_types & DEVICE_HOVER)
+    UpdateHoverState();
 }
 
 void InputWatcher::ProcessEvent(const input_event& event,
@@ -388,20 +399,13 @@ void InputWatcher::ProcessHoverEvent(const input_event& event) {
     single_touch_hover_valid_ = (event.value == 1);
   } else if (event.type == EV_SYN && event.code == SYN_REPORT) {
     // SYN_REPORT events indicate the end of the current set of multitouch data.
-    // Check whether the overall hovering state is different from before and
-    // notify observers if so.
+    // Update the overall hovering state; observers are notified by
+    // UpdateHoverState() once the whole batch of events has been processed.
     VLOG(2) << "SYN_REPORT";
     bool multi_touch_hovering = multitouch_slots_hover_state_ != 0;
     bool single_touch_hovering = (single_touch_hover_distance_nonzero_ &&
                                   single_touch_hover_valid_);
-    bool hovering = multi_touch_hovering || single_touch_hovering;
-    if (hovering != hovering_) {
-      VLOG(1) << "Notifying observers about hover state change to "
-              << (hovering ? "on" : "off");
-      hovering_ = hovering;
-      FOR_EACH_OBSERVER(InputObserver, observers_,
-                        OnHoverStateChange(hovering_));
-    }
+    hovering_ = multi_touch_hovering || single_touch_hovering;
   }
 }
 
@@ -498,9 +502,48 @@ void InputWatcher::HandleRemovedInput(int input_num) {
 }
 
 void InputWatcher::SendQueuedEvents() {
-  for (auto event_pair : queued_events_)
+  if (queued_events_.empty())
+    return;
+
+  bool saw_hover_events = false;
+  for (auto event_pair : queued_events_) {
     ProcessEvent(event_pair.first, event_pair.second);
+    saw_hover_events |= (event_pair.second & DEVICE_HOVER) != 0;
+  }
   queued_events_.clear();
+  if (saw_hover_events)
+    UpdateHoverState();
+}
+
+void InputWatcher::UpdateHoverState() {
+  if (hovering_ == reported_hovering_ ||
+      hover_notification_timer_.IsRunning())
+    return;
+
+  const base::TimeDelta interval =
+      base::TimeDelta::FromMilliseconds(kHoverNotificationIntervalMs);
+  const base::TimeTicks now = clock_.GetCurrentTime();
+  if (!last_hover_notification_time_.is_null() &&
+      now - last_hover_notification_time_ < interval) {
+    hover_notification_timer_.Start(
+        FROM_HERE, last_hover_notification_time_ + interval - now, this,
+        &InputWatcher::NotifyObserversAboutHover);
+    return;
+  }
+
+  NotifyObserversAboutHover();
+}
+
+void InputWatcher::NotifyObserversAboutHover() {
+  if (hovering_ == reported_hovering_)
+    return;
+
+  VLOG(1) << "Notifying observers about hover state change to "
+          << (hovering_ ? "on" : "off");
+  reported_hovering_ = hovering_;
+  last_hover_notification_time_ = clock_.GetCurrentTime();
+  FOR_EACH_OBSERVER(InputObserver, observers_,
+                    OnHoverStateChange(reported_hovering_));
 }
 
 }  // namespace system
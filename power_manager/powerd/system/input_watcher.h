@@ -17,6 +17,10 @@
 #include <base/memory/linked_ptr.h>
 #include <base/memory/weak_ptr.h>
 #include <base/observer_list.h>
+#include <base/time/time.h>
+#include <base/timer/timer.h>
+
+#include "power_manager/common/clock.h"
 
 #include "power_manager/common/power_constants.h"
 #include "power_manager/powerd/system/input_watcher_interface.h"
@@ -54,6 +58,12 @@ class InputWatcher : public InputWatcherInterface,
   // to keyboard events.
   static const char kPowerButtonToSkipForLegacy[];
 
+  // Minimum interval between hover notifications, roughly a display frame.
+  // Changes that occur sooner are coalesced and reported when the interval
+  // ends, so a finger skimming the touchpad doesn't produce a notification
+  // per report.
+  static const int kHoverNotificationIntervalMs;
+
   InputWatcher();
   virtual ~InputWatcher();
 
@@ -68,6 +78,11 @@ class InputWatcher : public InputWatcherInterface,
   EventDeviceFactoryInterface* release_event_device_factory_for_testing() {
     return event_device_factory_.release();
   }
+  Clock* clock_for_testing() { return &clock_; }
+
+  // If |hover_notification_timer_| is running, stops it, calls
+  // NotifyObserversAboutHover(), and returns true. Returns false otherwise.
+  bool TriggerHoverNotificationTimeoutForTesting() WARN_UNUSED_RESULT;
 
   // Returns true on success.
   bool Init(std::unique_ptr<EventDeviceFactoryInterface> event_device_factory,
@@ -101,7 +116,8 @@ class InputWatcher : public InputWatcherInterface,
   // Returns a bitfield of DeviceType values describing |device|.
   uint32_t GetDeviceTypes(const EventDeviceInterface* device) const;
 
-  // Flushes queued events and reads new events from |device|.
+  // Flushes queued events and reads new events from |device| into
+  // |new_events_|.
   void OnNewEvents(EventDeviceInterface* device);
 
   // Updates internal state and notifies observers in response to |event|.
@@ -118,12 +134,18 @@ class InputWatcher : public InputWatcherInterface,
   void HandleAddedInput(const std::string& input_name, int input_num);
   void HandleRemovedInput(int input_num);
 
-  // Calls NotifyObserversAboutEvent() for each event in |queued_events_| and
-  // clears the vector.
+  // Calls ProcessEvent() for each event in |queued_events_| and clears the
+  // vector.
   void SendQueuedEvents();
 
-  // Notifies observers about |event| if came from a lid switch or power button.
-  void NotifyObserversAboutEvent(const input_event& event);
+  // Notifies observers if |hovering_| differs from |reported_hovering_|,
+  // unless they were notified less than kHoverNotificationIntervalMs ago, in
+  // which case |hover_notification_timer_| is started to notify them later.
+  void UpdateHoverState();
+
+  // Notifies observers about |hovering_| if it differs from
+  // |reported_hovering_| and updates |last_hover_notification_time_|.
+  void NotifyObserversAboutHover();
 
   base::FilePath dev_input_path_;
   base::FilePath sys_class_input_path_;
@@ -160,9 +182,19 @@ class InputWatcher : public InputWatcherInterface,
   // Should hover events be reported?
   bool detect_hover_;
 
-  // Most-recently-reported hover state.
+  // Most-recently-seen hover state.
   bool hovering_;
 
+  // Most-recently-reported hover state.
+  bool reported_hovering_;
+
+  // Time at which observers were last notified about a hover state change.
+  base::TimeTicks last_hover_notification_time_;
+
+  // Runs NotifyObserversAboutHover() once kHoverNotificationIntervalMs have
+  // passed since the last notification.
+  base::OneShotTimer hover_notification_timer_;
+
   // Multitouch slot for which input events are currently being reported. See
   // https://www.kernel.org/doc/Documentation/input/multi-touch-protocol.txt for
   // more details about the protocol.
@@ -184,6 +216,13 @@ class InputWatcher : public InputWatcherInterface,
   // QueryLidState() that haven't yet been sent to observers.
   std::vector<std::pair<input_event, uint32_t>> queued_events_;
 
+  // Buffers passed to EventDeviceInterface::ReadEvents() by OnNewEvents() and
+  // QueryLidState(), respectively. Kept as members so their storage is reused
+  // across reads; separate since observers may call QueryLidState() while
+  // OnNewEvents() is iterating over |new_events_|.
+  std::vector<input_event> new_events_;
+  std::vector<input_event> lid_events_;
+
   // Posted by QueryLidState() to run SendQueuedEvents() to notify observers
   // about |queued_events_|.
   base::CancelableClosure send_queued_events_task_;
@@ -196,6 +235,8 @@ class InputWatcher : public InputWatcherInterface,
 
   UdevInterface* udev_;  // non-owned
 
+  Clock clock_;
+
   // Keyed by input event number.
   typedef std::map<int, linked_ptr<EventDeviceInterface>> InputMap;
   InputMap event_devices_;
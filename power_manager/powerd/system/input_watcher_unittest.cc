@@ -15,6 +15,7 @@
 #include <linux/input.h>
 
 #include "power_manager/common/action_recorder.h"
+#include "power_manager/common/clock.h"
 #include "power_manager/common/fake_prefs.h"
 #include "power_manager/powerd/system/event_device_stub.h"
 #include "power_manager/powerd/system/input_observer.h"
@@ -109,6 +110,13 @@ class InputWatcherTest : public testing::Test {
       observer_.reset();
     }
     input_watcher_.reset(new InputWatcher);
+    // Advance the clock by a full interval whenever it's read so that hover
+    // changes are reported immediately unless a test says otherwise.
+    Clock* clock = input_watcher_->clock_for_testing();
+    clock->set_current_time_for_testing(
+        base::TimeTicks::FromInternalValue(1000));
+    clock->set_time_step_for_testing(base::TimeDelta::FromMilliseconds(
+        InputWatcher::kHoverNotificationIntervalMs));
     input_watcher_->set_dev_input_path_for_testing(dev_input_path_);
     input_watcher_->set_sys_class_input_path_for_testing(sys_class_input_path_);
     ASSERT_TRUE(input_watcher_->Init(
@@ -456,6 +464,55 @@ TEST_F(InputWatcherTest, HoverSingletouch) {
   EXPECT_EQ(kNoActions, observer_->GetActions());
 }
 
+TEST_F(InputWatcherTest, HoverNotificationsCoalesced) {
+  linked_ptr<EventDeviceStub> touchpad(new EventDeviceStub);
+  touchpad->set_hover_supported(true);
+  touchpad->set_has_left_button(true);
+  AddDevice("event0", touchpad);
+  detect_hover_pref_ = 1;
+  Init();
+  input_watcher_->clock_for_testing()->set_time_step_for_testing(
+      base::TimeDelta());
+
+  // Hovering that starts and stops within a single batch of events shouldn't
+  // be reported.
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, 0);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, -1);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->NotifyAboutEvents();
+  EXPECT_EQ(kNoActions, observer_->GetActions());
+  EXPECT_FALSE(input_watcher_->TriggerHoverNotificationTimeoutForTesting());
+
+  // The first change should be reported immediately.
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, 0);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->NotifyAboutEvents();
+  EXPECT_EQ(kHoverOnAction, observer_->GetActions());
+
+  // Changes within the interval should be held back, and nothing should be
+  // reported if the state ends up where it started.
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, -1);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->NotifyAboutEvents();
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, 1);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->NotifyAboutEvents();
+  EXPECT_EQ(kNoActions, observer_->GetActions());
+  ASSERT_TRUE(input_watcher_->TriggerHoverNotificationTimeoutForTesting());
+  EXPECT_EQ(kNoActions, observer_->GetActions());
+
+  // A change that's still pending when the interval ends should be reported
+  // then.
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, -1);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->NotifyAboutEvents();
+  EXPECT_EQ(kNoActions, observer_->GetActions());
+  ASSERT_TRUE(input_watcher_->TriggerHoverNotificationTimeoutForTesting());
+  EXPECT_EQ(kHoverOffAction, observer_->GetActions());
+  EXPECT_FALSE(input_watcher_->TriggerHoverNotificationTimeoutForTesting());
+}
+
 TEST_F(InputWatcherTest, IgnoreDevices) {
   // Create a device that looks like a power button but that doesn't follow the
   // expected device naming scheme. InputWatcher shouldn't request eents from
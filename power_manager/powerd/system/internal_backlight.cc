@@ -4,7 +4,9 @@
 
 #include "power_manager/powerd/system/internal_backlight.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <string>
 
 #include <base/files/file_enumerator.h>
@@ -70,8 +72,8 @@ InternalBacklight::InternalBacklight()
     : clock_(new Clock),
       max_brightness_level_(0),
       current_brightness_level_(0),
-      transition_start_level_(0),
-      transition_end_level_(0) {
+      transition_end_level_(0),
+      next_transition_step_(0) {
 }
 
 InternalBacklight::~InternalBacklight() {}
@@ -131,6 +133,14 @@ bool InternalBacklight::Init(const base::FilePath& base_path,
     return false;
   }
 
+  brightness_file_.Initialize(brightness_path_,
+                              base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+  if (!brightness_file_.IsValid()) {
+    LOG(WARNING) << "Unable to open " << brightness_path_.value() << ": "
+                 << base::File::ErrorToString(
+                        brightness_file_.error_details());
+  }
+
   ReadBrightnessLevelFromFile(actual_brightness_path_,
                               &current_brightness_level_);
   return true;
@@ -167,16 +177,19 @@ bool InternalBacklight::SetBrightnessLevel(int64_t level,
     return WriteBrightness(level);
   }
 
+  // Repeated requests for the level that's already being approached (e.g.
+  // from ambient light readings that don't change the target) leave the
+  // transition in progress alone rather than restarting its curve.
+  if (transition_timer_.IsRunning() && level == transition_end_level_)
+    return true;
+
+  const bool was_running = transition_timer_.IsRunning();
   transition_start_time_ = clock_->GetCurrentTime();
-  transition_end_time_ = transition_start_time_ + interval;
-  transition_start_level_ = current_brightness_level_;
   transition_end_level_ = level;
-  if (!transition_timer_.IsRunning()) {
-    transition_timer_.Start(FROM_HERE,
-        base::TimeDelta::FromMilliseconds(kTransitionIntervalMs), this,
-        &InternalBacklight::HandleTransitionTimeout);
+  ComputeTransitionSteps(level, interval);
+  ScheduleNextTransitionStep();
+  if (!was_running)
     transition_timer_start_time_ = transition_start_time_;
-  }
   return true;
 }
 
@@ -199,7 +212,7 @@ bool InternalBacklight::WriteBrightness(int64_t new_level) {
   if (current_brightness_level_ == 0 && !bl_power_path_.empty())
     WriteFile(bl_power_path_, FB_BLANK_UNBLANK);
 
-  if (!WriteFile(brightness_path_, new_level))
+  if (!WriteBrightnessFile(new_level))
     return false;
 
   current_brightness_level_ = new_level;
@@ -212,35 +225,84 @@ bool InternalBacklight::WriteBrightness(int64_t new_level) {
   return true;
 }
 
-void InternalBacklight::HandleTransitionTimeout() {
-  base::TimeTicks now = clock_->GetCurrentTime();
-  int64_t new_level = 0;
+bool InternalBacklight::WriteBrightnessFile(int64_t level) {
+  if (!brightness_file_.IsValid())
+    return WriteFile(brightness_path_, level);
+
+  const std::string buf = base::Int64ToString(level);
+  VLOG(1) << "Writing " << buf << " to " << brightness_path_.value();
+  // Truncating is a no-op for sysfs attributes, but keeps regular files (as
+  // used by tests) from retaining the tail of a longer earlier value.
+  if (!brightness_file_.SetLength(0) ||
+      brightness_file_.Write(0, buf.data(), buf.size()) !=
+          static_cast<int>(buf.size())) {
+    PLOG(ERROR) << "Unable to write \"" << buf << "\" to "
+                << brightness_path_.value();
+    return false;
+  }
+  return true;
+}
 
-  if (now >= transition_end_time_) {
-    new_level = transition_end_level_;
-    transition_timer_.Stop();
-  } else {
-    double transition_fraction =
-        (now - transition_start_time_).InMillisecondsF() /
-        (transition_end_time_ - transition_start_time_).InMillisecondsF();
-    int64_t intermediate_amount = lround(
-        transition_fraction *
-        (transition_end_level_ - transition_start_level_));
-    new_level = transition_start_level_ + intermediate_amount;
+void InternalBacklight::ComputeTransitionSteps(int64_t end_level,
+                                               base::TimeDelta interval) {
+  transition_steps_.clear();
+  next_transition_step_ = 0;
+
+  // Use one step per level, unless that would put steps closer together than
+  // kTransitionIntervalMs.
+  const int64_t start_level = current_brightness_level_;
+  const int64_t delta = end_level - start_level;
+  const int64_t max_steps = std::max(
+      static_cast<int64_t>(1),
+      interval.InMilliseconds() / static_cast<int64_t>(kTransitionIntervalMs));
+  const int64_t num_steps = std::min(std::abs(delta), max_steps);
+
+  transition_steps_.reserve(num_steps);
+  for (int64_t i = 1; i <= num_steps; ++i) {
+    TransitionStep step;
+    step.offset = interval * i / num_steps;
+    step.level = start_level +
+        lround(static_cast<double>(delta) * i / num_steps);
+    transition_steps_.push_back(step);
   }
+}
 
-  if (new_level == current_brightness_level_)
+void InternalBacklight::ScheduleNextTransitionStep() {
+  if (next_transition_step_ >= transition_steps_.size()) {
+    transition_timer_.Stop();
     return;
+  }
+  const base::TimeTicks step_time = transition_start_time_ +
+      transition_steps_[next_transition_step_].offset;
+  transition_timer_.Start(
+      FROM_HERE,
+      std::max(base::TimeDelta(), step_time - clock_->GetCurrentTime()), this,
+      &InternalBacklight::HandleTransitionTimeout);
+}
+
+void InternalBacklight::HandleTransitionTimeout() {
+  // Skip straight to the last step that's due in case the timer fired late.
+  const base::TimeDelta elapsed =
+      clock_->GetCurrentTime() - transition_start_time_;
+  int64_t new_level = current_brightness_level_;
+  while (next_transition_step_ < transition_steps_.size() &&
+         transition_steps_[next_transition_step_].offset <= elapsed) {
+    new_level = transition_steps_[next_transition_step_].level;
+    next_transition_step_++;
+  }
+
+  if (new_level != current_brightness_level_)
+    WriteBrightness(new_level);
 
-  WriteBrightness(new_level);
+  ScheduleNextTransitionStep();
 }
 
 void InternalBacklight::CancelTransition() {
   transition_timer_.Stop();
   transition_start_time_ = base::TimeTicks();
-  transition_end_time_ = base::TimeTicks();
-  transition_start_level_ = current_brightness_level_;
   transition_end_level_ = current_brightness_level_;
+  transition_steps_.clear();
+  next_transition_step_ = 0;
 }
 
 }  // namespace system
@@ -8,7 +8,9 @@
 #include <stdint.h>
 
 #include <memory>
+#include <vector>
 
+#include <base/files/file.h>
 #include <base/files/file_path.h>
 #include <base/macros.h>
 #include <base/time/time.h>
@@ -53,6 +55,9 @@ class InternalBacklight : public BacklightInterface {
   base::TimeTicks transition_timer_start_time() const {
     return transition_timer_start_time_;
   }
+  base::TimeDelta transition_timer_delay() const {
+    return transition_timer_.GetCurrentDelay();
+  }
   Clock* clock() { return clock_.get(); }
 
   // Calls HandleTransitionTimeout() as if |transition_timer_| had fired
@@ -68,14 +73,33 @@ class InternalBacklight : public BacklightInterface {
   bool TransitionInProgress() const override;
 
  private:
+  // A level that a transition reaches |offset| after it starts.
+  struct TransitionStep {
+    base::TimeDelta offset;
+    int64_t level;
+  };
+
   // Helper method that actually writes to |brightness_path_| and updates
   // |current_brightness_level_|, also writing to |bl_power_path_| if necessary.
   // Called by SetBrightnessLevel() and HandleTransitionTimeout(). Returns true
   // on success.
   bool WriteBrightness(int64_t new_level);
 
-  // Sets the brightness level appropriately for the current point in the
-  // transition.  When the transition is done, stops |transition_timer_|.
+  // Writes |level| through |brightness_file_|, falling back to opening
+  // |brightness_path_| if it isn't open. Returns true on success.
+  bool WriteBrightnessFile(int64_t level);
+
+  // Fills |transition_steps_| with the levels between the current level and
+  // |end_level| that a transition lasting |interval| passes through.
+  void ComputeTransitionSteps(int64_t end_level, base::TimeDelta interval);
+
+  // Starts |transition_timer_| to fire when the next step in
+  // |transition_steps_| is due.
+  void ScheduleNextTransitionStep();
+
+  // Writes the level of the last step in |transition_steps_| that is due, if
+  // any, and schedules the next one. When the transition is done, stops
+  // |transition_timer_|.
   void HandleTransitionTimeout();
 
   // Cancels |transition_timeout_id_| if set.
@@ -95,24 +119,36 @@ class InternalBacklight : public BacklightInterface {
   // details.
   base::FilePath bl_power_path_;
 
+  // |brightness_path_|, kept open so that each step of a transition is a
+  // single write() rather than an open(), write() and close().
+  base::File brightness_file_;
+
   // Cached maximum and last-set brightness levels.
   int64_t max_brightness_level_;
   int64_t current_brightness_level_;
 
-  // Calls HandleTransitionTimeout().
-  base::RepeatingTimer transition_timer_;
+  // Calls HandleTransitionTimeout() when the next step in
+  // |transition_steps_| is due.
+  base::OneShotTimer transition_timer_;
 
-  // Time at which |transition_timer_| was last started. Used for testing.
+  // Time at which |transition_timer_| was started for the current run of
+  // (possibly retargeted) transitions. Used for testing.
   base::TimeTicks transition_timer_start_time_;
 
-  // Times at which the current transition started and is scheduled to end.
+  // Time at which the current transition started.
   base::TimeTicks transition_start_time_;
-  base::TimeTicks transition_end_time_;
 
-  // Start and end brightness level for the current transition.
-  int64_t transition_start_level_;
+  // End brightness level for the current transition.
   int64_t transition_end_level_;
 
+  // The current transition, computed when it starts. Steps are at least
+  // kTransitionIntervalMs apart and each changes the level, so the timer only
+  // fires when there's something to write.
+  std::vector<TransitionStep> transition_steps_;
+
+  // Index in |transition_steps_| of the next step to write.
+  size_t next_transition_step_;
+
   DISALLOW_COPY_AND_ASSIGN(InternalBacklight);
 };
 
@@ -279,6 +279,50 @@ TEST_F(InternalBacklightTest, InterruptTransition) {
   EXPECT_EQ(kThreeQuartersBrightness, ReadBrightness(backlight_dir));
 }
 
+TEST_F(InternalBacklightTest, TransitionOnlyWakesForLevelChanges) {
+  // Use a backlight with just a few levels, like a keyboard backlight.
+  const int kMaxBrightness = 4;
+  base::FilePath backlight_dir = test_path_.Append("backlight");
+  PopulateBacklightDir(backlight_dir, 0, kMaxBrightness, 0);
+  InternalBacklight backlight;
+  const base::TimeTicks kStartTime = base::TimeTicks::FromInternalValue(10000);
+  backlight.clock()->set_current_time_for_testing(kStartTime);
+  ASSERT_TRUE(backlight.Init(test_path_, "*"));
+
+  // A one-second transition to the max level should only wake up once per
+  // level.
+  const base::TimeDelta kDuration = base::TimeDelta::FromSeconds(1);
+  const base::TimeDelta kStepDuration = kDuration / kMaxBrightness;
+  backlight.SetBrightnessLevel(kMaxBrightness, kDuration);
+  EXPECT_TRUE(backlight.transition_timer_is_running());
+  EXPECT_EQ(kStepDuration.InMilliseconds(),
+            backlight.transition_timer_delay().InMilliseconds());
+
+  backlight.clock()->set_current_time_for_testing(kStartTime + kStepDuration);
+  EXPECT_TRUE(backlight.TriggerTransitionTimeoutForTesting());
+  EXPECT_EQ(1, ReadBrightness(backlight_dir));
+  EXPECT_EQ(kStepDuration.InMilliseconds(),
+            backlight.transition_timer_delay().InMilliseconds());
+
+  // Requesting the same level again shouldn't restart the transition.
+  backlight.SetBrightnessLevel(kMaxBrightness, kDuration);
+  EXPECT_EQ(kStartTime.ToInternalValue(),
+            backlight.transition_timer_start_time().ToInternalValue());
+
+  // If the timer fires late, the levels that were missed should be skipped.
+  backlight.clock()->set_current_time_for_testing(
+      kStartTime + 3 * kStepDuration + kStepDuration / 2);
+  EXPECT_TRUE(backlight.TriggerTransitionTimeoutForTesting());
+  EXPECT_EQ(3, ReadBrightness(backlight_dir));
+  EXPECT_EQ((kStepDuration / 2).InMilliseconds(),
+            backlight.transition_timer_delay().InMilliseconds());
+
+  backlight.clock()->set_current_time_for_testing(kStartTime + kDuration);
+  EXPECT_FALSE(backlight.TriggerTransitionTimeoutForTesting());
+  EXPECT_EQ(kMaxBrightness, ReadBrightness(backlight_dir));
+  EXPECT_EQ(kMaxBrightness, backlight.GetCurrentBrightnessLevel());
+}
+
 TEST_F(InternalBacklightTest, BlPower) {
   const int kMaxBrightness = 100;
   const base::FilePath kDir = test_path_.Append("backlight");
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <utility>
 
 #include <base/bind.h>
 #include <base/files/file_enumerator.h>
@@ -58,36 +59,8 @@ const char kBatteryStatusFull[] = "Full";
 // which the system is being charged.
 const char kLinePowerStatusCharging[] = "Charging";
 
-// Reads the contents of |filename| within |directory| into |out|, trimming
-// trailing whitespace.  Returns true on success.
-bool ReadAndTrimString(const base::FilePath& directory,
-                       const std::string& filename,
-                       std::string* out) {
-  if (!base::ReadFileToString(directory.Append(filename), out))
-    return false;
-
-  base::TrimWhitespaceASCII(*out, base::TRIM_TRAILING, out);
-  return true;
-}
-
-// Reads a 64-bit integer value from a file and returns true on success.
-bool ReadInt64(const base::FilePath& directory,
-               const std::string& filename,
-               int64_t* out) {
-  std::string buffer;
-  if (!ReadAndTrimString(directory, filename, &buffer))
-    return false;
-  return base::StringToInt64(buffer, out);
-}
-
-// Reads an integer value and scales it to a double (see |kDoubleScaleFactor|.
-// Returns 0.0 on failure.
-double ReadScaledDouble(const base::FilePath& directory,
-                        const std::string& filename) {
-  int64_t value = 0;
-  return ReadInt64(directory, filename, &value) ?
-      kDoubleScaleFactor * value : 0.0;
-}
+// Prefix of the keys in a power supply's "uevent" file.
+const char kUeventKeyPrefix[] = "POWER_SUPPLY_";
 
 // Returns true if |type|, a power supply type read from a "type" file in
 // sysfs, indicates USB BC1.2 types.
@@ -104,19 +77,6 @@ bool IsDualRoleType(const std::string& type) {
   return type == "USB_PD_DRP";
 }
 
-// Returns true if |path|, a sysfs directory, corresponds to an external
-// peripheral (e.g. a wireless mouse or keyboard).
-bool IsExternalPeripheral(const base::FilePath& path) {
-  std::string scope;
-  return ReadAndTrimString(path, "scope", &scope) && scope == "Device";
-}
-
-// Returns true if |path|, a sysfs directory, corresponds to a battery.
-bool IsBatteryPresent(const base::FilePath& path) {
-  int64_t present = 0;
-  return ReadInt64(path, "present", &present) && present != 0;
-}
-
 // Returns a string describing |type|.
 const char* ExternalPowerToString(PowerSupplyProperties::ExternalPower type) {
   switch (type) {
@@ -167,6 +127,98 @@ PowerSupplyProperties::PowerSource::Port GetPortFromString(
 
 }  // namespace
 
+// Values of a power supply's attributes, read from its sysfs directory.
+//
+// The kernel reports all of a power supply's properties in the directory's
+// "uevent" file as POWER_SUPPLY_<NAME>=<value> lines, so that file is read once
+// per update rather than opening a file for each attribute. Attributes that it
+// doesn't list (e.g. "type" and "scope" on older kernels) and directories
+// without it are read file by file.
+class PowerSupplyAttributes {
+ public:
+  explicit PowerSupplyAttributes(const base::FilePath& path) : path_(path) {
+    std::string uevent;
+    if (!base::ReadFileToString(path_.Append("uevent"), &uevent))
+      return;
+    base::StringPairs pairs;
+    base::SplitStringIntoKeyValuePairs(uevent, '=', '\n', &pairs);
+    for (auto& pair : pairs) {
+      if (base::StartsWith(pair.first, kUeventKeyPrefix,
+                           base::CompareCase::SENSITIVE)) {
+        base::TrimWhitespaceASCII(pair.second, base::TRIM_TRAILING,
+                                  &pair.second);
+        uevent_values_[pair.first] = pair.second;
+      }
+    }
+  }
+  ~PowerSupplyAttributes() {}
+
+  const base::FilePath& path() const { return path_; }
+
+  // Returns true if the power supply has the attribute |name|.
+  bool Has(const std::string& name) const {
+    return uevent_values_.count(GetUeventKey(name)) ||
+        base::PathExists(path_.Append(name));
+  }
+
+  // Reads the value of the attribute |name| into |out|, trimming trailing
+  // whitespace. Returns true on success.
+  bool ReadString(const std::string& name, std::string* out) const {
+    const auto it = uevent_values_.find(GetUeventKey(name));
+    if (it != uevent_values_.end()) {
+      *out = it->second;
+      return true;
+    }
+    if (!base::ReadFileToString(path_.Append(name), out))
+      return false;
+    base::TrimWhitespaceASCII(*out, base::TRIM_TRAILING, out);
+    return true;
+  }
+
+  // Reads a 64-bit integer value and returns true on success.
+  bool ReadInt64(const std::string& name, int64_t* out) const {
+    std::string buffer;
+    return ReadString(name, &buffer) && base::StringToInt64(buffer, out);
+  }
+
+  // Reads an integer value and scales it to a double (see
+  // |kDoubleScaleFactor|). Returns 0.0 on failure.
+  double ReadScaledDouble(const std::string& name) const {
+    int64_t value = 0;
+    return ReadInt64(name, &value) ? kDoubleScaleFactor * value : 0.0;
+  }
+
+  // Returns true if the power supply is an external peripheral (e.g. a
+  // wireless mouse or keyboard).
+  bool IsExternalPeripheral() const {
+    std::string scope;
+    return ReadString("scope", &scope) && scope == "Device";
+  }
+
+  // Returns true if the power supply is a battery that is present.
+  bool IsBatteryPresent() const {
+    int64_t present = 0;
+    return ReadInt64("present", &present) && present != 0;
+  }
+
+ private:
+  // Returns the key of the attribute |name| (e.g. "charge_now") in the
+  // "uevent" file (e.g. "POWER_SUPPLY_CHARGE_NOW").
+  static std::string GetUeventKey(const std::string& name) {
+    std::string key = kUeventKeyPrefix;
+    for (char c : name)
+      key.push_back(base::ToUpperASCII(c));
+    return key;
+  }
+
+  const base::FilePath path_;
+
+  // Values read from the "uevent" file, keyed by their names there.
+  std::map<std::string, std::string> uevent_values_;
+
+  DISALLOW_COPY_AND_ASSIGN(PowerSupplyAttributes);
+};
+
 void CopyPowerStatusToProtocolBuffer(const PowerStatus& status,
                                      PowerSupplyProperties* proto) {
   DCHECK(proto);
@@ -344,6 +396,7 @@ bool PowerSupply::TestApi::TriggerPollTimeout() {
 const char PowerSupply::kUdevSubsystem[] = "power_supply";
 const char PowerSupply::kChargeControlLimitMaxFile[] =
     "charge_control_limit_max";
+const int PowerSupply::kFullBatteryPollMultiplier = 4;
 const int PowerSupply::kObservedBatteryChargeRateMinMs = kDefaultPollMs;
 const int PowerSupply::kBatteryStabilizedSlackMs = 50;
 const double PowerSupply::kLowBatteryShutdownSafetyPercent = 5.0;
@@ -559,36 +612,36 @@ bool PowerSupply::UpdatePowerStatus(UpdatePolicy policy) {
 
   // The battery state is dependent on the line power state, so defer reading it
   // until all other directories have been examined.
-  base::FilePath battery_path;
+  std::unique_ptr<PowerSupplyAttributes> battery;
 
   // Iterate through sysfs's power supply information.
   base::FileEnumerator file_enum(
       power_supply_path_, false, base::FileEnumerator::DIRECTORIES);
   for (base::FilePath path = file_enum.Next(); !path.empty();
        path = file_enum.Next()) {
-    if (IsExternalPeripheral(path))
+    std::unique_ptr<PowerSupplyAttributes> attributes(
+        new PowerSupplyAttributes(path));
+    if (attributes->IsExternalPeripheral())
       continue;
 
     std::string type;
-    if (!base::ReadFileToString(path.Append("type"), &type))
+    if (!attributes->ReadString("type", &type))
       continue;
-    base::TrimWhitespaceASCII(type, base::TRIM_TRAILING, &type);
 
     saw_power_source = true;
 
     if (type == kBatteryType) {
-      if (battery_path.empty())
-        battery_path = path;
+      if (!battery)
+        battery = std::move(attributes);
       else
         LOG(WARNING) << "Multiple batteries; skipping " << path.value();
     } else {
-      ReadLinePowerDirectory(path, &status);
+      ReadLinePowerDirectory(*attributes, &status);
     }
   }
 
   // If no battery was found, assume that the system is actually on AC power.
-  if (!status.line_power_on &&
-      (battery_path.empty() || !IsBatteryPresent(battery_path))) {
+  if (!status.line_power_on && (!battery || !battery->IsBatteryPresent())) {
     if (saw_power_source) {
       // Batteryless Chromeboxes sometimes don't report any power sources. If we
       // saw at least one source but it wasn't online, the battery status might
@@ -613,7 +666,7 @@ bool PowerSupply::UpdatePowerStatus(UpdatePolicy policy) {
     power_status_ = status;
 
   // Finally, read the battery status.
-  if (!battery_path.empty() && !ReadBatteryDirectory(battery_path, &status))
+  if (battery && !ReadBatteryDirectory(*battery, &status))
     return false;
 
   // Bail out before recording charge and current samples if this was a spurious
@@ -669,18 +722,20 @@ bool PowerSupply::UpdatePowerStatus(UpdatePolicy policy) {
   return true;
 }
 
-void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
-                                         PowerStatus* status) {
+void PowerSupply::ReadLinePowerDirectory(
+    const PowerSupplyAttributes& attributes, PowerStatus* status) {
+  const base::FilePath& path = attributes.path();
+
   // Bidirectional/dual-role ports export a "status" field.
   std::string line_status;
-  ReadAndTrimString(path, "status", &line_status);
+  attributes.ReadString("status", &line_status);
   const bool is_dual_role_port = !line_status.empty();
   if (is_dual_role_port)
     status->supports_dual_role_devices = true;
 
   // An "Unknown" type indicates a sink-only device that can't supply power.
   std::string type;
-  ReadAndTrimString(path, "type", &type);
+  attributes.ReadString("type", &type);
   if (type == kUnknownType)
     return;
 
@@ -688,7 +743,7 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
   // in which case, an online of 0 indicates connected to a Dual Role device
   // but not sinking power.
   int64_t online_value = 0;
-  if ((!ReadInt64(path, "online", &online_value) || !online_value) &&
+  if ((!attributes.ReadInt64("online", &online_value) || !online_value) &&
       !IsDualRoleType(type))
     return;
 
@@ -709,11 +764,11 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
           : PowerSupplyProperties_PowerSource_Port_UNKNOWN;
 
   std::string manufacturer_id, model_id;
-  ReadAndTrimString(path, "manufacturer", &manufacturer_id);
-  ReadAndTrimString(path, "model_name", &model_id);
+  attributes.ReadString("manufacturer", &manufacturer_id);
+  attributes.ReadString("model_name", &model_id);
 
-  const double max_voltage = ReadScaledDouble(path, "voltage_max_design");
-  const double max_current = ReadScaledDouble(path, "current_max");
+  const double max_voltage = attributes.ReadScaledDouble("voltage_max_design");
+  const double max_current = attributes.ReadScaledDouble("current_max");
   const double max_power = max_voltage * max_current;  // watts
 
   status->available_external_power_sources.push_back(PowerStatus::Source(
@@ -737,9 +792,9 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
   status->line_power_on = true;
   status->line_power_path = path.value();
   status->line_power_type = type;
-  status->line_power_voltage = ReadScaledDouble(path, "voltage_now");
+  status->line_power_voltage = attributes.ReadScaledDouble("voltage_now");
   status->line_power_max_voltage = max_voltage;
-  status->line_power_current = ReadScaledDouble(path, "current_now");
+  status->line_power_current = attributes.ReadScaledDouble("current_now");
   status->line_power_max_current = max_current;
 
   // The USB PD driver reports the maximum power as being 0 watts while it's
@@ -765,27 +820,28 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
           << "\" at " << path.value();
 }
 
-bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
+bool PowerSupply::ReadBatteryDirectory(const PowerSupplyAttributes& attributes,
                                        PowerStatus* status) {
+  const base::FilePath& path = attributes.path();
   VLOG(1) << "Reading battery status from " << path.value();
   status->battery_path = path.value();
-  status->battery_is_present = IsBatteryPresent(path);
+  status->battery_is_present = attributes.IsBatteryPresent();
   if (!status->battery_is_present)
     return true;
 
   std::string status_value;
-  ReadAndTrimString(path, "status", &status_value);
+  attributes.ReadString("status", &status_value);
 
   // POWER_SUPPLY_PROP_VENDOR does not seem to be a valid property
   // defined in <linux/power_supply.h>.
-  ReadAndTrimString(path,
-      base::PathExists(path.Append("manufacturer")) ? "manufacturer" : "vendor",
+  attributes.ReadString(
+      attributes.Has("manufacturer") ? "manufacturer" : "vendor",
       &status->battery_vendor);
-  ReadAndTrimString(path, "model_name", &status->battery_model_name);
-  ReadAndTrimString(path, "serial_number", &status->battery_serial);
-  ReadAndTrimString(path, "technology", &status->battery_technology);
+  attributes.ReadString("model_name", &status->battery_model_name);
+  attributes.ReadString("serial_number", &status->battery_serial);
+  attributes.ReadString("technology", &status->battery_technology);
 
-  double voltage = ReadScaledDouble(path, "voltage_now");
+  double voltage = attributes.ReadScaledDouble("voltage_now");
   status->battery_voltage = voltage;
 
   // Attempt to determine nominal voltage for time-remaining calculations. This
@@ -794,10 +850,10 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
   // Some batteries don't have a voltage_min/max_design attribute, so just use
   // the current voltage in that case.
   double nominal_voltage = voltage;
-  if (base::PathExists(path.Append("voltage_min_design")))
-    nominal_voltage = ReadScaledDouble(path, "voltage_min_design");
-  else if (base::PathExists(path.Append("voltage_max_design")))
-    nominal_voltage = ReadScaledDouble(path, "voltage_max_design");
+  if (attributes.Has("voltage_min_design"))
+    nominal_voltage = attributes.ReadScaledDouble("voltage_min_design");
+  else if (attributes.Has("voltage_max_design"))
+    nominal_voltage = attributes.ReadScaledDouble("voltage_max_design");
 
   // Nominal voltage is not required to obtain the charge level; if it's
   // missing, just use |battery_voltage|. Save the fact that it was zero so it
@@ -830,16 +886,16 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
   double charge = 0;
   double energy = 0;
 
-  if (base::PathExists(path.Append("energy_now")))
-    energy = ReadScaledDouble(path, "energy_now");
+  if (attributes.Has("energy_now"))
+    energy = attributes.ReadScaledDouble("energy_now");
 
-  if (base::PathExists(path.Append("charge_full"))) {
-    charge_full = ReadScaledDouble(path, "charge_full");
-    charge_full_design = ReadScaledDouble(path, "charge_full_design");
-    charge = ReadScaledDouble(path, "charge_now");
+  if (attributes.Has("charge_full")) {
+    charge_full = attributes.ReadScaledDouble("charge_full");
+    charge_full_design = attributes.ReadScaledDouble("charge_full_design");
+    charge = attributes.ReadScaledDouble("charge_now");
     if (energy <= 0.0)
       energy = charge * nominal_voltage;
-  } else if (base::PathExists(path.Append("energy_full"))) {
+  } else if (attributes.Has("energy_full")) {
     // Valid voltage is required to determine the charge so return early if it
     // is not present. In this case, we know nothing about battery state or
     // remaining percentage, so set proper status.
@@ -848,8 +904,8 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
                    << " conversion: " << nominal_voltage;
       return false;
     }
-    charge_full = ReadScaledDouble(path, "energy_full") / nominal_voltage;
-    charge_full_design = ReadScaledDouble(path, "energy_full_design") /
+    charge_full = attributes.ReadScaledDouble("energy_full") / nominal_voltage;
+    charge_full_design = attributes.ReadScaledDouble("energy_full_design") /
                          nominal_voltage;
     charge = energy / nominal_voltage;
   } else {
@@ -876,9 +932,9 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
   // The current can be reported as negative on some systems but not on others,
   // so it can't be used to determine whether the battery is charging or
   // discharging.
-  double current = base::PathExists(path.Append("power_now")) ?
-      fabs(ReadScaledDouble(path, "power_now")) / voltage :
-      fabs(ReadScaledDouble(path, "current_now"));
+  double current = attributes.Has("power_now") ?
+      fabs(attributes.ReadScaledDouble("power_now")) / voltage :
+      fabs(attributes.ReadScaledDouble("current_now"));
   status->battery_current = current;
   status->battery_energy_rate = current * voltage;
 
@@ -1018,6 +1074,20 @@ bool PowerSupply::PerformUpdate(UpdatePolicy update_policy,
 
 void PowerSupply::SchedulePoll() {
   base::TimeDelta delay = poll_delay_;
+  if (power_status_initialized_) {
+    // Without a battery, there's nothing to sample: udev events report line
+    // power sources being connected or disconnected.
+    if (power_status_.battery_path.empty()) {
+      VLOG(1) << "No battery; not polling";
+      poll_timer_.Stop();
+      current_poll_delay_for_testing_ = base::TimeDelta();
+      return;
+    }
+    if (power_status_.line_power_on &&
+        power_status_.battery_state == PowerSupplyProperties_BatteryState_FULL)
+      delay *= kFullBatteryPollMultiplier;
+  }
+
   base::TimeTicks now = clock_->GetCurrentTime();
   if (battery_stabilized_timestamp_ > now) {
     delay = std::min(delay,
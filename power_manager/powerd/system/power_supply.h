@@ -32,6 +32,7 @@ class PrefsInterface;
 namespace system {
 
 struct PowerStatus;
+class PowerSupplyAttributes;
 class UdevInterface;
 
 // Copies fields from |status| into |proto|.
@@ -238,6 +239,11 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   // device be used to deliver power to the system.
   static const char kChargeControlLimitMaxFile[];
 
+  // When the battery is full and line power is connected, the status is
+  // polled this many times less often than usual: udev events report the
+  // charger being disconnected, and the time-to-full estimate isn't needed.
+  static const int kFullBatteryPollMultiplier;
+
   // Minimum duration of samples that need to be present in |charge_samples_|
   // for the observed battery charge rate to be calculated.
   static const int kObservedBatteryChargeRateMinMs;
@@ -318,16 +324,17 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   // connected power sources have not changed.
   bool UpdatePowerStatus(UpdatePolicy policy);
 
-  // Helper method for UpdatePowerStatus() that reads |path|, a directory under
-  // |power_supply_path_| corresponding to a line power source (e.g. anything
-  // that isn't a battery), and updates |status|.
-  void ReadLinePowerDirectory(const base::FilePath& path,
+  // Helper method for UpdatePowerStatus() that reads |attributes|, read from
+  // a directory under |power_supply_path_| corresponding to a line power
+  // source (e.g. anything that isn't a battery), and updates |status|.
+  void ReadLinePowerDirectory(const PowerSupplyAttributes& attributes,
                               PowerStatus* status);
 
-  // Helper method for UpdatePowerStatus() that reads |path|, a directory under
-  // |power_supply_path_| corresponding to a battery, and updates |status|.
-  // Returns false if an error is encountered.
-  bool ReadBatteryDirectory(const base::FilePath& path, PowerStatus* status);
+  // Helper method for UpdatePowerStatus() that reads |attributes|, read from
+  // a directory under |power_supply_path_| corresponding to a battery, and
+  // updates |status|. Returns false if an error is encountered.
+  bool ReadBatteryDirectory(const PowerSupplyAttributes& attributes,
+                            PowerStatus* status);
 
   // Updates |status|'s time-to-full and time-to-empty estimates or returns
   // false if estimates can't be calculated yet. Negative values are used
@@ -352,7 +359,9 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   // according to |notify_policy| on success.
   bool PerformUpdate(UpdatePolicy update_policy, NotifyPolicy notify_policy);
 
-  // Schedules |poll_timer_| to call HandlePollTimeout().
+  // Schedules |poll_timer_| to call HandlePollTimeout(), or stops it if
+  // |power_status_| can be kept up to date by udev events alone (i.e. there's
+  // no battery whose charge needs to be sampled).
   void SchedulePoll();
 
   // Handles |poll_timer_| firing. Updates |power_status_| and reschedules the
@@ -427,7 +436,7 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   double full_factor_;
 
   // Amount of time to wait before updating |power_status_| again after an
-  // update.
+  // update while the battery is charging or discharging.
   base::TimeDelta poll_delay_;
 
   // Calls HandlePollTimeout().
@@ -621,7 +621,9 @@ TEST_F(PowerSupplyTest, EnergyDischarging) {
 }
 
 TEST_F(PowerSupplyTest, PollDelays) {
+  // Start out charging rather than full; a full battery is polled less often.
   WriteDefaultValues(POWER_AC);
+  UpdateChargeAndCurrent(0.5, 1.0);
 
   const base::TimeDelta kPollDelay = base::TimeDelta::FromSeconds(30);
   const base::TimeDelta kStartupDelay = base::TimeDelta::FromSeconds(6);
@@ -722,6 +724,42 @@ TEST_F(PowerSupplyTest, PollDelays) {
   EXPECT_FALSE(status.is_calculating_battery_time);
 }
 
+TEST_F(PowerSupplyTest, PollOnlyToSampleBattery) {
+  const base::TimeDelta kPollDelay = base::TimeDelta::FromSeconds(30);
+  prefs_.SetInt64(kBatteryPollIntervalPref, kPollDelay.InMilliseconds());
+  prefs_.SetInt64(kBatteryStabilizedAfterStartupMsPref, 0);
+  prefs_.SetInt64(kBatteryStabilizedAfterLinePowerConnectedMsPref, 0);
+  prefs_.SetInt64(kBatteryStabilizedAfterLinePowerDisconnectedMsPref, 0);
+
+  // Without a battery, udev events are enough to track line power.
+  WriteDefaultValues(POWER_AC);
+  base::DeleteFile(battery_dir_, true);
+  Init();
+  PowerStatus status;
+  ASSERT_TRUE(UpdateStatus(&status));
+  EXPECT_EQ(0, test_api_->current_poll_delay().InMilliseconds());
+  EXPECT_FALSE(test_api_->TriggerPollTimeout());
+
+  // A full battery on line power is polled less often.
+  WriteDefaultValues(POWER_AC);
+  SendUdevEvent();
+  status = power_supply_->GetPowerStatus();
+  ASSERT_TRUE(status.battery_is_present);
+  ASSERT_EQ(PowerSupplyProperties_BatteryState_FULL, status.battery_state);
+  EXPECT_EQ((kPollDelay * PowerSupply::kFullBatteryPollMultiplier)
+                .InMilliseconds(),
+            test_api_->current_poll_delay().InMilliseconds());
+
+  // Once the charger is disconnected, the battery is polled as usual.
+  UpdatePowerSourceAndBatteryStatus(POWER_BATTERY, kAcType, kDischarging);
+  SendUdevEvent();
+  status = power_supply_->GetPowerStatus();
+  ASSERT_EQ(PowerSupplyProperties_BatteryState_DISCHARGING,
+            status.battery_state);
+  EXPECT_EQ(kPollDelay.InMilliseconds(),
+            test_api_->current_poll_delay().InMilliseconds());
+}
+
 TEST_F(PowerSupplyTest, UpdateBatteryTimeEstimates) {
   // Start out with the battery 50% full and an unset current.
   WriteDefaultValues(POWER_AC);
@@ -1483,6 +1521,39 @@ TEST_F(PowerSupplyTest, BatteryEnergyValue) {
   EXPECT_DOUBLE_EQ(kCharge, status.battery_charge);
 }
 
+TEST_F(PowerSupplyTest, ReadUevent) {
+  const double kCharge = 0.5;
+  const double kCurrent = 1.0;
+  WriteDefaultValues(POWER_BATTERY);
+  UpdateChargeAndCurrent(0.25, 2.0);
+
+  // Values listed by the "uevent" file should be used instead of the
+  // attributes' own files. Attributes that it doesn't list are still read
+  // from their files.
+  WriteValue(battery_dir_, "uevent", base::StringPrintf(
+      "POWER_SUPPLY_NAME=battery\n"
+      "POWER_SUPPLY_STATUS=%s\n"
+      "POWER_SUPPLY_PRESENT=1\n"
+      "POWER_SUPPLY_MODEL_NAME=Model Name\n"
+      "POWER_SUPPLY_CHARGE_NOW=%d\n"
+      "POWER_SUPPLY_CURRENT_NOW=%d\n",
+      kDischarging, static_cast<int>(round(kCharge * 1000000)),
+      static_cast<int>(round(kCurrent * 1000000))));
+  WriteValue(battery_dir_, "model_name", "Other Name");
+  Init();
+
+  PowerStatus status;
+  ASSERT_TRUE(UpdateStatus(&status));
+  EXPECT_TRUE(status.battery_is_present);
+  EXPECT_EQ(PowerSupplyProperties_BatteryState_DISCHARGING,
+            status.battery_state);
+  EXPECT_EQ("Model Name", status.battery_model_name);
+  EXPECT_DOUBLE_EQ(kCharge, status.battery_charge);
+  EXPECT_DOUBLE_EQ(kCurrent, status.battery_current);
+  EXPECT_DOUBLE_EQ(1.0, status.battery_charge_full);
+  EXPECT_DOUBLE_EQ(kVoltage, status.battery_voltage);
+}
+
 TEST_F(PowerSupplyTest, NoNominalVoltage) {
   const double kCharge = 0.5;
   const double kCurrent = 1.0;